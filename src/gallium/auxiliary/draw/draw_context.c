@@ -41,7 +41,6 @@
 #include "draw_gs.h"
 
 #if HAVE_LLVM
-#include "gallivm/lp_bld_init.h"
 #include "draw_llvm.h"
 
 static boolean
@@ -71,17 +70,6 @@ draw_get_option_use_llvm(void)
  */
 struct draw_context *
 draw_create(struct pipe_context *pipe)
-{
-   return draw_create_gallivm(pipe, NULL);
-}
-
-
-
-/**
- * Create new draw module context with gallivm state for LLVM JIT.
- */
-struct draw_context *
-draw_create_gallivm(struct pipe_context *pipe, struct gallivm_state *gallivm)
 {
    struct draw_context *draw = CALLOC_STRUCT( draw_context );
    if (draw == NULL)
@@ -89,13 +77,7 @@ draw_create_gallivm(struct pipe_context *pipe, struct gallivm_state *gallivm)
 
 #if HAVE_LLVM
    if (draw_get_option_use_llvm()) {
-      if (!gallivm) {
-         gallivm = gallivm_create();
-         draw->own_gallivm = gallivm;
-      }
-
-      if (gallivm)
-         draw->llvm = draw_llvm_create(draw, gallivm);
+      draw->llvm = draw_llvm_create(draw);
    }
 #endif
 
@@ -188,9 +170,6 @@ void draw_destroy( struct draw_context *draw )
 #ifdef HAVE_LLVM
    if (draw->llvm)
       draw_llvm_destroy( draw->llvm );
-
-   if (draw->own_gallivm)
-      gallivm_destroy(draw->own_gallivm);
 #endif
 
    FREE( draw );
@@ -56,35 +56,6 @@
 #define DEBUG_STORE 0
 
 
-/**
- * This function is called by the gallivm "garbage collector" when
- * the LLVM global data structures are freed.  We must free all LLVM-related
- * data.  Specifically, all JIT'd shader variants.
- */
-static void
-draw_llvm_garbage_collect_callback(void *cb_data)
-{
-   struct draw_llvm *llvm = (struct draw_llvm *) cb_data;
-   struct draw_llvm_variant_list_item *li;
-
-   /* free all shader variants */
-   li = first_elem(&llvm->vs_variants_list);
-   while (!at_end(&llvm->vs_variants_list, li)) {
-      struct draw_llvm_variant_list_item *next = next_elem(li);
-      draw_llvm_destroy_variant(li->base);
-      li = next;
-   }
-
-   /* Null-out these pointers so they get remade next time they're needed.
-    * See the accessor functions below.
-    */
-   llvm->context_ptr_type = NULL;
-   llvm->buffer_ptr_type = NULL;
-   llvm->vb_ptr_type = NULL;
-   llvm->vertex_header_ptr_type = NULL;
-}
-
-
 static void
 draw_llvm_generate(struct draw_llvm *llvm, struct draw_llvm_variant *var,
                    boolean elts);
@@ -319,56 +290,21 @@ create_jit_vertex_header(struct gallivm_state *gallivm, int data_elems)
  * Create LLVM types for various structures.
  */
 static void
-create_jit_types(struct draw_llvm *llvm)
+create_jit_types(struct draw_llvm_variant *variant)
 {
-   struct gallivm_state *gallivm = llvm->gallivm;
+   struct gallivm_state *gallivm = variant->gallivm;
    LLVMTypeRef texture_type, context_type, buffer_type, vb_type;
 
    texture_type = create_jit_texture_type(gallivm, "texture");
 
    context_type = create_jit_context_type(gallivm, texture_type, "draw_jit_context");
-   llvm->context_ptr_type = LLVMPointerType(context_type, 0);
+   variant->context_ptr_type = LLVMPointerType(context_type, 0);
 
    buffer_type = LLVMPointerType(LLVMIntTypeInContext(gallivm->context, 8), 0);
-   llvm->buffer_ptr_type = LLVMPointerType(buffer_type, 0);
+   variant->buffer_ptr_type = LLVMPointerType(buffer_type, 0);
 
    vb_type = create_jit_vertex_buffer_type(gallivm, "pipe_vertex_buffer");
-   llvm->vb_ptr_type = LLVMPointerType(vb_type, 0);
-}
-
-
-static LLVMTypeRef
-get_context_ptr_type(struct draw_llvm *llvm)
-{
-   if (!llvm->context_ptr_type)
-      create_jit_types(llvm);
-   return llvm->context_ptr_type;
-}
-
-
-static LLVMTypeRef
-get_buffer_ptr_type(struct draw_llvm *llvm)
-{
-   if (!llvm->buffer_ptr_type)
-      create_jit_types(llvm);
-   return llvm->buffer_ptr_type;
-}
-
-
-static LLVMTypeRef
-get_vb_ptr_type(struct draw_llvm *llvm)
-{
-   if (!llvm->vb_ptr_type)
-      create_jit_types(llvm);
-   return llvm->vb_ptr_type;
-}
-
-static LLVMTypeRef
-get_vertex_header_ptr_type(struct draw_llvm *llvm)
-{
-   if (!llvm->vertex_header_ptr_type)
-      create_jit_types(llvm);
-   return llvm->vertex_header_ptr_type;
+   variant->vb_ptr_type = LLVMPointerType(vb_type, 0);
 }
 
 
@@ -376,7 +312,7 @@ get_vertex_header_ptr_type(struct draw_llvm *llvm)
  * Create per-context LLVM info.
  */
 struct draw_llvm *
-draw_llvm_create(struct draw_context *draw, struct gallivm_state *gallivm)
+draw_llvm_create(struct draw_context *draw)
 {
    struct draw_llvm *llvm;
 
@@ -387,18 +323,10 @@ draw_llvm_create(struct draw_context *draw, struct gallivm_state *gallivm)
    lp_build_init();
 
    llvm->draw = draw;
-   llvm->gallivm = gallivm;
-
-   if (gallivm_debug & GALLIVM_DEBUG_IR) {
-      LLVMDumpModule(llvm->gallivm->module);
-   }
 
    llvm->nr_variants = 0;
    make_empty_list(&llvm->vs_variants_list);
 
-   gallivm_register_garbage_collector_callback(
-                              draw_llvm_garbage_collect_callback, llvm);
-
    return llvm;
 }
 
@@ -409,9 +337,6 @@ draw_llvm_create(struct draw_context *draw, struct gallivm_state *gallivm)
 void
 draw_llvm_destroy(struct draw_llvm *llvm)
 {
-   gallivm_remove_garbage_collector_callback(
-                              draw_llvm_garbage_collect_callback, llvm);
-
    /* XXX free other draw_llvm data? */
    FREE(llvm);
 }
@@ -438,11 +363,22 @@ draw_llvm_create_variant(struct draw_llvm *llvm,
 
    variant->llvm = llvm;
 
+   /* Each variant is compiled in its own LLVM context, so that destroying
+    * it frees all the memory used for its code.
+    */
+   variant->gallivm = gallivm_create();
+   if (!variant->gallivm) {
+      FREE(variant);
+      return NULL;
+   }
+
    memcpy(&variant->key, key, shader->variant_key_size);
 
-   vertex_header = create_jit_vertex_header(llvm->gallivm, num_inputs);
+   create_jit_types(variant);
+
+   vertex_header = create_jit_vertex_header(variant->gallivm, num_inputs);
 
-   llvm->vertex_header_ptr_type = LLVMPointerType(vertex_header, 0);
+   variant->vertex_header_ptr_type = LLVMPointerType(vertex_header, 0);
 
    draw_llvm_generate(llvm, variant, FALSE);  /* linear */
    draw_llvm_generate(llvm, variant, TRUE);   /* elts */
@@ -458,7 +394,7 @@ draw_llvm_create_variant(struct draw_llvm *llvm,
 
 
 static void
-generate_vs(struct draw_llvm *llvm,
+generate_vs(struct draw_llvm_variant *variant,
             LLVMBuilderRef builder,
             LLVMValueRef (*outputs)[NUM_CHANNELS],
             const LLVMValueRef (*inputs)[NUM_CHANNELS],
@@ -467,9 +403,11 @@ generate_vs(struct draw_llvm *llvm,
             struct lp_build_sampler_soa *draw_sampler,
             boolean clamp_vertex_color)
 {
+   struct draw_llvm *llvm = variant->llvm;
+   struct gallivm_state *gallivm = variant->gallivm;
    const struct tgsi_token *tokens = llvm->draw->vs.vertex_shader->state.tokens;
    struct lp_type vs_type;
-   LLVMValueRef consts_ptr = draw_jit_context_vs_constants(llvm->gallivm, context_ptr);
+   LLVMValueRef consts_ptr = draw_jit_context_vs_constants(gallivm, context_ptr);
    struct lp_build_sampler_soa *sampler = 0;
 
    memset(&vs_type, 0, sizeof vs_type);
@@ -489,7 +427,7 @@ generate_vs(struct draw_llvm *llvm,
    if (llvm->draw->num_sampler_views && llvm->draw->num_samplers)
       sampler = draw_sampler;
 
-   lp_build_tgsi_soa(llvm->gallivm,
+   lp_build_tgsi_soa(gallivm,
                      tokens,
                      vs_type,
                      NULL /*struct lp_build_mask_context *mask*/,
@@ -506,7 +444,7 @@ generate_vs(struct draw_llvm *llvm,
       unsigned chan, attrib;
       struct lp_build_context bld;
       struct tgsi_shader_info* info = &llvm->draw->vs.vertex_shader->info;
-      lp_build_context_init(&bld, llvm->gallivm, vs_type);
+      lp_build_context_init(&bld, gallivm, vs_type);
 
       for (attrib = 0; attrib < info->num_outputs; ++attrib) {
          for (chan = 0; chan < NUM_CHANNELS; ++chan) {
@@ -963,13 +901,13 @@ vec4f_from_scalar(struct gallivm_state *gallivm,
  * Transforms the outputs for viewport mapping
  */
 static void
-generate_viewport(struct draw_llvm *llvm,
+generate_viewport(struct draw_llvm_variant *variant,
                   LLVMBuilderRef builder,
                   LLVMValueRef (*outputs)[NUM_CHANNELS],
                   LLVMValueRef context_ptr)
 {
    int i;
-   struct gallivm_state *gallivm = llvm->gallivm;
+   struct gallivm_state *gallivm = variant->gallivm;
    struct lp_type f32_type = lp_type_float_vec(32);
    LLVMValueRef out3 = LLVMBuildLoad(builder, outputs[0][3], ""); /*w0 w1 w2 w3*/   
    LLVMValueRef const1 = lp_build_const_vec(gallivm, f32_type, 1.0);       /*1.0 1.0 1.0 1.0*/ 
@@ -1170,7 +1108,7 @@ static void
 draw_llvm_generate(struct draw_llvm *llvm, struct draw_llvm_variant *variant,
                    boolean elts)
 {
-   struct gallivm_state *gallivm = llvm->gallivm;
+   struct gallivm_state *gallivm = variant->gallivm;
    LLVMContextRef context = gallivm->context;
    LLVMTypeRef int32_type = LLVMInt32TypeInContext(context);
    LLVMTypeRef arg_types[8];
@@ -1203,16 +1141,16 @@ draw_llvm_generate(struct draw_llvm *llvm, struct draw_llvm_variant *variant,
                                    variant->key.clip_user;
    LLVMValueRef variant_func;
 
-   arg_types[0] = get_context_ptr_type(llvm);       /* context */
-   arg_types[1] = get_vertex_header_ptr_type(llvm); /* vertex_header */
-   arg_types[2] = get_buffer_ptr_type(llvm);        /* vbuffers */
+   arg_types[0] = variant->context_ptr_type;        /* context */
+   arg_types[1] = variant->vertex_header_ptr_type;  /* vertex_header */
+   arg_types[2] = variant->buffer_ptr_type;         /* vbuffers */
    if (elts)
       arg_types[3] = LLVMPointerType(int32_type, 0);/* fetch_elts * */
    else
       arg_types[3] = int32_type;                    /* start */
    arg_types[4] = int32_type;                       /* fetch_count / count */
    arg_types[5] = int32_type;                       /* stride */
-   arg_types[6] = get_vb_ptr_type(llvm);            /* pipe_vertex_buffer's */
+   arg_types[6] = variant->vb_ptr_type;             /* pipe_vertex_buffer's */
    arg_types[7] = int32_type;                       /* instance_id */
 
    func_type = LLVMFunctionType(int32_type, arg_types, Elements(arg_types), 0);
@@ -1345,7 +1283,7 @@ draw_llvm_generate(struct draw_llvm *llvm, struct draw_llvm_variant *variant,
                      draw->pt.nr_vertex_elements);
 
       ptr_aos = (const LLVMValueRef (*)[NUM_CHANNELS]) inputs;
-      generate_vs(llvm,
+      generate_vs(variant,
                   builder,
                   outputs,
                   ptr_aos,
@@ -1376,7 +1314,7 @@ draw_llvm_generate(struct draw_llvm *llvm, struct draw_llvm_variant *variant,
       
       /* do viewport mapping */
       if (!bypass_viewport) {
-         generate_viewport(llvm, builder, outputs, context_ptr);
+         generate_viewport(variant, builder, outputs, context_ptr);
       }
 
       /* store clipmask in vertex header, 
@@ -1404,14 +1342,14 @@ draw_llvm_generate(struct draw_llvm *llvm, struct draw_llvm_variant *variant,
    }
 #endif
 
-   LLVMRunFunctionPassManager(gallivm->passmgr, variant_func);
+   gallivm_optimize_function(gallivm, variant_func);
 
    if (gallivm_debug & GALLIVM_DEBUG_IR) {
       lp_debug_dump_value(variant_func);
       debug_printf("\n");
    }
 
-   code = LLVMGetPointerToGlobal(gallivm->engine, variant_func);
+   code = gallivm_jit_function(gallivm, variant_func);
    if (elts)
       variant->jit_func_elts = (draw_jit_vert_func_elts) pointer_to_func(code);
    else
@@ -1527,17 +1465,10 @@ draw_llvm_destroy_variant(struct draw_llvm_variant *variant)
 {
    struct draw_llvm *llvm = variant->llvm;
 
-   if (variant->function_elts) {
-      LLVMFreeMachineCodeForFunction(llvm->gallivm->engine,
-                                     variant->function_elts);
-      LLVMDeleteFunction(variant->function_elts);
-   }
-
-   if (variant->function) {
-      LLVMFreeMachineCodeForFunction(llvm->gallivm->engine,
-                                     variant->function);
-      LLVMDeleteFunction(variant->function);
-   }
+   /* frees both functions' machine code, and all the LLVM memory used to
+    * generate them
+    */
+   gallivm_destroy(variant->gallivm);
 
    remove_from_list(&variant->list_item_local);
    variant->shader->variants_cached--;
@@ -30,7 +30,7 @@
 #include "util/u_cpu_detect.h"
 #include "util/u_debug.h"
 #include "util/u_memory.h"
-#include "util/u_simple_list.h"
+#include "os/os_time.h"
 #include "lp_bld_debug.h"
 #include "lp_bld_init.h"
 
@@ -57,6 +57,8 @@ DEBUG_GET_ONCE_FLAGS_OPTION(gallivm_debug, "GALLIVM_DEBUG", lp_bld_debug_flags,
 
 static boolean gallivm_initialized = FALSE;
 
+boolean gallivm_multithreaded = FALSE;
+
 
 /*
  * Optimization values are:
@@ -88,11 +90,14 @@ lp_register_oprofile_jit_event_listener(LLVMExecutionEngineRef EE);
 extern void
 lp_set_target_options(void);
 
+extern boolean
+lp_start_multithreaded(void);
+
 
 
 /**
  * Create the LLVM (optimization) pass manager and install
- * relevant optimization passes.
+ * relevant optimization passes for the gallivm's profile.
  * \return  TRUE for success, FALSE for failure
  */
 static boolean
@@ -106,11 +111,16 @@ create_pass_manager(struct gallivm_state *gallivm)
 
    LLVMAddTargetData(gallivm->target, gallivm->passmgr);
 
-   if ((gallivm_debug & GALLIVM_DEBUG_NO_OPT) == 0) {
+   if ((gallivm_debug & GALLIVM_DEBUG_NO_OPT) == 0 &&
+       gallivm->profile != GALLIVM_PROFILE_FAST) {
       /* These are the passes currently listed in llvm-c/Transforms/Scalar.h,
        * but there are more on SVN.
        * TODO: Add more passes.
        */
+      if (gallivm->profile == GALLIVM_PROFILE_FULL) {
+         LLVMAddScalarReplAggregatesPass(gallivm->passmgr);
+      }
+
       LLVMAddCFGSimplificationPass(gallivm->passmgr);
 
       if (HAVE_LLVM >= 0x207 && sizeof(void*) == 4) {
@@ -133,13 +143,31 @@ create_pass_manager(struct gallivm_state *gallivm)
           */
          LLVMAddInstructionCombiningPass(gallivm->passmgr);
       }
+
+      if (gallivm->profile == GALLIVM_PROFILE_FULL) {
+         LLVMAddReassociatePass(gallivm->passmgr);
+      }
+
       LLVMAddGVNPass(gallivm->passmgr);
+
+      if (gallivm->profile == GALLIVM_PROFILE_FULL) {
+         /* Hoist the invariant interpolation and texture state loads out
+          * of the block loops of the whole tile functions, and clean up
+          * after GVN.
+          */
+         LLVMAddLICMPass(gallivm->passmgr);
+         LLVMAddDeadStoreEliminationPass(gallivm->passmgr);
+         LLVMAddAggressiveDCEPass(gallivm->passmgr);
+         LLVMAddCFGSimplificationPass(gallivm->passmgr);
+      }
    }
    else {
       /* We need at least this pass to prevent the backends to fail in
        * unexpected ways.
        */
       LLVMAddPromoteMemoryToRegisterPass(gallivm->passmgr);
+      if (gallivm->profile == GALLIVM_PROFILE_FAST)
+         LLVMAddCFGSimplificationPass(gallivm->passmgr);
    }
 
    return TRUE;
@@ -152,47 +180,32 @@ create_pass_manager(struct gallivm_state *gallivm)
 static void
 free_gallivm_state(struct gallivm_state *gallivm)
 {
-#if HAVE_LLVM >= 0x207 /* XXX or 0x208? */
-   /* This leads to crashes w/ some versions of LLVM */
-   LLVMModuleRef mod;
-   char *error;
-
-   if (gallivm->engine && gallivm->provider)
-      LLVMRemoveModuleProvider(gallivm->engine, gallivm->provider,
-                               &mod, &error);
-#endif
-
-#if 0
-   /* XXX this seems to crash with all versions of LLVM */
-   if (gallivm->provider)
-      LLVMDisposeModuleProvider(gallivm->provider);
-#endif
-
    if (gallivm->passmgr)
       LLVMDisposePassManager(gallivm->passmgr);
 
-#if HAVE_LLVM >= 0x207
-   if (gallivm->module)
-      LLVMDisposeModule(gallivm->module);
-#endif
+   if (gallivm->builder)
+      LLVMDisposeBuilder(gallivm->builder);
 
-#if 0
-   /* Don't free the exec engine, it's a global/singleton */
-   if (gallivm->engine)
+   if (gallivm->engine) {
+      /* The engine owns the module, and frees it along with the machine
+       * code of all its functions.
+       */
       LLVMDisposeExecutionEngine(gallivm->engine);
+   }
+   else {
+#if HAVE_LLVM >= 0x207
+      if (gallivm->module)
+         LLVMDisposeModule(gallivm->module);
 #endif
+   }
 
-#if 0
-   /* Don't free the TargetData, it's owned by the exec engine */
-   LLVMDisposeTargetData(gallivm->target);
-#endif
+   /* TargetData is owned by the exec engine, and the module provider by
+    * the module.
+    */
 
    if (gallivm->context)
       LLVMContextDispose(gallivm->context);
 
-   if (gallivm->builder)
-      LLVMDisposeBuilder(gallivm->builder);
-
    gallivm->engine = NULL;
    gallivm->target = NULL;
    gallivm->module = NULL;
@@ -210,7 +223,8 @@ free_gallivm_state(struct gallivm_state *gallivm)
 static boolean
 init_gallivm_state(struct gallivm_state *gallivm)
 {
-   LLVMExecutionEngineRef GlobalEngine = NULL;
+   enum LLVM_CodeGenOpt_Level optlevel;
+   char *error = NULL;
 
    assert(!gallivm->context);
    assert(!gallivm->module);
@@ -232,33 +246,34 @@ init_gallivm_state(struct gallivm_state *gallivm)
    if (!gallivm->provider)
       goto fail;
 
-   if (!GlobalEngine) {
-      /* We can only create one LLVMExecutionEngine (w/ LLVM 2.6 anyway) */
-      enum LLVM_CodeGenOpt_Level optlevel;
-      char *error = NULL;
-
-      if (gallivm_debug & GALLIVM_DEBUG_NO_OPT) {
+   if (gallivm_debug & GALLIVM_DEBUG_NO_OPT) {
+      optlevel = None;
+   }
+   else {
+      switch (gallivm->profile) {
+      case GALLIVM_PROFILE_FAST:
          optlevel = None;
-      }
-      else {
+         break;
+      case GALLIVM_PROFILE_FULL:
+         optlevel = Aggressive;
+         break;
+      default:
          optlevel = Default;
+         break;
       }
+   }
 
-      if (LLVMCreateJITCompiler(&GlobalEngine, gallivm->provider,
-                                (unsigned) optlevel, &error)) {
-         _debug_printf("%s\n", error);
-         LLVMDisposeMessage(error);
-         goto fail;
-      }
+   if (LLVMCreateJITCompiler(&gallivm->engine, gallivm->provider,
+                             (unsigned) optlevel, &error)) {
+      _debug_printf("%s\n", error);
+      LLVMDisposeMessage(error);
+      gallivm->engine = NULL;
+      goto fail;
+   }
 
 #if defined(DEBUG) || defined(PROFILE)
-      lp_register_oprofile_jit_event_listener(GlobalEngine);
+   lp_register_oprofile_jit_event_listener(gallivm->engine);
 #endif
-   }
-
-   gallivm->engine = GlobalEngine;
-
-   LLVMAddModuleProvider(gallivm->engine, gallivm->provider);//new
 
    gallivm->target = LLVMGetExecutionEngineTargetData(gallivm->engine);
    if (!gallivm->target)
@@ -279,162 +294,162 @@ fail:
 }
 
 
-struct callback
+void
+lp_build_init(void)
 {
-   garbage_collect_callback_func func;
-   void *cb_data;
-   struct callback *prev, *next;
-};
+   if (gallivm_initialized)
+      return;
 
+#ifdef DEBUG
+   gallivm_debug = debug_get_option_gallivm_debug();
+#endif
 
-/** list of all garbage collector callbacks */
-static struct callback callback_list = {NULL, NULL, NULL, NULL};
+   lp_set_target_options();
 
+   gallivm_multithreaded = lp_start_multithreaded();
 
-/**
- * Register a function with gallivm which will be called when we
- * do garbage collection.
- */
-void
-gallivm_register_garbage_collector_callback(garbage_collect_callback_func func,
-                                            void *cb_data)
-{
-   struct callback *cb;
+   LLVMInitializeNativeTarget();
 
-   if (!callback_list.prev) {
-      make_empty_list(&callback_list);
-   }
+   LLVMLinkInJIT();
 
-   /* see if already in list */
-   foreach(cb, &callback_list) {
-      if (cb->func == func && cb->cb_data == cb_data)
-         return;
-   }
+   util_cpu_detect();
+ 
+   gallivm_initialized = TRUE;
 
-   /* add to list */
-   cb = CALLOC_STRUCT(callback);
-   if (cb) {
-      cb->func = func;
-      cb->cb_data = cb_data;
-      insert_at_head(&callback_list, cb);
-   }
+#if 0
+   /* For simulating less capable machines */
+   util_cpu_caps.has_sse3 = 0;
+   util_cpu_caps.has_ssse3 = 0;
+   util_cpu_caps.has_sse4_1 = 0;
+#endif
 }
 
 
+
 /**
- * Remove a callback.
+ * Create a new gallivm_state object, optimizing the code with the given
+ * profile.
+ *
+ * Every object has its own LLVM context, module and execution engine, so
+ * that all the memory used for the code generated with it, IR and machine
+ * code, is freed by gallivm_destroy().  Shader variants should therefore
+ * be compiled each in their own gallivm_state.
  */
-void
-gallivm_remove_garbage_collector_callback(garbage_collect_callback_func func,
-                                          void *cb_data)
+struct gallivm_state *
+gallivm_create_profile(enum gallivm_profile profile)
 {
-   struct callback *cb;
-
-   /* search list */
-   foreach(cb, &callback_list) {
-      if (cb->func == func && cb->cb_data == cb_data) {
-         /* found, remove it */
-         remove_from_list(cb);
-         return;
+   struct gallivm_state *gallivm;
+
+   gallivm = CALLOC_STRUCT(gallivm_state);
+   if (gallivm) {
+      gallivm->profile = profile;
+      if (!init_gallivm_state(gallivm)) {
+         FREE(gallivm);
+         gallivm = NULL;
       }
    }
+   return gallivm;
 }
 
 
 /**
- * Call the callback functions (which are typically in the
- * draw module and llvmpipe driver.
+ * Create a new gallivm_state object with the default optimization profile.
  */
-static void
-call_garbage_collector_callbacks(void)
+struct gallivm_state *
+gallivm_create(void)
 {
-   struct callback *cb;
-   foreach(cb, &callback_list) {
-      cb->func(cb->cb_data);
-   }
+   return gallivm_create_profile(GALLIVM_PROFILE_DEFAULT);
 }
 
 
-
 /**
- * Other gallium components using gallivm should call this periodically
- * to let us do garbage collection (or at least try to free memory
- * accumulated by the LLVM libraries).
+ * Destroy a gallivm_state object, and all the code generated with it.
  */
 void
-gallivm_garbage_collect(struct gallivm_state *gallivm)
+gallivm_destroy(struct gallivm_state *gallivm)
 {
-   if (gallivm->context) {
-      if (gallivm_debug & GALLIVM_DEBUG_GC)
-         debug_printf("***** Doing LLVM garbage collection\n");
+   if (!gallivm)
+      return;
 
-      call_garbage_collector_callbacks();
-      free_gallivm_state(gallivm);
-      init_gallivm_state(gallivm);
-   }
+   if (gallivm_debug & GALLIVM_DEBUG_GC)
+      debug_printf("***** Freeing gallivm state %p\n", (void *) gallivm);
+
+   free_gallivm_state(gallivm);
+   FREE(gallivm);
 }
 
 
-void
-lp_build_init(void)
+static unsigned
+count_instructions(LLVMValueRef func)
 {
-   if (gallivm_initialized)
-      return;
+   LLVMBasicBlockRef block;
+   LLVMValueRef instr;
+   unsigned count = 0;
+
+   for (block = LLVMGetFirstBasicBlock(func); block;
+        block = LLVMGetNextBasicBlock(block)) {
+      for (instr = LLVMGetFirstInstruction(block); instr;
+           instr = LLVMGetNextInstruction(instr)) {
+         count++;
+      }
+   }
 
-#ifdef DEBUG
-   gallivm_debug = debug_get_option_gallivm_debug();
-#endif
+   return count;
+}
 
-   lp_set_target_options();
 
-   LLVMInitializeNativeTarget();
+/**
+ * Run the gallivm's optimization passes on a function, accounting the
+ * time spent and the instruction counts in gallivm->stats.
+ */
+void
+gallivm_optimize_function(struct gallivm_state *gallivm,
+                          LLVMValueRef func)
+{
+   int64_t t0;
 
-   LLVMLinkInJIT();
+   gallivm->stats.nr_instrs += count_instructions(func);
 
-   util_cpu_detect();
- 
-   gallivm_initialized = TRUE;
+   t0 = os_time_get();
+   LLVMRunFunctionPassManager(gallivm->passmgr, func);
+   gallivm->stats.opt_time += os_time_get() - t0;
 
-#if 0
-   /* For simulating less capable machines */
-   util_cpu_caps.has_sse3 = 0;
-   util_cpu_caps.has_ssse3 = 0;
-   util_cpu_caps.has_sse4_1 = 0;
-#endif
+   gallivm->stats.nr_instrs_opt += count_instructions(func);
 }
 
 
-
 /**
- * Create a new gallivm_state object.
- * Note that we return a singleton.
+ * Generate the machine code of a function, accounting the time spent in
+ * gallivm->stats.
+ * \return  pointer to the function's machine code
  */
-struct gallivm_state *
-gallivm_create(void)
+void *
+gallivm_jit_function(struct gallivm_state *gallivm,
+                     LLVMValueRef func)
 {
-   struct gallivm_state *GlobalGallivm = NULL;
-
-   if (!GlobalGallivm) {
-      GlobalGallivm = CALLOC_STRUCT(gallivm_state);
-      if (GlobalGallivm) {
-         if (!init_gallivm_state(GlobalGallivm)) {
-            FREE(GlobalGallivm);
-            GlobalGallivm = NULL;
-         }
-      }
-   }
-   return GlobalGallivm;
+   void *code;
+   int64_t t0;
+
+   t0 = os_time_get();
+   code = LLVMGetPointerToGlobal(gallivm->engine, func);
+   gallivm->stats.codegen_time += os_time_get() - t0;
+   gallivm->stats.nr_functions++;
+
+   return code;
 }
 
 
-/**
- * Destroy a gallivm_state object.
- */
-void
-gallivm_destroy(struct gallivm_state *gallivm)
+const char *
+gallivm_profile_name(enum gallivm_profile profile)
 {
-   /* No-op: don't destroy the singleton */
-   (void) gallivm;
+   switch (profile) {
+   case GALLIVM_PROFILE_FAST:
+      return "fast";
+   case GALLIVM_PROFILE_FULL:
+      return "full";
+   default:
+      return "default";
+   }
 }
 
 
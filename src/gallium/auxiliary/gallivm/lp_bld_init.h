@@ -35,8 +35,36 @@
 #include <llvm-c/ExecutionEngine.h>
 
 
+/**
+ * How hard to optimize the code generated with a gallivm_state, trading
+ * compile time for code quality.
+ */
+enum gallivm_profile
+{
+   GALLIVM_PROFILE_FAST,     /**< few passes, no codegen optimization */
+   GALLIVM_PROFILE_DEFAULT,
+   GALLIVM_PROFILE_FULL      /**< more passes, aggressive codegen */
+};
+
+
+/**
+ * Compilation statistics of a gallivm_state, accumulated by
+ * gallivm_optimize_function() and gallivm_jit_function().
+ */
+struct gallivm_stats
+{
+   unsigned nr_functions;
+   unsigned nr_instrs;        /**< IR instructions before optimization */
+   unsigned nr_instrs_opt;    /**< IR instructions after optimization */
+   int64_t opt_time;          /**< usecs spent in the IR passes */
+   int64_t codegen_time;      /**< usecs spent generating machine code */
+};
+
+
 struct gallivm_state
 {
+   enum gallivm_profile profile;
+   struct gallivm_stats stats;
    LLVMModuleRef module;
    LLVMExecutionEngineRef engine;
    LLVMModuleProviderRef provider;
@@ -55,26 +83,33 @@ extern void
 lp_func_delete_body(LLVMValueRef func);
 
 
-void
-gallivm_garbage_collect(struct gallivm_state *gallivm);
-
+struct gallivm_state *
+gallivm_create(void);
 
-typedef void (*garbage_collect_callback_func)(void *cb_data);
+struct gallivm_state *
+gallivm_create_profile(enum gallivm_profile profile);
 
 void
-gallivm_register_garbage_collector_callback(garbage_collect_callback_func func,
-                                            void *cb_data);
+gallivm_destroy(struct gallivm_state *gallivm);
 
 void
-gallivm_remove_garbage_collector_callback(garbage_collect_callback_func func,
-                                          void *cb_data);
+gallivm_optimize_function(struct gallivm_state *gallivm,
+                          LLVMValueRef func);
 
+void *
+gallivm_jit_function(struct gallivm_state *gallivm,
+                     LLVMValueRef func);
 
-struct gallivm_state *
-gallivm_create(void);
+const char *
+gallivm_profile_name(enum gallivm_profile profile);
 
-void
-gallivm_destroy(struct gallivm_state *gallivm);
+
+/**
+ * Whether LLVM was successfully put in multithreaded mode by
+ * lp_build_init(), i.e., whether separate gallivm_state objects may be
+ * compiled concurrently from different threads.
+ */
+extern boolean gallivm_multithreaded;
 
 
 extern LLVMValueRef
@@ -43,6 +43,11 @@
 #include <llvm/ExecutionEngine/JITEventListener.h>
 #include <llvm/Support/CommandLine.h>
 #include <llvm/Support/PrettyStackTrace.h>
+#if HAVE_LLVM >= 0x0209
+#include <llvm/Support/Threading.h>
+#else
+#include <llvm/System/Threading.h>
+#endif
 
 #include "pipe/p_config.h"
 #include "util/u_debug.h"
@@ -143,6 +148,20 @@ lp_set_target_options(void)
 }
 
 
+/**
+ * Enable the locking of LLVM's global state, so that code can be generated
+ * from several threads at once, each with its own LLVM context.
+ *
+ * Must be called before any other thread uses LLVM.  Returns false when
+ * LLVM was built without thread support.
+ */
+extern "C" boolean
+lp_start_multithreaded(void)
+{
+   return llvm::llvm_start_multithreaded() ? TRUE : FALSE;
+}
+
+
 extern "C" void
 lp_func_delete_body(LLVMValueRef FF)
 {
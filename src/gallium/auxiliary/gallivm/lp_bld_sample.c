@@ -32,11 +32,14 @@
  * @author Jose Fonseca <jfonseca@vmware.com>
  */
 
+#include <float.h>
+
 #include "pipe/p_defines.h"
 #include "pipe/p_state.h"
 #include "util/u_format.h"
 #include "util/u_math.h"
 #include "lp_bld_arit.h"
+#include "lp_bld_bitarit.h"
 #include "lp_bld_const.h"
 #include "lp_bld_debug.h"
 #include "lp_bld_printf.h"
@@ -165,6 +168,19 @@ lp_sampler_static_state(struct lp_sampler_static_state *state,
       }
    }
 
+   /*
+    * Anisotropic filtering is only done for minification of 2D textures
+    * with linear filtering.
+    */
+   if (sampler->max_anisotropy > 1 &&
+       sampler->min_img_filter == PIPE_TEX_FILTER_LINEAR &&
+       (texture->target == PIPE_TEXTURE_2D ||
+        texture->target == PIPE_TEXTURE_RECT) &&
+       !state->min_max_lod_equal) {
+      state->max_anisotropy = MIN2(sampler->max_anisotropy,
+                                   LP_MAX_ANISOTROPY);
+   }
+
    state->compare_mode      = sampler->compare_mode;
    if (sampler->compare_mode != PIPE_TEX_COMPARE_NONE) {
       state->compare_func   = sampler->compare_func;
@@ -400,10 +416,105 @@ lp_build_brilinear_rho(struct lp_build_context *bld,
 }
 
 
+/**
+ * Generate code to compute the anisotropic filtering footprint, following
+ * the EXT_texture_filter_anisotropic spec.
+ *
+ * The pixel footprint in texel space is the parallelogram spanned by the
+ * X and Y derivatives.  Its major axis is covered with
+ * N = min(ceil(Pmax/Pmin), max_anisotropy) probes, and the level of detail
+ * is derived from Pmax/N rather than Pmax, so each probe is sharper than an
+ * isotropic sample of the whole footprint would be.
+ *
+ * Like lp_build_rho, only the first element of the derivatives is used.
+ *
+ * \param out_rho  scalar float rho to derive the lod from
+ * \param out_num_probes  scalar int number of probes, in [1, max_anisotropy]
+ * \param out_axis  scalar float (s, t) major axis, in texture coordinates
+ */
+void
+lp_build_aniso_footprint(struct lp_build_sample_context *bld,
+                         unsigned unit,
+                         const LLVMValueRef ddx[4],
+                         const LLVMValueRef ddy[4],
+                         LLVMValueRef *out_rho,
+                         LLVMValueRef *out_num_probes,
+                         LLVMValueRef out_axis[2])
+{
+   struct lp_build_context *float_bld = &bld->float_bld;
+   struct lp_build_context *int_bld = &bld->int_bld;
+   LLVMBuilderRef builder = bld->gallivm->builder;
+   LLVMValueRef index0 = lp_build_const_int32(bld->gallivm, 0);
+   LLVMValueRef index1 = lp_build_const_int32(bld->gallivm, 1);
+   const unsigned max_anisotropy = bld->static_state->max_anisotropy;
+   LLVMValueRef first_level, first_level_vec;
+   LLVMValueRef int_size, float_size, width, height;
+   LLVMValueRef dudx, dvdx, dudy, dvdy;
+   LLVMValueRef px, py, pmax, pmin, x_major;
+   LLVMValueRef num_probes;
+
+   assert(bld->dims == 2);
+   assert(max_anisotropy > 1);
+
+   first_level = bld->dynamic_state->first_level(bld->dynamic_state,
+                                                 bld->gallivm, unit);
+   first_level_vec = lp_build_broadcast_scalar(&bld->int_size_bld, first_level);
+   int_size = lp_build_minify(&bld->int_size_bld, bld->int_size, first_level_vec);
+   float_size = lp_build_int_to_float(&bld->float_size_bld, int_size);
+   width = LLVMBuildExtractElement(builder, float_size, index0, "");
+   height = LLVMBuildExtractElement(builder, float_size, index1, "");
+
+   dudx = lp_build_mul(float_bld, ddx[0], width);
+   dvdx = lp_build_mul(float_bld, ddx[1], height);
+   dudy = lp_build_mul(float_bld, ddy[0], width);
+   dvdy = lp_build_mul(float_bld, ddy[1], height);
+
+   /* px = sqrt(dudx^2 + dvdx^2), py = sqrt(dudy^2 + dvdy^2) */
+   px = lp_build_add(float_bld,
+                     lp_build_mul(float_bld, dudx, dudx),
+                     lp_build_mul(float_bld, dvdx, dvdx));
+   py = lp_build_add(float_bld,
+                     lp_build_mul(float_bld, dudy, dudy),
+                     lp_build_mul(float_bld, dvdy, dvdy));
+   px = lp_build_sqrt(float_bld, px);
+   py = lp_build_sqrt(float_bld, py);
+
+   x_major = LLVMBuildFCmp(builder, LLVMRealOGE, px, py, "x_major");
+   pmax = LLVMBuildSelect(builder, x_major, px, py, "");
+   pmin = LLVMBuildSelect(builder, x_major, py, px, "");
+
+   /*
+    * Bound the number of probes by clamping the minor axis to
+    * pmax / max_anisotropy, and avoid dividing by zero for degenerate
+    * footprints.
+    */
+   pmin = lp_build_max(float_bld, pmin,
+                       lp_build_mul(float_bld, pmax,
+                                    lp_build_const_float(bld->gallivm,
+                                                         1.0f/max_anisotropy)));
+   pmin = lp_build_max(float_bld, pmin,
+                       lp_build_const_float(bld->gallivm, FLT_MIN));
+
+   num_probes = lp_build_iceil(float_bld, lp_build_div(float_bld, pmax, pmin));
+   num_probes = lp_build_clamp(int_bld, num_probes, int_bld->one,
+                               lp_build_const_int32(bld->gallivm,
+                                                    max_anisotropy));
+
+   *out_rho = lp_build_div(float_bld, pmax,
+                           lp_build_int_to_float(float_bld, num_probes));
+   *out_num_probes = num_probes;
+   out_axis[0] = LLVMBuildSelect(builder, x_major, ddx[0], ddy[0], "");
+   out_axis[1] = LLVMBuildSelect(builder, x_major, ddx[1], ddy[1], "");
+
+   lp_build_name(*out_num_probes, "sampler%u_aniso_probes", unit);
+}
+
+
 /**
  * Generate code to compute texture level of detail (lambda).
  * \param ddx  partial derivatives of (s, t, r, q) with respect to X
  * \param ddy  partial derivatives of (s, t, r, q) with respect to Y
+ * \param rho  optional scalar float rho, overriding the derivatives
  * \param lod_bias  optional float vector with the shader lod bias
  * \param explicit_lod  optional float vector with the explicit lod
  * \param width  scalar int texture width
@@ -418,6 +529,7 @@ lp_build_lod_selector(struct lp_build_sample_context *bld,
                       unsigned unit,
                       const LLVMValueRef ddx[4],
                       const LLVMValueRef ddy[4],
+                      LLVMValueRef rho, /* optional */
                       LLVMValueRef lod_bias, /* optional */
                       LLVMValueRef explicit_lod, /* optional */
                       unsigned mip_filter,
@@ -451,9 +563,8 @@ lp_build_lod_selector(struct lp_build_sample_context *bld,
                                        index0, "");
       }
       else {
-         LLVMValueRef rho;
-
-         rho = lp_build_rho(bld, unit, ddx, ddy);
+         if (!rho)
+            rho = lp_build_rho(bld, unit, ddx, ddy);
 
          /*
           * Compute lod = log2(rho)
@@ -1066,6 +1177,70 @@ lp_build_sample_partial_offset(struct lp_build_context *bld,
 }
 
 
+/**
+ * Compute the partial offset of a texel along an axis of a texture with a
+ * tiled layout (see LP_SAMPLER_TILE_SIZE).
+ *
+ * @param coord         coordinate in texels
+ * @param tile_stride   number of bytes between successive tiles along the
+ *                      coordinate axis
+ * @param texel_stride  number of bytes between successive texels of a tile
+ *                      along the coordinate axis
+ */
+LLVMValueRef
+lp_build_sample_tiled_partial_offset(struct lp_build_context *bld,
+                                     LLVMValueRef coord,
+                                     LLVMValueRef tile_stride,
+                                     LLVMValueRef texel_stride)
+{
+   LLVMBuilderRef builder = bld->gallivm->builder;
+   LLVMValueRef tile_shift =
+      lp_build_const_int_vec(bld->gallivm, bld->type,
+                             util_logbase2(LP_SAMPLER_TILE_SIZE));
+   LLVMValueRef tile_mask =
+      lp_build_const_int_vec(bld->gallivm, bld->type,
+                             LP_SAMPLER_TILE_SIZE - 1);
+   LLVMValueRef tile, subcoord;
+
+   tile = LLVMBuildLShr(builder, coord, tile_shift, "");
+   subcoord = LLVMBuildAnd(builder, coord, tile_mask, "");
+
+   return lp_build_add(bld,
+                       lp_build_mul(bld, tile, tile_stride),
+                       lp_build_mul(bld, subcoord, texel_stride));
+}
+
+
+/**
+ * Get the strides for lp_build_sample_tiled_partial_offset() along the x and
+ * y axes of a texture with a tiled layout.
+ *
+ * @param texel_size  size of a texel in bytes
+ * @param row_stride  number of bytes between rows of texels, as in the
+ *                    linear layout
+ */
+void
+lp_build_sample_tiled_strides(struct lp_build_context *bld,
+                              unsigned texel_size,
+                              LLVMValueRef row_stride,
+                              LLVMValueRef *x_tile_stride,
+                              LLVMValueRef *x_texel_stride,
+                              LLVMValueRef *y_tile_stride,
+                              LLVMValueRef *y_texel_stride)
+{
+   const unsigned tile_size = LP_SAMPLER_TILE_SIZE;
+
+   *x_tile_stride = lp_build_const_int_vec(bld->gallivm, bld->type,
+                                           tile_size * tile_size * texel_size);
+   *x_texel_stride = lp_build_const_int_vec(bld->gallivm, bld->type,
+                                            texel_size);
+   *y_tile_stride = lp_build_shl_imm(bld, row_stride,
+                                     util_logbase2(tile_size));
+   *y_texel_stride = lp_build_const_int_vec(bld->gallivm, bld->type,
+                                            tile_size * texel_size);
+}
+
+
 /**
  * Compute the offset of a pixel block.
  *
@@ -1120,3 +1295,47 @@ lp_build_sample_offset(struct lp_build_context *bld,
 
    *out_offset = offset;
 }
+
+
+/**
+ * Compute the offset of a texel of a texture with a tiled layout (see
+ * LP_SAMPLER_TILE_SIZE).
+ *
+ * Like lp_build_sample_offset(), but only for formats with 1x1 pixel blocks,
+ * so there are no sub-block coordinates.
+ */
+void
+lp_build_sample_tiled_offset(struct lp_build_context *bld,
+                             const struct util_format_description *format_desc,
+                             LLVMValueRef x,
+                             LLVMValueRef y,
+                             LLVMValueRef z,
+                             LLVMValueRef y_stride,
+                             LLVMValueRef z_stride,
+                             LLVMValueRef *out_offset)
+{
+   LLVMValueRef x_tile_stride, x_texel_stride;
+   LLVMValueRef y_tile_stride, y_texel_stride;
+   LLVMValueRef offset;
+
+   assert(format_desc->block.width == 1);
+   assert(format_desc->block.height == 1);
+   assert(y && y_stride);
+
+   lp_build_sample_tiled_strides(bld, format_desc->block.bits/8, y_stride,
+                                 &x_tile_stride, &x_texel_stride,
+                                 &y_tile_stride, &y_texel_stride);
+
+   offset = lp_build_sample_tiled_partial_offset(bld, x, x_tile_stride,
+                                                 x_texel_stride);
+   offset = lp_build_add(bld, offset,
+                         lp_build_sample_tiled_partial_offset(bld, y,
+                                                              y_tile_stride,
+                                                              y_texel_stride));
+
+   if (z && z_stride) {
+      offset = lp_build_add(bld, offset, lp_build_mul(bld, z, z_stride));
+   }
+
+   *out_offset = offset;
+}
@@ -51,6 +51,28 @@ struct lp_type;
 struct lp_build_context;
 
 
+/**
+ * Upper bound of the number of probes taken by anisotropic filtering.
+ */
+#define LP_MAX_ANISOTROPY 16
+
+
+/**
+ * Width and height of the texel tiles of textures with a tiled layout.
+ *
+ * The tiles of each row of tiles are stored one after another, and the
+ * texels of each tile in row-major order, so the texel (x, y) of an image
+ * lies at
+ *
+ *   (y/4)*4*row_stride + (x/4)*16*texel_size + (y%4)*4*texel_size +
+ *   (x%4)*texel_size
+ *
+ * Padding the image to a multiple of 4 texels, a row of tiles takes 4 rows
+ * of the linear layout, so both layouts share row and image strides.
+ */
+#define LP_SAMPLER_TILE_SIZE 4
+
+
 /**
  * Sampler static state.
  *
@@ -71,6 +93,8 @@ struct lp_sampler_static_state
    unsigned pot_width:1;     /**< is the width a power of two? */
    unsigned pot_height:1;
    unsigned pot_depth:1;
+   unsigned tiled:1;         /**< tiled layout, see LP_SAMPLER_TILE_SIZE;
+                                  set by the driver, not from the texture */
 
    /* pipe_sampler_state's state */
    unsigned wrap_s:3;
@@ -86,6 +110,7 @@ struct lp_sampler_static_state
    unsigned lod_bias_non_zero:1;
    unsigned apply_min_lod:1;  /**< min_lod > 0 ? */
    unsigned apply_max_lod:1;  /**< max_lod < last_level ? */
+   unsigned max_anisotropy:5; /**< max probes, or 0 if not anisotropic */
 };
 
 
@@ -303,12 +328,22 @@ lp_build_lod_selector(struct lp_build_sample_context *bld,
                       unsigned unit,
                       const LLVMValueRef ddx[4],
                       const LLVMValueRef ddy[4],
+                      LLVMValueRef rho, /* optional */
                       LLVMValueRef lod_bias, /* optional */
                       LLVMValueRef explicit_lod, /* optional */
                       unsigned mip_filter,
                       LLVMValueRef *out_lod_ipart,
                       LLVMValueRef *out_lod_fpart);
 
+void
+lp_build_aniso_footprint(struct lp_build_sample_context *bld,
+                         unsigned unit,
+                         const LLVMValueRef ddx[4],
+                         const LLVMValueRef ddy[4],
+                         LLVMValueRef *out_rho,
+                         LLVMValueRef *out_num_probes,
+                         LLVMValueRef out_axis[2]);
+
 void
 lp_build_nearest_mip_level(struct lp_build_sample_context *bld,
                            unsigned unit,
@@ -377,6 +412,23 @@ lp_build_sample_partial_offset(struct lp_build_context *bld,
                                LLVMValueRef *out_i);
 
 
+LLVMValueRef
+lp_build_sample_tiled_partial_offset(struct lp_build_context *bld,
+                                     LLVMValueRef coord,
+                                     LLVMValueRef tile_stride,
+                                     LLVMValueRef texel_stride);
+
+
+void
+lp_build_sample_tiled_strides(struct lp_build_context *bld,
+                              unsigned texel_size,
+                              LLVMValueRef row_stride,
+                              LLVMValueRef *x_tile_stride,
+                              LLVMValueRef *x_texel_stride,
+                              LLVMValueRef *y_tile_stride,
+                              LLVMValueRef *y_texel_stride);
+
+
 void
 lp_build_sample_offset(struct lp_build_context *bld,
                        const struct util_format_description *format_desc,
@@ -390,6 +442,17 @@ lp_build_sample_offset(struct lp_build_context *bld,
                        LLVMValueRef *out_j);
 
 
+void
+lp_build_sample_tiled_offset(struct lp_build_context *bld,
+                             const struct util_format_description *format_desc,
+                             LLVMValueRef x,
+                             LLVMValueRef y,
+                             LLVMValueRef z,
+                             LLVMValueRef y_stride,
+                             LLVMValueRef z_stride,
+                             LLVMValueRef *out_offset);
+
+
 void
 lp_build_sample_soa(struct gallivm_state *gallivm,
                     const struct lp_sampler_static_state *static_state,
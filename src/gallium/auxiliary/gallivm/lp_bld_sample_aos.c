@@ -66,6 +66,10 @@
  * \param coord  the incoming texcoord (s,t,r or q) scaled to the texture size
  * \param length  the texture size along one dimension
  * \param stride  pixel stride along the coordinate axis (in bytes)
+ * \param tile_stride  stride between texel tiles along the coordinate axis
+ *                     (in bytes) for tiled layouts, in which case stride is
+ *                     the stride between the texels of a tile; NULL for
+ *                     linear layouts
  * \param is_pot  if TRUE, length is a power of two
  * \param wrap_mode  one of PIPE_TEX_WRAP_x
  * \param out_offset  byte offset for the wrapped coordinate
@@ -77,6 +81,7 @@ lp_build_sample_wrap_nearest_int(struct lp_build_sample_context *bld,
                                  LLVMValueRef coord,
                                  LLVMValueRef length,
                                  LLVMValueRef stride,
+                                 LLVMValueRef tile_stride,
                                  boolean is_pot,
                                  unsigned wrap_mode,
                                  LLVMValueRef *out_offset,
@@ -115,8 +120,16 @@ lp_build_sample_wrap_nearest_int(struct lp_build_sample_context *bld,
       assert(0);
    }
 
-   lp_build_sample_partial_offset(int_coord_bld, block_length, coord, stride,
-                                  out_offset, out_i);
+   if (tile_stride) {
+      assert(block_length == 1);
+      *out_offset = lp_build_sample_tiled_partial_offset(int_coord_bld, coord,
+                                                         tile_stride, stride);
+      *out_i = int_coord_bld->zero;
+   }
+   else {
+      lp_build_sample_partial_offset(int_coord_bld, block_length, coord,
+                                     stride, out_offset, out_i);
+   }
 }
 
 
@@ -128,6 +141,10 @@ lp_build_sample_wrap_nearest_int(struct lp_build_sample_context *bld,
  * \param coord0  the incoming texcoord (s,t,r or q) scaled to the texture size
  * \param length  the texture size along one dimension
  * \param stride  pixel stride along the coordinate axis (in bytes)
+ * \param tile_stride  stride between texel tiles along the coordinate axis
+ *                     for tiled layouts, see
+ *                     lp_build_sample_wrap_nearest_int(); NULL for linear
+ *                     layouts
  * \param is_pot  if TRUE, length is a power of two
  * \param wrap_mode  one of PIPE_TEX_WRAP_x
  * \param offset0  resulting relative offset for coord0
@@ -141,6 +158,7 @@ lp_build_sample_wrap_linear_int(struct lp_build_sample_context *bld,
                                 LLVMValueRef coord0,
                                 LLVMValueRef length,
                                 LLVMValueRef stride,
+                                LLVMValueRef tile_stride,
                                 boolean is_pot,
                                 unsigned wrap_mode,
                                 LLVMValueRef *offset0,
@@ -153,11 +171,11 @@ lp_build_sample_wrap_linear_int(struct lp_build_sample_context *bld,
    LLVMValueRef length_minus_one;
    LLVMValueRef lmask, umask, mask;
 
-   if (block_length != 1) {
+   if (block_length != 1 || tile_stride) {
       /*
-       * If the pixel block covers more than one pixel then there is no easy
-       * way to calculate offset1 relative to offset0. Instead, compute them
-       * independently.
+       * If the pixel block covers more than one pixel, or the texels are
+       * tiled, then there is no easy way to calculate offset1 relative to
+       * offset0. Instead, compute them independently.
        */
 
       LLVMValueRef coord1;
@@ -167,6 +185,7 @@ lp_build_sample_wrap_linear_int(struct lp_build_sample_context *bld,
                                        coord0,
                                        length,
                                        stride,
+                                       tile_stride,
                                        is_pot,
                                        wrap_mode,
                                        offset0, i0);
@@ -178,6 +197,7 @@ lp_build_sample_wrap_linear_int(struct lp_build_sample_context *bld,
                                        coord1,
                                        length,
                                        stride,
+                                       tile_stride,
                                        is_pot,
                                        wrap_mode,
                                        offset1, i1);
@@ -272,7 +292,8 @@ lp_build_sample_image_nearest(struct lp_build_sample_context *bld,
    LLVMValueRef i32_c8;
    LLVMValueRef width_vec, height_vec, depth_vec;
    LLVMValueRef s_ipart, t_ipart = NULL, r_ipart = NULL;
-   LLVMValueRef x_stride;
+   LLVMValueRef x_stride, y_stride;
+   LLVMValueRef x_tile_stride = NULL, y_tile_stride = NULL;
    LLVMValueRef x_offset, offset;
    LLVMValueRef x_subcoord, y_subcoord, z_subcoord;
 
@@ -330,11 +351,20 @@ lp_build_sample_image_nearest(struct lp_build_sample_context *bld,
    x_stride = lp_build_const_vec(bld->gallivm,
                                  bld->int_coord_bld.type,
                                  bld->format_desc->block.bits/8);
+   y_stride = row_stride_vec;
+   if (bld->static_state->tiled) {
+      lp_build_sample_tiled_strides(&bld->int_coord_bld,
+                                    bld->format_desc->block.bits/8,
+                                    row_stride_vec,
+                                    &x_tile_stride, &x_stride,
+                                    &y_tile_stride, &y_stride);
+   }
 
    /* Do texcoord wrapping, compute texel offset */
    lp_build_sample_wrap_nearest_int(bld,
                                     bld->format_desc->block.width,
-                                    s_ipart, width_vec, x_stride,
+                                    s_ipart, width_vec,
+                                    x_stride, x_tile_stride,
                                     bld->static_state->pot_width,
                                     bld->static_state->wrap_s,
                                     &x_offset, &x_subcoord);
@@ -343,7 +373,8 @@ lp_build_sample_image_nearest(struct lp_build_sample_context *bld,
       LLVMValueRef y_offset;
       lp_build_sample_wrap_nearest_int(bld,
                                        bld->format_desc->block.height,
-                                       t_ipart, height_vec, row_stride_vec,
+                                       t_ipart, height_vec,
+                                       y_stride, y_tile_stride,
                                        bld->static_state->pot_height,
                                        bld->static_state->wrap_t,
                                        &y_offset, &y_subcoord);
@@ -352,7 +383,8 @@ lp_build_sample_image_nearest(struct lp_build_sample_context *bld,
          LLVMValueRef z_offset;
          lp_build_sample_wrap_nearest_int(bld,
                                           1, /* block length (depth) */
-                                          r_ipart, depth_vec, img_stride_vec,
+                                          r_ipart, depth_vec,
+                                          img_stride_vec, NULL,
                                           bld->static_state->pot_depth,
                                           bld->static_state->wrap_r,
                                           &z_offset, &z_subcoord);
@@ -441,6 +473,7 @@ lp_build_sample_image_linear(struct lp_build_sample_context *bld,
    LLVMValueRef t_ipart = NULL, t_fpart = NULL, t_fpart_lo = NULL, t_fpart_hi = NULL;
    LLVMValueRef r_ipart = NULL, r_fpart = NULL, r_fpart_lo = NULL, r_fpart_hi = NULL;
    LLVMValueRef x_stride, y_stride, z_stride;
+   LLVMValueRef x_tile_stride = NULL, y_tile_stride = NULL;
    LLVMValueRef x_offset0, x_offset1;
    LLVMValueRef y_offset0, y_offset1;
    LLVMValueRef z_offset0, z_offset1;
@@ -527,11 +560,19 @@ lp_build_sample_image_linear(struct lp_build_sample_context *bld,
                                  bld->format_desc->block.bits/8);
    y_stride = row_stride_vec;
    z_stride = img_stride_vec;
+   if (bld->static_state->tiled) {
+      lp_build_sample_tiled_strides(&bld->int_coord_bld,
+                                    bld->format_desc->block.bits/8,
+                                    row_stride_vec,
+                                    &x_tile_stride, &x_stride,
+                                    &y_tile_stride, &y_stride);
+   }
 
    /* do texcoord wrapping and compute texel offsets */
    lp_build_sample_wrap_linear_int(bld,
                                    bld->format_desc->block.width,
-                                   s_ipart, width_vec, x_stride,
+                                   s_ipart, width_vec,
+                                   x_stride, x_tile_stride,
                                    bld->static_state->pot_width,
                                    bld->static_state->wrap_s,
                                    &x_offset0, &x_offset1,
@@ -546,7 +587,8 @@ lp_build_sample_image_linear(struct lp_build_sample_context *bld,
    if (dims >= 2) {
       lp_build_sample_wrap_linear_int(bld,
                                       bld->format_desc->block.height,
-                                      t_ipart, height_vec, y_stride,
+                                      t_ipart, height_vec,
+                                      y_stride, y_tile_stride,
                                       bld->static_state->pot_height,
                                       bld->static_state->wrap_t,
                                       &y_offset0, &y_offset1,
@@ -565,7 +607,8 @@ lp_build_sample_image_linear(struct lp_build_sample_context *bld,
    if (dims >= 3) {
       lp_build_sample_wrap_linear_int(bld,
                                       bld->format_desc->block.height,
-                                      r_ipart, depth_vec, z_stride,
+                                      r_ipart, depth_vec,
+                                      z_stride, NULL,
                                       bld->static_state->pot_depth,
                                       bld->static_state->wrap_r,
                                       &z_offset0, &z_offset1,
@@ -982,7 +1025,7 @@ lp_build_sample_aos(struct lp_build_sample_context *bld,
       /* Need to compute lod either to choose mipmap levels or to
        * distinguish between minification/magnification with one mipmap level.
        */
-      lp_build_lod_selector(bld, unit, ddx, ddy,
+      lp_build_lod_selector(bld, unit, ddx, ddy, NULL,
                             lod_bias, explicit_lod,
                             mip_filter,
                             &lod_ipart, &lod_fpart);
@@ -132,10 +132,19 @@ lp_build_sample_texel_soa(struct lp_build_sample_context *bld,
    }
 
    /* convert x,y,z coords to linear offset from start of texture, in bytes */
-   lp_build_sample_offset(&bld->int_coord_bld,
-                          bld->format_desc,
-                          x, y, z, y_stride, z_stride,
-                          &offset, &i, &j);
+   if (static_state->tiled) {
+      lp_build_sample_tiled_offset(&bld->int_coord_bld,
+                                   bld->format_desc,
+                                   x, y, z, y_stride, z_stride,
+                                   &offset);
+      i = j = int_coord_bld->zero;
+   }
+   else {
+      lp_build_sample_offset(&bld->int_coord_bld,
+                             bld->format_desc,
+                             x, y, z, y_stride, z_stride,
+                             &offset, &i, &j);
+   }
 
    if (use_border) {
       /* If we can sample the border color, it means that texcoords may
@@ -917,6 +926,91 @@ lp_build_sample_mipmap(struct lp_build_sample_context *bld,
 
 
 
+/**
+ * Anisotropic filtering: average num_probes samples, each filtered with
+ * lp_build_sample_mipmap, evenly spaced along the major axis of the pixel
+ * footprint.  See lp_build_aniso_footprint.
+ * \param num_probes  scalar int number of probes, at least one
+ * \param axis  scalar float (s, t) major axis of the footprint
+ */
+static void
+lp_build_sample_aniso(struct lp_build_sample_context *bld,
+                      unsigned unit,
+                      unsigned img_filter,
+                      unsigned mip_filter,
+                      LLVMValueRef s,
+                      LLVMValueRef t,
+                      LLVMValueRef r,
+                      LLVMValueRef ilevel0,
+                      LLVMValueRef ilevel1,
+                      LLVMValueRef lod_fpart,
+                      LLVMValueRef num_probes,
+                      const LLVMValueRef axis[2],
+                      LLVMValueRef *colors_out)
+{
+   LLVMBuilderRef builder = bld->gallivm->builder;
+   struct lp_build_context *float_bld = &bld->float_bld;
+   struct lp_build_context *coord_bld = &bld->coord_bld;
+   struct lp_build_context *texel_bld = &bld->texel_bld;
+   LLVMValueRef half = lp_build_const_float(bld->gallivm, 0.5f);
+   LLVMValueRef probe[4], sum[4];
+   LLVMValueRef weight;
+   struct lp_build_loop_state loop;
+   unsigned chan;
+
+   for (chan = 0; chan < 4; chan++) {
+      probe[chan] = lp_build_alloca(bld->gallivm, texel_bld->vec_type, "");
+      sum[chan] = lp_build_alloca(bld->gallivm, texel_bld->vec_type, "");
+   }
+
+   /* weight = 1 / num_probes */
+   weight = lp_build_div(float_bld, float_bld->one,
+                         lp_build_int_to_float(float_bld, num_probes));
+
+   lp_build_loop_begin(&loop, bld->gallivm, bld->int_bld.zero);
+   {
+      LLVMValueRef offset, s_probe, t_probe;
+
+      /* offset = (i + 0.5) / num_probes - 0.5, in [-0.5, 0.5] */
+      offset = lp_build_int_to_float(float_bld, loop.counter);
+      offset = lp_build_add(float_bld, offset, half);
+      offset = lp_build_mul(float_bld, offset, weight);
+      offset = lp_build_sub(float_bld, offset, half);
+
+      s_probe = lp_build_mul(float_bld, offset, axis[0]);
+      t_probe = lp_build_mul(float_bld, offset, axis[1]);
+      s_probe = lp_build_add(coord_bld, s,
+                             lp_build_broadcast_scalar(coord_bld, s_probe));
+      t_probe = lp_build_add(coord_bld, t,
+                             lp_build_broadcast_scalar(coord_bld, t_probe));
+
+      lp_build_sample_mipmap(bld, unit,
+                             img_filter, mip_filter,
+                             s_probe, t_probe, r,
+                             ilevel0, ilevel1, lod_fpart,
+                             probe);
+
+      for (chan = 0; chan < 4; chan++) {
+         LLVMValueRef value;
+         value = lp_build_add(texel_bld,
+                              LLVMBuildLoad(builder, sum[chan], ""),
+                              LLVMBuildLoad(builder, probe[chan], ""));
+         LLVMBuildStore(builder, value, sum[chan]);
+      }
+   }
+   lp_build_loop_end(&loop, num_probes, NULL);
+
+   weight = lp_build_broadcast_scalar(texel_bld, weight);
+
+   for (chan = 0; chan < 4; chan++) {
+      LLVMValueRef value = LLVMBuildLoad(builder, sum[chan], "");
+      value = lp_build_mul(texel_bld, value, weight);
+      LLVMBuildStore(builder, value, colors_out[chan]);
+   }
+}
+
+
+
 /**
  * General texture sampling codegen.
  * This function handles texture sampling for all texture targets (1D,
@@ -941,6 +1035,7 @@ lp_build_sample_general(struct lp_build_sample_context *bld,
    const unsigned mag_filter = bld->static_state->mag_img_filter;
    LLVMValueRef lod_ipart = NULL, lod_fpart = NULL;
    LLVMValueRef ilevel0, ilevel1 = NULL;
+   LLVMValueRef aniso_rho = NULL, num_probes = NULL, aniso_axis[2];
    LLVMValueRef face_ddx[4], face_ddy[4];
    LLVMValueRef texels[4];
    LLVMValueRef first_level;
@@ -976,6 +1071,14 @@ lp_build_sample_general(struct lp_build_sample_context *bld,
       ddy = face_ddy;
    }
 
+   /*
+    * Compute the anisotropic footprint, which determines the lod too.
+    */
+   if (bld->static_state->max_anisotropy && !explicit_lod) {
+      lp_build_aniso_footprint(bld, unit, ddx, ddy,
+                               &aniso_rho, &num_probes, aniso_axis);
+   }
+
    /*
     * Compute the level of detail (float).
     */
@@ -984,7 +1087,7 @@ lp_build_sample_general(struct lp_build_sample_context *bld,
       /* Need to compute lod either to choose mipmap levels or to
        * distinguish between minification/magnification with one mipmap level.
        */
-      lp_build_lod_selector(bld, unit, ddx, ddy,
+      lp_build_lod_selector(bld, unit, ddx, ddy, aniso_rho,
                             lod_bias, explicit_lod,
                             mip_filter,
                             &lod_ipart, &lod_fpart);
@@ -1039,11 +1142,21 @@ lp_build_sample_general(struct lp_build_sample_context *bld,
 
    if (min_filter == mag_filter) {
       /* no need to distinquish between minification and magnification */
-      lp_build_sample_mipmap(bld, unit,
-                             min_filter, mip_filter,
-                             s, t, r,
-                             ilevel0, ilevel1, lod_fpart,
-                             texels);
+      if (num_probes) {
+         lp_build_sample_aniso(bld, unit,
+                               min_filter, mip_filter,
+                               s, t, r,
+                               ilevel0, ilevel1, lod_fpart,
+                               num_probes, aniso_axis,
+                               texels);
+      }
+      else {
+         lp_build_sample_mipmap(bld, unit,
+                                min_filter, mip_filter,
+                                s, t, r,
+                                ilevel0, ilevel1, lod_fpart,
+                                texels);
+      }
    }
    else {
       /* Emit conditional to choose min image filter or mag image filter
@@ -1059,11 +1172,21 @@ lp_build_sample_general(struct lp_build_sample_context *bld,
       lp_build_if(&if_ctx, bld->gallivm, minify);
       {
          /* Use the minification filter */
-         lp_build_sample_mipmap(bld, unit,
-                                min_filter, mip_filter,
-                                s, t, r,
-                                ilevel0, ilevel1, lod_fpart,
-                                texels);
+         if (num_probes) {
+            lp_build_sample_aniso(bld, unit,
+                                  min_filter, mip_filter,
+                                  s, t, r,
+                                  ilevel0, ilevel1, lod_fpart,
+                                  num_probes, aniso_axis,
+                                  texels);
+         }
+         else {
+            lp_build_sample_mipmap(bld, unit,
+                                   min_filter, mip_filter,
+                                   s, t, r,
+                                   ilevel0, ilevel1, lod_fpart,
+                                   texels);
+         }
       }
       lp_build_else(&if_ctx);
       {
@@ -1247,6 +1370,7 @@ lp_build_sample_soa(struct gallivm_state *gallivm,
       lp_build_sample_nop(gallivm, bld.texel_type, texel_out);
    }
    else if (util_format_fits_8unorm(bld.format_desc) &&
+            !static_state->max_anisotropy &&
             lp_is_simple_wrap_mode(static_state->wrap_s) &&
             lp_is_simple_wrap_mode(static_state->wrap_t)) {
       /* do sampling/filtering with fixed pt arithmetic */
@@ -75,6 +75,8 @@ def prolog():
 #include "util/u_debug.h"
 #include "pipe/p_defines.h"
 #include "util/u_memory.h"
+#include "util/u_cpu_detect.h"
+#include "util/u_sse.h"
 
 
 static unsigned out_size_idx( unsigned index_size )
@@ -101,6 +103,85 @@ static u_translate_func translate[IN_COUNT][OUT_COUNT][PV_COUNT][PV_COUNT][PRIM_
 static u_generate_func  generate[OUT_COUNT][PV_COUNT][PV_COUNT][PRIM_COUNT];
 
 
+/*
+ * Index size conversions, which is all the translations keeping the
+ * vertex order (points, lines and triangles with the same provoking
+ * vertex) come down to.  The widening ones use SSE2 unpacks.
+ */
+
+static void convert_ubyte2ushort( const ubyte *in, unsigned nr, ushort *out )
+{
+   unsigned i = 0;
+#if defined(PIPE_ARCH_SSE)
+   if (util_cpu_caps.has_sse2) {
+      const __m128i zero = _mm_setzero_si128();
+      for (; i + 16 <= nr; i += 16) {
+         __m128i v = _mm_loadu_si128((const __m128i *)(in + i));
+         _mm_storeu_si128((__m128i *)(out + i), _mm_unpacklo_epi8(v, zero));
+         _mm_storeu_si128((__m128i *)(out + i + 8), _mm_unpackhi_epi8(v, zero));
+      }
+   }
+#endif
+   for (; i < nr; i++)
+      out[i] = (ushort)in[i];
+}
+
+static void convert_ubyte2uint( const ubyte *in, unsigned nr, uint *out )
+{
+   unsigned i = 0;
+#if defined(PIPE_ARCH_SSE)
+   if (util_cpu_caps.has_sse2) {
+      const __m128i zero = _mm_setzero_si128();
+      for (; i + 16 <= nr; i += 16) {
+         __m128i v = _mm_loadu_si128((const __m128i *)(in + i));
+         __m128i lo = _mm_unpacklo_epi8(v, zero);
+         __m128i hi = _mm_unpackhi_epi8(v, zero);
+         _mm_storeu_si128((__m128i *)(out + i), _mm_unpacklo_epi16(lo, zero));
+         _mm_storeu_si128((__m128i *)(out + i + 4), _mm_unpackhi_epi16(lo, zero));
+         _mm_storeu_si128((__m128i *)(out + i + 8), _mm_unpacklo_epi16(hi, zero));
+         _mm_storeu_si128((__m128i *)(out + i + 12), _mm_unpackhi_epi16(hi, zero));
+      }
+   }
+#endif
+   for (; i < nr; i++)
+      out[i] = (uint)in[i];
+}
+
+static void convert_ushort2uint( const ushort *in, unsigned nr, uint *out )
+{
+   unsigned i = 0;
+#if defined(PIPE_ARCH_SSE)
+   if (util_cpu_caps.has_sse2) {
+      const __m128i zero = _mm_setzero_si128();
+      for (; i + 8 <= nr; i += 8) {
+         __m128i v = _mm_loadu_si128((const __m128i *)(in + i));
+         _mm_storeu_si128((__m128i *)(out + i), _mm_unpacklo_epi16(v, zero));
+         _mm_storeu_si128((__m128i *)(out + i + 4), _mm_unpackhi_epi16(v, zero));
+      }
+   }
+#endif
+   for (; i < nr; i++)
+      out[i] = (uint)in[i];
+}
+
+static void convert_ushort2ushort( const ushort *in, unsigned nr, ushort *out )
+{
+   memcpy(out, in, nr * sizeof *out);
+}
+
+static void convert_uint2uint( const uint *in, unsigned nr, uint *out )
+{
+   memcpy(out, in, nr * sizeof *out);
+}
+
+static void convert_uint2ushort( const uint *in, unsigned nr, ushort *out )
+{
+   unsigned i;
+   for (i = 0; i < nr; i++)
+      out[i] = (ushort)in[i];
+}
+
+
 '''
 
 def vert( intype, outtype, v0 ):
@@ -143,6 +224,47 @@ def do_quad( intype, outtype, ptr, v0, v1, v2, v3, inpv, outpv ):
     do_tri( intype, outtype, ptr+'+0',  v0, v1, v3, inpv, outpv );
     do_tri( intype, outtype, ptr+'+3',  v1, v2, v3, inpv, outpv );
 
+def tri_order( v0, v1, v2, inpv, outpv ):
+    if inpv == outpv:
+        return [v0, v1, v2]
+    elif inpv == FIRST:
+        return [v1, v2, v0]
+    else:
+        return [v2, v0, v1]
+
+def quad_order( inpv, outpv ):
+    '''Which of the 4 vertices of a quad do_quad() emits, in order.'''
+    return tri_order(0, 1, 3, inpv, outpv) + tri_order(1, 2, 3, inpv, outpv)
+
+def keeps_order( prim, inpv, outpv ):
+    '''Whether the translation is a mere index size conversion.'''
+    return prim == 'points' or (prim in ('lines', 'tris') and inpv == outpv)
+
+def do_convert( intype, outtype ):
+    print '  convert_' + intype + '2' + outtype + '(in, nr, out);'
+    print '  (void)i;'
+
+def shuffle_imm( order ):
+    return '_MM_SHUFFLE(%u, %u, %u, %u)' % (order[3], order[2], order[1], order[0])
+
+def do_quads_sse2( inpv, outpv ):
+    '''Two ushort quads at a time: the first 4 indices of each quad come
+    from one pshuflw/pshufhw, the last 2 from another.'''
+    order = quad_order(inpv, outpv)
+    print '#if defined(PIPE_ARCH_SSE)'
+    print '  if (util_cpu_caps.has_sse2) {'
+    print '    for (; j + 12 <= nr; j+=12, i+=8) {'
+    print '      __m128i v = _mm_loadu_si128((const __m128i *)(in + i));'
+    print '      __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, %s), %s);' % (shuffle_imm(order[0:4]), shuffle_imm(order[0:4]))
+    print '      __m128i b = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, %s), %s);' % (shuffle_imm(order[4:6] + [0, 0]), shuffle_imm(order[4:6] + [0, 0]))
+    print '      _mm_storel_epi64((__m128i *)(out + j), a);'
+    print '      *(int *)(out + j + 4) = _mm_cvtsi128_si32(b);'
+    print '      _mm_storel_epi64((__m128i *)(out + j + 6), _mm_srli_si128(a, 8));'
+    print '      *(int *)(out + j + 10) = _mm_cvtsi128_si32(_mm_srli_si128(b, 8));'
+    print '    }'
+    print '  }'
+    print '#endif'
+
 def name(intype, outtype, inpv, outpv, prim):
     if intype == GENERATE:
         return 'generate_' + prim + '_' + outtype + '_' + inpv + '2' + outpv
@@ -168,6 +290,10 @@ def postamble():
 
 def points(intype, outtype, inpv, outpv):
     preamble(intype, outtype, inpv, outpv, prim='points')
+    if intype != GENERATE and keeps_order('points', inpv, outpv):
+        do_convert( intype, outtype )
+        postamble()
+        return
     print '  for (i = 0; i < nr; i++) { '
     do_point( intype, outtype, 'out+i',  'i' );
     print '   }'
@@ -175,6 +301,10 @@ def points(intype, outtype, inpv, outpv):
 
 def lines(intype, outtype, inpv, outpv):
     preamble(intype, outtype, inpv, outpv, prim='lines')
+    if intype != GENERATE and keeps_order('lines', inpv, outpv):
+        do_convert( intype, outtype )
+        postamble()
+        return
     print '  for (i = 0; i < nr; i+=2) { '
     do_line( intype, outtype, 'out+i',  'i', 'i+1', inpv, outpv );
     print '   }'
@@ -197,6 +327,10 @@ def lineloop(intype, outtype, inpv, outpv):
 
 def tris(intype, outtype, inpv, outpv):
     preamble(intype, outtype, inpv, outpv, prim='tris')
+    if intype != GENERATE and keeps_order('tris', inpv, outpv):
+        do_convert( intype, outtype )
+        postamble()
+        return
     print '  for (i = 0; i < nr; i+=3) { '
     do_tri( intype, outtype, 'out+i',  'i', 'i+1', 'i+2', inpv, outpv );
     print '   }'
@@ -236,7 +370,10 @@ def polygon(intype, outtype, inpv, outpv):
 
 def quads(intype, outtype, inpv, outpv):
     preamble(intype, outtype, inpv, outpv, prim='quads')
-    print '  for (j = i = 0; j < nr; j+=6, i+=4) { '
+    print '  j = i = 0;'
+    if intype == USHORT and outtype == USHORT:
+        do_quads_sse2( inpv, outpv )
+    print '  for (; j < nr; j+=6, i+=4) { '
     do_quad( intype, outtype, 'out+j', 'i+0', 'i+1', 'i+2', 'i+3', inpv, outpv );
     print '   }'
     postamble()
@@ -298,6 +435,7 @@ def emit_init():
     print '  static int firsttime = 1;'
     print '  if (!firsttime) return;'
     print '  firsttime = 0;'
+    print '  util_cpu_detect();'
     emit_all_inits()
     print '}'
 
@@ -33,15 +33,25 @@
 #include "util/u_memory.h"
 #include "util/u_format.h"
 #include "util/u_math.h"
+#include "util/u_half.h"
 #include "pipe/p_state.h"
 #include "translate.h"
 
 
 #define DRAW_DBG 0
 
+/**
+ * Number of vertices the run functions process at a time, one attribute
+ * after the other, so that the per-attribute setup is done once per batch.
+ */
+#define GENERIC_BATCH_SIZE 8
+
 typedef void (*fetch_func)(float *dst,
                            const uint8_t *src,
                            unsigned i, unsigned j);
+typedef void (*unpack_func)(float *dst, unsigned dst_stride,
+                            const uint8_t *src, unsigned src_stride,
+                            unsigned width, unsigned height);
 typedef void (*emit_func)(const float *attrib, void *ptr);
 
 
@@ -53,6 +63,7 @@ struct translate_generic {
       enum translate_element_type type;
 
       fetch_func fetch;
+      unpack_func unpack;
       unsigned buffer;
       unsigned input_offset;
       unsigned instance_divisor;
@@ -62,6 +73,7 @@ struct translate_generic {
       
       const uint8_t *input_ptr;
       unsigned input_stride;
+      unsigned input_size;    /* bytes per vertex, or 0 if not a whole number */
       unsigned max_index;
 
       /* this value is set to -1 if this is a normal element with output_format != input_format:
@@ -105,6 +117,7 @@ emit_##NAME(const float *attrib, void *ptr)		\
 
 #define TO_64_FLOAT(x)   ((double) x)
 #define TO_32_FLOAT(x)   (x)
+#define TO_16_FLOAT(x)   util_float_to_half(x)
 
 #define TO_8_USCALED(x)  ((unsigned char) x)
 #define TO_16_USCALED(x) ((unsigned short) x)
@@ -135,6 +148,11 @@ ATTRIB( R32G32B32_FLOAT,      3, float, TO_32_FLOAT )
 ATTRIB( R32G32_FLOAT,         2, float, TO_32_FLOAT )
 ATTRIB( R32_FLOAT,            1, float, TO_32_FLOAT )
 
+ATTRIB( R16G16B16A16_FLOAT,   4, ushort, TO_16_FLOAT )
+ATTRIB( R16G16B16_FLOAT,      3, ushort, TO_16_FLOAT )
+ATTRIB( R16G16_FLOAT,         2, ushort, TO_16_FLOAT )
+ATTRIB( R16_FLOAT,            1, ushort, TO_16_FLOAT )
+
 ATTRIB( R32G32B32A32_USCALED, 4, unsigned, TO_32_USCALED )
 ATTRIB( R32G32B32_USCALED,    3, unsigned, TO_32_USCALED )
 ATTRIB( R32G32_USCALED,       2, unsigned, TO_32_USCALED )
@@ -215,6 +233,33 @@ emit_B8G8R8A8_UNORM( const float *attrib, void *ptr)
    out[3] = TO_8_UNORM(attrib[3]);
 }
 
+/* these are rounded and clamped like the u_format pack functions, the
+ * 2 bit alpha channel wouldn't survive a round trip otherwise */
+#define TO_10_UNORM(x)   ((unsigned) util_iround(CLAMP(x, 0.0f, 1.0f) * 1023.0f))
+#define TO_2_UNORM(x)    ((unsigned) util_iround(CLAMP(x, 0.0f, 1.0f) * 3.0f))
+#define TO_10_USCALED(x) ((unsigned) (x) & 0x3ff)
+#define TO_2_USCALED(x)  ((unsigned) (x) & 0x3)
+#define TO_10_SNORM(x)   ((unsigned) util_iround(CLAMP(x, -1.0f, 1.0f) * 511.0f) & 0x3ff)
+#define TO_2_SNORM(x)    ((unsigned) util_iround(CLAMP(x, -1.0f, 1.0f)) & 0x3)
+#define TO_10_SSCALED(x) ((unsigned) (int) (x) & 0x3ff)
+#define TO_2_SSCALED(x)  ((unsigned) (int) (x) & 0x3)
+
+#define ATTRIB_1010102( NAME, TO10, TO2 )                \
+static void                                             \
+emit_##NAME(const float *attrib, void *ptr)             \
+{                                                       \
+   uint32_t value = TO10(attrib[0]);                    \
+   value |= TO10(attrib[1]) << 10;                      \
+   value |= TO10(attrib[2]) << 20;                      \
+   value |= TO2(attrib[3]) << 30;                       \
+   *(uint32_t *)ptr = util_le32_to_cpu(value);          \
+}
+
+ATTRIB_1010102( R10G10B10A2_UNORM,   TO_10_UNORM,   TO_2_UNORM )
+ATTRIB_1010102( R10G10B10A2_USCALED, TO_10_USCALED, TO_2_USCALED )
+ATTRIB_1010102( R10G10B10A2_SNORM,   TO_10_SNORM,   TO_2_SNORM )
+ATTRIB_1010102( R10G10B10A2_SSCALED, TO_10_SSCALED, TO_2_SSCALED )
+
 static void 
 emit_NULL( const float *attrib, void *ptr )
 {
@@ -242,6 +287,15 @@ static emit_func get_emit_func( enum pipe_format format )
    case PIPE_FORMAT_R32G32B32A32_FLOAT:
       return &emit_R32G32B32A32_FLOAT;
 
+   case PIPE_FORMAT_R16_FLOAT:
+      return &emit_R16_FLOAT;
+   case PIPE_FORMAT_R16G16_FLOAT:
+      return &emit_R16G16_FLOAT;
+   case PIPE_FORMAT_R16G16B16_FLOAT:
+      return &emit_R16G16B16_FLOAT;
+   case PIPE_FORMAT_R16G16B16A16_FLOAT:
+      return &emit_R16G16B16A16_FLOAT;
+
    case PIPE_FORMAT_R32_UNORM:
       return &emit_R32_UNORM;
    case PIPE_FORMAT_R32G32_UNORM:
@@ -356,125 +410,156 @@ static emit_func get_emit_func( enum pipe_format format )
    case PIPE_FORMAT_A8R8G8B8_UNORM:
       return &emit_A8R8G8B8_UNORM;
 
+   case PIPE_FORMAT_R10G10B10A2_UNORM:
+      return &emit_R10G10B10A2_UNORM;
+   case PIPE_FORMAT_R10G10B10A2_USCALED:
+      return &emit_R10G10B10A2_USCALED;
+   case PIPE_FORMAT_R10G10B10A2_SNORM:
+      return &emit_R10G10B10A2_SNORM;
+   case PIPE_FORMAT_R10G10B10A2_SSCALED:
+      return &emit_R10G10B10A2_SSCALED;
+
    default:
       assert(0); 
       return &emit_NULL;
    }
 }
 
-static ALWAYS_INLINE void PIPE_CDECL generic_run_one( struct translate_generic *tg,
-                                         unsigned elt,
-                                         unsigned instance_id,
-                                         void *vert )
+/**
+ * Fetch and emit the vertex attributes of 'count' (at most
+ * GENERIC_BATCH_SIZE) vertices, one attribute after the other.
+ *
+ * If 'linear' is set the elts are consecutive, which lets the attributes
+ * that don't need clamping be converted with a single unpack call.
+ */
+static ALWAYS_INLINE void PIPE_CDECL generic_run_batch( struct translate_generic *tg,
+                                           const unsigned *elts,
+                                           boolean linear,
+                                           unsigned count,
+                                           unsigned instance_id,
+                                           void *output_buffer )
 {
+   const unsigned output_stride = tg->translate.key.output_stride;
    unsigned nr_attrs = tg->nr_attrib;
-   unsigned attr;
+   unsigned attr, i;
 
    for (attr = 0; attr < nr_attrs; attr++) {
-      float data[4];
-      uint8_t *dst = (uint8_t *)vert + tg->attrib[attr].output_offset;
+      float data[GENERIC_BATCH_SIZE][4];
+      uint8_t *dst = (uint8_t *)output_buffer + tg->attrib[attr].output_offset;
+      int copy_size = tg->attrib[attr].copy_size;
 
       if (tg->attrib[attr].type == TRANSLATE_ELEMENT_NORMAL) {
-         const uint8_t *src;
-         unsigned index;
-         int copy_size;
+         const uint8_t *input_ptr = tg->attrib[attr].input_ptr;
+         unsigned input_stride = tg->attrib[attr].input_stride;
+         unsigned max_index = tg->attrib[attr].max_index;
 
          if (tg->attrib[attr].instance_divisor) {
-            index = instance_id / tg->attrib[attr].instance_divisor;
-            /* XXX we need to clamp the index here too, but to a
+            /* The same value for the whole batch.
+             *
+             * XXX we need to clamp the index here too, but to a
              * per-array max value, not the draw->pt.max_index value
              * that's being given to us via translate->set_buffer().
              */
+            unsigned index = instance_id / tg->attrib[attr].instance_divisor;
+            const uint8_t *src = input_ptr + input_stride * index;
+
+            if (likely(copy_size >= 0)) {
+               for (i = 0; i < count; i++)
+                  memcpy(dst + i * output_stride, src, copy_size);
+            }
+            else {
+               tg->attrib[attr].fetch( data[0], src, 0, 0 );
+               for (i = 0; i < count; i++)
+                  tg->attrib[attr].emit( data[0], dst + i * output_stride );
+            }
          }
-         else {
-            index = elt;
-            /* clamp to avoid going out of bounds */
-            index = MIN2(index, tg->attrib[attr].max_index);
+         else if (likely(copy_size >= 0)) {
+            for (i = 0; i < count; i++) {
+               /* clamp to avoid going out of bounds */
+               unsigned index = MIN2(elts[i], max_index);
+               memcpy(dst + i * output_stride,
+                      input_ptr + input_stride * index, copy_size);
+            }
          }
-
-         src = tg->attrib[attr].input_ptr +
-               tg->attrib[attr].input_stride * index;
-
-         copy_size = tg->attrib[attr].copy_size;
-         if(likely(copy_size >= 0))
-            memcpy(dst, src, copy_size);
-         else
-         {
-            tg->attrib[attr].fetch( data, src, 0, 0 );
+         else {
+            if (linear && elts[count - 1] <= max_index) {
+               const uint8_t *src = input_ptr + input_stride * elts[0];
+
+               if (input_stride == tg->attrib[attr].input_size)
+                  tg->attrib[attr].unpack( data[0], sizeof data,
+                                           src, input_stride * count,
+                                           count, 1 );
+               else
+                  tg->attrib[attr].unpack( data[0], sizeof data[0],
+                                           src, input_stride,
+                                           1, count );
+            }
+            else {
+               for (i = 0; i < count; i++) {
+                  /* clamp to avoid going out of bounds */
+                  unsigned index = MIN2(elts[i], max_index);
+                  tg->attrib[attr].fetch( data[i],
+                                          input_ptr + input_stride * index,
+                                          0, 0 );
+               }
+            }
 
             if (0)
-               debug_printf("Fetch linear attr %d  from %p  stride %d  index %d: "
+               debug_printf("Fetch attr %d  from %p  stride %d  index %d: "
                          " %f, %f, %f, %f \n",
                          attr,
-                         tg->attrib[attr].input_ptr,
-                         tg->attrib[attr].input_stride,
-                         index,
-                         data[0], data[1],data[2], data[3]);
+                         input_ptr,
+                         input_stride,
+                         elts[0],
+                         data[0][0], data[0][1], data[0][2], data[0][3]);
 
-            tg->attrib[attr].emit( data, dst );
+            for (i = 0; i < count; i++)
+               tg->attrib[attr].emit( data[i], dst + i * output_stride );
          }
       } else {
-         if(likely(tg->attrib[attr].copy_size >= 0))
-            memcpy(data, &instance_id, 4);
+         if(likely(copy_size >= 0)) {
+            for (i = 0; i < count; i++)
+               memcpy(dst + i * output_stride, &instance_id, 4);
+         }
          else
          {
-            data[0] = (float)instance_id;
-            tg->attrib[attr].emit( data, dst );
+            data[0][0] = (float)instance_id;
+            for (i = 0; i < count; i++)
+               tg->attrib[attr].emit( data[0], dst + i * output_stride );
          }
       }
    }
 }
 
+#define GENERIC_RUN_ELTS( NAME, TYPE )                                  \
+static void PIPE_CDECL NAME( struct translate *translate,              \
+                             const TYPE *elts,                         \
+                             unsigned count,                           \
+                             unsigned instance_id,                     \
+                             void *output_buffer )                     \
+{                                                                      \
+   struct translate_generic *tg = translate_generic(translate);        \
+   const unsigned output_stride = tg->translate.key.output_stride;     \
+   char *vert = output_buffer;                                         \
+   unsigned batch[GENERIC_BATCH_SIZE];                                 \
+   unsigned i, n;                                                      \
+                                                                       \
+   while (count) {                                                     \
+      n = MIN2(count, GENERIC_BATCH_SIZE);                             \
+      for (i = 0; i < n; i++)                                          \
+         batch[i] = *elts++;                                           \
+      generic_run_batch(tg, batch, FALSE, n, instance_id, vert);       \
+      vert += n * output_stride;                                       \
+      count -= n;                                                      \
+   }                                                                   \
+}
+
 /**
  * Fetch vertex attributes for 'count' vertices.
  */
-static void PIPE_CDECL generic_run_elts( struct translate *translate,
-                                         const unsigned *elts,
-                                         unsigned count,
-                                         unsigned instance_id,
-                                         void *output_buffer )
-{
-   struct translate_generic *tg = translate_generic(translate);
-   char *vert = output_buffer;
-   unsigned i;
-
-   for (i = 0; i < count; i++) {
-      generic_run_one(tg, *elts++, instance_id, vert);
-      vert += tg->translate.key.output_stride;
-   }
-}
-
-static void PIPE_CDECL generic_run_elts16( struct translate *translate,
-                                         const uint16_t *elts,
-                                         unsigned count,
-                                         unsigned instance_id,
-                                         void *output_buffer )
-{
-   struct translate_generic *tg = translate_generic(translate);
-   char *vert = output_buffer;
-   unsigned i;
-
-   for (i = 0; i < count; i++) {
-      generic_run_one(tg, *elts++, instance_id, vert);
-      vert += tg->translate.key.output_stride;
-   }
-}
-
-static void PIPE_CDECL generic_run_elts8( struct translate *translate,
-                                         const uint8_t *elts,
-                                         unsigned count,
-                                         unsigned instance_id,
-                                         void *output_buffer )
-{
-   struct translate_generic *tg = translate_generic(translate);
-   char *vert = output_buffer;
-   unsigned i;
-
-   for (i = 0; i < count; i++) {
-      generic_run_one(tg, *elts++, instance_id, vert);
-      vert += tg->translate.key.output_stride;
-   }
-}
+GENERIC_RUN_ELTS( generic_run_elts, unsigned )
+GENERIC_RUN_ELTS( generic_run_elts16, uint16_t )
+GENERIC_RUN_ELTS( generic_run_elts8, uint8_t )
 
 static void PIPE_CDECL generic_run( struct translate *translate,
                                     unsigned start,
@@ -483,12 +568,19 @@ static void PIPE_CDECL generic_run( struct translate *translate,
                                     void *output_buffer )
 {
    struct translate_generic *tg = translate_generic(translate);
+   const unsigned output_stride = tg->translate.key.output_stride;
    char *vert = output_buffer;
-   unsigned i;
-
-   for (i = 0; i < count; i++) {
-      generic_run_one(tg, start + i, instance_id, vert);
-      vert += tg->translate.key.output_stride;
+   unsigned batch[GENERIC_BATCH_SIZE];
+   unsigned i, n;
+
+   while (count) {
+      n = MIN2(count, GENERIC_BATCH_SIZE);
+      for (i = 0; i < n; i++)
+         batch[i] = start + i;
+      generic_run_batch(tg, batch, TRUE, n, instance_id, vert);
+      vert += n * output_stride;
+      start += n;
+      count -= n;
    }
 }
 
@@ -547,12 +639,18 @@ struct translate *translate_generic_create( const struct translate_key *key )
       tg->attrib[i].type = key->element[i].type;
 
       tg->attrib[i].fetch = format_desc->fetch_rgba_float;
+      tg->attrib[i].unpack = format_desc->unpack_rgba_float;
       tg->attrib[i].buffer = key->element[i].input_buffer;
       tg->attrib[i].input_offset = key->element[i].input_offset;
       tg->attrib[i].instance_divisor = key->element[i].instance_divisor;
 
       tg->attrib[i].output_offset = key->element[i].output_offset;
 
+      if (format_desc->block.width == 1
+            && format_desc->block.height == 1
+            && !(format_desc->block.bits & 7))
+         tg->attrib[i].input_size = format_desc->block.bits >> 3;
+
       tg->attrib[i].copy_size = -1;
       if (tg->attrib[i].type == TRANSLATE_ELEMENT_INSTANCE_ID)
       {
@@ -595,6 +693,11 @@ boolean translate_generic_is_output_format_supported(enum pipe_format format)
    case PIPE_FORMAT_R32G32_FLOAT: return TRUE;
    case PIPE_FORMAT_R32_FLOAT: return TRUE;
 
+   case PIPE_FORMAT_R16G16B16A16_FLOAT: return TRUE;
+   case PIPE_FORMAT_R16G16B16_FLOAT: return TRUE;
+   case PIPE_FORMAT_R16G16_FLOAT: return TRUE;
+   case PIPE_FORMAT_R16_FLOAT: return TRUE;
+
    case PIPE_FORMAT_R32G32B32A32_USCALED: return TRUE;
    case PIPE_FORMAT_R32G32B32_USCALED: return TRUE;
    case PIPE_FORMAT_R32G32_USCALED: return TRUE;
@@ -657,6 +760,11 @@ boolean translate_generic_is_output_format_supported(enum pipe_format format)
 
    case PIPE_FORMAT_A8R8G8B8_UNORM: return TRUE;
    case PIPE_FORMAT_B8G8R8A8_UNORM: return TRUE;
+
+   case PIPE_FORMAT_R10G10B10A2_UNORM: return TRUE;
+   case PIPE_FORMAT_R10G10B10A2_USCALED: return TRUE;
+   case PIPE_FORMAT_R10G10B10A2_SNORM: return TRUE;
+   case PIPE_FORMAT_R10G10B10A2_SSCALED: return TRUE;
    default: return FALSE;
    }
 }
@@ -62,7 +62,7 @@ struct translate_buffer_variant {
 
 #define ELEMENT_BUFFER_INSTANCE_ID  1001
 
-#define NUM_CONSTS 7
+#define NUM_CONSTS 16
 
 enum
 {
@@ -72,7 +72,16 @@ enum
    CONST_INV_32767,
    CONST_INV_65535,
    CONST_INV_2147483647,
-   CONST_255
+   CONST_255,
+   CONST_2_112,
+   CONST_65536,
+   CONST_SIGN,
+   CONST_2_32,
+   CONST_1010102_UNORM,
+   CONST_1010102_SNORM,
+   CONST_1010102_SCALED,
+   CONST_1010102_MASK,
+   CONST_1010102_SIGN
 };
 
 #define C(v) {(float)(v), (float)(v), (float)(v), (float)(v)}
@@ -83,10 +92,27 @@ static float consts[NUM_CONSTS][4] = {
       C(1.0 / 32767.0),
       C(1.0 / 65535.0),
       C(1.0 / 2147483647.0),
-      C(255.0)
+      C(255.0),
+      C(5192296858534827628530496329220096.0), /* 2^112 */
+      C(65536.0),
+      C(-0.0),
+      C(4294967296.0),
+      /* the 10_10_10_2 channels are converted in place, so the scales
+       * also undo the shift of each channel */
+      {1.0 / 1023.0, 1.0 / (1023.0 * 1024.0), 1.0 / (1023.0 * 1048576.0), 1.0 / (3.0 * 1073741824.0)},
+      {1.0 / 511.0, 1.0 / (511.0 * 1024.0), 1.0 / (511.0 * 1048576.0), 1.0 / 1073741824.0},
+      {1.0, 1.0 / 1024.0, 1.0 / 1048576.0, 1.0 / 1073741824.0},
+      /* integer masks, filled from int_consts */
+      C(0),
+      C(0)
 };
 #undef C
 
+static const uint32_t int_consts[2][4] = {
+      {0x3ff, 0x3ff << 10, 0x3ff << 20, 0xc0000000},
+      {0x200, 0x200 << 10, 0x200 << 20, 0}
+};
+
 struct translate_sse {
    struct translate translate;
 
@@ -214,6 +240,88 @@ static boolean emit_load_sse2( struct translate_sse *p,
    return TRUE;
 }
 
+/* convert the half floats in the low words of data to floats */
+static void emit_half_to_float( struct translate_sse *p,
+                                struct x86_reg data )
+{
+   struct x86_reg tmpXMM = x86_make_reg(file_XMM, 1);
+
+   sse2_punpcklwd(p->func, data, get_const(p, CONST_IDENTITY));
+   sse2_pslld_imm(p->func, data, 16);
+
+   /* exponent and mantissa, rebiased by scaling, which also takes care
+    * of the (rare, and slow) denormals */
+   sse_movaps(p->func, tmpXMM, data);
+   sse2_pslld_imm(p->func, tmpXMM, 1);
+   sse2_psrld_imm(p->func, tmpXMM, 4);
+   sse_mulps(p->func, tmpXMM, get_const(p, CONST_2_112));
+
+   sse_andps(p->func, data, get_const(p, CONST_SIGN));
+   sse_orps(p->func, data, tmpXMM);
+
+   /* infinities and NaNs end up >= 65536: force the exponent to 255 */
+   sse_cmpps(p->func, tmpXMM, get_const(p, CONST_65536), cc_NotLessThan);
+   sse2_pslld_imm(p->func, tmpXMM, 24);
+   sse2_psrld_imm(p->func, tmpXMM, 1);
+   sse_orps(p->func, data, tmpXMM);
+}
+
+static boolean is_r10g10b10a2( enum pipe_format format )
+{
+   switch(format)
+   {
+   case PIPE_FORMAT_R10G10B10A2_UNORM:
+   case PIPE_FORMAT_R10G10B10A2_USCALED:
+   case PIPE_FORMAT_R10G10B10A2_SNORM:
+   case PIPE_FORMAT_R10G10B10A2_SSCALED:
+      return TRUE;
+   default:
+      return FALSE;
+   }
+}
+
+/* load a 10_10_10_2 value and convert its 4 channels to floats */
+static void emit_load_r10g10b10a2( struct translate_sse *p,
+                                   struct x86_reg data,
+                                   struct x86_reg src,
+                                   const struct util_format_description *desc )
+{
+   struct x86_reg tmpXMM = x86_make_reg(file_XMM, 1);
+
+   /* every channel in place in its own lane */
+   sse2_movd(p->func, data, src);
+   sse2_pshufd(p->func, data, data, SHUF(0, 0, 0, 0));
+
+   if(desc->channel[0].type == UTIL_FORMAT_TYPE_SIGNED)
+   {
+      /* subtract twice the sign bit of each channel */
+      sse_movaps(p->func, tmpXMM, data);
+      sse_andps(p->func, data, get_const(p, CONST_1010102_MASK));
+      sse_andps(p->func, tmpXMM, get_const(p, CONST_1010102_SIGN));
+      sse2_cvtdq2ps(p->func, data, data);
+      sse2_cvtdq2ps(p->func, tmpXMM, tmpXMM);
+      sse_addps(p->func, tmpXMM, tmpXMM);
+      sse_subps(p->func, data, tmpXMM);
+   }
+   else
+   {
+      /* the alpha channel sets the sign bit: add 2^32 back */
+      sse_andps(p->func, data, get_const(p, CONST_1010102_MASK));
+      sse_movaps(p->func, tmpXMM, data);
+      sse2_psrad_imm(p->func, tmpXMM, 31);
+      sse_andps(p->func, tmpXMM, get_const(p, CONST_2_32));
+      sse2_cvtdq2ps(p->func, data, data);
+      sse_addps(p->func, data, tmpXMM);
+   }
+
+   if(!desc->channel[0].normalized)
+      sse_mulps(p->func, data, get_const(p, CONST_1010102_SCALED));
+   else if(desc->channel[0].type == UTIL_FORMAT_TYPE_SIGNED)
+      sse_mulps(p->func, data, get_const(p, CONST_1010102_SNORM));
+   else
+      sse_mulps(p->func, data, get_const(p, CONST_1010102_UNORM));
+}
+
 /* this value can be passed for the out_chans argument */
 #define CHANNELS_0001 5
 
@@ -457,17 +565,30 @@ static boolean translate_attr_convert( struct translate_sse *p,
    if(a->output_format == PIPE_FORMAT_NONE || a->input_format == PIPE_FORMAT_NONE)
       return FALSE;
 
-   if(input_desc->channel[0].size & 7)
-      return FALSE;
-
    if(input_desc->colorspace != output_desc->colorspace)
       return FALSE;
 
-   for(i = 1; i < input_desc->nr_channels; ++i)
+   if(is_r10g10b10a2(a->input_format))
    {
-      if(memcmp(&input_desc->channel[i], &input_desc->channel[0], sizeof(input_desc->channel[0])))
+      /* only converted to floats */
+      if(!(x86_target_caps(p->func) & X86_SSE2) || !(0
+            || a->output_format == PIPE_FORMAT_R32_FLOAT
+            || a->output_format == PIPE_FORMAT_R32G32_FLOAT
+            || a->output_format == PIPE_FORMAT_R32G32B32_FLOAT
+            || a->output_format == PIPE_FORMAT_R32G32B32A32_FLOAT))
          return FALSE;
    }
+   else
+   {
+      if(input_desc->channel[0].size & 7)
+         return FALSE;
+
+      for(i = 1; i < input_desc->nr_channels; ++i)
+      {
+         if(memcmp(&input_desc->channel[i], &input_desc->channel[0], sizeof(input_desc->channel[0])))
+            return FALSE;
+      }
+   }
 
    for(i = 1; i < output_desc->nr_channels; ++i)
    {
@@ -505,7 +626,9 @@ static boolean translate_attr_convert( struct translate_sse *p,
 
       if(needed_chans > 0)
       {
-         switch(input_desc->channel[0].type)
+         if(is_r10g10b10a2(a->input_format))
+            emit_load_r10g10b10a2(p, dataXMM, src, input_desc);
+         else switch(input_desc->channel[0].type)
          {
          case UTIL_FORMAT_TYPE_UNSIGNED:
             if(!(x86_target_caps(p->func) & X86_SSE2))
@@ -608,15 +731,22 @@ static boolean translate_attr_convert( struct translate_sse *p,
 
             break;
          case UTIL_FORMAT_TYPE_FLOAT:
-            if(input_desc->channel[0].size != 32 && input_desc->channel[0].size != 64)
+            if(input_desc->channel[0].size != 16 && input_desc->channel[0].size != 32 && input_desc->channel[0].size != 64)
                return FALSE;
-            if(swizzle[3] == UTIL_FORMAT_SWIZZLE_1 && input_desc->nr_channels <= 3)
+            if(swizzle[3] == UTIL_FORMAT_SWIZZLE_1 && input_desc->nr_channels <= 3
+                  && input_desc->channel[0].size != 16)
             {
                swizzle[3] = UTIL_FORMAT_SWIZZLE_W;
                needed_chans = CHANNELS_0001;
             }
             switch(input_desc->channel[0].size)
             {
+            case 16:
+               if(!(x86_target_caps(p->func) & X86_SSE2))
+                  return FALSE;
+               emit_load_sse2(p, dataXMM, src, 2 * input_desc->nr_channels);
+               emit_half_to_float(p, dataXMM);
+               break;
             case 32:
                emit_load_float32(p, dataXMM, src, needed_chans, input_desc->nr_channels);
                break;
@@ -1463,6 +1593,7 @@ struct translate *translate_sse2_create( const struct translate_key *key )
       goto fail;
    memset(p, 0, sizeof(*p));
    memcpy(p->consts, consts, sizeof(consts));
+   memcpy(p->consts[CONST_1010102_MASK], int_consts, sizeof(int_consts));
 
    p->translate.key = *key;
    p->translate.release = translate_sse_release;
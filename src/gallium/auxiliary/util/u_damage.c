@@ -0,0 +1,226 @@
+/**************************************************************************
+ *
+ * Copyright 2012 The Mesa authors.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * @file
+ * Tile granularity damage tracking.
+ */
+
+
+#include "pipe/p_state.h"
+#include "util/u_box.h"
+#include "util/u_damage.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"
+
+
+/**
+ * Initialize damage tracking for a width x height image.  The whole image
+ * starts damaged, as its contents were never presented.
+ */
+boolean
+util_damage_init(struct util_damage *damage,
+                 unsigned width, unsigned height,
+                 unsigned tile_size_log2)
+{
+   const unsigned tile_size = 1 << tile_size_log2;
+
+   damage->width = width;
+   damage->height = height;
+   damage->tile_size_log2 = tile_size_log2;
+   damage->tiles_x = (width + tile_size - 1) >> tile_size_log2;
+   damage->tiles_y = (height + tile_size - 1) >> tile_size_log2;
+   damage->tiles = MALLOC(damage->tiles_x * damage->tiles_y);
+   if (!damage->tiles)
+      return FALSE;
+
+   util_damage_all(damage);
+   return TRUE;
+}
+
+
+void
+util_damage_cleanup(struct util_damage *damage)
+{
+   FREE(damage->tiles);
+   damage->tiles = NULL;
+}
+
+
+/**
+ * Flag the tiles touched by a box, in pixels, as damaged.
+ */
+void
+util_damage_box(struct util_damage *damage,
+                const struct pipe_box *box)
+{
+   unsigned tx0, ty0, tx1, ty1, ty;
+
+   if (!damage->tiles || box->width <= 0 || box->height <= 0 ||
+       box->x >= (int) damage->width || box->y >= (int) damage->height)
+      return;
+
+   tx0 = MAX2(box->x, 0) >> damage->tile_size_log2;
+   ty0 = MAX2(box->y, 0) >> damage->tile_size_log2;
+   tx1 = MIN2((box->x + box->width - 1) >> damage->tile_size_log2,
+              (int) damage->tiles_x - 1);
+   ty1 = MIN2((box->y + box->height - 1) >> damage->tile_size_log2,
+              (int) damage->tiles_y - 1);
+
+   for (ty = ty0; ty <= ty1; ty++)
+      memset(damage->tiles + ty * damage->tiles_x + tx0, 1, tx1 - tx0 + 1);
+}
+
+
+void
+util_damage_all(struct util_damage *damage)
+{
+   if (damage->tiles)
+      memset(damage->tiles, 1, damage->tiles_x * damage->tiles_y);
+}
+
+
+/**
+ * Convert a rectangle of tiles to pixels, clipped to the image.
+ */
+static void
+util_damage_tiles_to_box(const struct util_damage *damage,
+                         unsigned tx0, unsigned ty0,
+                         unsigned tx1, unsigned ty1,
+                         struct pipe_box *box)
+{
+   const unsigned shift = damage->tile_size_log2;
+   const unsigned x0 = tx0 << shift, y0 = ty0 << shift;
+   const unsigned x1 = MIN2(tx1 << shift, damage->width);
+   const unsigned y1 = MIN2(ty1 << shift, damage->height);
+
+   u_box_2d(x0, y0, x1 - x0, y1 - y0, box);
+}
+
+
+/**
+ * Return the damaged region as a list of at most max_boxes rectangles, in
+ * pixels, and clear the damage.
+ *
+ * Runs of damaged tiles within a tile row become rectangles, which are
+ * extended downwards while the rows below have a run with the same
+ * horizontal extent.  If that takes more than max_boxes rectangles the
+ * bounding box of the damage is returned instead.
+ *
+ * \return number of rectangles, zero if nothing was damaged
+ */
+unsigned
+util_damage_get_boxes(struct util_damage *damage,
+                      struct pipe_box *boxes,
+                      unsigned max_boxes)
+{
+   /* tile extents of the rectangles, y1 is exclusive */
+   struct {
+      unsigned x0, x1, y0, y1;
+   } rects[UTIL_DAMAGE_MAX_BOXES], bounds;
+   unsigned num_rects = 0, first_active = 0;
+   boolean overflow = FALSE;
+   unsigned tx, ty, i;
+
+   if (!damage->tiles || !max_boxes)
+      return 0;
+
+   max_boxes = MIN2(max_boxes, UTIL_DAMAGE_MAX_BOXES);
+
+   bounds.x0 = damage->tiles_x;
+   bounds.y0 = damage->tiles_y;
+   bounds.x1 = bounds.y1 = 0;
+
+   for (ty = 0; ty < damage->tiles_y; ty++) {
+      const ubyte *row = damage->tiles + ty * damage->tiles_x;
+      /* rectangles which ended on the previous row can still grow */
+      const unsigned last_active = num_rects;
+      unsigned next_active = num_rects;
+
+      tx = 0;
+      while (tx < damage->tiles_x) {
+         unsigned x0;
+
+         if (!row[tx]) {
+            tx++;
+            continue;
+         }
+
+         x0 = tx;
+         while (tx < damage->tiles_x && row[tx])
+            tx++;
+
+         bounds.x0 = MIN2(bounds.x0, x0);
+         bounds.x1 = MAX2(bounds.x1, tx);
+         bounds.y0 = MIN2(bounds.y0, ty);
+         bounds.y1 = ty + 1;
+
+         if (overflow)
+            continue;
+
+         for (i = first_active; i < last_active; i++) {
+            if (rects[i].y1 == ty && rects[i].x0 == x0 && rects[i].x1 == tx)
+               break;
+         }
+
+         if (i < last_active) {
+            rects[i].y1 = ty + 1;
+            next_active = MIN2(next_active, i);
+         }
+         else if (num_rects < max_boxes) {
+            rects[num_rects].x0 = x0;
+            rects[num_rects].x1 = tx;
+            rects[num_rects].y0 = ty;
+            rects[num_rects].y1 = ty + 1;
+            num_rects++;
+         }
+         else {
+            overflow = TRUE;
+         }
+      }
+
+      first_active = next_active;
+
+      memset((void *) row, 0, damage->tiles_x);
+   }
+
+   if (bounds.y1 == 0)
+      return 0;
+
+   if (overflow) {
+      util_damage_tiles_to_box(damage, bounds.x0, bounds.y0,
+                               bounds.x1, bounds.y1, &boxes[0]);
+      return 1;
+   }
+
+   for (i = 0; i < num_rects; i++) {
+      util_damage_tiles_to_box(damage, rects[i].x0, rects[i].y0,
+                               rects[i].x1, rects[i].y1, &boxes[i]);
+   }
+
+   return num_rects;
+}
@@ -0,0 +1,104 @@
+/**************************************************************************
+ *
+ * Copyright 2012 The Mesa authors.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * @file
+ * Tile granularity damage tracking of 2D images.
+ *
+ * Software rasterizers flag the tiles they write to display targets, and
+ * turn them into a short list of rectangles when presenting, so that
+ * winsys only need to upload the regions which actually changed.
+ *
+ * Flags are bytes, so different threads may damage different tiles
+ * concurrently without locking.
+ */
+
+#ifndef U_DAMAGE_H
+#define U_DAMAGE_H
+
+
+#include "pipe/p_compiler.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+struct pipe_box;
+
+
+/** Maximum number of rectangles util_damage_get_boxes() returns */
+#define UTIL_DAMAGE_MAX_BOXES 32
+
+
+struct util_damage
+{
+   unsigned width, height;      /**< image size, in pixels */
+   unsigned tile_size_log2;
+   unsigned tiles_x, tiles_y;
+   ubyte *tiles;                /**< [tiles_y][tiles_x] damaged flags */
+};
+
+
+boolean
+util_damage_init(struct util_damage *damage,
+                 unsigned width, unsigned height,
+                 unsigned tile_size_log2);
+
+void
+util_damage_cleanup(struct util_damage *damage);
+
+void
+util_damage_box(struct util_damage *damage,
+                const struct pipe_box *box);
+
+void
+util_damage_all(struct util_damage *damage);
+
+unsigned
+util_damage_get_boxes(struct util_damage *damage,
+                      struct pipe_box *boxes,
+                      unsigned max_boxes);
+
+
+/**
+ * Flag the tile at the given tile coordinates as damaged.
+ */
+static INLINE void
+util_damage_tile(struct util_damage *damage, unsigned tx, unsigned ty)
+{
+   if (damage->tiles && tx < damage->tiles_x && ty < damage->tiles_y)
+      damage->tiles[ty * damage->tiles_x + tx] = 1;
+}
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* U_DAMAGE_H */
@@ -583,6 +583,294 @@ def generate_pack_kernel(format, src_channel, src_native_type):
         print '         memcpy(dst, &pixel, sizeof pixel);'
     
 
+def is_format_simd(format):
+    '''Whether SSE kernels are generated for the format, i.e., whether it
+    only has 8bit unorm channels, which can be moved around bytewise.'''
+
+    if format.layout != PLAIN or format.colorspace != RGB:
+        return False
+    if format.block_width != 1 or format.block_height != 1:
+        return False
+    if format.block_size() not in (8, 16, 32):
+        return False
+    size = 0
+    for channel in format.channels:
+        if channel.size == 0:
+            continue
+        if channel.size != 8:
+            return False
+        if channel.type != VOID and not (channel.type == UNSIGNED and channel.norm):
+            return False
+        size += channel.size
+    if size != format.block_size():
+        return False
+    for swizzle in format.swizzles:
+        if swizzle == SWIZZLE_NONE:
+            return False
+    return True
+
+
+def simd_unpack_mask(format):
+    '''Return the pshufb mask and the constant to OR, which turn 4 pixels
+    into RGBA8.'''
+
+    stride = format.block_size()/8
+    mask = []
+    ones = 0
+    for x in range(4):
+        for i in range(4):
+            swizzle = format.swizzles[i]
+            if swizzle < 4:
+                mask.append(x*stride + swizzle)
+            else:
+                mask.append(0x80)
+                if swizzle == SWIZZLE_1:
+                    ones |= 0xff << (8*i)
+    return mask, ones
+
+
+def simd_pack_mask(format):
+    '''Return the pshufb mask which turns 4 RGBA8 pixels into the format.'''
+
+    stride = format.block_size()/8
+    inv_swizzle = format.inv_swizzles()
+    mask = []
+    for x in range(4):
+        for i in range(stride):
+            if format.channels[i].type == VOID or inv_swizzle[i] is None:
+                mask.append(0x80)
+            else:
+                mask.append(x*4 + inv_swizzle[i])
+    mask += [0x80]*(16 - len(mask))
+    return mask
+
+
+def simd_mask_expr(mask):
+    return '_mm_setr_epi8(%s)' % ', '.join(['(char)0x%02x' % m for m in mask])
+
+
+def simd_shift_expr(value, src_byte, dst_byte):
+    '''SSE2 expression moving byte src_byte of every dword to dst_byte.'''
+
+    if src_byte != 3:
+        if src_byte:
+            value = '_mm_srli_epi32(%s, %u)' % (value, src_byte*8)
+        value = '_mm_and_si128(%s, mask)' % value
+    else:
+        value = '_mm_srli_epi32(%s, 24)' % value
+    if dst_byte:
+        value = '_mm_slli_epi32(%s, %u)' % (value, dst_byte*8)
+    return value
+
+
+def simd_or_expr(terms, indent):
+    value = terms[0]
+    for term in terms[1:]:
+        value = '_mm_or_si128(%s,\n%s%s)' % (value, ' '*indent, term)
+    return value
+
+
+def simd_load_expr(stride):
+    if stride == 4:
+        return '_mm_loadu_si128((const __m128i *)src)'
+    elif stride == 2:
+        return '_mm_loadl_epi64((const __m128i *)src)'
+    else:
+        return '_mm_cvtsi32_si128(*(const int *)src)'
+
+
+def generate_simd_store(stride):
+    if stride == 4:
+        print '   _mm_storeu_si128((__m128i *)dst, pixels);'
+    elif stride == 2:
+        print '   _mm_storel_epi64((__m128i *)dst, pixels);'
+    else:
+        print '   *(int *)dst = _mm_cvtsi128_si32(pixels);'
+
+
+def generate_simd_helpers():
+    '''Generate the format independent SSE helpers.'''
+
+    print '#ifdef PIPE_ARCH_SSE'
+    print
+    print '/**'
+    print ' * Convert 4 RGBA8 pixels to floats, exactly like ubyte_to_float().'
+    print ' */'
+    print 'static INLINE void'
+    print 'util_format_unorm8_to_float_sse2(float *dst, __m128i pixels)'
+    print '{'
+    print '   const __m128i zero = _mm_setzero_si128();'
+    print '   const __m128 scale = _mm_set1_ps(1.0f / 255.0f);'
+    print '   __m128i lo = _mm_unpacklo_epi8(pixels, zero);'
+    print '   __m128i hi = _mm_unpackhi_epi8(pixels, zero);'
+    print '   _mm_storeu_ps(dst +  0, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)), scale));'
+    print '   _mm_storeu_ps(dst +  4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)), scale));'
+    print '   _mm_storeu_ps(dst +  8, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)), scale));'
+    print '   _mm_storeu_ps(dst + 12, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)), scale));'
+    print '}'
+    print
+    print '/**'
+    print ' * Convert 4 float RGBA pixels to RGBA8, exactly like float_to_ubyte().'
+    print ' */'
+    print 'static INLINE __m128i'
+    print 'util_format_float_to_unorm8_sse2(const float *src)'
+    print '{'
+    print '   const __m128i zero = _mm_setzero_si128();'
+    print '   const __m128i ieee_0996 = _mm_set1_epi32(0x3f7f0000 - 1);'
+    print '   const __m128i mask = _mm_set1_epi32(0xff);'
+    print '   const __m128 scale = _mm_set1_ps(255.0f/256.0f);'
+    print '   const __m128 bias = _mm_set1_ps(32768.0f);'
+    print '   __m128i values[4];'
+    print '   unsigned i;'
+    print '   for (i = 0; i < 4; i++) {'
+    print '      __m128 f = _mm_loadu_ps(src + 4*i);'
+    print '      __m128i bits = _mm_castps_si128(f);'
+    print '      __m128i value = _mm_castps_si128(_mm_add_ps(_mm_mul_ps(f, scale), bias));'
+    print '      value = _mm_and_si128(value, mask);'
+    print '      value = _mm_andnot_si128(_mm_cmplt_epi32(bits, zero), value);'
+    print '      value = _mm_or_si128(value, _mm_and_si128(_mm_cmpgt_epi32(bits, ieee_0996), mask));'
+    print '      values[i] = value;'
+    print '   }'
+    print '   return _mm_packus_epi16(_mm_packs_epi32(values[0], values[1]),'
+    print '                           _mm_packs_epi32(values[2], values[3]));'
+    print '}'
+    print
+    print '#endif /* PIPE_ARCH_SSE */'
+    print
+
+
+def generate_format_simd(format):
+    '''Generate the SSE kernels converting 4 pixels at a time to and from
+    RGBA8, and the row functions using them.'''
+
+    name = format.short_name()
+    stride = format.block_size()/8
+    inv_swizzle = format.inv_swizzles()
+
+    print '#ifdef PIPE_ARCH_SSE'
+    print
+
+    mask, ones = simd_unpack_mask(format)
+
+    print 'static INLINE __m128i'
+    print 'util_format_%s_load_rgba8_ssse3(const uint8_t *src)' % name
+    print '{'
+    print '   __m128i pixels = %s;' % simd_load_expr(stride)
+    if mask != range(16):
+        print '   pixels = _mm_shuffle_epi8(pixels, %s);' % simd_mask_expr(mask)
+    if ones:
+        print '   pixels = _mm_or_si128(pixels, _mm_set1_epi32(0x%08x));' % ones
+    print '   return pixels;'
+    print '}'
+    print
+
+    if stride == 4:
+        terms = []
+        for i in range(4):
+            swizzle = format.swizzles[i]
+            if swizzle < 4:
+                terms.append(simd_shift_expr('pixels', swizzle, i))
+        if ones:
+            terms.append('_mm_set1_epi32(0x%08x)' % ones)
+
+        print 'static INLINE __m128i'
+        print 'util_format_%s_load_rgba8_sse2(const uint8_t *src)' % name
+        print '{'
+        print '   const __m128i mask = _mm_set1_epi32(0xff);'
+        print '   __m128i pixels = _mm_loadu_si128((const __m128i *)src);'
+        print '   (void) mask;'
+        print '   return %s;' % simd_or_expr(terms, 22)
+        print '}'
+        print
+
+    mask = simd_pack_mask(format)
+
+    print 'static INLINE void'
+    print 'util_format_%s_store_rgba8_ssse3(uint8_t *dst, __m128i pixels)' % name
+    print '{'
+    if mask != range(16):
+        print '   pixels = _mm_shuffle_epi8(pixels, %s);' % simd_mask_expr(mask)
+    generate_simd_store(stride)
+    print '}'
+    print
+
+    if stride == 4:
+        terms = []
+        for i in range(4):
+            if format.channels[i].type != VOID and inv_swizzle[i] is not None:
+                terms.append(simd_shift_expr('pixels', inv_swizzle[i], i))
+
+        print 'static INLINE void'
+        print 'util_format_%s_store_rgba8_sse2(uint8_t *dst, __m128i pixels)' % name
+        print '{'
+        print '   const __m128i mask = _mm_set1_epi32(0xff);'
+        print '   (void) mask;'
+        print '   pixels = %s;' % simd_or_expr(terms, 24)
+        generate_simd_store(stride)
+        print '}'
+        print
+
+    isas = ['ssse3']
+    if stride == 4:
+        isas.append('sse2')
+
+    for suffix, native_type in (
+        ('unpack_rgba_8unorm', 'uint8_t'),
+        ('unpack_rgba_float', 'float'),
+        ('pack_rgba_8unorm', 'uint8_t'),
+        ('pack_rgba_float', 'float'),
+    ):
+        unpack = suffix.startswith('unpack')
+        if unpack:
+            args = '%s *dst, const uint8_t *src' % native_type
+        else:
+            args = 'uint8_t *dst, const %s *src' % native_type
+
+        print 'static INLINE unsigned'
+        print 'util_format_%s_%s_simd(%s, unsigned width)' % (name, suffix, args)
+        print '{'
+        print '   unsigned x = 0;'
+        for isa in isas:
+            if isa == isas[0]:
+                print '   if (util_cpu_caps.has_%s) {' % isa
+            else:
+                print '   else if (util_cpu_caps.has_%s) {' % isa
+            print '      for (; x + 4 <= width; x += 4) {'
+            if suffix == 'unpack_rgba_8unorm':
+                print '         _mm_storeu_si128((__m128i *)dst, util_format_%s_load_rgba8_%s(src));' % (name, isa)
+            elif suffix == 'unpack_rgba_float':
+                print '         util_format_unorm8_to_float_sse2(dst, util_format_%s_load_rgba8_%s(src));' % (name, isa)
+            elif suffix == 'pack_rgba_8unorm':
+                print '         util_format_%s_store_rgba8_%s(dst, _mm_loadu_si128((const __m128i *)src));' % (name, isa)
+            else:
+                print '         util_format_%s_store_rgba8_%s(dst, util_format_float_to_unorm8_sse2(src));' % (name, isa)
+            if unpack:
+                print '         src += %u;' % (4*stride)
+                print '         dst += 16;'
+            else:
+                print '         src += 16;'
+                print '         dst += %u;' % (4*stride)
+            print '      }'
+            print '   }'
+        print '   return x;'
+        print '}'
+        print
+
+    print '#endif /* PIPE_ARCH_SSE */'
+    print
+
+
+def generate_simd_prologue(format, suffix, src_stride, dst_stride):
+    '''Let the SSE kernels do as many pixels of the row as they can.'''
+
+    print '      x = 0;'
+    print '#ifdef PIPE_ARCH_SSE'
+    print '      x = util_format_%s_%s_simd(dst, src, width);' % (format.short_name(), suffix)
+    print '      src += x * %u;' % src_stride
+    print '      dst += x * %u;' % dst_stride
+    print '#endif'
+
+
 def generate_format_unpack(format, dst_channel, dst_native_type, dst_suffix):
     '''Generate the function to unpack pixels from a particular format'''
 
@@ -597,7 +885,11 @@ def generate_format_unpack(format, dst_channel, dst_native_type, dst_suffix):
         print '   for(y = 0; y < height; y += %u) {' % (format.block_height,)
         print '      %s *dst = dst_row;' % (dst_native_type)
         print '      const uint8_t *src = src_row;'
-        print '      for(x = 0; x < width; x += %u) {' % (format.block_width,)
+        if is_format_simd(format) and dst_suffix in ('rgba_float', 'rgba_8unorm'):
+            generate_simd_prologue(format, 'unpack_' + dst_suffix, format.block_size() / 8, 4)
+            print '      for(; x < width; x += %u) {' % (format.block_width,)
+        else:
+            print '      for(x = 0; x < width; x += %u) {' % (format.block_width,)
         
         generate_unpack_kernel(format, dst_channel, dst_native_type)
     
@@ -626,7 +918,11 @@ def generate_format_pack(format, src_channel, src_native_type, src_suffix):
         print '   for(y = 0; y < height; y += %u) {' % (format.block_height,)
         print '      const %s *src = src_row;' % (src_native_type)
         print '      uint8_t *dst = dst_row;'
-        print '      for(x = 0; x < width; x += %u) {' % (format.block_width,)
+        if is_format_simd(format) and src_suffix in ('rgba_float', 'rgba_8unorm'):
+            generate_simd_prologue(format, 'pack_' + src_suffix, 4, format.block_size() / 8)
+            print '      for(; x < width; x += %u) {' % (format.block_width,)
+        else:
+            print '      for(x = 0; x < width; x += %u) {' % (format.block_width,)
     
         generate_pack_kernel(format, src_channel, src_native_type)
             
@@ -672,6 +968,13 @@ def generate(formats):
     print '#include "u_format_yuv.h"'
     print '#include "u_format_zs.h"'
     print
+    print '#ifdef PIPE_ARCH_SSE'
+    print '#include "u_sse.h"'
+    print '#include "u_cpu_detect.h"'
+    print '#endif'
+    print
+
+    generate_simd_helpers()
 
     for format in formats:
         if not is_format_hand_written(format):
@@ -679,6 +982,9 @@ def generate(formats):
             if is_format_supported(format):
                 generate_format_type(format)
 
+            if is_format_simd(format):
+                generate_format_simd(format)
+
             if is_format_pure_unsigned(format):
                 native_type = 'unsigned'
                 suffix = 'unsigned'
@@ -50,6 +50,10 @@
 #include "util/u_texture.h"
 #include "util/u_half.h"
 #include "util/u_surface.h"
+#include "util/u_cpu_detect.h"
+#include "util/u_format_srgb.h"
+#include "util/u_mipmap_row.h"
+#include "os/os_thread.h"
 
 #include "cso_cache/cso_context.h"
 
@@ -73,6 +77,10 @@ struct gen_mipmap_state
    unsigned vbuf_slot;
 
    float vertices[4][2][4];   /**< vertex/texcoords for quad */
+
+   /* for the software fallback */
+   uint num_threads;          /**< for large levels */
+   boolean srgb_linear;       /**< filter sRGB formats in linear space */
 };
 
 
@@ -178,6 +186,39 @@ do_row(enum dtype datatype, uint comps, int srcWidth,
    assert(srcWidth == dstWidth || srcWidth == 2 * dstWidth);
    */
 
+   if (srcWidth != dstWidth) {
+      /* Do the start of the row with the vector code, if there's some */
+      uint n = 0, bpt = 0;
+
+      if (datatype == DTYPE_UBYTE) {
+         n = util_mipmap_row_unorm8(comps, srcRowA, srcRowB,
+                                    dstWidth, dstRow);
+         bpt = comps;
+      }
+      else if (datatype == DTYPE_USHORT) {
+         n = util_mipmap_row_unorm16(comps, srcRowA, srcRowB,
+                                     dstWidth, dstRow);
+         bpt = 2 * comps;
+      }
+      else if (datatype == DTYPE_FLOAT) {
+         n = util_mipmap_row_float(comps, srcRowA, srcRowB,
+                                   dstWidth, dstRow);
+         bpt = 4 * comps;
+      }
+
+      if (n == (uint) dstWidth)
+         return;
+
+      if (n) {
+         /* k0 and colStride are unchanged for the rest of the row */
+         srcRowA = (const ubyte *) srcRowA + 2 * n * bpt;
+         srcRowB = (const ubyte *) srcRowB + 2 * n * bpt;
+         dstRow = (ubyte *) dstRow + n * bpt;
+         srcWidth -= 2 * n;
+         dstWidth -= n;
+      }
+   }
+
    if (datatype == DTYPE_UBYTE && comps == 4) {
       uint i, j, k;
       const ubyte(*rowA)[4] = (const ubyte(*)[4]) srcRowA;
@@ -946,6 +987,50 @@ format_to_type_comps(enum pipe_format pformat,
       *datatype = DTYPE_UBYTE;
       *comps = 2;
       return;
+   case PIPE_FORMAT_R8G8B8A8_UNORM:
+   case PIPE_FORMAT_R8G8B8X8_UNORM:
+   case PIPE_FORMAT_A8B8G8R8_UNORM:
+   case PIPE_FORMAT_X8B8G8R8_UNORM:
+      *datatype = DTYPE_UBYTE;
+      *comps = 4;
+      return;
+   case PIPE_FORMAT_R8G8_UNORM:
+      *datatype = DTYPE_UBYTE;
+      *comps = 2;
+      return;
+   case PIPE_FORMAT_R8_UNORM:
+      *datatype = DTYPE_UBYTE;
+      *comps = 1;
+      return;
+   case PIPE_FORMAT_R16G16B16A16_UNORM:
+      *datatype = DTYPE_USHORT;
+      *comps = 4;
+      return;
+   case PIPE_FORMAT_R16G16_UNORM:
+      *datatype = DTYPE_USHORT;
+      *comps = 2;
+      return;
+   case PIPE_FORMAT_R16_UNORM:
+   case PIPE_FORMAT_L16_UNORM:
+      *datatype = DTYPE_USHORT;
+      *comps = 1;
+      return;
+   case PIPE_FORMAT_R16G16B16A16_FLOAT:
+      *datatype = DTYPE_HALF_FLOAT;
+      *comps = 4;
+      return;
+   case PIPE_FORMAT_R32G32B32A32_FLOAT:
+      *datatype = DTYPE_FLOAT;
+      *comps = 4;
+      return;
+   case PIPE_FORMAT_R32G32_FLOAT:
+      *datatype = DTYPE_FLOAT;
+      *comps = 2;
+      return;
+   case PIPE_FORMAT_R32_FLOAT:
+      *datatype = DTYPE_FLOAT;
+      *comps = 1;
+      return;
    default:
       assert(0);
       *datatype = DTYPE_UBYTE;
@@ -955,20 +1040,147 @@ format_to_type_comps(enum pipe_format pformat,
 }
 
 
+/**
+ * A band of destination rows of a 2D image, each computed from two source
+ * rows.
+ */
+struct reduce_rows
+{
+   enum dtype datatype;
+   uint comps;
+   boolean srgb;        /**< filter in linear space */
+   uint srgb_alpha;     /**< alpha component of sRGB formats, or comps */
+   int srcWidth;
+   const ubyte *srcA, *srcB;
+   int srcStride;       /**< between two dest rows, in bytes */
+   int dstWidth;
+   ubyte *dst;
+   int dstStride;
+   int numRows;
+};
+
+
+static void
+init_reduce_rows(struct gen_mipmap_state *ctx,
+                 enum pipe_format pformat,
+                 struct reduce_rows *rows)
+{
+   const struct util_format_description *desc =
+      util_format_description(pformat);
+
+   memset(rows, 0, sizeof *rows);
+
+   format_to_type_comps(pformat, &rows->datatype, &rows->comps);
+
+   if (ctx->srgb_linear &&
+       util_format_is_srgb(pformat) &&
+       rows->datatype == DTYPE_UBYTE) {
+      rows->srgb = TRUE;
+      rows->srgb_alpha = desc->swizzle[3] <= UTIL_FORMAT_SWIZZLE_W ?
+         desc->swizzle[3] : rows->comps;
+   }
+}
+
+
+static void
+do_rows(const struct reduce_rows *rows)
+{
+   const ubyte *srcA = rows->srcA, *srcB = rows->srcB;
+   ubyte *dst = rows->dst;
+   int row;
+
+   for (row = 0; row < rows->numRows; row++) {
+      if (rows->srgb) {
+         util_mipmap_row_srgb8(rows->comps, rows->srgb_alpha,
+                               util_format_srgb_8unorm_to_linear_float_table,
+                               srcA, srcB,
+                               rows->srcWidth, rows->dstWidth, dst);
+      }
+      else {
+         do_row(rows->datatype, rows->comps,
+                rows->srcWidth, srcA, srcB,
+                rows->dstWidth, dst);
+      }
+      srcA += rows->srcStride;
+      srcB += rows->srcStride;
+      dst += rows->dstStride;
+   }
+}
+
+
+static PIPE_THREAD_ROUTINE(do_rows_thread, data)
+{
+   do_rows((const struct reduce_rows *) data);
+   return NULL;
+}
+
+
+/**
+ * Reduce rows, splitting large images in bands done by several threads.
+ */
 static void
-reduce_1d(enum pipe_format pformat,
+do_rows_threaded(struct gen_mipmap_state *ctx,
+                 const struct reduce_rows *rows)
+{
+   uint num_threads = 1;
+
+   if (rows->dstStride * rows->numRows >= UTIL_MIPMAP_THREAD_MIN_BYTES)
+      num_threads = MIN2(ctx->num_threads, (uint) rows->numRows);
+
+   if (num_threads > 1) {
+      struct reduce_rows bands[UTIL_MIPMAP_MAX_THREADS];
+      pipe_thread threads[UTIL_MIPMAP_MAX_THREADS];
+      uint t;
+      int first = 0;
+
+      for (t = 0; t < num_threads; t++) {
+         const int last = rows->numRows * (t + 1) / num_threads;
+         bands[t] = *rows;
+         bands[t].srcA += first * rows->srcStride;
+         bands[t].srcB += first * rows->srcStride;
+         bands[t].dst += first * rows->dstStride;
+         bands[t].numRows = last - first;
+         first = last;
+      }
+
+      /* the first band is done by this thread */
+      for (t = 1; t < num_threads; t++) {
+         threads[t] = pipe_thread_create(do_rows_thread, &bands[t]);
+         if (!threads[t])
+            do_rows(&bands[t]);
+      }
+
+      do_rows(&bands[0]);
+
+      for (t = 1; t < num_threads; t++) {
+         if (threads[t])
+            pipe_thread_wait(threads[t]);
+      }
+   }
+   else {
+      do_rows(rows);
+   }
+}
+
+
+static void
+reduce_1d(struct gen_mipmap_state *ctx,
+          enum pipe_format pformat,
           int srcWidth, const ubyte *srcPtr,
           int dstWidth, ubyte *dstPtr)
 {
-   enum dtype datatype;
-   uint comps;
+   struct reduce_rows rows;
 
-   format_to_type_comps(pformat, &datatype, &comps);
+   init_reduce_rows(ctx, pformat, &rows);
 
    /* we just duplicate the input row, kind of hack, saves code */
-   do_row(datatype, comps,
-          srcWidth, srcPtr, srcPtr,
-          dstWidth, dstPtr);
+   rows.srcWidth = srcWidth;
+   rows.srcA = srcPtr;
+   rows.srcB = srcPtr;
+   rows.dstWidth = dstWidth;
+   rows.dst = dstPtr;
+   rows.numRows = 1;
+   do_rows(&rows);
 }
 
 
@@ -976,20 +1188,17 @@ reduce_1d(enum pipe_format pformat,
  * Strides are in bytes.  If zero, it'll be computed as width * bpp.
  */
 static void
-reduce_2d(enum pipe_format pformat,
+reduce_2d(struct gen_mipmap_state *ctx,
+          enum pipe_format pformat,
           int srcWidth, int srcHeight,
           int srcRowStride, const ubyte *srcPtr,
           int dstWidth, int dstHeight,
           int dstRowStride, ubyte *dstPtr)
 {
-   enum dtype datatype;
-   uint comps;
    const int bpt = util_format_get_blocksize(pformat);
-   const ubyte *srcA, *srcB;
-   ubyte *dst;
-   int row;
+   struct reduce_rows rows;
 
-   format_to_type_comps(pformat, &datatype, &comps);
+   init_reduce_rows(ctx, pformat, &rows);
 
    if (!srcRowStride)
       srcRowStride = bpt * srcWidth;
@@ -998,21 +1207,19 @@ reduce_2d(enum pipe_format pformat,
       dstRowStride = bpt * dstWidth;
 
    /* Compute src and dst pointers */
-   srcA = srcPtr;
+   rows.srcWidth = srcWidth;
+   rows.srcA = srcPtr;
    if (srcHeight > 1) 
-      srcB = srcA + srcRowStride;
+      rows.srcB = srcPtr + srcRowStride;
    else
-      srcB = srcA;
-   dst = dstPtr;
-
-   for (row = 0; row < dstHeight; row++) {
-      do_row(datatype, comps,
-             srcWidth, srcA, srcB,
-             dstWidth, dst);
-      srcA += 2 * srcRowStride;
-      srcB += 2 * srcRowStride;
-      dst += dstRowStride;
-   }
+      rows.srcB = srcPtr;
+   rows.srcStride = 2 * srcRowStride;
+   rows.dstWidth = dstWidth;
+   rows.dst = dstPtr;
+   rows.dstStride = dstRowStride;
+   rows.numRows = dstHeight;
+
+   do_rows_threaded(ctx, &rows);
 }
 
 
@@ -1121,7 +1328,7 @@ make_1d_mipmap(struct gen_mipmap_state *ctx,
       srcMap = (ubyte *) pipe->transfer_map(pipe, srcTrans);
       dstMap = (ubyte *) pipe->transfer_map(pipe, dstTrans);
 
-      reduce_1d(pt->format,
+      reduce_1d(ctx, pt->format,
                 srcTrans->box.width, srcMap,
                 dstTrans->box.width, dstMap);
 
@@ -1162,7 +1369,7 @@ make_2d_mipmap(struct gen_mipmap_state *ctx,
       srcMap = (ubyte *) pipe->transfer_map(pipe, srcTrans);
       dstMap = (ubyte *) pipe->transfer_map(pipe, dstTrans);
 
-      reduce_2d(pt->format,
+      reduce_2d(ctx, pt->format,
                 srcTrans->box.width, srcTrans->box.height,
                 srcTrans->stride, srcMap,
                 dstTrans->box.width, dstTrans->box.height,
@@ -1310,6 +1517,12 @@ util_create_gen_mipmap(struct pipe_context *pipe,
 
    /* Note: the actual vertex buffer is allocated as needed below */
 
+   util_cpu_detect();
+   ctx->num_threads = debug_get_num_option("GALLIUM_MIPMAP_THREADS",
+                                           util_cpu_caps.nr_cpus);
+   ctx->num_threads = CLAMP(ctx->num_threads, 1, UTIL_MIPMAP_MAX_THREADS);
+   ctx->srgb_linear = debug_get_bool_option("GALLIUM_MIPMAP_SRGB", FALSE);
+
    return ctx;
 }
 
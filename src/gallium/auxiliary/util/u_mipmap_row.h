@@ -0,0 +1,317 @@
+/**************************************************************************
+ *
+ * Copyright 2012 The Mesa authors.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * @file
+ * Box filter kernels for software mipmap generation.
+ *
+ * Shared by the core Mesa (main/mipmap.c) and the gallium
+ * (util/u_gen_mipmap.c) fallbacks, so this header must only depend on the
+ * includer having defined INLINE and the <stdint.h> types.
+ *
+ * The util_mipmap_row_*() functions average two source rows of 2 * n or
+ * 2 * n + 1 pixels down to one destination row of n pixels, with the same
+ * results as the scalar code of the mipmap generators:  integer averages
+ * are truncated and float sums are done in the same order.  They return
+ * the number of destination pixels done, which is zero when there is no
+ * vector code for the component count, and the caller finishes the row.
+ */
+
+#ifndef U_MIPMAP_ROW_H
+#define U_MIPMAP_ROW_H
+
+
+#include <math.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+
+/** Levels smaller than this (in destination bytes) are done on one thread */
+#define UTIL_MIPMAP_THREAD_MIN_BYTES (1 << 20)
+
+/** Maximum number of threads the mipmap generators split a level over */
+#define UTIL_MIPMAP_MAX_THREADS 8
+
+
+#if defined(__SSE2__)
+
+/**
+ * Sum adjacent pixels of 16 consecutive 16-bit components, given in two
+ * registers, for 1, 2 or 4 components per pixel.
+ */
+static INLINE __m128i
+util_mipmap_hadd_epi16(__m128i x, __m128i y, unsigned comps)
+{
+   if (comps == 4) {
+      return _mm_add_epi16(_mm_unpacklo_epi64(x, y),
+                           _mm_unpackhi_epi64(x, y));
+   }
+   else if (comps == 2) {
+      x = _mm_shuffle_epi32(x, _MM_SHUFFLE(3, 1, 2, 0));
+      y = _mm_shuffle_epi32(y, _MM_SHUFFLE(3, 1, 2, 0));
+      return _mm_add_epi16(_mm_unpacklo_epi64(x, y),
+                           _mm_unpackhi_epi64(x, y));
+   }
+   else {
+      const __m128i mask = _mm_set1_epi32(0xffff);
+      x = _mm_add_epi32(_mm_and_si128(x, mask), _mm_srli_epi32(x, 16));
+      y = _mm_add_epi32(_mm_and_si128(y, mask), _mm_srli_epi32(y, 16));
+      return _mm_packs_epi32(x, y);
+   }
+}
+
+
+/**
+ * Sum adjacent pixels of 8 consecutive 32-bit components, given in two
+ * registers, for 1, 2 or 4 components per pixel.
+ */
+static INLINE __m128i
+util_mipmap_hadd_epi32(__m128i x, __m128i y, unsigned comps)
+{
+   if (comps == 4) {
+      return _mm_add_epi32(x, y);
+   }
+   else if (comps == 2) {
+      return _mm_add_epi32(_mm_unpacklo_epi64(x, y),
+                           _mm_unpackhi_epi64(x, y));
+   }
+   else {
+      x = _mm_shuffle_epi32(x, _MM_SHUFFLE(3, 1, 2, 0));
+      y = _mm_shuffle_epi32(y, _MM_SHUFFLE(3, 1, 2, 0));
+      return _mm_add_epi32(_mm_unpacklo_epi64(x, y),
+                           _mm_unpackhi_epi64(x, y));
+   }
+}
+
+#endif /* __SSE2__ */
+
+
+/**
+ * 8-bit unsigned normalized components.
+ */
+static INLINE unsigned
+util_mipmap_row_unorm8(unsigned comps,
+                       const uint8_t *rowA, const uint8_t *rowB,
+                       unsigned dstWidth, uint8_t *dst)
+{
+#if defined(__SSE2__)
+   const unsigned n = dstWidth * comps;
+   const __m128i zero = _mm_setzero_si128();
+   unsigned i;
+
+   if (comps != 1 && comps != 2 && comps != 4)
+      return 0;
+
+   /* 16 destination bytes per iteration */
+   for (i = 0; i + 16 <= n; i += 16) {
+      const __m128i a0 = _mm_loadu_si128((const __m128i *) (rowA + 2 * i));
+      const __m128i a1 = _mm_loadu_si128((const __m128i *) (rowA + 2 * i + 16));
+      const __m128i b0 = _mm_loadu_si128((const __m128i *) (rowB + 2 * i));
+      const __m128i b1 = _mm_loadu_si128((const __m128i *) (rowB + 2 * i + 16));
+      __m128i v0 = _mm_add_epi16(_mm_unpacklo_epi8(a0, zero),
+                                 _mm_unpacklo_epi8(b0, zero));
+      __m128i v1 = _mm_add_epi16(_mm_unpackhi_epi8(a0, zero),
+                                 _mm_unpackhi_epi8(b0, zero));
+      __m128i v2 = _mm_add_epi16(_mm_unpacklo_epi8(a1, zero),
+                                 _mm_unpacklo_epi8(b1, zero));
+      __m128i v3 = _mm_add_epi16(_mm_unpackhi_epi8(a1, zero),
+                                 _mm_unpackhi_epi8(b1, zero));
+      __m128i lo = _mm_srli_epi16(util_mipmap_hadd_epi16(v0, v1, comps), 2);
+      __m128i hi = _mm_srli_epi16(util_mipmap_hadd_epi16(v2, v3, comps), 2);
+      _mm_storeu_si128((__m128i *) (dst + i), _mm_packus_epi16(lo, hi));
+   }
+
+   return i / comps;
+#else
+   (void) comps; (void) rowA; (void) rowB; (void) dstWidth; (void) dst;
+   return 0;
+#endif
+}
+
+
+/**
+ * 16-bit unsigned normalized components.
+ */
+static INLINE unsigned
+util_mipmap_row_unorm16(unsigned comps,
+                        const uint16_t *rowA, const uint16_t *rowB,
+                        unsigned dstWidth, uint16_t *dst)
+{
+#if defined(__SSE2__)
+   const unsigned n = dstWidth * comps;
+   const __m128i zero = _mm_setzero_si128();
+   const __m128i bias32 = _mm_set1_epi32(0x8000);
+   const __m128i bias16 = _mm_set1_epi16((short) 0x8000);
+   unsigned i;
+
+   if (comps != 1 && comps != 2 && comps != 4)
+      return 0;
+
+   /* 8 destination components per iteration */
+   for (i = 0; i + 8 <= n; i += 8) {
+      const __m128i a0 = _mm_loadu_si128((const __m128i *) (rowA + 2 * i));
+      const __m128i a1 = _mm_loadu_si128((const __m128i *) (rowA + 2 * i + 8));
+      const __m128i b0 = _mm_loadu_si128((const __m128i *) (rowB + 2 * i));
+      const __m128i b1 = _mm_loadu_si128((const __m128i *) (rowB + 2 * i + 8));
+      __m128i v0 = _mm_add_epi32(_mm_unpacklo_epi16(a0, zero),
+                                 _mm_unpacklo_epi16(b0, zero));
+      __m128i v1 = _mm_add_epi32(_mm_unpackhi_epi16(a0, zero),
+                                 _mm_unpackhi_epi16(b0, zero));
+      __m128i v2 = _mm_add_epi32(_mm_unpacklo_epi16(a1, zero),
+                                 _mm_unpacklo_epi16(b1, zero));
+      __m128i v3 = _mm_add_epi32(_mm_unpackhi_epi16(a1, zero),
+                                 _mm_unpackhi_epi16(b1, zero));
+      __m128i lo = _mm_srli_epi32(util_mipmap_hadd_epi32(v0, v1, comps), 2);
+      __m128i hi = _mm_srli_epi32(util_mipmap_hadd_epi32(v2, v3, comps), 2);
+      /* there is no unsigned 32 -> 16 bit pack before SSE4.1 */
+      lo = _mm_sub_epi32(lo, bias32);
+      hi = _mm_sub_epi32(hi, bias32);
+      _mm_storeu_si128((__m128i *) (dst + i),
+                       _mm_add_epi16(_mm_packs_epi32(lo, hi), bias16));
+   }
+
+   return i / comps;
+#else
+   (void) comps; (void) rowA; (void) rowB; (void) dstWidth; (void) dst;
+   return 0;
+#endif
+}
+
+
+/**
+ * 32-bit float components.
+ */
+static INLINE unsigned
+util_mipmap_row_float(unsigned comps,
+                      const float *rowA, const float *rowB,
+                      unsigned dstWidth, float *dst)
+{
+#if defined(__SSE2__)
+   const unsigned n = dstWidth * comps;
+   const __m128 quarter = _mm_set1_ps(0.25F);
+   unsigned i;
+
+   if (comps != 1 && comps != 2 && comps != 4)
+      return 0;
+
+   /* 4 destination components per iteration */
+   for (i = 0; i + 4 <= n; i += 4) {
+      __m128 aj, ak, bj, bk, sum;
+
+      if (comps == 4) {
+         aj = _mm_loadu_ps(rowA + 2 * i);
+         ak = _mm_loadu_ps(rowA + 2 * i + 4);
+         bj = _mm_loadu_ps(rowB + 2 * i);
+         bk = _mm_loadu_ps(rowB + 2 * i + 4);
+      }
+      else {
+         const __m128 a0 = _mm_loadu_ps(rowA + 2 * i);
+         const __m128 a1 = _mm_loadu_ps(rowA + 2 * i + 4);
+         const __m128 b0 = _mm_loadu_ps(rowB + 2 * i);
+         const __m128 b1 = _mm_loadu_ps(rowB + 2 * i + 4);
+         if (comps == 2) {
+            aj = _mm_shuffle_ps(a0, a1, _MM_SHUFFLE(1, 0, 1, 0));
+            ak = _mm_shuffle_ps(a0, a1, _MM_SHUFFLE(3, 2, 3, 2));
+            bj = _mm_shuffle_ps(b0, b1, _MM_SHUFFLE(1, 0, 1, 0));
+            bk = _mm_shuffle_ps(b0, b1, _MM_SHUFFLE(3, 2, 3, 2));
+         }
+         else {
+            aj = _mm_shuffle_ps(a0, a1, _MM_SHUFFLE(2, 0, 2, 0));
+            ak = _mm_shuffle_ps(a0, a1, _MM_SHUFFLE(3, 1, 3, 1));
+            bj = _mm_shuffle_ps(b0, b1, _MM_SHUFFLE(2, 0, 2, 0));
+            bk = _mm_shuffle_ps(b0, b1, _MM_SHUFFLE(3, 1, 3, 1));
+         }
+      }
+
+      sum = _mm_add_ps(_mm_add_ps(_mm_add_ps(aj, ak), bj), bk);
+      _mm_storeu_ps(dst + i, _mm_mul_ps(sum, quarter));
+   }
+
+   return i / comps;
+#else
+   (void) comps; (void) rowA; (void) rowB; (void) dstWidth; (void) dst;
+   return 0;
+#endif
+}
+
+
+/**
+ * Convert a linear value in [0, 1] to 8-bit sRGB.
+ */
+static INLINE uint8_t
+util_mipmap_linear_to_srgb8(float x)
+{
+   if (x >= 1.0F)
+      return 255;
+   else if (x >= 0.0031308F)
+      return (uint8_t) ((1.055F * powf(x, 0.41666F) - 0.055F) * 255.0F + 0.5F);
+   else if (x > 0.0F)
+      return (uint8_t) (12.92F * x * 255.0F + 0.5F);
+   else
+      return 0;
+}
+
+
+/**
+ * sRGB-correct reduction of 8-bit sRGB components: the color components
+ * are averaged in linear space, the alpha component (if alpha < comps) is
+ * averaged as is.  Unlike the functions above this handles the whole row,
+ * including 1 pixel wide rows.
+ *
+ * \param to_linear  256 entry sRGB to linear float table
+ */
+static INLINE void
+util_mipmap_row_srgb8(unsigned comps, unsigned alpha,
+                      const float *to_linear,
+                      const uint8_t *rowA, const uint8_t *rowB,
+                      unsigned srcWidth, unsigned dstWidth, uint8_t *dst)
+{
+   const unsigned k0 = (srcWidth == dstWidth) ? 0 : comps;
+   const unsigned colStride = (srcWidth == dstWidth) ? comps : 2 * comps;
+   unsigned i, j, c;
+
+   for (i = 0, j = 0; i < dstWidth; i++, j += colStride) {
+      const unsigned k = j + k0;
+      for (c = 0; c < comps; c++) {
+         if (c == alpha) {
+            dst[c] = (rowA[j + c] + rowA[k + c] +
+                      rowB[j + c] + rowB[k + c]) >> 2;
+         }
+         else {
+            dst[c] = util_mipmap_linear_to_srgb8(
+               (to_linear[rowA[j + c]] + to_linear[rowA[k + c]] +
+                to_linear[rowB[j + c]] + to_linear[rowB[k + c]]) * 0.25F);
+         }
+      }
+      dst += comps;
+   }
+}
+
+
+#endif /* U_MIPMAP_ROW_H */
@@ -30,14 +30,26 @@
  */
 
 #include "pipe/p_defines.h"
+#include "util/u_debug.h"
 #include "util/u_inlines.h"
 #include "pipe/p_context.h"
+#include "pipe/p_screen.h"
 #include "util/u_memory.h"
 #include "util/u_math.h"
+#include "util/u_atomic.h"
 
 #include "u_upload_mgr.h"
 
 
+/* Maximum number of released upload buffers waiting to be recycled. */
+#define U_UPLOAD_RING_SIZE 8
+
+struct u_upload_ring_entry {
+   struct pipe_resource *buffer;
+   struct pipe_fence_handle *fence; /* NULL until the next u_upload_fence */
+   boolean idle; /* fence is of a flush after the driver's last reference */
+};
+
 struct u_upload_mgr {
    struct pipe_context *pipe;
 
@@ -51,6 +63,15 @@ struct u_upload_mgr {
    unsigned size;   /* Actual size of the upload buffer. */
    unsigned offset; /* Aligned offset to the upload buffer, pointing
                      * at the first unused byte. */
+
+   /* Released upload buffers, the oldest first. Only used once the driver
+    * reports fences with u_upload_fence. */
+   struct u_upload_ring_entry ring[U_UPLOAD_RING_SIZE];
+   unsigned ring_count;
+   boolean use_fences;
+
+   struct u_upload_stats stats;
+   boolean dump_stats;
 };
 
 
@@ -68,6 +89,7 @@ struct u_upload_mgr *u_upload_create( struct pipe_context *pipe,
    upload->alignment = alignment;
    upload->bind = bind;
    upload->buffer = NULL;
+   upload->dump_stats = debug_get_bool_option("GALLIUM_UPLOAD_STATS", FALSE);
 
    return upload;
 }
@@ -88,27 +110,159 @@ void u_upload_unmap( struct u_upload_mgr *upload )
    }
 }
 
+/* Take an entry out of the ring, returning its buffer reference.
+ */
+static struct pipe_resource *
+u_upload_ring_take( struct u_upload_mgr *upload, unsigned i )
+{
+   struct pipe_screen *screen = upload->pipe->screen;
+   struct pipe_resource *buffer = upload->ring[i].buffer;
+
+   screen->fence_reference(screen, &upload->ring[i].fence, NULL);
+
+   upload->ring_count--;
+   memmove(&upload->ring[i], &upload->ring[i + 1],
+           (upload->ring_count - i) * sizeof(upload->ring[0]));
+
+   return buffer;
+}
+
+
+static void
+u_upload_ring_remove( struct u_upload_mgr *upload, unsigned i )
+{
+   struct pipe_resource *buffer = u_upload_ring_take(upload, i);
+
+   pipe_resource_reference(&buffer, NULL);
+}
+
+
 /* Release old buffer.
  * 
  * This must usually be called prior to firing the command stream
  * which references the upload buffer, as many memory managers will
  * cause subsequent maps of a fired buffer to wait.
  *
- * Can improve this with a change to pipe_buffer_write to use the
- * DONT_WAIT bit, but for now, it's easiest just to grab a new buffer.
+ * If the driver reports fences, the buffer is put in the ring, to be
+ * reused once the command stream referencing it has been executed.
  */
 void u_upload_flush( struct u_upload_mgr *upload )
 {
    /* Unmap and unreference the upload buffer. */
    u_upload_unmap(upload);
+
+   if (upload->buffer && upload->use_fences) {
+      struct u_upload_ring_entry *entry;
+
+      /* Make room by dropping the oldest buffer. */
+      if (upload->ring_count == U_UPLOAD_RING_SIZE)
+         u_upload_ring_remove(upload, 0);
+
+      entry = &upload->ring[upload->ring_count++];
+
+      /* Move the reference. */
+      entry->buffer = upload->buffer;
+      entry->fence = NULL;
+      entry->idle = FALSE;
+      upload->buffer = NULL;
+   }
+
    pipe_resource_reference( &upload->buffer, NULL );
    upload->size = 0;
 }
 
 
+void u_upload_fence( struct u_upload_mgr *upload,
+                     struct pipe_fence_handle *fence )
+{
+   struct pipe_screen *screen = upload->pipe->screen;
+   unsigned i;
+
+   if (!fence)
+      return;
+
+   upload->use_fences = TRUE;
+
+   /* A buffer the driver still references may be used by commands
+    * submitted after this flush (e.g. draws re-emitted after an internal
+    * flush), so it only gets its final fence from the first flush after
+    * the driver released it.
+    */
+   for (i = 0; i < upload->ring_count; i++) {
+      struct u_upload_ring_entry *entry = &upload->ring[i];
+
+      if (!entry->idle) {
+         screen->fence_reference(screen, &entry->fence, fence);
+         entry->idle = p_atomic_read(&entry->buffer->reference.count) == 1;
+      }
+   }
+}
+
+
+void u_upload_get_stats( struct u_upload_mgr *upload,
+                         struct u_upload_stats *stats )
+{
+   *stats = upload->stats;
+}
+
+
+/* Take the oldest buffer the GPU is done with out of the ring, if any.
+ * Never wait for a fence: allocating a new buffer is cheaper than a stall.
+ */
+static struct pipe_resource *
+u_upload_recycle_buffer( struct u_upload_mgr *upload,
+                         unsigned min_size )
+{
+   struct pipe_screen *screen = upload->pipe->screen;
+   struct pipe_resource *buffer;
+   unsigned i;
+
+   for (i = 0; i < upload->ring_count; i++) {
+      struct u_upload_ring_entry *entry = &upload->ring[i];
+
+      if (entry->idle &&
+          p_atomic_read(&entry->buffer->reference.count) == 1 &&
+          screen->fence_signalled(screen, entry->fence))
+         break;
+   }
+
+   if (i == upload->ring_count)
+      return NULL;
+
+   buffer = u_upload_ring_take(upload, i);
+
+   if (buffer->width0 < min_size) {
+      pipe_resource_reference(&buffer, NULL);
+      return NULL;
+   }
+
+   upload->stats.buffers_recycled++;
+   return buffer;
+}
+
+
 void u_upload_destroy( struct u_upload_mgr *upload )
 {
+   struct pipe_screen *screen = upload->pipe->screen;
+   unsigned i;
+
+   if (upload->dump_stats) {
+      debug_printf("u_upload_mgr %p: %llu bytes uploaded, "
+                   "%u buffers created, %u recycled\n",
+                   (void *) upload,
+                   (unsigned long long) upload->stats.bytes_uploaded,
+                   upload->stats.buffers_created,
+                   upload->stats.buffers_recycled);
+   }
+
+   upload->use_fences = FALSE;
    u_upload_flush( upload );
+
+   for (i = 0; i < upload->ring_count; i++) {
+      pipe_resource_reference(&upload->ring[i].buffer, NULL);
+      screen->fence_reference(screen, &upload->ring[i].fence, NULL);
+   }
+
    FREE( upload );
 }
 
@@ -118,28 +272,36 @@ u_upload_alloc_buffer( struct u_upload_mgr *upload,
                        unsigned min_size )
 {
    unsigned size;
+   unsigned usage = PIPE_TRANSFER_WRITE | PIPE_TRANSFER_FLUSH_EXPLICIT;
 
    /* Release the old buffer, if present:
     */
    u_upload_flush( upload );
 
-   /* Allocate a new one: 
+   /* Reuse an old one, or allocate a new one:
     */
-   size = align(MAX2(upload->default_size, min_size), 4096);
-
-   upload->buffer = pipe_buffer_create( upload->pipe->screen,
-                                        upload->bind,
-                                        PIPE_USAGE_STREAM,
-                                        size );
-   if (upload->buffer == NULL) {
-      return PIPE_ERROR_OUT_OF_MEMORY;
+   upload->buffer = u_upload_recycle_buffer(upload, min_size);
+   if (upload->buffer) {
+      /* The GPU is done with it. */
+      usage |= PIPE_TRANSFER_UNSYNCHRONIZED;
+      size = upload->buffer->width0;
+   }
+   else {
+      size = align(MAX2(upload->default_size, min_size), 4096);
+
+      upload->buffer = pipe_buffer_create( upload->pipe->screen,
+                                           upload->bind,
+                                           PIPE_USAGE_STREAM,
+                                           size );
+      if (upload->buffer == NULL) {
+         return PIPE_ERROR_OUT_OF_MEMORY;
+      }
+      upload->stats.buffers_created++;
    }
 
    /* Map the new buffer. */
    upload->map = pipe_buffer_map_range(upload->pipe, upload->buffer,
-                                       0, size,
-                                       PIPE_TRANSFER_WRITE |
-                                       PIPE_TRANSFER_FLUSH_EXPLICIT,
+                                       0, size, usage,
                                        &upload->transfer);
    if (upload->map == NULL) {
       upload->size = 0;
@@ -204,6 +366,7 @@ enum pipe_error u_upload_alloc( struct u_upload_mgr *upload,
    *out_offset = offset;
 
    upload->offset = offset + alloc_size;
+   upload->stats.bytes_uploaded += size;
    return PIPE_OK;
 }
 
@@ -36,6 +36,17 @@
 
 struct pipe_context;
 struct pipe_resource;
+struct pipe_fence_handle;
+
+
+/**
+ * Upload statistics, see u_upload_get_stats().
+ */
+struct u_upload_stats {
+   uint64_t bytes_uploaded;    /**< Sum of the sizes of the sub-allocations. */
+   unsigned buffers_created;   /**< Upload buffers created. */
+   unsigned buffers_recycled;  /**< Upload buffers reused after their fence. */
+};
 
 
 /**
@@ -66,6 +77,24 @@ void u_upload_destroy( struct u_upload_mgr *upload );
 
 void u_upload_flush( struct u_upload_mgr *upload );
 
+/**
+ * Tell the upload manager about a hardware flush.
+ *
+ * The upload buffers released by u_upload_flush() are kept in a ring and
+ * recycled once the driver holds no other reference to them and the fence
+ * of the first flush after it dropped those has signalled, instead of
+ * being released to the driver.  Drivers which never call this get the
+ * old behaviour of a new buffer after every flush.
+ */
+void u_upload_fence( struct u_upload_mgr *upload,
+                     struct pipe_fence_handle *fence );
+
+/**
+ * Return the statistics of the upload manager.
+ */
+void u_upload_get_stats( struct u_upload_mgr *upload,
+                         struct u_upload_stats *stats );
+
 /**
  * Unmap upload buffer
  *
@@ -27,7 +27,10 @@
 
 #include "util/u_vbuf.h"
 
+#include "util/u_double_list.h"
 #include "util/u_format.h"
+#include "util/u_hash.h"
+#include "util/u_hash_table.h"
 #include "util/u_inlines.h"
 #include "util/u_memory.h"
 #include "util/u_upload_mgr.h"
@@ -54,11 +57,68 @@ struct u_vbuf_elements {
    boolean incompatible_layout_elem[PIPE_MAX_ATTRIBS];
 };
 
+/* The translated vertices of real buffers are kept around, and reused until
+ * the source buffers are written or destroyed, or until they are evicted
+ * because of the size limit, least recently used first. */
+#define U_VBUF_TRANSLATION_CACHE_SIZE (16 * 1024 * 1024)
+
+/* Size of the buffers the cached translations are suballocated from. */
+#define U_VBUF_TRANSLATION_BUFFER_SIZE (1024 * 1024)
+
+/* What a cached translation was made from. */
+struct u_vbuf_translation_key {
+   struct translate_key tr;
+   struct {
+      struct pipe_resource *buffer;
+      unsigned buffer_offset;
+      unsigned stride;
+   } vb[PIPE_MAX_ATTRIBS];
+   int min_index;
+   int max_index;
+};
+
+struct u_vbuf_translation;
+
+/* Links a cached translation to one of its source buffers. The key doesn't
+ * hold references to the buffers; the translation is dropped instead when
+ * one of them is destroyed. */
+struct u_vbuf_translation_src {
+   struct list_head list; /* in u_vbuf_resource::translations */
+   struct u_vbuf_translation *translation;
+};
+
+struct u_vbuf_translation {
+   struct list_head list;
+   struct u_vbuf_priv *mgr;
+   struct u_vbuf_translation_key key;
+   unsigned hash;
+   /* The generations of the source buffers at translation time. */
+   unsigned generation[PIPE_MAX_ATTRIBS];
+   struct u_vbuf_translation_src src[PIPE_MAX_ATTRIBS];
+
+   /* The vertices key.min_index..key.max_index, suballocated from
+    * u_vbuf_priv::translation_uploader. buffer_offset is what the vertex
+    * buffer must be bound with, i.e. the offset of vertex 0. */
+   struct pipe_resource *buffer;
+   unsigned buffer_offset;
+   unsigned size;
+};
+
 struct u_vbuf_priv {
    struct u_vbuf b;
    struct pipe_context *pipe;
    struct translate_cache *translate_cache;
 
+   /* Translated vertex buffers, the most recently used first, and hashed
+    * by their keys. */
+   struct list_head translations;
+   struct util_hash_table *translation_table;
+   unsigned translations_size;
+   /* Where the cached translations are allocated. Space is never reused
+    * while the GPU may read it, translations are only ever moved to new
+    * space. */
+   struct u_upload_mgr *translation_uploader;
+
    /* Vertex element state bound by the state tracker. */
    void *saved_ve;
    /* and its associated helper structure for this module. */
@@ -113,6 +173,35 @@ static void u_vbuf_init_format_caps(struct u_vbuf_priv *mgr)
                                   0, PIPE_BIND_VERTEX_BUFFER);
 }
 
+static unsigned u_vbuf_translation_hash(void *key)
+{
+   struct u_vbuf_translation_key *tkey = key;
+   unsigned hash, i;
+
+   hash = util_hash_crc32(&tkey->tr, translate_keysize(&tkey->tr));
+   hash ^= util_hash_crc32(&tkey->min_index, 2 * sizeof(int));
+
+   for (i = 0; i < PIPE_MAX_ATTRIBS; i++) {
+      if (tkey->vb[i].buffer) {
+         hash ^= util_hash_crc32(&tkey->vb[i], sizeof(tkey->vb[i])) + i;
+      }
+   }
+   return hash;
+}
+
+static int u_vbuf_translation_compare(void *key1, void *key2)
+{
+   struct u_vbuf_translation_key *a = key1, *b = key2;
+
+   if (a->min_index != b->min_index || a->max_index != b->max_index) {
+      return 1;
+   }
+   if (translate_key_compare(&a->tr, &b->tr) != 0) {
+      return 1;
+   }
+   return memcmp(a->vb, b->vb, sizeof(a->vb));
+}
+
 struct u_vbuf *
 u_vbuf_create(struct pipe_context *pipe,
               unsigned upload_buffer_size,
@@ -125,10 +214,17 @@ u_vbuf_create(struct pipe_context *pipe,
    mgr->pipe = pipe;
    mgr->translate_cache = translate_cache_create();
    mgr->fallback_vb_slot = ~0;
+   LIST_INITHEAD(&mgr->translations);
+   mgr->translation_table =
+      util_hash_table_create(u_vbuf_translation_hash,
+                             u_vbuf_translation_compare);
 
    mgr->b.uploader = u_upload_create(pipe, upload_buffer_size,
                                      upload_buffer_alignment,
                                      upload_buffer_bind);
+   mgr->translation_uploader =
+      u_upload_create(pipe, U_VBUF_TRANSLATION_BUFFER_SIZE,
+                      upload_buffer_alignment, PIPE_BIND_VERTEX_BUFFER);
 
    mgr->b.caps.fetch_dword_unaligned =
          fetch_alignment == U_VERTEX_FETCH_BYTE_ALIGNED;
@@ -138,11 +234,47 @@ u_vbuf_create(struct pipe_context *pipe,
    return &mgr->b;
 }
 
+static void u_vbuf_translation_destroy(struct u_vbuf_priv *mgr,
+                                       struct u_vbuf_translation *t)
+{
+   unsigned i;
+
+   for (i = 0; i < PIPE_MAX_ATTRIBS; i++) {
+      if (t->key.vb[i].buffer) {
+         LIST_DEL(&t->src[i].list);
+      }
+   }
+   pipe_resource_reference(&t->buffer, NULL);
+
+   util_hash_table_remove(mgr->translation_table, &t->key);
+   mgr->translations_size -= t->size;
+   LIST_DEL(&t->list);
+   FREE(t);
+}
+
+void u_vbuf_resource_destroyed(struct pipe_resource *r)
+{
+   struct list_head *translations = &u_vbuf_resource(r)->translations;
+
+   while (!LIST_IS_EMPTY(translations)) {
+      struct u_vbuf_translation_src *src =
+         LIST_ENTRY(struct u_vbuf_translation_src, translations->next, list);
+      struct u_vbuf_translation *t = src->translation;
+
+      u_vbuf_translation_destroy(t->mgr, t);
+   }
+}
+
 void u_vbuf_destroy(struct u_vbuf *mgrb)
 {
    struct u_vbuf_priv *mgr = (struct u_vbuf_priv*)mgrb;
+   struct u_vbuf_translation *t, *next;
    unsigned i;
 
+   LIST_FOR_EACH_ENTRY_SAFE(t, next, &mgr->translations, list) {
+      u_vbuf_translation_destroy(mgr, t);
+   }
+
    for (i = 0; i < mgr->b.nr_vertex_buffers; i++) {
       pipe_resource_reference(&mgr->b.vertex_buffer[i].buffer, NULL);
    }
@@ -151,6 +283,8 @@ void u_vbuf_destroy(struct u_vbuf *mgrb)
    }
 
    translate_cache_destroy(mgr->translate_cache);
+   util_hash_table_destroy(mgr->translation_table);
+   u_upload_destroy(mgr->translation_uploader);
    u_upload_destroy(mgr->b.uploader);
    FREE(mgr);
 }
@@ -182,6 +316,219 @@ static unsigned u_vbuf_get_free_real_vb_slot(struct u_vbuf_priv *mgr)
    return ~0;
 }
 
+/* Translate the vertices min_index..min_index+num_verts-1 of the buffers
+ * in vb_translated to out_map. */
+static void
+u_vbuf_translate_buffers(struct u_vbuf_priv *mgr,
+                         struct translate_key *key,
+                         const boolean *vb_translated,
+                         int min_index, unsigned num_verts,
+                         uint8_t *out_map)
+{
+   struct translate *tr;
+   struct pipe_transfer *vb_transfer[PIPE_MAX_ATTRIBS] = {0};
+   unsigned i;
+
+   /* Get a translate object. */
+   tr = translate_cache_find(mgr->translate_cache, key);
+
+   /* Map buffers we want to translate. */
+   for (i = 0; i < mgr->b.nr_vertex_buffers; i++) {
+      if (vb_translated[i]) {
+         struct pipe_vertex_buffer *vb = &mgr->b.vertex_buffer[i];
+
+         uint8_t *map = pipe_buffer_map(mgr->pipe, vb->buffer,
+                                        PIPE_TRANSFER_READ, &vb_transfer[i]);
+
+         tr->set_buffer(tr, i,
+                        map + vb->buffer_offset + vb->stride * min_index,
+                        vb->stride, ~0);
+      }
+   }
+
+   /* Translate. */
+   tr->run(tr, 0, num_verts, 0, out_map);
+
+   /* Unmap all buffers. */
+   for (i = 0; i < mgr->b.nr_vertex_buffers; i++) {
+      if (vb_translated[i]) {
+         pipe_buffer_unmap(mgr->pipe, vb_transfer[i]);
+      }
+   }
+}
+
+/* Return FALSE if the translated vertices can't be kept, i.e. if they come
+ * from user buffers, which can change behind our back. */
+static boolean
+u_vbuf_translation_init_key(struct u_vbuf_priv *mgr,
+                            struct u_vbuf_translation_key *tkey,
+                            const struct translate_key *key,
+                            const boolean *vb_translated,
+                            int min_index, int max_index)
+{
+   unsigned i;
+
+   memset(tkey, 0, sizeof(*tkey));
+   tkey->tr = *key;
+   tkey->min_index = min_index;
+   tkey->max_index = max_index;
+
+   for (i = 0; i < mgr->b.nr_vertex_buffers; i++) {
+      if (vb_translated[i]) {
+         struct pipe_vertex_buffer *vb = &mgr->b.vertex_buffer[i];
+
+         if (u_vbuf_resource(vb->buffer)->user_ptr) {
+            return FALSE;
+         }
+
+         tkey->vb[i].buffer = vb->buffer;
+         tkey->vb[i].buffer_offset = vb->buffer_offset;
+         tkey->vb[i].stride = vb->stride;
+      }
+   }
+   return TRUE;
+}
+
+/* Whether the source buffers have been written since the translation. */
+static boolean
+u_vbuf_translation_is_stale(struct u_vbuf_translation *t)
+{
+   unsigned i;
+
+   for (i = 0; i < PIPE_MAX_ATTRIBS; i++) {
+      if (t->key.vb[i].buffer &&
+          t->generation[i] != u_vbuf_resource(t->key.vb[i].buffer)->generation) {
+         return TRUE;
+      }
+   }
+   return FALSE;
+}
+
+static void
+u_vbuf_translation_update_generation(struct u_vbuf_translation *t)
+{
+   unsigned i;
+
+   for (i = 0; i < PIPE_MAX_ATTRIBS; i++) {
+      if (t->key.vb[i].buffer) {
+         t->generation[i] = u_vbuf_resource(t->key.vb[i].buffer)->generation;
+      }
+   }
+}
+
+static void
+u_vbuf_translation_evict(struct u_vbuf_priv *mgr, unsigned size)
+{
+   struct u_vbuf_translation *t, *prev;
+
+   LIST_FOR_EACH_ENTRY_SAFE_REV(t, prev, &mgr->translations, list) {
+      if (mgr->translations_size + size <= U_VBUF_TRANSLATION_CACHE_SIZE) {
+         break;
+      }
+      u_vbuf_translation_destroy(mgr, t);
+   }
+}
+
+/* Allocate new space for the translated vertices, and return a pointer to
+ * where vertex min_index goes. The old space is left alone, as the GPU may
+ * still be reading it. */
+static uint8_t *
+u_vbuf_translation_alloc(struct u_vbuf_priv *mgr,
+                         struct u_vbuf_translation *t)
+{
+   unsigned out_offset, min_offset = t->key.tr.output_stride * t->key.min_index;
+   boolean flushed;
+   uint8_t *out_map;
+
+   pipe_resource_reference(&t->buffer, NULL);
+
+   /* Like for uploads, the space is placed so that the buffer can be bound
+    * with the offset of vertex 0. */
+   if (u_upload_alloc(mgr->translation_uploader, min_offset, t->size,
+                      &out_offset, &t->buffer, &flushed,
+                      (void**)&out_map) != PIPE_OK) {
+      return NULL;
+   }
+
+   t->buffer_offset = out_offset - min_offset;
+   return out_map;
+}
+
+/* Return the cached translation of the current vertex buffers, creating it
+ * if needed, or NULL if they can't be cached. *out_map is set if the
+ * vertices must be (re)translated there. */
+static struct u_vbuf_translation *
+u_vbuf_translation_get(struct u_vbuf_priv *mgr,
+                       const struct translate_key *key,
+                       const boolean *vb_translated,
+                       int min_index, int max_index,
+                       uint8_t **out_map)
+{
+   struct u_vbuf_translation_key tkey;
+   struct u_vbuf_translation *t;
+   unsigned i, size = key->output_stride * (max_index + 1 - min_index);
+
+   *out_map = NULL;
+
+   if (size > U_VBUF_TRANSLATION_CACHE_SIZE / 4 ||
+       !u_vbuf_translation_init_key(mgr, &tkey, key, vb_translated,
+                                    min_index, max_index)) {
+      return NULL;
+   }
+
+   t = util_hash_table_get(mgr->translation_table, &tkey);
+   if (t) {
+      /* Move it to the front. */
+      LIST_DEL(&t->list);
+      LIST_ADD(&t->list, &mgr->translations);
+
+      /* Buffers which are written between draws get their vertices
+       * translated into new space. */
+      if (u_vbuf_translation_is_stale(t)) {
+         u_vbuf_translation_update_generation(t);
+         *out_map = u_vbuf_translation_alloc(mgr, t);
+         if (!*out_map) {
+            u_vbuf_translation_destroy(mgr, t);
+            return NULL;
+         }
+      }
+      return t;
+   }
+
+   u_vbuf_translation_evict(mgr, size);
+
+   t = CALLOC_STRUCT(u_vbuf_translation);
+   if (!t) {
+      return NULL;
+   }
+
+   t->mgr = mgr;
+   t->key = tkey;
+   t->size = size;
+
+   *out_map = u_vbuf_translation_alloc(mgr, t);
+   if (!*out_map ||
+       util_hash_table_set(mgr->translation_table, &t->key, t) != PIPE_OK) {
+      pipe_resource_reference(&t->buffer, NULL);
+      FREE(t);
+      *out_map = NULL;
+      return NULL;
+   }
+
+   for (i = 0; i < PIPE_MAX_ATTRIBS; i++) {
+      if (tkey.vb[i].buffer) {
+         t->src[i].translation = t;
+         LIST_ADD(&t->src[i].list,
+                  &u_vbuf_resource(tkey.vb[i].buffer)->translations);
+      }
+   }
+   u_vbuf_translation_update_generation(t);
+
+   LIST_ADD(&t->list, &mgr->translations);
+   mgr->translations_size += size;
+   return t;
+}
+
 static void
 u_vbuf_translate_begin(struct u_vbuf_priv *mgr,
                        int min_index, int max_index)
@@ -189,10 +536,9 @@ u_vbuf_translate_begin(struct u_vbuf_priv *mgr,
    struct translate_key key;
    struct translate_element *te;
    unsigned tr_elem_index[PIPE_MAX_ATTRIBS];
-   struct translate *tr;
    boolean vb_translated[PIPE_MAX_ATTRIBS] = {0};
+   struct u_vbuf_translation *translation;
    uint8_t *out_map;
-   struct pipe_transfer *vb_transfer[PIPE_MAX_ATTRIBS] = {0};
    struct pipe_resource *out_buffer = NULL;
    unsigned i, num_verts, out_offset;
    boolean upload_flushed = FALSE;
@@ -255,42 +601,33 @@ u_vbuf_translate_begin(struct u_vbuf_priv *mgr,
       key.nr_elements++;
    }
 
-   /* Get a translate object. */
-   tr = translate_cache_find(mgr->translate_cache, &key);
-
-   /* Map buffers we want to translate. */
-   for (i = 0; i < mgr->b.nr_vertex_buffers; i++) {
-      if (vb_translated[i]) {
-         struct pipe_vertex_buffer *vb = &mgr->b.vertex_buffer[i];
-
-         uint8_t *map = pipe_buffer_map(mgr->pipe, vb->buffer,
-                                        PIPE_TRANSFER_READ, &vb_transfer[i]);
-
-         tr->set_buffer(tr, i,
-                        map + vb->buffer_offset + vb->stride * min_index,
-                        vb->stride, ~0);
-      }
-   }
-
-   /* Create and map the output buffer. */
    num_verts = max_index + 1 - min_index;
 
-   u_upload_alloc(mgr->b.uploader,
-                  key.output_stride * min_index,
-                  key.output_stride * num_verts,
-                  &out_offset, &out_buffer, &upload_flushed,
-                  (void**)&out_map);
+   /* Reuse the vertices translated by a previous draw if the buffers
+    * haven't been written since. */
+   translation = u_vbuf_translation_get(mgr, &key, vb_translated,
+                                        min_index, max_index, &out_map);
+   if (translation) {
+      if (out_map) {
+         u_vbuf_translate_buffers(mgr, &key, vb_translated, min_index, num_verts,
+                                  out_map);
+         u_upload_unmap(mgr->translation_uploader);
+      }
 
-   out_offset -= key.output_stride * min_index;
+      pipe_resource_reference(&out_buffer, translation->buffer);
+      out_offset = translation->buffer_offset;
+   } else {
+      /* Create and map the output buffer. */
+      u_upload_alloc(mgr->b.uploader,
+                     key.output_stride * min_index,
+                     key.output_stride * num_verts,
+                     &out_offset, &out_buffer, &upload_flushed,
+                     (void**)&out_map);
 
-   /* Translate. */
-   tr->run(tr, 0, num_verts, 0, out_map);
+      out_offset -= key.output_stride * min_index;
 
-   /* Unmap all buffers. */
-   for (i = 0; i < mgr->b.nr_vertex_buffers; i++) {
-      if (vb_translated[i]) {
-         pipe_buffer_unmap(mgr->pipe, vb_transfer[i]);
-      }
+      u_vbuf_translate_buffers(mgr, &key, vb_translated, min_index, num_verts,
+                               out_map);
    }
 
    /* Setup the new vertex buffer. */
@@ -35,6 +35,7 @@
 
 #include "pipe/p_context.h"
 #include "pipe/p_state.h"
+#include "util/u_double_list.h"
 #include "util/u_transfer.h"
 
 /* Hardware vertex fetcher limitations can be described by this structure. */
@@ -85,6 +86,15 @@ struct u_vbuf {
 struct u_vbuf_resource {
    struct u_resource b;
    uint8_t *user_ptr;
+
+   /* Incremented every time the buffer is written, so that the manager
+    * knows when the vertices it translated from it are out of date.
+    * See u_vbuf_resource_written(). */
+   unsigned generation;
+
+   /* Links to the cached translations made from the buffer, which are
+    * dropped when it's destroyed. See u_vbuf_resource_destroyed(). */
+   struct list_head translations;
 };
 
 /* Opaque type containing information about vertex elements for the manager. */
@@ -142,4 +152,16 @@ static INLINE struct u_vbuf_resource *u_vbuf_resource(struct pipe_resource *r)
    return (struct u_vbuf_resource*)r;
 }
 
+/* Drivers must call this whenever a buffer is written, e.g. when it's
+ * mapped for writing, because the manager keeps the vertices it translated
+ * from real buffers around until then. */
+static INLINE void u_vbuf_resource_written(struct pipe_resource *r)
+{
+   u_vbuf_resource(r)->generation++;
+}
+
+/* Drivers must call this when a buffer is destroyed, to drop the vertices
+ * translated from it. */
+void u_vbuf_resource_destroyed(struct pipe_resource *r);
+
 #endif
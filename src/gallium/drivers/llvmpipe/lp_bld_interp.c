@@ -41,6 +41,7 @@
 #include "gallivm/lp_bld_debug.h"
 #include "gallivm/lp_bld_const.h"
 #include "gallivm/lp_bld_arit.h"
+#include "gallivm/lp_bld_flow.h"
 #include "gallivm/lp_bld_swizzle.h"
 #include "lp_bld_interp.h"
 
@@ -263,6 +264,8 @@ coeffs_init(struct lp_build_interp_soa_context *bld,
 
             bld->a   [attrib][chan] = a;
             bld->dadq[attrib][chan] = dadq;
+            bld->dadx[attrib][chan] = dadx;
+            bld->dady[attrib][chan] = dady;
          }
       }
    }
@@ -477,3 +480,124 @@ lp_build_interp_soa_update_pos(struct lp_build_interp_soa_context *bld,
    attribs_update(bld, gallivm, quad_index, 0, 1);
 }
 
+
+/**
+ * Whether the attribute varies across the primitive, i.e., whether its
+ * value must be stepped from one block to the next.
+ */
+static INLINE boolean
+attrib_is_interpolated(const struct lp_build_interp_soa_context *bld,
+                       unsigned attrib, unsigned chan)
+{
+   return (bld->mask[attrib] & (1 << chan)) &&
+          (bld->interp[attrib] == LP_INTERP_LINEAR ||
+           bld->interp[attrib] == LP_INTERP_PERSPECTIVE);
+}
+
+
+/**
+ * Start a row of blocks, y_offset (int32) pixels below the block given to
+ * lp_build_interp_soa_init(), for code shading several blocks in a loop.
+ *
+ * The values at the first block of the row are computed from the
+ * coefficients, so errors don't accumulate from row to row.  Along the
+ * row they are carried in variables, and incremented by x_step pixels at
+ * a time with lp_build_interp_soa_next_block().
+ */
+void
+lp_build_interp_soa_begin_row(struct lp_build_interp_soa_context *bld,
+                              struct gallivm_state *gallivm,
+                              LLVMValueRef y_offset,
+                              unsigned x_step)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_build_context *coeff_bld = &bld->coeff_bld;
+   LLVMValueRef x_step_f = LLVMConstReal(coeff_bld->elem_type, x_step);
+   LLVMValueRef y_offset_f;
+   unsigned attrib;
+   unsigned chan;
+
+#if PERSPECTIVE_DIVIDE_PER_QUAD
+   /* bld->oow would need stepping too */
+   assert(0);
+#endif
+
+   y_offset_f = LLVMBuildSIToFP(builder, y_offset, coeff_bld->elem_type, "");
+
+   for (attrib = 0; attrib < bld->num_attribs; ++attrib) {
+      for (chan = 0; chan < NUM_CHANNELS; ++chan) {
+         if (attrib_is_interpolated(bld, attrib, chan)) {
+            LLVMValueRef a, ay, step;
+
+            if (!bld->a_var[attrib][chan]) {
+               bld->a_origin[attrib][chan] = bld->a[attrib][chan];
+               bld->a_var[attrib][chan] =
+                  lp_build_alloca(gallivm, coeff_bld->vec_type, "");
+            }
+
+            /* a = a_origin + y_offset * dady */
+            ay = LLVMBuildFMul(builder, y_offset_f,
+                               bld->dady[attrib][chan], "");
+            ay = lp_build_broadcast(gallivm, coeff_bld->vec_type, ay);
+            a = LLVMBuildFAdd(builder, bld->a_origin[attrib][chan], ay, "");
+            LLVMBuildStore(builder, a, bld->a_var[attrib][chan]);
+
+            /* step = x_step * dadx */
+            step = LLVMBuildFMul(builder, x_step_f,
+                                 bld->dadx[attrib][chan], "");
+            step = lp_build_broadcast(gallivm, coeff_bld->vec_type, step);
+            attrib_name(step, attrib, chan, ".step");
+            bld->a_step[attrib][chan] = step;
+         }
+      }
+   }
+}
+
+
+/**
+ * Fetch the values at the current block of the row.  Call this at the
+ * start of every block, before lp_build_interp_soa_update_*().
+ */
+void
+lp_build_interp_soa_begin_block(struct lp_build_interp_soa_context *bld,
+                                struct gallivm_state *gallivm)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   unsigned attrib;
+   unsigned chan;
+
+   for (attrib = 0; attrib < bld->num_attribs; ++attrib) {
+      for (chan = 0; chan < NUM_CHANNELS; ++chan) {
+         if (attrib_is_interpolated(bld, attrib, chan)) {
+            assert(bld->a_var[attrib][chan]);
+            bld->a[attrib][chan] =
+               LLVMBuildLoad(builder, bld->a_var[attrib][chan], "");
+            attrib_name(bld->a[attrib][chan], attrib, chan, ".a");
+         }
+      }
+   }
+}
+
+
+/**
+ * Advance to the next block of the row.
+ */
+void
+lp_build_interp_soa_next_block(struct lp_build_interp_soa_context *bld,
+                               struct gallivm_state *gallivm)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   unsigned attrib;
+   unsigned chan;
+
+   for (attrib = 0; attrib < bld->num_attribs; ++attrib) {
+      for (chan = 0; chan < NUM_CHANNELS; ++chan) {
+         if (attrib_is_interpolated(bld, attrib, chan)) {
+            LLVMValueRef a;
+            a = LLVMBuildFAdd(builder, bld->a[attrib][chan],
+                              bld->a_step[attrib][chan], "");
+            LLVMBuildStore(builder, a, bld->a_var[attrib][chan]);
+         }
+      }
+   }
+}
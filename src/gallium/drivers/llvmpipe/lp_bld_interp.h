@@ -92,6 +92,17 @@ struct lp_build_interp_soa_context
 
    LLVMValueRef attribs[1 + PIPE_MAX_SHADER_INPUTS][NUM_CHANNELS];
 
+   /*
+    * For loops over blocks: the scalar derivatives, the values at the
+    * first block, the variables holding the values at the current block,
+    * and the increments to the next block in the row.
+    */
+   LLVMValueRef dadx    [1 + PIPE_MAX_SHADER_INPUTS][NUM_CHANNELS];
+   LLVMValueRef dady    [1 + PIPE_MAX_SHADER_INPUTS][NUM_CHANNELS];
+   LLVMValueRef a_origin[1 + PIPE_MAX_SHADER_INPUTS][NUM_CHANNELS];
+   LLVMValueRef a_var   [1 + PIPE_MAX_SHADER_INPUTS][NUM_CHANNELS];
+   LLVMValueRef a_step  [1 + PIPE_MAX_SHADER_INPUTS][NUM_CHANNELS];
+
    /*
     * Convenience pointers. Callers may access this one.
     */
@@ -123,5 +134,19 @@ lp_build_interp_soa_update_pos(struct lp_build_interp_soa_context *bld,
                                struct gallivm_state *gallivm,
                                int quad_index);
 
+void
+lp_build_interp_soa_begin_row(struct lp_build_interp_soa_context *bld,
+                              struct gallivm_state *gallivm,
+                              LLVMValueRef y_offset,
+                              unsigned x_step);
+
+void
+lp_build_interp_soa_begin_block(struct lp_build_interp_soa_context *bld,
+                                struct gallivm_state *gallivm);
+
+void
+lp_build_interp_soa_next_block(struct lp_build_interp_soa_context *bld,
+                               struct gallivm_state *gallivm);
+
 
 #endif /* LP_BLD_INTERP_H */
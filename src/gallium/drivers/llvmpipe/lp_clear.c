@@ -56,7 +56,7 @@ llvmpipe_clear(struct pipe_context *pipe,
    if (llvmpipe->no_rast)
       return;
 
-   if (!llvmpipe_check_render_cond(llvmpipe))
+   if (!llvmpipe_check_render_cond(llvmpipe, FALSE))
       return;
 
    if (LP_PERF & PERF_NO_DEPTH)
@@ -34,6 +34,7 @@
 #include "pipe/p_context.h"
 
 #include "draw/draw_vertex.h"
+#include "os/os_thread.h"
 
 #include "lp_tex_sample.h"
 #include "lp_jit.h"
@@ -130,9 +131,24 @@ struct llvmpipe_context {
    struct lp_fs_variant_list_item fs_variants_list;
    unsigned nr_fs_variants;
 
-   /** JIT code generation */
-   struct gallivm_state *gallivm;
-   LLVMTypeRef jit_context_ptr_type;
+   /** The fragment shader variant bound to the setup module */
+   struct lp_fragment_shader_variant *fs_variant;
+
+   /**
+    * Recompilation of the hot fragment shader variants with full
+    * optimization, on a background thread started on demand.
+    */
+   struct {
+      unsigned hot_draws;       /**< draws before recompiling, 0 = never */
+      boolean thread_started;
+      boolean quit;
+      pipe_thread thread;
+      pipe_mutex mutex;
+      pipe_condvar cond;
+      struct lp_fs_variant_list_item queue;   /**< variants to recompile */
+      struct lp_fs_variant_list_item done;    /**< variants recompiled */
+      int32_t nr_done;   /**< length of done, readable without the mutex */
+   } fs_recompile;
 
    struct lp_setup_variant_list_item setup_variants_list;
    unsigned nr_setup_variants;
@@ -143,14 +159,6 @@ struct llvmpipe_context {
 };
 
 
-/**
- * Fragment and setup variant count, used to trigger garbage collection.
- * This is global since all variants in all contexts will be free when
- * we do garbage collection.
- */
-extern unsigned llvmpipe_variant_count;
-
-
 struct pipe_context *
 llvmpipe_create_context( struct pipe_screen *screen, void *priv );
 
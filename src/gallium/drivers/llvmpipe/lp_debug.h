@@ -50,6 +50,7 @@ st_print_current(void);
 #define DEBUG_FENCE         0x2000
 #define DEBUG_MEM           0x4000
 #define DEBUG_FS            0x8000
+#define DEBUG_JIT           0x10000
 
 /* Performance flags.  These are active even on release builds.
  */
@@ -61,6 +62,8 @@ st_print_current(void);
 #define PERF_NO_BLEND       0x20  	/* disable blending */
 #define PERF_NO_DEPTH       0x40  	/* disable depth buffering entirely */
 #define PERF_NO_ALPHATEST   0x80  	/* disable alpha testing */
+#define PERF_COUNTERS       0x100 	/* print the lp_perf.h counters */
+#define PERF_NO_TEX_TILING  0x200 	/* always sample linear textures */
 
 
 extern int LP_PERF;
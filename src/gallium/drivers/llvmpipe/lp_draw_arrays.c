@@ -34,10 +34,12 @@
 #include "pipe/p_defines.h"
 #include "pipe/p_context.h"
 #include "util/u_prim.h"
+#include "os/os_time.h"
 
 #include "lp_context.h"
 #include "lp_state.h"
 #include "lp_query.h"
+#include "lp_perf.h"
 
 #include "draw/draw_context.h"
 
@@ -56,13 +58,19 @@ llvmpipe_draw_vbo(struct pipe_context *pipe, const struct pipe_draw_info *info)
    struct draw_context *draw = lp->draw;
    void *mapped_indices = NULL;
    unsigned i;
+   int64_t t0, finish_time0;
 
-   if (!llvmpipe_check_render_cond(lp))
+   if (!llvmpipe_check_render_cond(lp, TRUE))
       return;
 
+   t0 = os_time_get();
+   finish_time0 = LP_COUNT_GET(finish_time);
+
    if (lp->dirty)
       llvmpipe_update_derived( lp );
 
+   llvmpipe_fs_variant_draw(lp);
+
    /*
     * Map vertex buffers
     */
@@ -101,6 +109,12 @@ llvmpipe_draw_vbo(struct pipe_context *pipe, const struct pipe_draw_info *info)
     * internally when this condition is seen?)
     */
    draw_flush(draw);
+
+   /* Binning may have flushed the scene, don't count the rasterizer's
+    * time, which is in finish_time already.
+    */
+   LP_COUNT_ADD(setup_time, os_time_get() - t0 -
+                (LP_COUNT_GET(finish_time) - finish_time0));
 }
 
 
@@ -38,10 +38,14 @@
 #include "gallivm/lp_bld_debug.h"
 #include "lp_context.h"
 #include "lp_jit.h"
+#include "lp_state_fs.h"
 
 
-static void
-lp_jit_create_types(struct llvmpipe_context *lp)
+/**
+ * Create the types of the JIT interface in the variant's LLVM context.
+ */
+void
+lp_jit_init_types(struct lp_fragment_shader_variant *lp)
 {
    struct gallivm_state *gallivm = lp->gallivm;
    LLVMContextRef lc = gallivm->context;
@@ -190,12 +194,3 @@ lp_jit_screen_init(struct llvmpipe_screen *screen)
    lp_build_init();
 }
 
-
-LLVMTypeRef
-lp_jit_get_context_type(struct llvmpipe_context *lp)
-{
-   if (!lp->jit_context_ptr_type)
-      lp_jit_create_types(lp);
-
-   return lp->jit_context_ptr_type;
-}
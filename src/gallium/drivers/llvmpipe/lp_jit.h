@@ -43,6 +43,7 @@
 
 
 struct llvmpipe_screen;
+struct lp_fragment_shader_variant;
 
 
 struct lp_jit_texture
@@ -156,6 +157,27 @@ typedef void
                     uint32_t *counter);
 
 
+/**
+ * Shade a size x size run of 4x4 blocks, all fully covered, at (x, y).
+ * color[] point to the first block in the swizzled color tiles, and depth
+ * to the first block in the depth buffer, whose rows of blocks are
+ * depth_stride bytes apart.
+ */
+typedef void
+(*lp_jit_frag_tile_func)(const struct lp_jit_context *context,
+                         uint32_t x,
+                         uint32_t y,
+                         uint32_t facing,
+                         const void *a0,
+                         const void *dadx,
+                         const void *dady,
+                         uint8_t **color,
+                         void *depth,
+                         uint32_t depth_stride,
+                         uint32_t size,
+                         uint32_t *counter);
+
+
 void
 lp_jit_screen_cleanup(struct llvmpipe_screen *screen);
 
@@ -164,8 +186,8 @@ void
 lp_jit_screen_init(struct llvmpipe_screen *screen);
 
 
-LLVMTypeRef
-lp_jit_get_context_type(struct llvmpipe_context *lp);
+void
+lp_jit_init_types(struct lp_fragment_shader_variant *lp);
 
 
 #endif /* LP_JIT_H */
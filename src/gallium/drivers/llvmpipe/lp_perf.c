@@ -25,7 +25,10 @@
  *
  **************************************************************************/
 
+#include <stdio.h>
+
 #include "util/u_debug.h"
+#include "os/os_thread.h"
 #include "lp_debug.h"
 #include "lp_perf.h"
 
@@ -33,6 +36,13 @@
 
 struct lp_counters lp_count;
 
+boolean lp_trace_active = FALSE;
+
+static FILE *lp_trace_file = NULL;
+
+/** Serializes the trace events of the different threads */
+pipe_static_mutex(lp_trace_mutex);
+
 
 void
 lp_reset_counters(void)
@@ -41,15 +51,64 @@ lp_reset_counters(void)
 }
 
 
+/**
+ * Add the counters of a rasterizer thread to lp_count.
+ * Called with the rasterizer idle.
+ */
+void
+lp_accumulate_rast_counters(unsigned thread,
+                            const struct lp_rast_counters *counters)
+{
+   struct lp_rast_counters *total = &lp_count.rast[thread];
+
+   total->nr_scenes += counters->nr_scenes;
+   total->nr_bins += counters->nr_bins;
+   total->nr_pure_shade_opaque_64 += counters->nr_pure_shade_opaque_64;
+   total->nr_pure_shade_64 += counters->nr_pure_shade_64;
+   total->nr_empty_16 += counters->nr_empty_16;
+   total->nr_fully_covered_16 += counters->nr_fully_covered_16;
+   total->nr_partially_covered_16 += counters->nr_partially_covered_16;
+   total->nr_empty_4 += counters->nr_empty_4;
+   total->nr_fully_covered_4 += counters->nr_fully_covered_4;
+   total->nr_partially_covered_4 += counters->nr_partially_covered_4;
+   total->nr_non_empty_4 += counters->nr_non_empty_4;
+   total->nr_shade_4 += counters->nr_shade_4;
+   total->nr_color_tile_clear += counters->nr_color_tile_clear;
+   total->nr_color_tile_load += counters->nr_color_tile_load;
+   total->nr_color_tile_store += counters->nr_color_tile_store;
+   total->rast_time += counters->rast_time;
+   total->wait_time += counters->wait_time;
+}
+
+
 void
 lp_print_counters(void)
 {
-   if (LP_DEBUG & DEBUG_COUNTERS) {
+   if ((LP_DEBUG & DEBUG_COUNTERS) || (LP_PERF & PERF_COUNTERS)) {
+      struct lp_rast_counters rast;
       unsigned total_64, total_16, total_4;
       float p1, p2, p3, p5, p6;
+      unsigned i;
+
+      memset(&rast, 0, sizeof rast);
+      for (i = 0; i < LP_MAX_THREADS; i++) {
+         const struct lp_rast_counters *counters = &lp_count.rast[i];
+         rast.nr_pure_shade_opaque_64 += counters->nr_pure_shade_opaque_64;
+         rast.nr_pure_shade_64 += counters->nr_pure_shade_64;
+         rast.nr_empty_16 += counters->nr_empty_16;
+         rast.nr_fully_covered_16 += counters->nr_fully_covered_16;
+         rast.nr_partially_covered_16 += counters->nr_partially_covered_16;
+         rast.nr_empty_4 += counters->nr_empty_4;
+         rast.nr_fully_covered_4 += counters->nr_fully_covered_4;
+         rast.nr_partially_covered_4 += counters->nr_partially_covered_4;
+         rast.nr_non_empty_4 += counters->nr_non_empty_4;
+         rast.nr_color_tile_clear += counters->nr_color_tile_clear;
+         rast.nr_color_tile_load += counters->nr_color_tile_load;
+         rast.nr_color_tile_store += counters->nr_color_tile_store;
+      }
 
-      debug_printf("llvmpipe: nr_triangles:                 %9u\n", lp_count.nr_tris);
-      debug_printf("llvmpipe: nr_culled_triangles:          %9u\n", lp_count.nr_culled_tris);
+      _debug_printf("llvmpipe: nr_triangles:                 %9u\n", lp_count.nr_tris);
+      _debug_printf("llvmpipe: nr_culled_triangles:          %9u\n", lp_count.nr_culled_tris);
 
       total_64 = (lp_count.nr_empty_64 + 
                   lp_count.nr_fully_covered_64 +
@@ -61,49 +120,147 @@ lp_print_counters(void)
       p5 = 100.0 * (float) lp_count.nr_shade_opaque_64 / (float) total_64;
       p6 = 100.0 * (float) lp_count.nr_shade_64 / (float) total_64;
 
-      debug_printf("llvmpipe: nr_64x64:                     %9u\n", total_64);
-      debug_printf("llvmpipe:   nr_fully_covered_64x64:     %9u (%3.0f%% of %u)\n", lp_count.nr_fully_covered_64, p2, total_64);
-      debug_printf("llvmpipe:     nr_shade_opaque_64x64:    %9u (%3.0f%% of %u)\n", lp_count.nr_shade_opaque_64, p5, total_64);
-      debug_printf("llvmpipe:        nr_pure_shade_opaque:  %9u (%3.0f%% of %u)\n", lp_count.nr_pure_shade_opaque_64, 0.0, lp_count.nr_shade_opaque_64);
-      debug_printf("llvmpipe:     nr_shade_64x64:           %9u (%3.0f%% of %u)\n", lp_count.nr_shade_64, p6, total_64);
-      debug_printf("llvmpipe:        nr_pure_shade:         %9u (%3.0f%% of %u)\n", lp_count.nr_pure_shade_64, 0.0, lp_count.nr_shade_64);
-      debug_printf("llvmpipe:   nr_partially_covered_64x64: %9u (%3.0f%% of %u)\n", lp_count.nr_partially_covered_64, p3, total_64);
-      debug_printf("llvmpipe:   nr_empty_64x64:             %9u (%3.0f%% of %u)\n", lp_count.nr_empty_64, p1, total_64);
-
-      total_16 = (lp_count.nr_empty_16 + 
-                  lp_count.nr_fully_covered_16 +
-                  lp_count.nr_partially_covered_16);
-
-      p1 = 100.0 * (float) lp_count.nr_empty_16 / (float) total_16;
-      p2 = 100.0 * (float) lp_count.nr_fully_covered_16 / (float) total_16;
-      p3 = 100.0 * (float) lp_count.nr_partially_covered_16 / (float) total_16;
-
-      debug_printf("llvmpipe: nr_16x16:                     %9u\n", total_16);
-      debug_printf("llvmpipe:   nr_fully_covered_16x16:     %9u (%3.0f%% of %u)\n", lp_count.nr_fully_covered_16, p2, total_16);
-      debug_printf("llvmpipe:   nr_partially_covered_16x16: %9u (%3.0f%% of %u)\n", lp_count.nr_partially_covered_16, p3, total_16);
-      debug_printf("llvmpipe:   nr_empty_16x16:             %9u (%3.0f%% of %u)\n", lp_count.nr_empty_16, p1, total_16);
-
-      total_4 = (lp_count.nr_empty_4 +
-                 lp_count.nr_fully_covered_4 +
-                 lp_count.nr_partially_covered_4);
-
-      p1 = 100.0 * (float) lp_count.nr_empty_4 / (float) total_4;
-      p2 = 100.0 * (float) lp_count.nr_fully_covered_4 / (float) total_4;
-      p3 = 100.0 * (float) lp_count.nr_partially_covered_4 / (float) total_4;
-
-      debug_printf("llvmpipe: nr_tri_4x4:                   %9u\n", total_4);
-      debug_printf("llvmpipe:   nr_fully_covered_4x4:       %9u (%3.0f%% of %u)\n", lp_count.nr_fully_covered_4, p2, total_4);
-      debug_printf("llvmpipe:   nr_partially_covered_4x4:   %9u (%3.0f%% of %u)\n", lp_count.nr_partially_covered_4, p3, total_4);
-      debug_printf("llvmpipe:   nr_empty_4x4:               %9u (%3.0f%% of %u)\n", lp_count.nr_empty_4, p1, total_4);
-      debug_printf("llvmpipe:   nr_non_empty_4x4:           %9u (%3.0f%% of %u)\n", lp_count.nr_non_empty_4, p2, total_4);
-
-      debug_printf("llvmpipe: nr_color_tile_clear:          %9u\n", lp_count.nr_color_tile_clear);
-      debug_printf("llvmpipe: nr_color_tile_load:           %9u\n", lp_count.nr_color_tile_load);
-      debug_printf("llvmpipe: nr_color_tile_store:          %9u\n", lp_count.nr_color_tile_store);
-
-      debug_printf("llvmpipe: nr_llvm_compiles:             %u\n", lp_count.nr_llvm_compiles);
-      debug_printf("llvmpipe: total LLVM compile time:      %.2f sec\n", lp_count.llvm_compile_time / 1000000.0);
-      debug_printf("llvmpipe: average LLVM compile time:    %.2f sec\n", lp_count.llvm_compile_time / 1000000.0 / lp_count.nr_llvm_compiles);
+      _debug_printf("llvmpipe: nr_64x64:                     %9u\n", total_64);
+      _debug_printf("llvmpipe:   nr_fully_covered_64x64:     %9u (%3.0f%% of %u)\n", lp_count.nr_fully_covered_64, p2, total_64);
+      _debug_printf("llvmpipe:     nr_shade_opaque_64x64:    %9u (%3.0f%% of %u)\n", lp_count.nr_shade_opaque_64, p5, total_64);
+      _debug_printf("llvmpipe:        nr_pure_shade_opaque:  %9u (%3.0f%% of %u)\n", rast.nr_pure_shade_opaque_64, 0.0, lp_count.nr_shade_opaque_64);
+      _debug_printf("llvmpipe:     nr_shade_64x64:           %9u (%3.0f%% of %u)\n", lp_count.nr_shade_64, p6, total_64);
+      _debug_printf("llvmpipe:        nr_pure_shade:         %9u (%3.0f%% of %u)\n", rast.nr_pure_shade_64, 0.0, lp_count.nr_shade_64);
+      _debug_printf("llvmpipe:   nr_partially_covered_64x64: %9u (%3.0f%% of %u)\n", lp_count.nr_partially_covered_64, p3, total_64);
+      _debug_printf("llvmpipe:   nr_empty_64x64:             %9u (%3.0f%% of %u)\n", lp_count.nr_empty_64, p1, total_64);
+
+      total_16 = (rast.nr_empty_16 + 
+                  rast.nr_fully_covered_16 +
+                  rast.nr_partially_covered_16);
+
+      p1 = 100.0 * (float) rast.nr_empty_16 / (float) total_16;
+      p2 = 100.0 * (float) rast.nr_fully_covered_16 / (float) total_16;
+      p3 = 100.0 * (float) rast.nr_partially_covered_16 / (float) total_16;
+
+      _debug_printf("llvmpipe: nr_16x16:                     %9u\n", total_16);
+      _debug_printf("llvmpipe:   nr_fully_covered_16x16:     %9u (%3.0f%% of %u)\n", rast.nr_fully_covered_16, p2, total_16);
+      _debug_printf("llvmpipe:   nr_partially_covered_16x16: %9u (%3.0f%% of %u)\n", rast.nr_partially_covered_16, p3, total_16);
+      _debug_printf("llvmpipe:   nr_empty_16x16:             %9u (%3.0f%% of %u)\n", rast.nr_empty_16, p1, total_16);
+
+      total_4 = (rast.nr_empty_4 +
+                 rast.nr_fully_covered_4 +
+                 rast.nr_partially_covered_4);
+
+      p1 = 100.0 * (float) rast.nr_empty_4 / (float) total_4;
+      p2 = 100.0 * (float) rast.nr_fully_covered_4 / (float) total_4;
+      p3 = 100.0 * (float) rast.nr_partially_covered_4 / (float) total_4;
+
+      _debug_printf("llvmpipe: nr_tri_4x4:                   %9u\n", total_4);
+      _debug_printf("llvmpipe:   nr_fully_covered_4x4:       %9u (%3.0f%% of %u)\n", rast.nr_fully_covered_4, p2, total_4);
+      _debug_printf("llvmpipe:   nr_partially_covered_4x4:   %9u (%3.0f%% of %u)\n", rast.nr_partially_covered_4, p3, total_4);
+      _debug_printf("llvmpipe:   nr_empty_4x4:               %9u (%3.0f%% of %u)\n", rast.nr_empty_4, p1, total_4);
+      _debug_printf("llvmpipe:   nr_non_empty_4x4:           %9u (%3.0f%% of %u)\n", rast.nr_non_empty_4, p2, total_4);
+
+      _debug_printf("llvmpipe: nr_color_tile_clear:          %9u\n", rast.nr_color_tile_clear);
+      _debug_printf("llvmpipe: nr_color_tile_load:           %9u\n", rast.nr_color_tile_load);
+      _debug_printf("llvmpipe: nr_color_tile_store:          %9u\n", rast.nr_color_tile_store);
+
+      _debug_printf("llvmpipe: nr_llvm_compiles:             %u\n", lp_count.nr_llvm_compiles);
+      _debug_printf("llvmpipe: total LLVM compile time:      %.2f sec\n", lp_count.llvm_compile_time / 1000000.0);
+      _debug_printf("llvmpipe: average LLVM compile time:    %.2f sec\n", lp_count.llvm_compile_time / 1000000.0 / lp_count.nr_llvm_compiles);
+
+      _debug_printf("llvmpipe: setup time:                   %.2f sec\n", lp_count.setup_time / 1000000.0);
+      _debug_printf("llvmpipe: wait for rasterizer time:     %.2f sec\n", lp_count.finish_time / 1000000.0);
+
+      for (i = 0; i < LP_MAX_THREADS; i++) {
+         const struct lp_rast_counters *counters = &lp_count.rast[i];
+
+         if (!counters->nr_scenes)
+            continue;
+
+         _debug_printf("llvmpipe: thread %2u: scenes %6u bins %9u shade_4x4 %10u "
+                       "rast %.2f sec wait %.2f sec\n",
+                       i, counters->nr_scenes, counters->nr_bins,
+                       counters->nr_shade_4,
+                       counters->rast_time / 1000000.0,
+                       counters->wait_time / 1000000.0);
+      }
+   }
+}
+
+
+/**
+ * Open the LP_TRACE file, if requested.
+ */
+void
+lp_trace_init(void)
+{
+   const char *filename = debug_get_option("LP_TRACE", NULL);
 
+   pipe_mutex_lock(lp_trace_mutex);
+   if (filename && !lp_trace_file) {
+      lp_trace_file = fopen(filename, "w");
+      if (lp_trace_file) {
+         /* The closing bracket of the JSON array is optional in this format,
+          * which lets us write the events as they happen.
+          */
+         fprintf(lp_trace_file, "[\n");
+         fflush(lp_trace_file);
+         lp_trace_active = TRUE;
+      }
+      else {
+         debug_printf("llvmpipe: could not open %s\n", filename);
+      }
    }
+   pipe_mutex_unlock(lp_trace_mutex);
+
+   if (lp_trace_file)
+      lp_trace_thread_name(LP_TRACE_SETUP_TID, "setup");
+}
+
+
+void
+lp_trace_thread_name(unsigned tid, const char *name)
+{
+   if (!lp_trace_file)
+      return;
+
+   pipe_mutex_lock(lp_trace_mutex);
+   fprintf(lp_trace_file,
+           "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, "
+           "\"tid\": %u, \"args\": {\"name\": \"%s\"}},\n",
+           tid, name);
+   pipe_mutex_unlock(lp_trace_mutex);
+}
+
+
+/**
+ * Record that the thread tid spent [start, end) doing name.
+ * \param start, end  os_time_get() values
+ */
+void
+lp_trace_span(unsigned tid, const char *name, int64_t start, int64_t end)
+{
+   if (!lp_trace_file)
+      return;
+
+   pipe_mutex_lock(lp_trace_mutex);
+   fprintf(lp_trace_file,
+           "{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 0, \"tid\": %u, "
+           "\"ts\": %lld, \"dur\": %lld},\n",
+           name, tid, (long long) start, (long long) (end - start));
+   pipe_mutex_unlock(lp_trace_mutex);
+}
+
+
+/**
+ * Record the execution of the bin x, y.
+ */
+void
+lp_trace_bin(unsigned tid, unsigned x, unsigned y, int64_t start, int64_t end)
+{
+   if (!lp_trace_file)
+      return;
+
+   pipe_mutex_lock(lp_trace_mutex);
+   fprintf(lp_trace_file,
+           "{\"name\": \"bin\", \"ph\": \"X\", \"pid\": 0, \"tid\": %u, "
+           "\"ts\": %lld, \"dur\": %lld, \"args\": {\"x\": %u, \"y\": %u}},\n",
+           tid, (long long) start, (long long) (end - start), x, y);
+   pipe_mutex_unlock(lp_trace_mutex);
 }
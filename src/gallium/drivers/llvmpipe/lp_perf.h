@@ -34,21 +34,22 @@
 #define LP_PERF_H
 
 #include "pipe/p_compiler.h"
+#include "lp_limits.h"
+
 
 /**
- * Various counters
+ * Counters updated by a rasterizer thread.
+ *
+ * Each thread has its own copy in its lp_rasterizer_task, so they can be
+ * updated without locking.  They're added to lp_count.rast[] after each
+ * scene, while the threads are idle.
  */
-struct lp_counters
+struct lp_rast_counters
 {
-   unsigned nr_tris;
-   unsigned nr_culled_tris;
-   unsigned nr_empty_64;
-   unsigned nr_fully_covered_64;
-   unsigned nr_partially_covered_64;
+   unsigned nr_scenes;
+   unsigned nr_bins;
    unsigned nr_pure_shade_opaque_64;
    unsigned nr_pure_shade_64;
-   unsigned nr_shade_64;
-   unsigned nr_shade_opaque_64;
    unsigned nr_empty_16;
    unsigned nr_fully_covered_16;
    unsigned nr_partially_covered_16;
@@ -56,36 +57,98 @@ struct lp_counters
    unsigned nr_fully_covered_4;
    unsigned nr_partially_covered_4;
    unsigned nr_non_empty_4;
-   unsigned nr_llvm_compiles;
-   int64_t llvm_compile_time;  /**< total, in microseconds */
+   unsigned nr_shade_4;        /**< fragment shader invocations (4x4 blocks) */
 
    unsigned nr_color_tile_clear;
    unsigned nr_color_tile_load;
    unsigned nr_color_tile_store;
+
+   int64_t rast_time;          /**< executing bins, in microseconds */
+   int64_t wait_time;          /**< waiting for the other threads, in usecs */
+};
+
+
+/**
+ * Various counters
+ */
+struct lp_counters
+{
+   unsigned nr_tris;
+   unsigned nr_culled_tris;
+   unsigned nr_empty_64;
+   unsigned nr_fully_covered_64;
+   unsigned nr_partially_covered_64;
+   unsigned nr_shade_64;
+   unsigned nr_shade_opaque_64;
+   unsigned nr_llvm_compiles;
+   int64_t llvm_compile_time;  /**< total, in microseconds */
+
+   int64_t setup_time;         /**< in draw_vbo, in microseconds */
+   int64_t finish_time;        /**< waiting for the rasterizer, in usecs */
+
+   struct lp_rast_counters rast[LP_MAX_THREADS];
 };
 
 
 extern struct lp_counters lp_count;
 
 
-/** Increment the named counter (only for debug builds) */
-#ifdef DEBUG
+/** Increment the named counter */
 #define LP_COUNT(counter) lp_count.counter++
 #define LP_COUNT_ADD(counter, incr)  lp_count.counter += (incr)
 #define LP_COUNT_GET(counter) (lp_count.counter)
-#else
-#define LP_COUNT(counter)
-#define LP_COUNT_ADD(counter, incr) (void)(incr)
-#define LP_COUNT_GET(counter) 0
-#endif
+
+/** Increment the named counter of a rasterizer thread */
+#define LP_RAST_COUNT(task, counter) (task)->counters.counter++
+#define LP_RAST_COUNT_ADD(task, counter, incr) (task)->counters.counter += (incr)
 
 
 extern void
 lp_reset_counters(void);
 
 
+extern void
+lp_accumulate_rast_counters(unsigned thread,
+                            const struct lp_rast_counters *counters);
+
+
 extern void
 lp_print_counters(void);
 
 
+/**
+ * Timeline of the scenes in the Chrome trace event format, written to the
+ * file named by the LP_TRACE environment variable.
+ */
+extern boolean lp_trace_active;
+
+
+static INLINE boolean
+lp_trace_enabled(void)
+{
+   return lp_trace_active;
+}
+
+
+extern void
+lp_trace_init(void);
+
+
+/** Thread ids of the timeline: the setup thread, then rasterizer threads */
+#define LP_TRACE_SETUP_TID  0
+#define LP_TRACE_RAST_TID(thread_index) (1 + (thread_index))
+
+
+extern void
+lp_trace_thread_name(unsigned tid, const char *name);
+
+
+extern void
+lp_trace_span(unsigned tid, const char *name, int64_t start, int64_t end);
+
+
+extern void
+lp_trace_bin(unsigned tid, unsigned x, unsigned y, int64_t start, int64_t end);
+
+
 #endif /* LP_PERF_H */
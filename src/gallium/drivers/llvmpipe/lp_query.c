@@ -37,6 +37,7 @@
 #include "lp_flush.h"
 #include "lp_fence.h"
 #include "lp_query.h"
+#include "lp_scene.h"
 #include "lp_state.h"
 
 
@@ -64,6 +65,14 @@ llvmpipe_destroy_query(struct pipe_context *pipe, struct pipe_query *q)
 {
    struct llvmpipe_query *pq = llvmpipe_query(q);
 
+   /* Draws binned in later scenes may still test the per-tile results of
+    * a query used as render condition.
+    */
+   if (pq->tile_visible) {
+      lp_setup_set_render_condition(llvmpipe_context(pipe)->setup, NULL);
+      llvmpipe_finish(pipe, __FUNCTION__);
+   }
+
    /* Ideally we would refcount queries & not get destroyed until the
     * last scene had finished with us.
     */
@@ -77,6 +86,8 @@ llvmpipe_destroy_query(struct pipe_context *pipe, struct pipe_query *q)
       lp_fence_reference(&pq->fence, NULL);
    }
 
+   lp_fence_reference(&pq->begin_fence, NULL);
+   FREE(pq->tile_visible);
    FREE(pq);
 }
 
@@ -98,10 +109,19 @@ llvmpipe_get_query_result(struct pipe_context *pipe,
    }
 
    if (!lp_fence_signalled(pq->fence)) {
-      if (!lp_fence_issued(pq->fence))
+      if (!lp_fence_issued(pq->fence)) {
+         /* Don't split the scene on the first poll: applications checking
+          * many queries once per frame get the results from the next
+          * flush.  Flush on the following polls, so that spinning on the
+          * result terminates.
+          */
+         if (!wait && pq->nr_polls++ == 0)
+            return FALSE;
+
          llvmpipe_flush(pipe, NULL, __FUNCTION__);
-         
-      if (!wait)
+      }
+
+      if (!wait && !lp_fence_signalled(pq->fence))
          return FALSE;
 
       lp_fence_wait(pq->fence);
@@ -134,6 +154,7 @@ llvmpipe_begin_query(struct pipe_context *pipe, struct pipe_query *q)
 
 
    memset(pq->count, 0, sizeof(pq->count));
+   pq->nr_polls = 0;
    lp_setup_begin_query(llvmpipe->setup, pq);
 
    llvmpipe->active_query_count++;
@@ -154,17 +175,49 @@ llvmpipe_end_query(struct pipe_context *pipe, struct pipe_query *q)
    llvmpipe->dirty |= LP_NEW_QUERY;
 }
 
+/**
+ * Check the render condition before a draw or clear.
+ *
+ * \param by_tile  whether the rasterizer may evaluate the condition
+ *                 (draws only)
+ * \return  FALSE if the operation must be skipped
+ */
 boolean
-llvmpipe_check_render_cond(struct llvmpipe_context *lp)
+llvmpipe_check_render_cond(struct llvmpipe_context *lp, boolean by_tile)
 {
    struct pipe_context *pipe = &lp->pipe;
-   boolean b, wait;
+   struct llvmpipe_query *pq = llvmpipe_query(lp->render_cond_query);
+   boolean b, wait, by_region;
    uint64_t result;
 
-   if (!lp->render_cond_query)
+   if (by_tile)
+      lp_setup_set_render_condition(lp->setup, NULL);
+
+   if (!pq)
       return TRUE; /* no query predicate, draw normally */
    wait = (lp->render_cond_mode == PIPE_RENDER_COND_WAIT ||
            lp->render_cond_mode == PIPE_RENDER_COND_BY_REGION_WAIT);
+   by_region = (lp->render_cond_mode == PIPE_RENDER_COND_BY_REGION_WAIT ||
+                lp->render_cond_mode == PIPE_RENDER_COND_BY_REGION_NO_WAIT);
+
+   if (pq->fence && !lp_fence_issued(pq->fence)) {
+      /* The result is only known after the scene is rasterized.  Rather
+       * than flushing, let the rasterizer discard the draw in the tiles
+       * where the query saw no samples, as the by-region modes permit.
+       */
+      if (by_region && by_tile &&
+          lp_setup_query_in_scene(lp->setup, pq)) {
+         if (!pq->tile_visible)
+            pq->tile_visible = CALLOC(TILES_X * TILES_Y, sizeof(uint8_t));
+         if (pq->tile_visible) {
+            lp_setup_set_render_condition(lp->setup, pq);
+            return TRUE;
+         }
+      }
+
+      if (!wait)
+         return TRUE; /* result not available, draw normally */
+   }
 
    b = pipe->get_query_result(pipe, lp->render_cond_query, wait, &result);
    if (b)
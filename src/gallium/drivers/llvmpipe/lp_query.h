@@ -44,11 +44,23 @@ struct llvmpipe_context;
 struct llvmpipe_query {
    uint64_t count[LP_MAX_THREADS];  /**< a counter for each thread */
    struct lp_fence *fence;      /* fence from last scene this was binned in */
+   struct lp_fence *begin_fence;  /* fence of the scene this was begun in */
+
+   /** Polls for the result since the query was begun */
+   unsigned nr_polls;
+
+   /**
+    * Whether any sample passed in each tile, written by the rasterizer
+    * when the query ends.  Only allocated once the query is used as a
+    * render condition evaluated per tile.
+    */
+   uint8_t *tile_visible;
 };
 
 
 extern void llvmpipe_init_query_funcs(struct llvmpipe_context * );
 
-extern boolean llvmpipe_check_render_cond(struct llvmpipe_context *);
+extern boolean llvmpipe_check_render_cond(struct llvmpipe_context *,
+                                          boolean by_tile);
 
 #endif /* LP_QUERY_H */
@@ -31,6 +31,8 @@
 #include "util/u_rect.h"
 #include "util/u_surface.h"
 #include "util/u_pack_color.h"
+#include "util/u_string.h"
+#include "os/os_time.h"
 
 #include "lp_scene_queue.h"
 #include "lp_debug.h"
@@ -101,6 +103,7 @@ lp_rast_tile_begin(struct lp_rasterizer_task *task,
    task->bin = bin;
    task->x = bin->x * TILE_SIZE;
    task->y = bin->y * TILE_SIZE;
+   task->cond_discard = FALSE;
 
    /* reset pointers to color tile(s) */
    memset(task->color_tiles, 0, sizeof(task->color_tiles));
@@ -195,7 +198,7 @@ lp_rast_clear_color(struct lp_rasterizer_task *task,
       }
    }
 
-   LP_COUNT(nr_color_tile_clear);
+   LP_RAST_COUNT(task, nr_color_tile_clear);
 }
 
 
@@ -313,11 +316,17 @@ lp_rast_store_linear_color( struct lp_rasterizer_task *task )
       if (!task->color_tiles[buf])
          continue;
 
+      LP_RAST_COUNT(task, nr_color_tile_store);
+
       llvmpipe_unswizzle_cbuf_tile(lpt,
                                    layer,
                                    level,
                                    task->x, task->y,
                                    task->color_tiles[buf]);
+
+      /* remember the tile changed, for partial presents */
+      if (lpt->dt)
+         util_damage_tile(&lpt->damage, task->bin->x, task->bin->y);
    }
 }
 
@@ -332,12 +341,8 @@ static void
 lp_rast_shade_tile(struct lp_rasterizer_task *task,
                    const union lp_rast_cmd_arg arg)
 {
-   const struct lp_scene *scene = task->scene;
    const struct lp_rast_shader_inputs *inputs = arg.shade_tile;
    const struct lp_rast_state *state;
-   struct lp_fragment_shader_variant *variant;
-   const unsigned tile_x = task->x, tile_y = task->y;
-   unsigned x, y;
 
    if (inputs->disable) {
       /* This command was partially binned and has been disabled */
@@ -351,38 +356,9 @@ lp_rast_shade_tile(struct lp_rasterizer_task *task,
    if (!state) {
       return;
    }
-   variant = state->variant;
-
-   /* render the whole 64x64 tile in 4x4 chunks */
-   for (y = 0; y < TILE_SIZE; y += 4){
-      for (x = 0; x < TILE_SIZE; x += 4) {
-         uint8_t *color[PIPE_MAX_COLOR_BUFS];
-         uint32_t *depth;
-         unsigned i;
-
-         /* color buffer */
-         for (i = 0; i < scene->fb.nr_cbufs; i++)
-            color[i] = lp_rast_get_color_block_pointer(task, i,
-                                                       tile_x + x, tile_y + y);
-
-         /* depth buffer */
-         depth = lp_rast_get_depth_block_pointer(task, tile_x + x, tile_y + y);
-
-         /* run shader on 4x4 block */
-         BEGIN_JIT_CALL(state, task);
-         variant->jit_function[RAST_WHOLE]( &state->jit_context,
-                                            tile_x + x, tile_y + y,
-                                            inputs->frontfacing,
-                                            GET_A0(inputs),
-                                            GET_DADX(inputs),
-                                            GET_DADY(inputs),
-                                            color,
-                                            depth,
-                                            0xffff,
-                                            &task->vis_counter);
-         END_JIT_CALL();
-      }
-   }
+
+   /* render the whole 64x64 tile in one go */
+   lp_rast_shade_blocks_all(task, inputs, task->x, task->y, TILE_SIZE);
 }
 
 
@@ -456,6 +432,8 @@ lp_rast_shade_quads_mask(struct lp_rasterizer_task *task,
 
    assert(lp_check_alignment(state->jit_context.blend_color, 16));
 
+   LP_RAST_COUNT(task, nr_shade_4);
+
    /* run shader on 4x4 block */
    BEGIN_JIT_CALL(state, task);
    variant->jit_function[RAST_EDGE_TEST](&state->jit_context,
@@ -501,7 +479,15 @@ lp_rast_end_query(struct lp_rasterizer_task *task,
 {
    assert(task->query);
    if (task->query) {
-      task->query->count[task->thread_index] += task->vis_counter;
+      struct llvmpipe_query *pq = task->query;
+
+      pq->count[task->thread_index] += task->vis_counter;
+
+      if (pq->tile_visible) {
+         const struct cmd_bin *bin = task->bin;
+         pq->tile_visible[bin->y * TILES_X + bin->x] = task->vis_counter != 0;
+      }
+
       task->query = NULL;
    }
 }
@@ -511,7 +497,21 @@ void
 lp_rast_set_state(struct lp_rasterizer_task *task,
                   const union lp_rast_cmd_arg arg)
 {
+   const struct llvmpipe_query *cond;
+
    task->state = arg.state;
+
+   /* The query ended earlier in this bin, so its result for the tile is
+    * known already.
+    */
+   cond = task->state->render_cond;
+   if (cond) {
+      const struct cmd_bin *bin = task->bin;
+      task->cond_discard = !cond->tile_visible[bin->y * TILES_X + bin->x];
+   }
+   else {
+      task->cond_discard = FALSE;
+   }
 }
 
 
@@ -643,7 +643,15 @@ do_rasterize_bin(struct lp_rasterizer_task *task,
 
    for (block = bin->head; block; block = block->next) {
       for (k = 0; k < block->count; k++) {
-         dispatch[block->cmd[k]]( task, block->arg[k] );
+         const unsigned cmd = block->cmd[k];
+
+         if (task->cond_discard &&
+             cmd >= LP_RAST_OP_TRIANGLE_1 &&
+             cmd <= LP_RAST_OP_SHADE_TILE_OPAQUE) {
+            continue;
+         }
+
+         dispatch[cmd]( task, block->arg[k] );
       }
    }
 }
@@ -671,9 +679,9 @@ rasterize_bin(struct lp_rasterizer_task *task,
     */
    if (bin->head->count == 1) {
       if (bin->head->cmd[0] == LP_RAST_OP_SHADE_TILE_OPAQUE)
-         LP_COUNT(nr_pure_shade_opaque_64);
+         LP_RAST_COUNT(task, nr_pure_shade_opaque_64);
       else if (bin->head->cmd[0] == LP_RAST_OP_SHADE_TILE)
-         LP_COUNT(nr_pure_shade_64);
+         LP_RAST_COUNT(task, nr_pure_shade_64);
    }
 }
 
@@ -714,13 +722,26 @@ rasterize_scene(struct lp_rasterizer_task *task,
    }
 #else
    {
+      const boolean trace = lp_trace_enabled();
       struct cmd_bin *bin;
+      int64_t start = os_time_get();
 
       assert(scene);
       while ((bin = lp_scene_bin_iter_next(scene))) {
-         if (!is_empty_bin( bin ))
+         if (!is_empty_bin( bin )) {
+            int64_t bin_start = trace ? os_time_get() : 0;
+
             rasterize_bin(task, bin);
+            LP_RAST_COUNT(task, nr_bins);
+
+            if (trace)
+               lp_trace_bin(LP_TRACE_RAST_TID(task->thread_index),
+                            bin->x, bin->y, bin_start, os_time_get());
+         }
       }
+
+      LP_RAST_COUNT(task, nr_scenes);
+      LP_RAST_COUNT_ADD(task, rast_time, os_time_get() - start);
    }
 #endif
 
@@ -756,6 +777,9 @@ lp_rast_queue_scene( struct lp_rasterizer *rast,
       /* threaded rendering! */
       unsigned i;
 
+      if (lp_trace_enabled())
+         scene->queue_time = os_time_get();
+
       lp_scene_enqueue( rast->full_scenes, scene );
 
       /* signal the threads that there's work to do */
@@ -797,6 +821,7 @@ static PIPE_THREAD_ROUTINE( thread_func, init_data )
    struct lp_rasterizer_task *task = (struct lp_rasterizer_task *) init_data;
    struct lp_rasterizer *rast = task->rast;
    boolean debug = false;
+   int64_t t0;
 
    while (1) {
       /* wait for work */
@@ -812,14 +837,21 @@ static PIPE_THREAD_ROUTINE( thread_func, init_data )
           *  - get next scene to rasterize
           *  - map the framebuffer surfaces
           */
-         lp_rast_begin( rast, 
-                        lp_scene_dequeue( rast->full_scenes, TRUE ) );
+         struct lp_scene *scene = lp_scene_dequeue( rast->full_scenes, TRUE );
+
+         if (lp_trace_enabled())
+            lp_trace_span(LP_TRACE_RAST_TID(0), "queued",
+                          scene->queue_time, os_time_get());
+
+         lp_rast_begin( rast, scene );
       }
 
       /* Wait for all threads to get here so that threads[1+] don't
        * get a null rast->curr_scene pointer.
        */
+      t0 = os_time_get();
       pipe_barrier_wait( &rast->barrier );
+      LP_RAST_COUNT_ADD(task, wait_time, os_time_get() - t0);
 
       /* do work */
       if (debug)
@@ -829,7 +861,13 @@ static PIPE_THREAD_ROUTINE( thread_func, init_data )
                       rast->curr_scene);
       
       /* wait for all threads to finish with this scene */
+      t0 = os_time_get();
       pipe_barrier_wait( &rast->barrier );
+      LP_RAST_COUNT_ADD(task, wait_time, os_time_get() - t0);
+
+      if (lp_trace_enabled())
+         lp_trace_span(LP_TRACE_RAST_TID(task->thread_index), "wait",
+                       t0, os_time_get());
 
       /* XXX: shouldn't be necessary:
        */
@@ -894,6 +932,14 @@ lp_rast_create( unsigned num_threads )
       task->thread_index = i;
    }
 
+   if (lp_trace_enabled()) {
+      for (i = 0; i < MAX2(1, num_threads); i++) {
+         char name[32];
+         util_snprintf(name, sizeof name, "rasterizer %u", i);
+         lp_trace_thread_name(LP_TRACE_RAST_TID(i), name);
+      }
+   }
+
    rast->num_threads = num_threads;
 
    create_rast_threads(rast);
@@ -949,6 +995,23 @@ void lp_rast_destroy( struct lp_rasterizer *rast )
 }
 
 
+/**
+ * Add the counters of the rasterizer threads to lp_count and reset them.
+ * Must be called with the rasterizer idle, i.e., after lp_rast_finish().
+ */
+void
+lp_rast_accumulate_counters( struct lp_rasterizer *rast )
+{
+   unsigned i;
+
+   for (i = 0; i < MAX2(1, rast->num_threads); i++) {
+      struct lp_rasterizer_task *task = &rast->tasks[i];
+      lp_accumulate_rast_counters(i, &task->counters);
+      memset(&task->counters, 0, sizeof task->counters);
+   }
+}
+
+
 /** Return number of rasterization threads */
 unsigned
 lp_rast_get_num_threads( struct lp_rasterizer *rast )
@@ -69,6 +69,10 @@ struct lp_rast_state {
     * the tile color/z/stencil data somehow
      */
    struct lp_fragment_shader_variant *variant;
+
+   /* Query whose per-tile result predicates the draws, or NULL.
+    */
+   const struct llvmpipe_query *render_cond;
 };
 
 
@@ -144,6 +148,9 @@ lp_rast_queue_scene( struct lp_rasterizer *rast,
 void
 lp_rast_finish( struct lp_rasterizer *rast );
 
+void
+lp_rast_accumulate_counters( struct lp_rasterizer *rast );
+
 
 union lp_rast_cmd_arg {
    const struct lp_rast_shader_inputs *shade_tile;
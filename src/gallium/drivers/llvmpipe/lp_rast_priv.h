@@ -38,6 +38,7 @@
 #include "lp_texture.h"
 #include "lp_tile_soa.h"
 #include "lp_limits.h"
+#include "lp_perf.h"
 
 
 /* If we crash in a jitted function, we can examine jit_line and jit_state
@@ -98,6 +99,12 @@ struct lp_rasterizer_task
    uint32_t vis_counter;
    struct llvmpipe_query *query;
 
+   /** The render condition failed in this tile: skip the draw commands */
+   boolean cond_discard;
+
+   /** Only touched by this thread, see lp_accumulate_rast_counters() */
+   struct lp_rast_counters counters;
+
    pipe_semaphore work_ready;
    pipe_semaphore work_done;
 };
@@ -197,6 +204,7 @@ lp_rast_get_color_tile_pointer(struct lp_rasterizer_task *task,
       task->color_tiles[buf] = lp_swizzled_cbuf[task->thread_index][buf];
 
       if (usage != LP_TEX_USAGE_WRITE_ALL) {
+         LP_RAST_COUNT(task, nr_color_tile_load);
          llvmpipe_swizzle_cbuf_tile(lpt,
                                     cbuf->u.tex.first_layer,
                                     cbuf->u.tex.level,
@@ -266,6 +274,8 @@ lp_rast_shade_quads_all( struct lp_rasterizer_task *task,
 
    depth = lp_rast_get_depth_block_pointer(task, x, y);
 
+   LP_RAST_COUNT(task, nr_shade_4);
+
    /* run shader on 4x4 block */
    BEGIN_JIT_CALL(state, task);
    variant->jit_function[RAST_WHOLE]( &state->jit_context,
@@ -281,6 +291,53 @@ lp_rast_shade_quads_all( struct lp_rasterizer_task *task,
    END_JIT_CALL();
 }
 
+/**
+ * Shade all pixels in a size x size run of 4x4 blocks (a whole tile, or a
+ * 16x16 block), with a single call to the fragment shader.  The fragment
+ * code omits the triangle in/out tests.
+ * \param x, y location of the run in window coords
+ */
+static INLINE void
+lp_rast_shade_blocks_all( struct lp_rasterizer_task *task,
+                          const struct lp_rast_shader_inputs *inputs,
+                          unsigned x, unsigned y, unsigned size )
+{
+   const struct lp_scene *scene = task->scene;
+   const struct lp_rast_state *state = task->state;
+   struct lp_fragment_shader_variant *variant = state->variant;
+   uint8_t *color[PIPE_MAX_COLOR_BUFS];
+   void *depth;
+   unsigned depth_stride;
+   unsigned i;
+
+   assert(size % TILE_VECTOR_WIDTH == 0);
+   assert(x % TILE_SIZE + size <= TILE_SIZE);
+   assert(y % TILE_SIZE + size <= TILE_SIZE);
+
+   /* color buffer */
+   for (i = 0; i < scene->fb.nr_cbufs; i++)
+      color[i] = lp_rast_get_color_block_pointer(task, i, x, y);
+
+   depth = lp_rast_get_depth_block_pointer(task, x, y);
+   depth_stride = scene->zsbuf.map ? scene->zsbuf.stride * TILE_VECTOR_HEIGHT : 0;
+
+   LP_RAST_COUNT_ADD(task, nr_shade_4, (size / 4) * (size / 4));
+
+   BEGIN_JIT_CALL(state, task);
+   variant->jit_tile_function( &state->jit_context,
+                               x, y,
+                               inputs->frontfacing,
+                               GET_A0(inputs),
+                               GET_DADX(inputs),
+                               GET_DADY(inputs),
+                               color,
+                               depth,
+                               depth_stride,
+                               size,
+                               &task->vis_counter );
+   END_JIT_CALL();
+}
+
 void lp_rast_triangle_1( struct lp_rasterizer_task *, 
                          const union lp_rast_cmd_arg );
 void lp_rast_triangle_2( struct lp_rasterizer_task *, 
@@ -59,12 +59,9 @@ block_full_16(struct lp_rasterizer_task *task,
               const struct lp_rast_triangle *tri,
               int x, int y)
 {
-   unsigned ix, iy;
    assert(x % 16 == 0);
    assert(y % 16 == 0);
-   for (iy = 0; iy < 16; iy += 4)
-      for (ix = 0; ix < 16; ix += 4)
-	 block_full_4(task, tri, x + ix, y + iy);
+   lp_rast_shade_blocks_all(task, &tri->inputs, x, y, 16);
 }
 
 #if !defined(PIPE_ARCH_SSE)
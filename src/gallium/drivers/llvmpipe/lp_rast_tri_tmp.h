@@ -106,7 +106,7 @@ TAG(do_block_16)(struct lp_rasterizer_task *task,
 
    assert((partial_mask & inmask) == 0);
 
-   LP_COUNT_ADD(nr_empty_4, util_bitcount(0xffff & ~(partial_mask | inmask)));
+   LP_RAST_COUNT_ADD(task, nr_empty_4, util_bitcount(0xffff & ~(partial_mask | inmask)));
 
    /* Iterate over partials:
     */
@@ -120,7 +120,7 @@ TAG(do_block_16)(struct lp_rasterizer_task *task,
 
       partial_mask &= ~(1 << i);
 
-      LP_COUNT(nr_partially_covered_4);
+      LP_RAST_COUNT(task, nr_partially_covered_4);
 
       for (j = 0; j < NR_PLANES; j++)
          cx[j] = (c[j] 
@@ -141,7 +141,7 @@ TAG(do_block_16)(struct lp_rasterizer_task *task,
 
       inmask &= ~(1 << i);
 
-      LP_COUNT(nr_fully_covered_4);
+      LP_RAST_COUNT(task, nr_fully_covered_4);
       block_full_4(task, tri, px, py);
    }
 }
@@ -209,7 +209,7 @@ TAG(lp_rast_triangle)(struct lp_rasterizer_task *task,
 
    assert((partial_mask & inmask) == 0);
 
-   LP_COUNT_ADD(nr_empty_16, util_bitcount(0xffff & ~(partial_mask | inmask)));
+   LP_RAST_COUNT_ADD(task, nr_empty_16, util_bitcount(0xffff & ~(partial_mask | inmask)));
 
    /* Iterate over partials:
     */
@@ -228,7 +228,7 @@ TAG(lp_rast_triangle)(struct lp_rasterizer_task *task,
 
       partial_mask &= ~(1 << i);
 
-      LP_COUNT(nr_partially_covered_16);
+      LP_RAST_COUNT(task, nr_partially_covered_16);
       TAG(do_block_16)(task, tri, plane, px, py, cx);
    }
 
@@ -243,7 +243,7 @@ TAG(lp_rast_triangle)(struct lp_rasterizer_task *task,
 
       inmask &= ~(1 << i);
 
-      LP_COUNT(nr_fully_covered_16);
+      LP_RAST_COUNT(task, nr_fully_covered_16);
       block_full_16(task, tri, px, py);
    }
 }
@@ -41,6 +41,7 @@
 /** List of resource references */
 struct resource_ref {
    struct pipe_resource *resource[RESOURCE_REF_SZ];
+   unsigned level_mask[RESOURCE_REF_SZ];  /**< mipmap levels read */
    int count;
    struct resource_ref *next;
 };
@@ -148,7 +149,7 @@ lp_scene_begin_rasterization(struct lp_scene *scene)
       scene->cbufs[i].map = llvmpipe_resource_map(cbuf->texture,
                                                   cbuf->u.tex.level,
                                                   cbuf->u.tex.first_layer,
-                                                  LP_TEX_USAGE_READ_WRITE,
+                                                  LP_TEX_USAGE_RENDER,
                                                   LP_TEX_LAYOUT_LINEAR);
    }
 
@@ -230,6 +231,7 @@ lp_scene_end_rasterization(struct lp_scene *scene )
                             ref->resource[i]->height0,
                             llvmpipe_resource_size(ref->resource[i]));
             j++;
+            llvmpipe_resource_scene_unref(llvmpipe_resource(ref->resource[i]));
             pipe_resource_reference(&ref->resource[i], NULL);
          }
       }
@@ -336,10 +338,12 @@ lp_scene_data_size( const struct lp_scene *scene )
 
 /**
  * Add a reference to a resource by the scene.
+ * \param level_mask  bitmask of the mipmap levels the scene reads
  */
 boolean
 lp_scene_add_resource_reference(struct lp_scene *scene,
                                 struct pipe_resource *resource,
+                                unsigned level_mask,
                                 boolean initializing_scene)
 {
    struct resource_ref *ref, **last = &scene->resources;
@@ -352,9 +356,12 @@ lp_scene_add_resource_reference(struct lp_scene *scene,
 
       /* Search for this resource:
        */
-      for (i = 0; i < ref->count; i++)
-         if (ref->resource[i] == resource)
+      for (i = 0; i < ref->count; i++) {
+         if (ref->resource[i] == resource) {
+            ref->level_mask[i] |= level_mask;
             return TRUE;
+         }
+      }
 
       if (ref->count < RESOURCE_REF_SZ) {
          /* If the block is half-empty, then append the reference here.
@@ -377,7 +384,9 @@ lp_scene_add_resource_reference(struct lp_scene *scene,
 
    /* Append the reference to the reference block.
     */
+   ref->level_mask[ref->count] = level_mask;
    pipe_resource_reference(&ref->resource[ref->count++], resource);
+   llvmpipe_resource_scene_ref(llvmpipe_resource(resource));
    scene->resource_reference_size += llvmpipe_resource_size(resource);
 
    /* Heuristic to advise scene flushes.  This isn't helpful in the
@@ -394,11 +403,12 @@ lp_scene_add_resource_reference(struct lp_scene *scene,
 
 
 /**
- * Does this scene have a reference to the given resource?
+ * Does this scene read the given mipmap level of the resource?
  */
 boolean
 lp_scene_is_resource_referenced(const struct lp_scene *scene,
-                                const struct pipe_resource *resource)
+                                const struct pipe_resource *resource,
+                                unsigned level)
 {
    const struct resource_ref *ref;
    int i;
@@ -406,7 +416,7 @@ lp_scene_is_resource_referenced(const struct lp_scene *scene,
    for (ref = scene->resources; ref; ref = ref->next) {
       for (i = 0; i < ref->count; i++)
          if (ref->resource[i] == resource)
-            return TRUE;
+            return (ref->level_mask[i] & (1 << level)) != 0;
    }
 
    return FALSE;
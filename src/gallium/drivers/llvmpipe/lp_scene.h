@@ -168,6 +168,10 @@ struct lp_scene {
    int curr_x, curr_y;  /**< for iterating over bins */
    pipe_mutex mutex;
 
+   /** When binning started and when the scene was queued, for LP_TRACE */
+   int64_t binning_time;
+   int64_t queue_time;
+
    struct cmd_bin tile[TILES_X][TILES_Y];
    struct data_block_list data;
 };
@@ -189,10 +193,12 @@ struct cmd_block *lp_scene_new_cmd_block( struct lp_scene *scene,
 
 boolean lp_scene_add_resource_reference(struct lp_scene *scene,
                                         struct pipe_resource *resource,
+                                        unsigned level_mask,
                                         boolean initializing_scene);
 
 boolean lp_scene_is_resource_referenced(const struct lp_scene *scene,
-                                        const struct pipe_resource *resource );
+                                        const struct pipe_resource *resource,
+                                        unsigned level);
 
 
 /**
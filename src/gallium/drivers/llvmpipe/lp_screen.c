@@ -44,6 +44,7 @@
 #include "lp_debug.h"
 #include "lp_public.h"
 #include "lp_limits.h"
+#include "lp_perf.h"
 #include "lp_rast.h"
 
 #include "state_tracker/sw_winsys.h"
@@ -66,6 +67,7 @@ static const struct debug_named_value lp_debug_flags[] = {
    { "fence", DEBUG_FENCE, NULL },
    { "mem", DEBUG_MEM, NULL },
    { "fs", DEBUG_FS, NULL },
+   { "jit", DEBUG_JIT, NULL },
    DEBUG_NAMED_VALUE_END
 };
 #endif
@@ -80,6 +82,8 @@ static const struct debug_named_value lp_perf_flags[] = {
    { "no_blend",       PERF_NO_BLEND, NULL },
    { "no_depth",       PERF_NO_DEPTH, NULL },
    { "no_alphatest",   PERF_NO_ALPHATEST, NULL },
+   { "counters",       PERF_COUNTERS, NULL },
+   { "no_tex_tiling",  PERF_NO_TEX_TILING, NULL },
    DEBUG_NAMED_VALUE_END
 };
 
@@ -113,7 +117,7 @@ llvmpipe_get_param(struct pipe_screen *screen, enum pipe_cap param)
    case PIPE_CAP_SM3:
       return 1;
    case PIPE_CAP_ANISOTROPIC_FILTER:
-      return 0;
+      return 1;
    case PIPE_CAP_POINT_SPRITE:
       return 1;
    case PIPE_CAP_MAX_RENDER_TARGETS:
@@ -202,7 +206,7 @@ llvmpipe_get_paramf(struct pipe_screen *screen, enum pipe_capf param)
    case PIPE_CAPF_MAX_POINT_WIDTH_AA:
       return 255.0; /* arbitrary */
    case PIPE_CAPF_MAX_TEXTURE_ANISOTROPY:
-      return 16.0; /* not actually signficant at this time */
+      return (float) LP_MAX_ANISOTROPY;
    case PIPE_CAPF_MAX_TEXTURE_LOD_BIAS:
       return 16.0; /* arbitrary */
    case PIPE_CAPF_GUARD_BAND_LEFT:
@@ -311,8 +315,19 @@ llvmpipe_flush_frontbuffer(struct pipe_screen *_screen,
    struct llvmpipe_resource *texture = llvmpipe_resource(resource);
 
    assert(texture->dt);
-   if (texture->dt)
-      winsys->displaytarget_display(winsys, texture->dt, context_private);
+   if (texture->dt) {
+      struct pipe_box boxes[UTIL_DAMAGE_MAX_BOXES];
+      unsigned num_boxes;
+
+      /* write the tiles which were fast cleared but not rendered to */
+      llvmpipe_resolve_fast_clears(texture);
+
+      num_boxes = util_damage_get_boxes(&texture->damage, boxes,
+                                        Elements(boxes));
+
+      winsys->displaytarget_display(winsys, texture->dt, context_private,
+                                    boxes, num_boxes);
+   }
 }
 
 
@@ -403,6 +418,8 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
 
    LP_PERF = debug_get_flags_option("LP_PERF", lp_perf_flags, 0 );
 
+   lp_trace_init();
+
    screen = CALLOC_STRUCT(llvmpipe_screen);
    if (!screen)
       return NULL;
@@ -39,6 +39,7 @@
 #include "util/u_inlines.h"
 #include "util/u_memory.h"
 #include "util/u_pack_color.h"
+#include "os/os_time.h"
 #include "draw/draw_pipe.h"
 #include "lp_context.h"
 #include "lp_memory.h"
@@ -47,6 +48,7 @@
 #include "lp_debug.h"
 #include "lp_fence.h"
 #include "lp_query.h"
+#include "lp_perf.h"
 #include "lp_rast.h"
 #include "lp_setup_context.h"
 #include "lp_screen.h"
@@ -81,7 +83,9 @@ lp_setup_get_empty_scene(struct lp_setup_context *setup)
    }
 
    lp_scene_begin_binning(setup->scene, &setup->fb);
-   
+
+   if (lp_trace_enabled())
+      setup->scene->binning_time = os_time_get();
 }
 
 
@@ -147,6 +151,7 @@ lp_setup_rasterize_scene( struct lp_setup_context *setup )
 {
    struct lp_scene *scene = setup->scene;
    struct llvmpipe_screen *screen = llvmpipe_screen(scene->pipe->screen);
+   int64_t t0, t1;
 
    lp_scene_end_binning(scene);
 
@@ -155,11 +160,24 @@ lp_setup_rasterize_scene( struct lp_setup_context *setup )
    if (setup->last_fence)
       setup->last_fence->issued = TRUE;
 
+   t0 = os_time_get();
+
    pipe_mutex_lock(screen->rast_mutex);
+   setup->rasterizing = TRUE;
    lp_rast_queue_scene(screen->rast, scene);
    lp_rast_finish(screen->rast);
+   lp_rast_accumulate_counters(screen->rast);
+   setup->rasterizing = FALSE;
    pipe_mutex_unlock(screen->rast_mutex);
 
+   t1 = os_time_get();
+   LP_COUNT_ADD(finish_time, t1 - t0);
+
+   if (lp_trace_enabled()) {
+      lp_trace_span(LP_TRACE_SETUP_TID, "binning", scene->binning_time, t0);
+      lp_trace_span(LP_TRACE_SETUP_TID, "rasterize", t0, t1);
+   }
+
    lp_scene_end_rasterization(setup->scene);
    lp_setup_reset( setup );
 
@@ -168,6 +186,81 @@ lp_setup_rasterize_scene( struct lp_setup_context *setup )
 
 
 
+/**
+ * Whether the surface is a whole 2D image of its texture, which the
+ * framebuffer covers entirely.
+ */
+static boolean
+is_whole_image( const struct pipe_surface *surf,
+                const struct pipe_framebuffer_state *fb )
+{
+   const struct llvmpipe_resource *lpr =
+      llvmpipe_resource_const(surf->texture);
+   const unsigned level = surf->u.tex.level;
+
+   return (surf->u.tex.first_layer < lpr->num_slices_faces[level] &&
+           u_minify(surf->texture->width0, level) == fb->width &&
+           u_minify(surf->texture->height0, level) == fb->height);
+}
+
+
+/**
+ * Turn the pending clears into fast clears of the resources, where
+ * possible, rather than binning clear commands into every tile.  The
+ * clear values are then only written to the tiles which the rasterizer,
+ * transfers or presents access.
+ * The clears which can't be done that way are left in setup->clear.
+ */
+static void
+execute_fast_clears( struct lp_setup_context *setup )
+{
+   const struct pipe_framebuffer_state *fb = &setup->fb;
+   unsigned i;
+
+   if (setup->clear.flags & PIPE_CLEAR_COLOR) {
+      boolean fast = TRUE;
+      uint32_t clear_value;
+
+      memcpy(&clear_value, setup->clear.color.clear_color,
+             sizeof clear_value);
+
+      for (i = 0; i < fb->nr_cbufs; i++) {
+         if (!is_whole_image(fb->cbufs[i], fb))
+            fast = FALSE;
+      }
+
+      for (i = 0; i < fb->nr_cbufs && fast; i++) {
+         struct pipe_surface *cbuf = fb->cbufs[i];
+         fast = llvmpipe_fast_clear_image(llvmpipe_resource(cbuf->texture),
+                                          cbuf->u.tex.first_layer,
+                                          cbuf->u.tex.level,
+                                          clear_value);
+      }
+
+      if (fast)
+         setup->clear.flags &= ~PIPE_CLEAR_COLOR;
+   }
+
+   if ((setup->clear.flags & PIPE_CLEAR_DEPTHSTENCIL) && fb->zsbuf) {
+      struct pipe_surface *zsbuf = fb->zsbuf;
+      const enum pipe_format format = zsbuf->format;
+
+      /* only clears of all the bits can be done lazily */
+      if (setup->clear.zsmask == util_pack_mask_z_stencil(format, ~0, 0xff) &&
+          util_format_get_blocksize(format) <= 4 &&
+          is_whole_image(zsbuf, fb) &&
+          llvmpipe_fast_clear_image(llvmpipe_resource(zsbuf->texture),
+                                    zsbuf->u.tex.first_layer,
+                                    zsbuf->u.tex.level,
+                                    setup->clear.zsvalue)) {
+         setup->clear.flags &= ~PIPE_CLEAR_DEPTHSTENCIL;
+         setup->clear.zsmask = 0;
+         setup->clear.zsvalue = 0;
+      }
+   }
+}
+
+
 static boolean
 begin_binning( struct lp_setup_context *setup )
 {
@@ -198,6 +291,9 @@ begin_binning( struct lp_setup_context *setup )
    if (!ok)
       return FALSE;
 
+   if (setup->clear.flags)
+      execute_fast_clears(setup);
+
    if (setup->fb.zsbuf &&
        ((setup->clear.flags & PIPE_CLEAR_DEPTHSTENCIL) != PIPE_CLEAR_DEPTHSTENCIL) &&
         util_format_is_depth_and_stencil(setup->fb.zsbuf->format))
@@ -250,9 +346,8 @@ begin_binning( struct lp_setup_context *setup )
 
 
 /* This basically bins and then flushes any outstanding full-screen
- * clears.  
- *
- * TODO: fast path for fullscreen clears and no triangles.
+ * clears.  Most of them become fast clears in begin_binning(), in which
+ * case nothing is binned and the scene is empty.
  */
 static boolean
 execute_clears( struct lp_setup_context *setup )
@@ -661,14 +756,25 @@ lp_setup_set_fragment_sampler_views(struct lp_setup_context *setup,
           * reference to it.
           */
          pipe_resource_reference(&setup->fs.current_tex[i], tex);
+         setup->fs.current_tex_levels[i] =
+            ((2 << tex->last_level) - 1) &
+            ~((1 << view->u.tex.first_level) - 1);
 
          if (!lp_tex->dt) {
             /* regular texture - setup array of mipmap level pointers */
             int j;
             for (j = view->u.tex.first_level; j <= tex->last_level; j++) {
-               jit_tex->data[j] =
-                  llvmpipe_get_texture_image_all(lp_tex, j, LP_TEX_USAGE_READ,
-                                                 LP_TEX_LAYOUT_LINEAR);
+               if (lp_tex->sampler_tiled) {
+                  /* tiled copy, see the key's lp_sampler_static_state */
+                  jit_tex->data[j] =
+                     llvmpipe_get_texture_sampler_image(lp_tex, j);
+               }
+               else {
+                  jit_tex->data[j] =
+                     llvmpipe_get_texture_image_all(lp_tex, j,
+                                                    LP_TEX_USAGE_READ,
+                                                    LP_TEX_LAYOUT_LINEAR);
+               }
                jit_tex->row_stride[j] = lp_tex->row_stride[j];
                jit_tex->img_stride[j] = lp_tex->img_stride[j];
 
@@ -739,28 +845,69 @@ lp_setup_set_fragment_sampler_state(struct lp_setup_context *setup,
 
 
 /**
- * Is the given texture referenced by any scene?
+ * Does the surface cover the given level and layer (-1 for any layer)?
+ */
+static boolean
+surface_overlaps(const struct pipe_surface *surf,
+                 const struct pipe_resource *texture,
+                 unsigned level, int layer)
+{
+   if (!surf || surf->texture != texture)
+      return FALSE;
+
+   if (surf->u.tex.level != level)
+      return FALSE;
+
+   return layer < 0 ||
+          ((unsigned) layer >= surf->u.tex.first_layer &&
+           (unsigned) layer <= surf->u.tex.last_layer);
+}
+
+
+/**
+ * Whether the rasterizer is executing one of this context's scenes.
+ * Code and state the bins refer to must not change meanwhile.
+ */
+boolean
+lp_setup_is_rasterizing( const struct lp_setup_context *setup )
+{
+   return setup->rasterizing;
+}
+
+
+/**
+ * Is the given level/layer (-1 for all layers) of the texture referenced
+ * by any scene?
  * Note: we have to check all scenes including any scenes currently
  * being rendered and the current scene being built.
+ *
+ * Only the images the pending rendering actually touches are reported,
+ * so that mapping other mipmap levels or layers of a texture in use, or
+ * reading a texture which is only sampled, doesn't flush the scene.
  */
 unsigned
 lp_setup_is_resource_referenced( const struct lp_setup_context *setup,
-                                const struct pipe_resource *texture )
+                                const struct pipe_resource *texture,
+                                unsigned level, int layer )
 {
    unsigned i;
 
-   /* check the render targets */
-   for (i = 0; i < setup->fb.nr_cbufs; i++) {
-      if (setup->fb.cbufs[i]->texture == texture)
+   /* check the render targets, which only have pending writes while
+    * there is a scene (or a deferred clear) to rasterize
+    */
+   if (setup->state != SETUP_FLUSHED) {
+      for (i = 0; i < setup->fb.nr_cbufs; i++) {
+         if (surface_overlaps(setup->fb.cbufs[i], texture, level, layer))
+            return LP_REFERENCED_FOR_READ | LP_REFERENCED_FOR_WRITE;
+      }
+      if (surface_overlaps(setup->fb.zsbuf, texture, level, layer)) {
          return LP_REFERENCED_FOR_READ | LP_REFERENCED_FOR_WRITE;
-   }
-   if (setup->fb.zsbuf && setup->fb.zsbuf->texture == texture) {
-      return LP_REFERENCED_FOR_READ | LP_REFERENCED_FOR_WRITE;
+      }
    }
 
    /* check textures referenced by the scene */
    for (i = 0; i < Elements(setup->scenes); i++) {
-      if (lp_scene_is_resource_referenced(setup->scenes[i], texture)) {
+      if (lp_scene_is_resource_referenced(setup->scenes[i], texture, level)) {
          return LP_REFERENCED_FOR_READ;
       }
    }
@@ -872,6 +1019,7 @@ try_update_scene_state( struct lp_setup_context *setup )
             if (setup->fs.current_tex[i]) {
                if (!lp_scene_add_resource_reference(scene,
                                                     setup->fs.current_tex[i],
+                                                    setup->fs.current_tex_levels[i],
                                                     new_scene)) {
                   assert(!new_scene);
                   return FALSE;
@@ -1094,6 +1242,8 @@ lp_setup_begin_query(struct lp_setup_context *setup,
             return;
          }
       }
+
+      lp_fence_reference(&pq->begin_fence, setup->scene->fence);
    }
 }
 
@@ -1134,6 +1284,37 @@ lp_setup_end_query(struct lp_setup_context *setup, struct llvmpipe_query *pq)
 }
 
 
+/**
+ * Whether the query was both begun and ended in the scene being binned,
+ * so that the rasterizer knows the query's result in each tile before
+ * executing any command binned from now on.
+ */
+boolean
+lp_setup_query_in_scene(struct lp_setup_context *setup,
+                        const struct llvmpipe_query *pq)
+{
+   return setup->scene &&
+          setup->active_query != pq &&
+          pq->begin_fence == setup->scene->fence &&
+          pq->fence == setup->scene->fence;
+}
+
+
+/**
+ * Have the rasterizer discard the following draws in the tiles where no
+ * sample passed the given query, or draw everywhere if pq is NULL.
+ */
+void
+lp_setup_set_render_condition(struct lp_setup_context *setup,
+                              const struct llvmpipe_query *pq)
+{
+   if (setup->fs.current.render_cond != pq) {
+      setup->fs.current.render_cond = pq;
+      setup->dirty |= LP_SETUP_NEW_FS;
+   }
+}
+
+
 boolean
 lp_setup_flush_and_restart(struct lp_setup_context *setup)
 {
@@ -129,9 +129,13 @@ lp_setup_set_fragment_sampler_state(struct lp_setup_context *setup,
                                     unsigned num,
                                     const struct pipe_sampler_state **samplers);
 
+boolean
+lp_setup_is_rasterizing( const struct lp_setup_context *setup );
+
 unsigned
 lp_setup_is_resource_referenced( const struct lp_setup_context *setup,
-                                const struct pipe_resource *texture );
+                                const struct pipe_resource *texture,
+                                unsigned level, int layer );
 
 void
 lp_setup_set_flatshade_first( struct lp_setup_context *setup, 
@@ -149,4 +153,12 @@ void
 lp_setup_end_query(struct lp_setup_context *setup,
                    struct llvmpipe_query *pq);
 
+boolean
+lp_setup_query_in_scene(struct lp_setup_context *setup,
+                        const struct llvmpipe_query *pq);
+
+void
+lp_setup_set_render_condition(struct lp_setup_context *setup,
+                              const struct llvmpipe_query *pq);
+
 #endif
@@ -88,6 +88,7 @@ struct lp_setup_context
    unsigned scene_idx;
    struct lp_scene *scenes[MAX_SCENES];  /**< all the scenes */
    struct lp_scene *scene;               /**< current scene being built */
+   boolean rasterizing;                  /**< a scene is being executed */
 
    struct lp_fence *last_fence;
    struct llvmpipe_query *active_query;
@@ -124,6 +125,7 @@ struct lp_setup_context
       const struct lp_rast_state *stored; /**< what's in the scene */
       struct lp_rast_state current;  /**< currently set state */
       struct pipe_resource *current_tex[PIPE_MAX_SAMPLERS];
+      unsigned current_tex_levels[PIPE_MAX_SAMPLERS]; /**< levels sampled */
    } fs;
 
    /** fragment shader constants */
@@ -66,6 +66,7 @@
 #include "util/u_dump.h"
 #include "util/u_string.h"
 #include "util/u_simple_list.h"
+#include "util/u_atomic.h"
 #include "os/os_time.h"
 #include "pipe/p_shader_tokens.h"
 #include "draw/draw_context.h"
@@ -95,6 +96,8 @@
 #include "lp_tex_sample.h"
 #include "lp_flush.h"
 #include "lp_state_fs.h"
+#include "lp_texture.h"
+#include "lp_tile_soa.h"
 
 
 #include <llvm-c/Analysis.h>
@@ -105,6 +108,14 @@
 static unsigned fs_no = 0;
 
 
+/*
+ * Number of draws after which a fragment shader variant, first compiled
+ * quickly, is recompiled with full optimization in the background.  Zero
+ * compiles every variant once with the default optimizations.
+ */
+DEBUG_GET_ONCE_NUM_OPTION(hot_draws, "LP_JIT_HOT_DRAWS", 64)
+
+
 /**
  * Expand the relevent bits of mask_input to a 4-dword mask for the 
  * four pixels in a 2x2 quad.  This will set the four elements of the
@@ -218,6 +229,7 @@ generate_fs(struct gallivm_state *gallivm,
             LLVMBuilderRef builder,
             struct lp_type type,
             LLVMValueRef context_ptr,
+            LLVMValueRef consts_ptr,
             unsigned i,
             struct lp_build_interp_soa_context *interp,
             struct lp_build_sampler_soa *sampler,
@@ -232,7 +244,6 @@ generate_fs(struct gallivm_state *gallivm,
    const struct util_format_description *zs_format_desc = NULL;
    const struct tgsi_token *tokens = shader->base.tokens;
    LLVMTypeRef vec_type;
-   LLVMValueRef consts_ptr;
    LLVMValueRef outputs[PIPE_MAX_SHADER_OUTPUTS][NUM_CHANNELS];
    LLVMValueRef z;
    LLVMValueRef zs_value = NULL;
@@ -283,8 +294,6 @@ generate_fs(struct gallivm_state *gallivm,
 
    vec_type = lp_build_vec_type(gallivm, type);
 
-   consts_ptr = lp_jit_context_constants(gallivm, context_ptr);
-
    memset(outputs, 0, sizeof outputs);
 
    /* Declare the color and z variables */
@@ -497,11 +506,178 @@ generate_blend(struct gallivm_state *gallivm,
 }
 
 
+/**
+ * Generate the code shading one 4x4 block: the fragment shader, tests and
+ * depth writes for each of its quads, followed by the blending.
+ * \param color_ptrs  the block in each (swizzled) color buffer tile
+ * \param depth_ptr  the block in the depth buffer
+ * \param partial_mask  if 1, do mask_input testing
+ */
+static void
+generate_block(struct gallivm_state *gallivm,
+               struct lp_fragment_shader *shader,
+               struct lp_fragment_shader_variant *variant,
+               struct lp_type fs_type,
+               unsigned num_fs,
+               struct lp_type blend_type,
+               LLVMValueRef context_ptr,
+               LLVMValueRef consts_ptr,
+               struct lp_build_interp_soa_context *interp,
+               struct lp_build_sampler_soa *sampler,
+               const LLVMValueRef *color_ptrs,
+               LLVMValueRef depth_ptr,
+               LLVMValueRef facing,
+               unsigned partial_mask,
+               LLVMValueRef mask_input,
+               LLVMValueRef counter)
+{
+   const struct lp_fragment_shader_variant_key *key = &variant->key;
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMTypeRef int32_type = LLVMInt32TypeInContext(gallivm->context);
+   LLVMValueRef fs_mask[LP_MAX_VECTOR_LENGTH];
+   LLVMValueRef fs_out_color[PIPE_MAX_COLOR_BUFS][NUM_CHANNELS][LP_MAX_VECTOR_LENGTH];
+   LLVMValueRef blend_mask;
+   const struct util_format_description *zs_format_desc;
+   unsigned i;
+   unsigned chan;
+   unsigned cbuf;
+   boolean cbuf0_write_all;
+
+   /* check if writes to cbuf[0] are to be copied to all cbufs */
+   cbuf0_write_all = FALSE;
+   for (i = 0;i < shader->info.base.num_properties; i++) {
+      if (shader->info.base.properties[i].name ==
+          TGSI_PROPERTY_FS_COLOR0_WRITES_ALL_CBUFS) {
+         cbuf0_write_all = TRUE;
+         break;
+      }
+   }
+
+   /* loop over quads in the block */
+   zs_format_desc = util_format_description(key->zsbuf_format);
+
+   for(i = 0; i < num_fs; ++i) {
+      LLVMValueRef depth_offset = LLVMConstInt(int32_type,
+                                               i*fs_type.length*zs_format_desc->block.bits/8,
+                                               0);
+      LLVMValueRef out_color[PIPE_MAX_COLOR_BUFS][NUM_CHANNELS];
+      LLVMValueRef depth_ptr_i;
+
+      depth_ptr_i = LLVMBuildGEP(builder, depth_ptr, &depth_offset, 1, "");
+
+      generate_fs(gallivm,
+                  shader, key,
+                  builder,
+                  fs_type,
+                  context_ptr,
+                  consts_ptr,
+                  i,
+                  interp,
+                  sampler,
+                  &fs_mask[i], /* output */
+                  out_color,
+                  depth_ptr_i,
+                  facing,
+                  partial_mask,
+                  mask_input,
+                  counter);
+
+      for (cbuf = 0; cbuf < key->nr_cbufs; cbuf++)
+         for (chan = 0; chan < NUM_CHANNELS; ++chan)
+            fs_out_color[cbuf][chan][i] =
+               out_color[cbuf * !cbuf0_write_all][chan];
+   }
+
+   /* Loop over color outputs / color buffers to do blending.
+    */
+   for(cbuf = 0; cbuf < key->nr_cbufs; cbuf++) {
+      LLVMValueRef blend_in_color[NUM_CHANNELS];
+      unsigned rt;
+
+      /* 
+       * Convert the fs's output color and mask to fit to the blending type. 
+       */
+      for(chan = 0; chan < NUM_CHANNELS; ++chan) {
+         LLVMValueRef fs_color_vals[LP_MAX_VECTOR_LENGTH];
+         
+         for (i = 0; i < num_fs; i++) {
+            fs_color_vals[i] =
+               LLVMBuildLoad(builder, fs_out_color[cbuf][chan][i], "fs_color_vals");
+         }
+
+	 lp_build_conv(gallivm, fs_type, blend_type,
+                       fs_color_vals,
+                       num_fs,
+		       &blend_in_color[chan], 1);
+
+	 lp_build_name(blend_in_color[chan], "color%d.%c", cbuf, "rgba"[chan]);
+      }
+
+      if (partial_mask || !variant->opaque) {
+         lp_build_conv_mask(gallivm, fs_type, blend_type,
+                            fs_mask, num_fs,
+                            &blend_mask, 1);
+      } else {
+         blend_mask = lp_build_const_int_vec(gallivm, blend_type, ~0);
+      }
+
+      /* which blend/colormask state to use */
+      rt = key->blend.independent_blend_enable ? cbuf : 0;
+
+      /*
+       * Blending.
+       */
+      {
+         /* Could the 4x4 have been killed?
+          */
+         boolean do_branch = ((key->depth.enabled || key->stencil[0].enabled) &&
+                              !key->alpha.enabled &&
+                              !shader->info.base.uses_kill);
+
+         generate_blend(gallivm,
+                        &key->blend,
+                        rt,
+                        builder,
+                        blend_type,
+                        context_ptr,
+                        blend_mask,
+                        blend_in_color,
+                        color_ptrs[cbuf],
+                        do_branch);
+      }
+   }
+}
+
+
+/**
+ * Return ptr advanced by offset (int32) bytes, keeping its type.
+ */
+static LLVMValueRef
+build_byte_offset(struct gallivm_state *gallivm,
+                  LLVMValueRef ptr,
+                  LLVMValueRef offset)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMTypeRef ptr_type = LLVMTypeOf(ptr);
+   LLVMTypeRef int8_ptr_type =
+      LLVMPointerType(LLVMInt8TypeInContext(gallivm->context), 0);
+
+   ptr = LLVMBuildBitCast(builder, ptr, int8_ptr_type, "");
+   ptr = LLVMBuildGEP(builder, ptr, &offset, 1, "");
+   return LLVMBuildBitCast(builder, ptr, ptr_type, "");
+}
+
+
 /**
  * Generate the runtime callable function for the whole fragment pipeline.
- * Note that the function which we generate operates on a block of 16
- * pixels at at time.  The block contains 2x2 quads.  Each quad contains
- * 2x2 pixels.
+ * Note that the RAST_WHOLE and RAST_EDGE_TEST functions operate on a block
+ * of 16 pixels at at time.  The block contains 2x2 quads.  Each quad
+ * contains 2x2 pixels.
+ *
+ * The RAST_WHOLE_TILE function loops over a square run of fully covered
+ * blocks instead -- a whole tile, or a 16x16 block of a triangle -- so
+ * that the interpolation, constant and texture setup are done once per
+ * run rather than once per block.
  */
 static void
 generate_fragment(struct llvmpipe_context *lp,
@@ -509,15 +685,17 @@ generate_fragment(struct llvmpipe_context *lp,
                   struct lp_fragment_shader_variant *variant,
                   unsigned partial_mask)
 {
-   struct gallivm_state *gallivm = lp->gallivm;
+   struct gallivm_state *gallivm = variant->gallivm;
    const struct lp_fragment_shader_variant_key *key = &variant->key;
+   const boolean whole_tile = partial_mask == RAST_WHOLE_TILE;
    struct lp_shader_input inputs[PIPE_MAX_SHADER_INPUTS];
    char func_name[256];
    struct lp_type fs_type;
    struct lp_type blend_type;
    LLVMTypeRef fs_elem_type;
    LLVMTypeRef blend_vec_type;
-   LLVMTypeRef arg_types[11];
+   LLVMTypeRef arg_types[12];
+   unsigned num_args;
    LLVMTypeRef func_type;
    LLVMTypeRef int32_type = LLVMInt32TypeInContext(gallivm->context);
    LLVMTypeRef int8_type = LLVMInt8TypeInContext(gallivm->context);
@@ -528,24 +706,22 @@ generate_fragment(struct llvmpipe_context *lp,
    LLVMValueRef dadx_ptr;
    LLVMValueRef dady_ptr;
    LLVMValueRef color_ptr_ptr;
+   LLVMValueRef color_ptrs[PIPE_MAX_COLOR_BUFS];
    LLVMValueRef depth_ptr;
-   LLVMValueRef mask_input;
+   LLVMValueRef mask_input = NULL;
+   LLVMValueRef depth_stride = NULL;
+   LLVMValueRef size = NULL;
    LLVMValueRef counter = NULL;
+   LLVMValueRef consts_ptr;
    LLVMBasicBlockRef block;
    LLVMBuilderRef builder;
    struct lp_build_sampler_soa *sampler;
    struct lp_build_interp_soa_context interp;
-   LLVMValueRef fs_mask[LP_MAX_VECTOR_LENGTH];
-   LLVMValueRef fs_out_color[PIPE_MAX_COLOR_BUFS][NUM_CHANNELS][LP_MAX_VECTOR_LENGTH];
-   LLVMValueRef blend_mask;
    LLVMValueRef function;
    LLVMValueRef facing;
-   const struct util_format_description *zs_format_desc;
    unsigned num_fs;
    unsigned i;
-   unsigned chan;
    unsigned cbuf;
-   boolean cbuf0_write_all;
 
    /* Adjust color input interpolation according to flatshade state:
     */
@@ -559,16 +735,6 @@ generate_fragment(struct llvmpipe_context *lp,
       }
    }
 
-   /* check if writes to cbuf[0] are to be copied to all cbufs */
-   cbuf0_write_all = FALSE;
-   for (i = 0;i < shader->info.base.num_properties; i++) {
-      if (shader->info.base.properties[i].name ==
-          TGSI_PROPERTY_FS_COLOR0_WRITES_ALL_CBUFS) {
-         cbuf0_write_all = TRUE;
-         break;
-      }
-   }
-
    /* TODO: actually pick these based on the fs and color buffer
     * characteristics. */
 
@@ -589,7 +755,8 @@ generate_fragment(struct llvmpipe_context *lp,
 
    /* 
     * Generate the function prototype. Any change here must be reflected in
-    * lp_jit.h's lp_jit_frag_func function pointer type, and vice-versa.
+    * lp_jit.h's lp_jit_frag_func (or lp_jit_frag_tile_func) function pointer
+    * type, and vice-versa.
     */
 
    fs_elem_type = lp_build_elem_type(gallivm, fs_type);
@@ -597,9 +764,10 @@ generate_fragment(struct llvmpipe_context *lp,
    blend_vec_type = lp_build_vec_type(gallivm, blend_type);
 
    util_snprintf(func_name, sizeof(func_name), "fs%u_variant%u_%s", 
-		 shader->no, variant->no, partial_mask ? "partial" : "whole");
+		 shader->no, variant->no,
+                 whole_tile ? "tile" : partial_mask ? "partial" : "whole");
 
-   arg_types[0] = lp_jit_get_context_type(lp);         /* context */
+   arg_types[0] = variant->jit_context_ptr_type;       /* context */
    arg_types[1] = int32_type;                          /* x */
    arg_types[2] = int32_type;                          /* y */
    arg_types[3] = int32_type;                          /* facing */
@@ -608,11 +776,20 @@ generate_fragment(struct llvmpipe_context *lp,
    arg_types[6] = LLVMPointerType(fs_elem_type, 0);    /* dady */
    arg_types[7] = LLVMPointerType(LLVMPointerType(blend_vec_type, 0), 0);  /* color */
    arg_types[8] = LLVMPointerType(int8_type, 0);       /* depth */
-   arg_types[9] = int32_type;                          /* mask_input */
-   arg_types[10] = LLVMPointerType(int32_type, 0);     /* counter */
+   if (whole_tile) {
+      arg_types[9] = int32_type;                       /* depth_stride */
+      arg_types[10] = int32_type;                      /* size */
+      arg_types[11] = LLVMPointerType(int32_type, 0);  /* counter */
+      num_args = 12;
+   }
+   else {
+      arg_types[9] = int32_type;                       /* mask_input */
+      arg_types[10] = LLVMPointerType(int32_type, 0);  /* counter */
+      num_args = 11;
+   }
 
    func_type = LLVMFunctionType(LLVMVoidTypeInContext(gallivm->context),
-                                arg_types, Elements(arg_types), 0);
+                                arg_types, num_args, 0);
 
    function = LLVMAddFunction(gallivm->module, func_name, func_type);
    LLVMSetFunctionCallConv(function, LLVMCCallConv);
@@ -622,7 +799,7 @@ generate_fragment(struct llvmpipe_context *lp,
    /* XXX: need to propagate noalias down into color param now we are
     * passing a pointer-to-pointer?
     */
-   for(i = 0; i < Elements(arg_types); ++i)
+   for(i = 0; i < num_args; ++i)
       if(LLVMGetTypeKind(arg_types[i]) == LLVMPointerTypeKind)
          LLVMAddAttribute(LLVMGetParam(function, i), LLVMNoAliasAttribute);
 
@@ -635,7 +812,6 @@ generate_fragment(struct llvmpipe_context *lp,
    dady_ptr     = LLVMGetParam(function, 6);
    color_ptr_ptr = LLVMGetParam(function, 7);
    depth_ptr    = LLVMGetParam(function, 8);
-   mask_input   = LLVMGetParam(function, 9);
 
    lp_build_name(context_ptr, "context");
    lp_build_name(x, "x");
@@ -645,10 +821,20 @@ generate_fragment(struct llvmpipe_context *lp,
    lp_build_name(dady_ptr, "dady");
    lp_build_name(color_ptr_ptr, "color_ptr_ptr");
    lp_build_name(depth_ptr, "depth");
-   lp_build_name(mask_input, "mask_input");
+
+   if (whole_tile) {
+      depth_stride = LLVMGetParam(function, 9);
+      size         = LLVMGetParam(function, 10);
+      lp_build_name(depth_stride, "depth_stride");
+      lp_build_name(size, "size");
+   }
+   else {
+      mask_input   = LLVMGetParam(function, 9);
+      lp_build_name(mask_input, "mask_input");
+   }
 
    if (key->occlusion_count) {
-      counter = LLVMGetParam(function, 10);
+      counter = LLVMGetParam(function, num_args - 1);
       lp_build_name(counter, "counter");
    }
 
@@ -677,108 +863,92 @@ generate_fragment(struct llvmpipe_context *lp,
    /* code generated texture sampling */
    sampler = lp_llvm_sampler_soa_create(key->sampler, context_ptr);
 
-   /* loop over quads in the block */
-   zs_format_desc = util_format_description(key->zsbuf_format);
-
-   for(i = 0; i < num_fs; ++i) {
-      LLVMValueRef depth_offset = LLVMConstInt(int32_type,
-                                               i*fs_type.length*zs_format_desc->block.bits/8,
-                                               0);
-      LLVMValueRef out_color[PIPE_MAX_COLOR_BUFS][NUM_CHANNELS];
-      LLVMValueRef depth_ptr_i;
-
-      depth_ptr_i = LLVMBuildGEP(builder, depth_ptr, &depth_offset, 1, "");
-
-      generate_fs(gallivm,
-                  shader, key,
-                  builder,
-                  fs_type,
-                  context_ptr,
-                  i,
-                  &interp,
-                  sampler,
-                  &fs_mask[i], /* output */
-                  out_color,
-                  depth_ptr_i,
-                  facing,
-                  partial_mask,
-                  mask_input,
-                  counter);
-
-      for (cbuf = 0; cbuf < key->nr_cbufs; cbuf++)
-         for (chan = 0; chan < NUM_CHANNELS; ++chan)
-            fs_out_color[cbuf][chan][i] =
-               out_color[cbuf * !cbuf0_write_all][chan];
-   }
-
-   sampler->destroy(sampler);
+   consts_ptr = lp_jit_context_constants(gallivm, context_ptr);
 
-   /* Loop over color outputs / color buffers to do blending.
-    */
-   for(cbuf = 0; cbuf < key->nr_cbufs; cbuf++) {
-      LLVMValueRef color_ptr;
+   for (cbuf = 0; cbuf < key->nr_cbufs; cbuf++) {
       LLVMValueRef index = lp_build_const_int32(gallivm, cbuf);
-      LLVMValueRef blend_in_color[NUM_CHANNELS];
-      unsigned rt;
-
-      /* 
-       * Convert the fs's output color and mask to fit to the blending type. 
-       */
-      for(chan = 0; chan < NUM_CHANNELS; ++chan) {
-         LLVMValueRef fs_color_vals[LP_MAX_VECTOR_LENGTH];
-         
-         for (i = 0; i < num_fs; i++) {
-            fs_color_vals[i] =
-               LLVMBuildLoad(builder, fs_out_color[cbuf][chan][i], "fs_color_vals");
-         }
-
-	 lp_build_conv(gallivm, fs_type, blend_type,
-                       fs_color_vals,
-                       num_fs,
-		       &blend_in_color[chan], 1);
-
-	 lp_build_name(blend_in_color[chan], "color%d.%c", cbuf, "rgba"[chan]);
-      }
-
-      if (partial_mask || !variant->opaque) {
-         lp_build_conv_mask(lp->gallivm, fs_type, blend_type,
-                            fs_mask, num_fs,
-                            &blend_mask, 1);
-      } else {
-         blend_mask = lp_build_const_int_vec(lp->gallivm, blend_type, ~0);
-      }
-
-      color_ptr = LLVMBuildLoad(builder, 
-				LLVMBuildGEP(builder, color_ptr_ptr, &index, 1, ""),
-				"");
-      lp_build_name(color_ptr, "color_ptr%d", cbuf);
-
-      /* which blend/colormask state to use */
-      rt = key->blend.independent_blend_enable ? cbuf : 0;
+      color_ptrs[cbuf] = LLVMBuildLoad(builder,
+                                       LLVMBuildGEP(builder, color_ptr_ptr, &index, 1, ""),
+                                       "");
+      lp_build_name(color_ptrs[cbuf], "color_ptr%d", cbuf);
+   }
 
-      /*
-       * Blending.
-       */
+   if (!whole_tile) {
+      generate_block(gallivm, shader, variant,
+                     fs_type, num_fs, blend_type,
+                     context_ptr, consts_ptr,
+                     &interp, sampler,
+                     color_ptrs, depth_ptr,
+                     facing,
+                     partial_mask, mask_input,
+                     counter);
+   }
+   else {
+      const struct util_format_description *zs_format_desc =
+         util_format_description(key->zsbuf_format);
+      const unsigned depth_block_size =
+         TILE_VECTOR_WIDTH * TILE_VECTOR_HEIGHT * zs_format_desc->block.bits / 8;
+      struct lp_build_loop_state loop_y, loop_x;
+      LLVMValueRef zero = lp_build_const_int32(gallivm, 0);
+      LLVMValueRef num_blocks;
+      LLVMValueRef row_color_ptrs[PIPE_MAX_COLOR_BUFS];
+      LLVMValueRef block_color_ptrs[PIPE_MAX_COLOR_BUFS];
+      LLVMValueRef row_depth_ptr, block_depth_ptr;
+      LLVMValueRef offset;
+
+      /* size / 4 blocks in each direction */
+      num_blocks = LLVMBuildLShr(builder, size,
+                                 lp_build_const_int32(gallivm, 2), "");
+
+      lp_build_loop_begin(&loop_y, gallivm, zero);
       {
-         /* Could the 4x4 have been killed?
-          */
-         boolean do_branch = ((key->depth.enabled || key->stencil[0].enabled) &&
-                              !key->alpha.enabled &&
-                              !shader->info.base.uses_kill);
-
-         generate_blend(lp->gallivm,
-                        &key->blend,
-                        rt,
-                        builder,
-                        blend_type,
-                        context_ptr,
-                        blend_mask,
-                        blend_in_color,
-                        color_ptr,
-                        do_branch);
+         offset = LLVMBuildMul(builder, loop_y.counter,
+                               lp_build_const_int32(gallivm, TILE_VECTOR_HEIGHT), "");
+         lp_build_interp_soa_begin_row(&interp, gallivm, offset,
+                                       TILE_VECTOR_WIDTH);
+
+         offset = LLVMBuildMul(builder, loop_y.counter,
+                               lp_build_const_int32(gallivm, TILE_Y_STRIDE), "");
+         for (cbuf = 0; cbuf < key->nr_cbufs; cbuf++)
+            row_color_ptrs[cbuf] = build_byte_offset(gallivm, color_ptrs[cbuf],
+                                                     offset);
+
+         offset = LLVMBuildMul(builder, loop_y.counter, depth_stride, "");
+         row_depth_ptr = LLVMBuildGEP(builder, depth_ptr, &offset, 1, "");
+
+         lp_build_loop_begin(&loop_x, gallivm, zero);
+         {
+            offset = LLVMBuildMul(builder, loop_x.counter,
+                                  lp_build_const_int32(gallivm, TILE_X_STRIDE), "");
+            for (cbuf = 0; cbuf < key->nr_cbufs; cbuf++)
+               block_color_ptrs[cbuf] = build_byte_offset(gallivm,
+                                                          row_color_ptrs[cbuf],
+                                                          offset);
+
+            offset = LLVMBuildMul(builder, loop_x.counter,
+                                  lp_build_const_int32(gallivm, depth_block_size), "");
+            block_depth_ptr = LLVMBuildGEP(builder, row_depth_ptr, &offset, 1, "");
+
+            lp_build_interp_soa_begin_block(&interp, gallivm);
+
+            generate_block(gallivm, shader, variant,
+                           fs_type, num_fs, blend_type,
+                           context_ptr, consts_ptr,
+                           &interp, sampler,
+                           block_color_ptrs, block_depth_ptr,
+                           facing,
+                           0, NULL,
+                           counter);
+
+            lp_build_interp_soa_next_block(&interp, gallivm);
+         }
+         lp_build_loop_end_cond(&loop_x, num_blocks, NULL, LLVMIntULT);
       }
+      lp_build_loop_end_cond(&loop_y, num_blocks, NULL, LLVMIntULT);
    }
 
+   sampler->destroy(sampler);
+
    LLVMBuildRetVoid(builder);
 
    /* Verify the LLVM IR.  If invalid, dump and abort */
@@ -791,7 +961,7 @@ generate_fragment(struct llvmpipe_context *lp,
 #endif
 
    /* Apply optimizations to LLVM IR */
-   LLVMRunFunctionPassManager(gallivm->passmgr, function);
+   gallivm_optimize_function(gallivm, function);
 
    if ((gallivm_debug & GALLIVM_DEBUG_IR) || (LP_DEBUG & DEBUG_FS)) {
       /* Print the LLVM IR to stderr */
@@ -808,9 +978,12 @@ generate_fragment(struct llvmpipe_context *lp,
     * Translate the LLVM IR into machine code.
     */
    {
-      void *f = LLVMGetPointerToGlobal(gallivm->engine, function);
+      void *f = gallivm_jit_function(gallivm, function);
 
-      variant->jit_function[partial_mask] = (lp_jit_frag_func)pointer_to_func(f);
+      if (whole_tile)
+         variant->jit_tile_function = (lp_jit_frag_tile_func)pointer_to_func(f);
+      else
+         variant->jit_function[partial_mask] = (lp_jit_frag_func)pointer_to_func(f);
 
       if ((gallivm_debug & GALLIVM_DEBUG_ASM) || (LP_DEBUG & DEBUG_FS)) {
          lp_disassemble(f);
@@ -880,6 +1053,7 @@ dump_fs_variant_key(const struct lp_fragment_shader_variant_key *key)
                    key->sampler[i].pot_width,
                    key->sampler[i].pot_height,
                    key->sampler[i].pot_depth);
+      debug_printf("  .tiled = %u\n", key->sampler[i].tiled);
       debug_printf("  .wrap = %s %s %s\n",
                    util_dump_tex_wrap(key->sampler[i].wrap_s, TRUE),
                    util_dump_tex_wrap(key->sampler[i].wrap_t, TRUE),
@@ -913,14 +1087,36 @@ lp_debug_fs_variant(const struct lp_fragment_shader_variant *variant)
 }
 
 
+static void
+print_variant_stats(const struct lp_fragment_shader_variant *variant,
+                    const char *when)
+{
+   const struct gallivm_stats *stats = &variant->gallivm->stats;
+
+   debug_printf("llvmpipe: fs #%u var #%u %s: %s, %u functions, "
+                "%u -> %u instrs, opt %.2f ms, codegen %.2f ms\n",
+                variant->shader->no, variant->no, when,
+                gallivm_profile_name(variant->profile),
+                stats->nr_functions,
+                stats->nr_instrs, stats->nr_instrs_opt,
+                stats->opt_time / 1000.0,
+                stats->codegen_time / 1000.0);
+}
+
+
 /**
  * Generate a new fragment shader variant from the shader code and
  * other state indicated by the key.
+ *
+ * Does not touch the context nor the shader, so that hot variants can be
+ * recompiled on the background thread.
  */
 static struct lp_fragment_shader_variant *
 generate_variant(struct llvmpipe_context *lp,
                  struct lp_fragment_shader *shader,
-                 const struct lp_fragment_shader_variant_key *key)
+                 const struct lp_fragment_shader_variant_key *key,
+                 unsigned no,
+                 enum gallivm_profile profile)
 {
    struct lp_fragment_shader_variant *variant;
    boolean fullcolormask;
@@ -929,10 +1125,18 @@ generate_variant(struct llvmpipe_context *lp,
    if(!variant)
       return NULL;
 
+   variant->gallivm = gallivm_create_profile(profile);
+   if (!variant->gallivm) {
+      FREE(variant);
+      return NULL;
+   }
+
    variant->shader = shader;
    variant->list_item_global.base = variant;
    variant->list_item_local.base = variant;
-   variant->no = shader->variants_created++;
+   variant->list_item_recompile.base = variant;
+   variant->no = no;
+   variant->profile = profile;
 
    memcpy(&variant->key, key, shader->variant_key_size);
 
@@ -964,6 +1168,8 @@ generate_variant(struct llvmpipe_context *lp,
       lp_debug_fs_variant(variant);
    }
 
+   lp_jit_init_types(variant);
+
    generate_fragment(lp, shader, variant, RAST_EDGE_TEST);
 
    if (variant->opaque) {
@@ -973,10 +1179,206 @@ generate_variant(struct llvmpipe_context *lp,
       variant->jit_function[RAST_WHOLE] = variant->jit_function[RAST_EDGE_TEST];
    }
 
+   generate_fragment(lp, shader, variant, RAST_WHOLE_TILE);
+
    return variant;
 }
 
 
+/**
+ * Background thread recompiling the queued variants with full
+ * optimization.
+ */
+static PIPE_THREAD_ROUTINE(fs_recompile_thread, data)
+{
+   struct llvmpipe_context *lp = (struct llvmpipe_context *) data;
+   struct lp_fragment_shader_variant *variant, *recompiled;
+   struct lp_fs_variant_list_item *item;
+
+   pipe_mutex_lock(lp->fs_recompile.mutex);
+   while (!lp->fs_recompile.quit) {
+      if (is_empty_list(&lp->fs_recompile.queue)) {
+         pipe_condvar_wait(lp->fs_recompile.cond, lp->fs_recompile.mutex);
+         continue;
+      }
+
+      /* oldest first */
+      item = last_elem(&lp->fs_recompile.queue);
+      variant = item->base;
+      remove_from_list(item);
+      variant->recompile = LP_RECOMPILE_BUSY;
+      pipe_mutex_unlock(lp->fs_recompile.mutex);
+
+      recompiled = generate_variant(lp, variant->shader, &variant->key,
+                                    variant->no, GALLIVM_PROFILE_FULL);
+
+      if (recompiled && (LP_DEBUG & DEBUG_JIT)) {
+         print_variant_stats(recompiled, "recompiled");
+      }
+
+      pipe_mutex_lock(lp->fs_recompile.mutex);
+      variant->recompiled = recompiled;
+      variant->recompile = LP_RECOMPILE_DONE;
+      insert_at_head(&lp->fs_recompile.done, &variant->list_item_recompile);
+      p_atomic_inc(&lp->fs_recompile.nr_done);
+
+      /* wake up llvmpipe_remove_shader_variant() if it waits for us */
+      pipe_condvar_broadcast(lp->fs_recompile.cond);
+   }
+   pipe_mutex_unlock(lp->fs_recompile.mutex);
+
+   return NULL;
+}
+
+
+/**
+ * Free the result of a variant's recompilation, if any, and take it off
+ * the recompilation lists.  Waits for the background thread if it is
+ * recompiling the variant right now.
+ */
+static void
+cancel_recompile(struct llvmpipe_context *lp,
+                 struct lp_fragment_shader_variant *variant)
+{
+   pipe_mutex_lock(lp->fs_recompile.mutex);
+
+   while (variant->recompile == LP_RECOMPILE_BUSY) {
+      pipe_condvar_wait(lp->fs_recompile.cond, lp->fs_recompile.mutex);
+   }
+
+   if (variant->recompile != LP_RECOMPILE_NONE) {
+      if (variant->recompile == LP_RECOMPILE_DONE)
+         p_atomic_dec(&lp->fs_recompile.nr_done);
+      remove_from_list(&variant->list_item_recompile);
+      variant->recompile = LP_RECOMPILE_NONE;
+   }
+
+   if (variant->recompiled) {
+      gallivm_destroy(variant->recompiled->gallivm);
+      FREE(variant->recompiled);
+      variant->recompiled = NULL;
+   }
+
+   pipe_mutex_unlock(lp->fs_recompile.mutex);
+}
+
+
+/**
+ * Replace a variant's code with its recompiled version.
+ *
+ * Rasterization happens within the flushes on this thread, so no scene
+ * can be executing the old code now, and the bins which refer to the
+ * variant will call the new code.
+ */
+static void
+adopt_recompiled(struct llvmpipe_context *lp,
+                 struct lp_fragment_shader_variant *variant,
+                 struct lp_fragment_shader_variant *recompiled)
+{
+   unsigned i;
+
+   assert(!lp_setup_is_rasterizing(lp->setup));
+
+   gallivm_destroy(variant->gallivm);
+
+   variant->gallivm = recompiled->gallivm;
+   variant->jit_context_ptr_type = recompiled->jit_context_ptr_type;
+   for (i = 0; i < Elements(variant->function); i++)
+      variant->function[i] = recompiled->function[i];
+   for (i = 0; i < Elements(variant->jit_function); i++)
+      variant->jit_function[i] = recompiled->jit_function[i];
+   variant->jit_tile_function = recompiled->jit_tile_function;
+   variant->profile = recompiled->profile;
+
+   FREE(recompiled);
+}
+
+
+/**
+ * Count a draw with the bound fragment shader variant, queueing it for
+ * recompilation once it is hot, and switch the variants recompiled in the
+ * meantime to their new code.
+ */
+void
+llvmpipe_fs_variant_draw(struct llvmpipe_context *lp)
+{
+   struct lp_fragment_shader_variant *variant = lp->fs_variant;
+
+   if (!lp->fs_recompile.hot_draws)
+      return;
+
+   /* Only take the mutex when the background thread has finished some
+    * work or the bound variant just got hot, not on every draw.
+    */
+   if (p_atomic_read(&lp->fs_recompile.nr_done)) {
+      pipe_mutex_lock(lp->fs_recompile.mutex);
+
+      while (!is_empty_list(&lp->fs_recompile.done)) {
+         struct lp_fs_variant_list_item *item =
+            first_elem(&lp->fs_recompile.done);
+         struct lp_fragment_shader_variant *done = item->base;
+
+         remove_from_list(item);
+         done->recompile = LP_RECOMPILE_NONE;
+         if (done->recompiled) {
+            adopt_recompiled(lp, done, done->recompiled);
+            done->recompiled = NULL;
+         }
+      }
+      p_atomic_set(&lp->fs_recompile.nr_done, 0);
+
+      pipe_mutex_unlock(lp->fs_recompile.mutex);
+   }
+
+   /* nr_draws is only ever touched on this thread */
+   if (variant &&
+       variant->profile == GALLIVM_PROFILE_FAST &&
+       ++variant->nr_draws == lp->fs_recompile.hot_draws) {
+      pipe_mutex_lock(lp->fs_recompile.mutex);
+
+      if (!lp->fs_recompile.thread_started) {
+         lp->fs_recompile.thread = pipe_thread_create(fs_recompile_thread, lp);
+         lp->fs_recompile.thread_started = TRUE;
+      }
+
+      variant->recompile = LP_RECOMPILE_QUEUED;
+      insert_at_head(&lp->fs_recompile.queue, &variant->list_item_recompile);
+      pipe_condvar_signal(lp->fs_recompile.cond);
+
+      pipe_mutex_unlock(lp->fs_recompile.mutex);
+   }
+}
+
+
+/**
+ * Stop the background recompilation thread, dropping the pending work.
+ */
+void
+llvmpipe_destroy_fs_recompile(struct llvmpipe_context *lp)
+{
+   struct lp_fs_variant_list_item *li;
+
+   if (lp->fs_recompile.thread_started) {
+      pipe_mutex_lock(lp->fs_recompile.mutex);
+      lp->fs_recompile.quit = TRUE;
+      pipe_condvar_broadcast(lp->fs_recompile.cond);
+      pipe_mutex_unlock(lp->fs_recompile.mutex);
+
+      pipe_thread_wait(lp->fs_recompile.thread);
+      lp->fs_recompile.thread_started = FALSE;
+   }
+
+   li = first_elem(&lp->fs_variants_list);
+   while (!at_end(&lp->fs_variants_list, li)) {
+      cancel_recompile(lp, li->base);
+      li = next_elem(li);
+   }
+
+   pipe_condvar_destroy(lp->fs_recompile.cond);
+   pipe_mutex_destroy(lp->fs_recompile.mutex);
+}
+
+
 static void *
 llvmpipe_create_fs_state(struct pipe_context *pipe,
                          const struct pipe_shader_state *templ)
@@ -1100,8 +1502,6 @@ void
 llvmpipe_remove_shader_variant(struct llvmpipe_context *lp,
                                struct lp_fragment_shader_variant *variant)
 {
-   unsigned i;
-
    if (gallivm_debug & GALLIVM_DEBUG_IR) {
       debug_printf("llvmpipe: del fs #%u var #%u v created #%u v cached"
                    " #%u v total cached #%u\n",
@@ -1112,15 +1512,15 @@ llvmpipe_remove_shader_variant(struct llvmpipe_context *lp,
                    lp->nr_fs_variants);
    }
 
-   /* free all the variant's JIT'd functions */
-   for (i = 0; i < Elements(variant->function); i++) {
-      if (variant->function[i]) {
-         if (variant->jit_function[i])
-            LLVMFreeMachineCodeForFunction(lp->gallivm->engine,
-                                           variant->function[i]);
-         LLVMDeleteFunction(variant->function[i]);
-      }
-   }
+   cancel_recompile(lp, variant);
+
+   if (lp->fs_variant == variant)
+      lp->fs_variant = NULL;
+
+   /* free the variant's JIT'd functions, along with all the LLVM memory
+    * used to generate them
+    */
+   gallivm_destroy(variant->gallivm);
 
    /* remove from shader's list */
    remove_from_list(&variant->list_item_local);
@@ -1310,6 +1710,16 @@ make_variant_key(struct llvmpipe_context *lp,
          lp_sampler_static_state(&key->sampler[i],
 				 lp->fragment_sampler_views[i],
 				 lp->sampler[i]);
+
+         /* Must match the images lp_setup_set_fragment_sampler_views()
+          * passes to the shader.
+          */
+         if (lp->fragment_sampler_views[i] &&
+             lp->fragment_sampler_views[i]->texture &&
+             lp->sampler[i]) {
+            key->sampler[i].tiled =
+               llvmpipe_resource(lp->fragment_sampler_views[i]->texture)->sampler_tiled;
+         }
       }
    }
 }
@@ -1386,13 +1796,21 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
        * Generate the new variant.
        */
       t0 = os_time_get();
-      variant = generate_variant(lp, shader, &key);
+      variant = generate_variant(lp, shader, &key,
+                                 shader->variants_created++,
+                                 lp->fs_recompile.hot_draws ?
+                                 GALLIVM_PROFILE_FAST :
+                                 GALLIVM_PROFILE_DEFAULT);
       t1 = os_time_get();
       dt = t1 - t0;
       LP_COUNT_ADD(llvm_compile_time, dt);
-      LP_COUNT_ADD(nr_llvm_compiles, 2);  /* emit vs. omit in/out test */
+      if (variant) {
+         LP_COUNT_ADD(nr_llvm_compiles, variant->gallivm->stats.nr_functions);
+      }
 
-      llvmpipe_variant_count++;
+      if (variant && (LP_DEBUG & DEBUG_JIT)) {
+         print_variant_stats(variant, "compiled");
+      }
 
       /* Put the new variant into the list */
       if (variant) {
@@ -1404,6 +1822,7 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
    }
 
    /* Bind this variant */
+   lp->fs_variant = variant;
    lp_setup_set_fs_variant(lp->setup, variant);
 }
 
@@ -1421,4 +1840,14 @@ llvmpipe_init_fs_funcs(struct llvmpipe_context *llvmpipe)
    llvmpipe->pipe.delete_fs_state = llvmpipe_delete_fs_state;
 
    llvmpipe->pipe.set_constant_buffer = llvmpipe_set_constant_buffer;
+
+   /* Tiered compilation needs LLVM to be usable from two threads */
+   lp_build_init();
+   if (gallivm_multithreaded)
+      llvmpipe->fs_recompile.hot_draws = debug_get_option_hot_draws();
+
+   pipe_mutex_init(llvmpipe->fs_recompile.mutex);
+   pipe_condvar_init(llvmpipe->fs_recompile.cond);
+   make_empty_list(&llvmpipe->fs_recompile.queue);
+   make_empty_list(&llvmpipe->fs_recompile.done);
 }
@@ -35,6 +35,7 @@
 #include "tgsi/tgsi_scan.h" /* for tgsi_shader_info */
 #include "gallivm/lp_bld_sample.h" /* for struct lp_sampler_static_state */
 #include "gallivm/lp_bld_tgsi.h" /* for lp_tgsi_info */
+#include "gallivm/lp_bld_init.h" /* for enum gallivm_profile */
 #include "lp_bld_interp.h" /* for struct lp_shader_input */
 
 
@@ -46,6 +47,16 @@ struct lp_fragment_shader;
 #define RAST_WHOLE 0
 #define RAST_EDGE_TEST 1
 
+/** Index of the function shading runs of whole blocks in function[] */
+#define RAST_WHOLE_TILE 2
+
+
+/** Values of lp_fragment_shader_variant::recompile */
+#define LP_RECOMPILE_NONE    0
+#define LP_RECOMPILE_QUEUED  1  /**< waiting for the background thread */
+#define LP_RECOMPILE_BUSY    2  /**< being compiled */
+#define LP_RECOMPILE_DONE    3  /**< waiting to be adopted */
+
 
 struct lp_fragment_shader_variant_key
 {
@@ -84,13 +95,36 @@ struct lp_fragment_shader_variant
 
    boolean opaque;
 
-   LLVMValueRef function[2];
+   /** LLVM context, module and engine owning all the variant's code */
+   struct gallivm_state *gallivm;
+
+   LLVMTypeRef jit_context_ptr_type;
+
+   LLVMValueRef function[3];
 
    lp_jit_frag_func jit_function[2];
 
+   /** Shades whole tiles, and 16x16 blocks, in a single call */
+   lp_jit_frag_tile_func jit_tile_function;
+
    struct lp_fs_variant_list_item list_item_global, list_item_local;
    struct lp_fragment_shader *shader;
 
+   /** Optimization profile the functions above were compiled with */
+   enum gallivm_profile profile;
+
+   /** Number of draws done with the variant, to find the hot ones */
+   unsigned nr_draws;
+
+   /**
+    * Recompilation with full optimization on the context's background
+    * thread.  The fields below are protected by the context's
+    * fs_recompile.mutex.
+    */
+   unsigned recompile;
+   struct lp_fragment_shader_variant *recompiled;
+   struct lp_fs_variant_list_item list_item_recompile;
+
    /* For debugging/profiling purposes */
    unsigned no;
 };
@@ -125,5 +159,11 @@ void
 llvmpipe_remove_shader_variant(struct llvmpipe_context *lp,
                                struct lp_fragment_shader_variant *variant);
 
+void
+llvmpipe_fs_variant_draw(struct llvmpipe_context *lp);
+
+void
+llvmpipe_destroy_fs_recompile(struct llvmpipe_context *lp);
+
 
 #endif /* LP_STATE_FS_H_ */
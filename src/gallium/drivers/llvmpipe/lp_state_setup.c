@@ -535,7 +535,7 @@ finalize_function(struct gallivm_state *gallivm,
 #endif
 
    /* Apply optimizations to LLVM IR */
-   LLVMRunFunctionPassManager(gallivm->passmgr, function);
+   gallivm_optimize_function(gallivm, function);
 
    if (gallivm_debug & GALLIVM_DEBUG_IR)
    {
@@ -547,7 +547,7 @@ finalize_function(struct gallivm_state *gallivm,
    /*
     * Translate the LLVM IR into machine code.
     */
-   f = LLVMGetPointerToGlobal(gallivm->engine, function);
+   f = gallivm_jit_function(gallivm, function);
 
    if (gallivm_debug & GALLIVM_DEBUG_ASM)
    {
@@ -639,19 +639,19 @@ init_args(struct gallivm_state *gallivm,
  *
  */
 static struct lp_setup_variant *
-generate_setup_variant(struct gallivm_state *gallivm,
-		       struct lp_setup_variant_key *key,
+generate_setup_variant(struct lp_setup_variant_key *key,
                        struct llvmpipe_context *lp)
 {
    struct lp_setup_variant *variant = NULL;
+   struct gallivm_state *gallivm;
    struct lp_setup_args args;
    char func_name[256];
    LLVMTypeRef vec4f_type;
    LLVMTypeRef func_type;
    LLVMTypeRef arg_types[7];
    LLVMBasicBlockRef block;
-   LLVMBuilderRef builder = gallivm->builder;
-   int64_t t0 = 0, t1;
+   LLVMBuilderRef builder;
+   int64_t t0, t1;
 
    if (0)
       goto fail;
@@ -660,9 +660,13 @@ generate_setup_variant(struct gallivm_state *gallivm,
    if (variant == NULL)
       goto fail;
 
-   if (LP_DEBUG & DEBUG_COUNTERS) {
-      t0 = os_time_get();
-   }
+   variant->gallivm = gallivm = gallivm_create();
+   if (!variant->gallivm)
+      goto fail;
+
+   builder = gallivm->builder;
+
+   t0 = os_time_get();
 
    memcpy(&variant->key, key, key->size);
    variant->list_item_global.base = variant;
@@ -732,22 +736,15 @@ generate_setup_variant(struct gallivm_state *gallivm,
    /*
     * Update timing information:
     */
-   if (LP_DEBUG & DEBUG_COUNTERS) {
-      t1 = os_time_get();
-      LP_COUNT_ADD(llvm_compile_time, t1 - t0);
-      LP_COUNT_ADD(nr_llvm_compiles, 1);
-   }
-   
+   t1 = os_time_get();
+   LP_COUNT_ADD(llvm_compile_time, t1 - t0);
+   LP_COUNT_ADD(nr_llvm_compiles, 1);
+
    return variant;
 
 fail:
    if (variant) {
-      if (variant->function) {
-	 if (variant->jit_function)
-	    LLVMFreeMachineCodeForFunction(gallivm->engine,
-					   variant->function);
-	 LLVMDeleteFunction(variant->function);
-      }
+      gallivm_destroy(variant->gallivm);
       FREE(variant);
    }
    
@@ -806,12 +803,7 @@ remove_setup_variant(struct llvmpipe_context *lp,
 		   variant->no, lp->nr_setup_variants);
    }
 
-   if (variant->function) {
-      if (variant->jit_function)
-	 LLVMFreeMachineCodeForFunction(lp->gallivm->engine,
-					variant->function);
-      LLVMDeleteFunction(variant->function);
-   }
+   gallivm_destroy(variant->gallivm);
 
    remove_from_list(&variant->list_item_global);
    lp->nr_setup_variants--;
@@ -873,11 +865,10 @@ llvmpipe_update_setup(struct llvmpipe_context *lp)
 	 cull_setup_variants(lp);
       }
 
-      variant = generate_setup_variant(lp->gallivm, key, lp);
+      variant = generate_setup_variant(key, lp);
       if (variant) {
          insert_at_head(&lp->setup_variants_list, &variant->list_item_global);
          lp->nr_setup_variants++;
-         llvmpipe_variant_count++;
       }
    }
 
@@ -55,6 +55,9 @@ struct lp_setup_variant {
    
    struct lp_setup_variant_list_item list_item_global;
 
+   /** LLVM context, module and engine owning all the variant's code */
+   struct gallivm_state *gallivm;
+
    /* XXX: this is a pointer to the LLVM IR.  Once jit_function is
     * generated, we never need to use the IR again - need to find a
     * way to release this data without destroying the generated
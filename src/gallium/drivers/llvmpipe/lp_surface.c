@@ -25,6 +25,7 @@
  * 
  **************************************************************************/
 
+#include "util/u_box.h"
 #include "util/u_rect.h"
 #include "util/u_surface.h"
 #include "lp_context.h"
@@ -169,6 +170,12 @@ lp_resource_copy(struct pipe_context *pipe,
                         src_box->x, src_box->y);
       }
    }
+
+   if (dst_tex->dt) {
+      struct pipe_box dst_box;
+      u_box_2d(dstx, dsty, width, height, &dst_box);
+      util_damage_box(&dst_tex->damage, &dst_box);
+   }
 }
 
 
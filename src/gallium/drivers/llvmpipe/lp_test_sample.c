@@ -0,0 +1,711 @@
+/**************************************************************************
+ *
+ * Copyright 2012 The Mesa authors.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/**
+ * @file
+ * Unit tests for texture sampling, currently anisotropic filtering and the
+ * tiled texture layout.
+ *
+ * A mipmapped texture of horizontal stripes is sampled with footprints
+ * stretched along the stripes.  The filtered colors are compared with the
+ * exact average of the base level over the footprint, for the isotropic
+ * and the anisotropic samplers, and the cost of both is measured.
+ * Sampling a tiled copy of the texture must give the same colors.
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "pipe/p_defines.h"
+#include "pipe/p_state.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"
+#include "util/u_pointer.h"
+
+#include "gallivm/lp_bld.h"
+#include "gallivm/lp_bld_const.h"
+#include "gallivm/lp_bld_debug.h"
+#include "gallivm/lp_bld_init.h"
+#include "gallivm/lp_bld_quad.h"
+#include "gallivm/lp_bld_sample.h"
+
+#include "lp_limits.h"
+#include "lp_test.h"
+
+
+#define TEX_SIZE    256
+#define TEX_LEVELS  9
+#define STRIPE      8
+
+/** Number of quads sampled per test case */
+#define NUM_QUADS   256
+
+/** Supersampling of the reference footprint average, per axis */
+#define REF_SAMPLES 32
+
+
+void
+write_tsv_header(FILE *fp)
+{
+   fprintf(fp,
+           "result\t"
+           "ratio\t"
+           "iso_error\t"
+           "aniso_error\t"
+           "iso_cycles\t"
+           "aniso_cycles\n");
+
+   fflush(fp);
+}
+
+
+typedef void
+(*sample_ptr_t)(const float *s, const float *t, float *rgba);
+
+
+/**
+ * Texture seen by the generated code, as constants.
+ */
+struct test_texture
+{
+   uint32_t row_stride[LP_MAX_TEXTURE_LEVELS];
+   uint32_t img_stride[LP_MAX_TEXTURE_LEVELS];
+   const void *data[LP_MAX_TEXTURE_LEVELS];
+   float border_color[4];
+   uint8_t *levels[TEX_LEVELS];
+};
+
+
+struct test_sampler_dynamic_state
+{
+   struct lp_sampler_dynamic_state base;
+   const struct test_texture *texture;
+};
+
+
+static INLINE const struct test_texture *
+test_texture(const struct lp_sampler_dynamic_state *state)
+{
+   return ((const struct test_sampler_dynamic_state *)state)->texture;
+}
+
+
+static LLVMValueRef
+test_array_pointer(struct gallivm_state *gallivm, const void *ptr,
+                   LLVMTypeRef elem_type, unsigned length)
+{
+   LLVMTypeRef type = LLVMPointerType(LLVMArrayType(elem_type, length), 0);
+   return LLVMBuildBitCast(gallivm->builder,
+                           lp_build_const_int_pointer(gallivm, ptr),
+                           type, "");
+}
+
+
+static LLVMValueRef
+test_texture_size(const struct lp_sampler_dynamic_state *state,
+                  struct gallivm_state *gallivm, unsigned unit)
+{
+   return lp_build_const_int32(gallivm, TEX_SIZE);
+}
+
+
+static LLVMValueRef
+test_texture_depth(const struct lp_sampler_dynamic_state *state,
+                   struct gallivm_state *gallivm, unsigned unit)
+{
+   return lp_build_const_int32(gallivm, 1);
+}
+
+
+static LLVMValueRef
+test_texture_first_level(const struct lp_sampler_dynamic_state *state,
+                         struct gallivm_state *gallivm, unsigned unit)
+{
+   return lp_build_const_int32(gallivm, 0);
+}
+
+
+static LLVMValueRef
+test_texture_last_level(const struct lp_sampler_dynamic_state *state,
+                        struct gallivm_state *gallivm, unsigned unit)
+{
+   return lp_build_const_int32(gallivm, TEX_LEVELS - 1);
+}
+
+
+static LLVMValueRef
+test_texture_row_stride(const struct lp_sampler_dynamic_state *state,
+                        struct gallivm_state *gallivm, unsigned unit)
+{
+   return test_array_pointer(gallivm, test_texture(state)->row_stride,
+                             LLVMInt32TypeInContext(gallivm->context),
+                             LP_MAX_TEXTURE_LEVELS);
+}
+
+
+static LLVMValueRef
+test_texture_img_stride(const struct lp_sampler_dynamic_state *state,
+                        struct gallivm_state *gallivm, unsigned unit)
+{
+   return test_array_pointer(gallivm, test_texture(state)->img_stride,
+                             LLVMInt32TypeInContext(gallivm->context),
+                             LP_MAX_TEXTURE_LEVELS);
+}
+
+
+static LLVMValueRef
+test_texture_data_ptr(const struct lp_sampler_dynamic_state *state,
+                      struct gallivm_state *gallivm, unsigned unit)
+{
+   LLVMTypeRef i8p = LLVMPointerType(LLVMInt8TypeInContext(gallivm->context), 0);
+   return test_array_pointer(gallivm, test_texture(state)->data,
+                             i8p, LP_MAX_TEXTURE_LEVELS);
+}
+
+
+static LLVMValueRef
+test_texture_min_lod(const struct lp_sampler_dynamic_state *state,
+                     struct gallivm_state *gallivm, unsigned unit)
+{
+   return lp_build_const_float(gallivm, 0.0f);
+}
+
+
+static LLVMValueRef
+test_texture_max_lod(const struct lp_sampler_dynamic_state *state,
+                     struct gallivm_state *gallivm, unsigned unit)
+{
+   return lp_build_const_float(gallivm, (float)(TEX_LEVELS - 1));
+}
+
+
+static LLVMValueRef
+test_texture_lod_bias(const struct lp_sampler_dynamic_state *state,
+                      struct gallivm_state *gallivm, unsigned unit)
+{
+   return lp_build_const_float(gallivm, 0.0f);
+}
+
+
+static LLVMValueRef
+test_texture_border_color(const struct lp_sampler_dynamic_state *state,
+                          struct gallivm_state *gallivm, unsigned unit)
+{
+   return test_array_pointer(gallivm, test_texture(state)->border_color,
+                             LLVMFloatTypeInContext(gallivm->context), 4);
+}
+
+
+/**
+ * Create a mipmapped RGBA8 texture of horizontal stripes, STRIPE texels
+ * wide, with the mipmaps box filtered from the base level.
+ */
+static boolean
+create_texture(struct test_texture *texture)
+{
+   unsigned level, x, y, c;
+
+   memset(texture, 0, sizeof *texture);
+
+   for (level = 0; level < TEX_LEVELS; ++level) {
+      unsigned size = TEX_SIZE >> level;
+      uint8_t *data = MALLOC(size * size * 4);
+      if (!data)
+         return FALSE;
+
+      for (y = 0; y < size; ++y) {
+         for (x = 0; x < size; ++x) {
+            uint8_t *dst = data + (y * size + x) * 4;
+            for (c = 0; c < 4; ++c) {
+               if (level == 0) {
+                  dst[c] = (c == 3 || ((y / STRIPE) & 1)) ? 255 : 0;
+               }
+               else {
+                  const uint8_t *src = texture->levels[level - 1];
+                  unsigned src_size = size * 2;
+                  unsigned sum =
+                     src[((2*y + 0) * src_size + 2*x + 0) * 4 + c] +
+                     src[((2*y + 0) * src_size + 2*x + 1) * 4 + c] +
+                     src[((2*y + 1) * src_size + 2*x + 0) * 4 + c] +
+                     src[((2*y + 1) * src_size + 2*x + 1) * 4 + c];
+                  dst[c] = (sum + 2) / 4;
+               }
+            }
+         }
+      }
+
+      texture->levels[level] = data;
+      texture->data[level] = data;
+      texture->row_stride[level] = size * 4;
+      texture->img_stride[level] = size * size * 4;
+   }
+
+   return TRUE;
+}
+
+
+/**
+ * Copy the texture into the tiled layout (see LP_SAMPLER_TILE_SIZE), padding
+ * the levels to whole tiles.
+ */
+static boolean
+create_tiled_texture(struct test_texture *tiled,
+                     const struct test_texture *texture)
+{
+   const unsigned tile_size = LP_SAMPLER_TILE_SIZE;
+   unsigned level, x, y;
+
+   memset(tiled, 0, sizeof *tiled);
+
+   for (level = 0; level < TEX_LEVELS; ++level) {
+      unsigned size = TEX_SIZE >> level;
+      unsigned padded_size = align(size, tile_size);
+      unsigned row_stride = padded_size * 4;
+      uint8_t *data = CALLOC(padded_size * padded_size, 4);
+      if (!data)
+         return FALSE;
+
+      for (y = 0; y < size; ++y) {
+         for (x = 0; x < size; ++x) {
+            unsigned offset = (y / tile_size) * tile_size * row_stride +
+                              (x / tile_size) * tile_size * tile_size * 4 +
+                              (y % tile_size) * tile_size * 4 +
+                              (x % tile_size) * 4;
+            memcpy(data + offset,
+                   texture->levels[level] + (y * size + x) * 4, 4);
+         }
+      }
+
+      tiled->levels[level] = data;
+      tiled->data[level] = data;
+      tiled->row_stride[level] = row_stride;
+      tiled->img_stride[level] = row_stride * padded_size;
+   }
+
+   return TRUE;
+}
+
+
+static void
+destroy_texture(struct test_texture *texture)
+{
+   unsigned level;
+   for (level = 0; level < TEX_LEVELS; ++level)
+      FREE(texture->levels[level]);
+}
+
+
+/**
+ * Exact average of the red channel of the base level over the
+ * parallelogram footprint centered at (s, t) and spanned by the
+ * derivatives, in texels.
+ */
+static double
+reference_footprint(const struct test_texture *texture,
+                    double s, double t,
+                    const double dx[2], const double dy[2])
+{
+   double sum = 0.0;
+   unsigned i, j;
+
+   for (j = 0; j < REF_SAMPLES; ++j) {
+      for (i = 0; i < REF_SAMPLES; ++i) {
+         double a = (i + 0.5) / REF_SAMPLES - 0.5;
+         double b = (j + 0.5) / REF_SAMPLES - 0.5;
+         int x = (int)floor(s * TEX_SIZE + a * dx[0] + b * dy[0]);
+         int y = (int)floor(t * TEX_SIZE + a * dx[1] + b * dy[1]);
+         x &= TEX_SIZE - 1;
+         y &= TEX_SIZE - 1;
+         sum += texture->levels[0][(y * TEX_SIZE + x) * 4] / 255.0;
+      }
+   }
+
+   return sum / (REF_SAMPLES * REF_SAMPLES);
+}
+
+
+static LLVMValueRef
+add_sample_test(struct gallivm_state *gallivm, unsigned verbose,
+                const struct lp_sampler_static_state *static_state,
+                struct lp_sampler_dynamic_state *dynamic_state)
+{
+   LLVMContextRef context = gallivm->context;
+   LLVMModuleRef module = gallivm->module;
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_type type = lp_float32_vec4_type();
+   struct lp_build_context bld;
+   LLVMTypeRef vec_ptr_type;
+   LLVMTypeRef args[3];
+   LLVMValueRef func;
+   LLVMBasicBlockRef block;
+   LLVMValueRef coords[3], ddx[4], ddy[4], texel[4];
+   LLVMValueRef rgba_ptr;
+   unsigned chan;
+
+   lp_build_context_init(&bld, gallivm, type);
+
+   vec_ptr_type = LLVMPointerType(bld.vec_type, 0);
+   args[0] = args[1] = args[2] = vec_ptr_type;
+
+   func = LLVMAddFunction(module,
+                          static_state->max_anisotropy ? "sample_aniso" : "sample",
+                          LLVMFunctionType(LLVMVoidTypeInContext(context),
+                                           args, Elements(args), 0));
+   LLVMSetFunctionCallConv(func, LLVMCCallConv);
+
+   block = LLVMAppendBasicBlockInContext(context, func, "entry");
+   LLVMPositionBuilderAtEnd(builder, block);
+
+   coords[0] = LLVMBuildLoad(builder, LLVMGetParam(func, 0), "s");
+   coords[1] = LLVMBuildLoad(builder, LLVMGetParam(func, 1), "t");
+   coords[2] = bld.zero;
+   rgba_ptr = LLVMGetParam(func, 2);
+
+   ddx[0] = lp_build_scalar_ddx(&bld, coords[0]);
+   ddx[1] = lp_build_scalar_ddx(&bld, coords[1]);
+   ddy[0] = lp_build_scalar_ddy(&bld, coords[0]);
+   ddy[1] = lp_build_scalar_ddy(&bld, coords[1]);
+   ddx[2] = ddx[3] = ddy[2] = ddy[3] = LLVMGetUndef(bld.elem_type);
+
+   lp_build_sample_soa(gallivm, static_state, dynamic_state, type,
+                       0, 2, coords, ddx, ddy, NULL, NULL, texel);
+
+   for (chan = 0; chan < 4; ++chan) {
+      LLVMValueRef index = lp_build_const_int32(gallivm, chan);
+      LLVMBuildStore(builder, texel[chan],
+                     LLVMBuildGEP(builder, rgba_ptr, &index, 1, ""));
+   }
+
+   LLVMBuildRetVoid(builder);
+
+   if (LLVMVerifyFunction(func, LLVMPrintMessageAction)) {
+      LLVMDumpValue(func);
+      abort();
+   }
+
+   LLVMRunFunctionPassManager(gallivm->passmgr, func);
+
+   if (verbose >= 1) {
+      LLVMDumpValue(func);
+   }
+
+   return func;
+}
+
+
+static void
+init_static_state(struct lp_sampler_static_state *static_state,
+                  unsigned max_anisotropy)
+{
+   struct pipe_resource texture;
+   struct pipe_sampler_view view;
+   struct pipe_sampler_state sampler;
+
+   memset(&texture, 0, sizeof texture);
+   texture.target = PIPE_TEXTURE_2D;
+   texture.format = PIPE_FORMAT_R8G8B8A8_UNORM;
+   texture.width0 = TEX_SIZE;
+   texture.height0 = TEX_SIZE;
+   texture.depth0 = 1;
+   texture.last_level = TEX_LEVELS - 1;
+
+   memset(&view, 0, sizeof view);
+   view.texture = &texture;
+   view.format = texture.format;
+   view.u.tex.last_level = TEX_LEVELS - 1;
+   view.swizzle_r = PIPE_SWIZZLE_RED;
+   view.swizzle_g = PIPE_SWIZZLE_GREEN;
+   view.swizzle_b = PIPE_SWIZZLE_BLUE;
+   view.swizzle_a = PIPE_SWIZZLE_ALPHA;
+
+   memset(&sampler, 0, sizeof sampler);
+   sampler.wrap_s = PIPE_TEX_WRAP_REPEAT;
+   sampler.wrap_t = PIPE_TEX_WRAP_REPEAT;
+   sampler.wrap_r = PIPE_TEX_WRAP_REPEAT;
+   sampler.min_img_filter = PIPE_TEX_FILTER_LINEAR;
+   sampler.mag_img_filter = PIPE_TEX_FILTER_LINEAR;
+   sampler.min_mip_filter = PIPE_TEX_MIPFILTER_LINEAR;
+   sampler.normalized_coords = 1;
+   sampler.max_lod = (float)(TEX_LEVELS - 1);
+   sampler.max_anisotropy = max_anisotropy;
+
+   lp_sampler_static_state(static_state, &view, &sampler);
+}
+
+
+/**
+ * Sample NUM_QUADS quads with the given pixel derivatives (in texels) and
+ * return the mean absolute error against the footprint average, and the
+ * mean number of cycles per quad.
+ */
+PIPE_ALIGN_STACK
+static void
+run_quads(sample_ptr_t sample, const struct test_texture *texture,
+          const double dx[2], const double dy[2],
+          double *error, double *cycles)
+{
+   PIPE_ALIGN_VAR(16) float s[4];
+   PIPE_ALIGN_VAR(16) float t[4];
+   PIPE_ALIGN_VAR(16) float rgba[4][4];
+   double total_error = 0.0;
+   uint64_t total_cycles = 0;
+   unsigned n, i;
+
+   srand(0);
+
+   for (n = 0; n < NUM_QUADS; ++n) {
+      double s0 = (double)rand() / RAND_MAX;
+      double t0 = (double)rand() / RAND_MAX;
+      uint64_t start;
+
+      for (i = 0; i < 4; ++i) {
+         s[i] = (float)(s0 + ((i & 1) * dx[0] + (i >> 1) * dy[0]) / TEX_SIZE);
+         t[i] = (float)(t0 + ((i & 1) * dx[1] + (i >> 1) * dy[1]) / TEX_SIZE);
+      }
+
+      start = rdtsc();
+      sample(s, t, &rgba[0][0]);
+      total_cycles += rdtsc() - start;
+
+      for (i = 0; i < 4; ++i) {
+         double ref = reference_footprint(texture, s[i], t[i], dx, dy);
+         total_error += fabs(rgba[0][i] - ref);
+      }
+   }
+
+   *error = total_error / (NUM_QUADS * 4);
+   *cycles = (double)total_cycles / NUM_QUADS;
+}
+
+
+/**
+ * Check that the linear and the tiled texture sample to the same colors.
+ */
+PIPE_ALIGN_STACK
+static boolean
+test_tiled(struct gallivm_state *gallivm, const char *name,
+           LLVMValueRef linear_func, LLVMValueRef tiled_func)
+{
+   static const unsigned ratios[] = { 1, 8 };
+   sample_ptr_t linear_ptr, tiled_ptr;
+   PIPE_ALIGN_VAR(16) float s[4];
+   PIPE_ALIGN_VAR(16) float t[4];
+   PIPE_ALIGN_VAR(16) float linear_rgba[4][4];
+   PIPE_ALIGN_VAR(16) float tiled_rgba[4][4];
+   unsigned mismatches = 0;
+   unsigned r, n, i;
+
+   linear_ptr = (sample_ptr_t) pointer_to_func(
+      LLVMGetPointerToGlobal(gallivm->engine, linear_func));
+   tiled_ptr = (sample_ptr_t) pointer_to_func(
+      LLVMGetPointerToGlobal(gallivm->engine, tiled_func));
+
+   srand(1);
+
+   for (r = 0; r < Elements(ratios); ++r) {
+      for (n = 0; n < NUM_QUADS; ++n) {
+         double s0 = (double)rand() / RAND_MAX;
+         double t0 = (double)rand() / RAND_MAX;
+
+         for (i = 0; i < 4; ++i) {
+            s[i] = (float)(s0 + (i & 1) * ratios[r] / (double)TEX_SIZE);
+            t[i] = (float)(t0 + (i >> 1) / (double)TEX_SIZE);
+         }
+
+         linear_ptr(s, t, &linear_rgba[0][0]);
+         tiled_ptr(s, t, &tiled_rgba[0][0]);
+
+         if (memcmp(linear_rgba, tiled_rgba, sizeof linear_rgba) != 0)
+            ++mismatches;
+      }
+   }
+
+   printf("%s: tiled layout, %s sampler\n",
+          mismatches ? "FAIL" : "PASS", name);
+
+   return mismatches == 0;
+}
+
+
+static boolean
+test_ratio(struct gallivm_state *gallivm, unsigned verbose, FILE *fp,
+           const struct test_texture *texture,
+           LLVMValueRef iso_func, LLVMValueRef aniso_func,
+           unsigned ratio)
+{
+   sample_ptr_t iso_ptr, aniso_ptr;
+   const double dx[2] = { (double)ratio, 0.0 };
+   const double dy[2] = { 0.0, 1.0 };
+   double iso_error, aniso_error;
+   double iso_cycles, aniso_cycles;
+   boolean success;
+
+   iso_ptr = (sample_ptr_t) pointer_to_func(
+      LLVMGetPointerToGlobal(gallivm->engine, iso_func));
+   aniso_ptr = (sample_ptr_t) pointer_to_func(
+      LLVMGetPointerToGlobal(gallivm->engine, aniso_func));
+
+   run_quads(iso_ptr, texture, dx, dy, &iso_error, &iso_cycles);
+   run_quads(aniso_ptr, texture, dx, dy, &aniso_error, &aniso_cycles);
+
+   if (ratio == 1) {
+      /* An isotropic footprint takes one probe, at the same lod */
+      success = fabs(aniso_error - iso_error) < 4.0/255.0;
+   }
+   else {
+      /* The stripes must not be blurred away */
+      success = aniso_error < 0.1 && aniso_error <= iso_error;
+      if (ratio >= 4)
+         success = success && aniso_error < iso_error * 0.5;
+   }
+
+   printf("%s: ratio %2u  error %.4f (isotropic) %.4f (anisotropic)  "
+          "cycles %.0f %.0f\n",
+          success ? "PASS" : "FAIL", ratio,
+          iso_error, aniso_error, iso_cycles, aniso_cycles);
+
+   if (fp) {
+      fprintf(fp, "%s\t%u\t%f\t%f\t%.0f\t%.0f\n",
+              success ? "pass" : "fail", ratio,
+              iso_error, aniso_error, iso_cycles, aniso_cycles);
+      fflush(fp);
+   }
+
+   return success;
+}
+
+
+boolean
+test_all(struct gallivm_state *gallivm, unsigned verbose, FILE *fp)
+{
+   static const unsigned ratios[] = { 1, 2, 4, 8, 16 };
+   struct lp_sampler_static_state iso_state, aniso_state;
+   struct lp_sampler_static_state tiled_iso_state, tiled_aniso_state;
+   struct test_sampler_dynamic_state dynamic_state, tiled_dynamic_state;
+   struct test_texture texture, tiled_texture;
+   LLVMValueRef iso_func, aniso_func;
+   LLVMValueRef tiled_iso_func, tiled_aniso_func;
+   boolean success = TRUE;
+   unsigned i;
+
+   if (!create_texture(&texture)) {
+      destroy_texture(&texture);
+      return FALSE;
+   }
+
+   if (!create_tiled_texture(&tiled_texture, &texture)) {
+      destroy_texture(&tiled_texture);
+      destroy_texture(&texture);
+      return FALSE;
+   }
+
+   init_static_state(&iso_state, 0);
+   init_static_state(&aniso_state, LP_MAX_ANISOTROPY);
+   assert(!iso_state.max_anisotropy);
+   assert(aniso_state.max_anisotropy == LP_MAX_ANISOTROPY);
+
+   tiled_iso_state = iso_state;
+   tiled_iso_state.tiled = 1;
+   tiled_aniso_state = aniso_state;
+   tiled_aniso_state.tiled = 1;
+
+   memset(&dynamic_state, 0, sizeof dynamic_state);
+   dynamic_state.base.width = test_texture_size;
+   dynamic_state.base.height = test_texture_size;
+   dynamic_state.base.depth = test_texture_depth;
+   dynamic_state.base.first_level = test_texture_first_level;
+   dynamic_state.base.last_level = test_texture_last_level;
+   dynamic_state.base.row_stride = test_texture_row_stride;
+   dynamic_state.base.img_stride = test_texture_img_stride;
+   dynamic_state.base.data_ptr = test_texture_data_ptr;
+   dynamic_state.base.min_lod = test_texture_min_lod;
+   dynamic_state.base.max_lod = test_texture_max_lod;
+   dynamic_state.base.lod_bias = test_texture_lod_bias;
+   dynamic_state.base.border_color = test_texture_border_color;
+   dynamic_state.texture = &texture;
+
+   tiled_dynamic_state = dynamic_state;
+   tiled_dynamic_state.texture = &tiled_texture;
+
+   iso_func = add_sample_test(gallivm, verbose, &iso_state,
+                              &dynamic_state.base);
+   aniso_func = add_sample_test(gallivm, verbose, &aniso_state,
+                                &dynamic_state.base);
+   tiled_iso_func = add_sample_test(gallivm, verbose, &tiled_iso_state,
+                                    &tiled_dynamic_state.base);
+   tiled_aniso_func = add_sample_test(gallivm, verbose, &tiled_aniso_state,
+                                      &tiled_dynamic_state.base);
+
+   if (verbose >= 2) {
+      lp_disassemble(LLVMGetPointerToGlobal(gallivm->engine, aniso_func));
+   }
+
+   for (i = 0; i < Elements(ratios); ++i) {
+      if (!test_ratio(gallivm, verbose, fp, &texture,
+                      iso_func, aniso_func, ratios[i]))
+         success = FALSE;
+   }
+
+   if (!test_tiled(gallivm, "isotropic", iso_func, tiled_iso_func))
+      success = FALSE;
+   if (!test_tiled(gallivm, "anisotropic", aniso_func, tiled_aniso_func))
+      success = FALSE;
+
+   LLVMFreeMachineCodeForFunction(gallivm->engine, iso_func);
+   LLVMFreeMachineCodeForFunction(gallivm->engine, aniso_func);
+   LLVMFreeMachineCodeForFunction(gallivm->engine, tiled_iso_func);
+   LLVMFreeMachineCodeForFunction(gallivm->engine, tiled_aniso_func);
+   LLVMDeleteFunction(iso_func);
+   LLVMDeleteFunction(aniso_func);
+   LLVMDeleteFunction(tiled_iso_func);
+   LLVMDeleteFunction(tiled_aniso_func);
+
+   destroy_texture(&tiled_texture);
+   destroy_texture(&texture);
+
+   return success;
+}
+
+
+boolean
+test_some(struct gallivm_state *gallivm, unsigned verbose, FILE *fp,
+          unsigned long n)
+{
+   return test_all(gallivm, verbose, fp);
+}
+
+
+boolean
+test_single(struct gallivm_state *gallivm, unsigned verbose, FILE *fp)
+{
+   printf("no test_single()");
+   return TRUE;
+}
@@ -99,12 +99,29 @@ lp_llvm_texture_member(const struct lp_sampler_dynamic_state *base,
    struct llvmpipe_sampler_dynamic_state *state =
       (struct llvmpipe_sampler_dynamic_state *)base;
    LLVMBuilderRef builder = gallivm->builder;
+   LLVMBasicBlockRef current_block = LLVMGetInsertBlock(builder);
+   LLVMValueRef function = LLVMGetBasicBlockParent(current_block);
+   LLVMBasicBlockRef entry_block = LLVMGetEntryBasicBlock(function);
+   LLVMBuilderRef entry_builder = NULL;
    LLVMValueRef indices[4];
    LLVMValueRef ptr;
    LLVMValueRef res;
 
    assert(unit < PIPE_MAX_SAMPLERS);
 
+   /*
+    * The texture state doesn't change during the call, so emit the code in
+    * the entry block, where it runs once even when the texture is sampled
+    * inside a loop over blocks.  The entry block is terminated already if
+    * we're past it.
+    */
+   if (entry_block != current_block) {
+      entry_builder = LLVMCreateBuilderInContext(gallivm->context);
+      LLVMPositionBuilderBefore(entry_builder,
+                                LLVMGetLastInstruction(entry_block));
+      builder = entry_builder;
+   }
+
    /* context[0] */
    indices[0] = lp_build_const_int32(gallivm, 0);
    /* context[0].textures */
@@ -123,6 +140,9 @@ lp_llvm_texture_member(const struct lp_sampler_dynamic_state *base,
 
    lp_build_name(res, "context.texture%u.%s", unit, member_name);
 
+   if (entry_builder)
+      LLVMDisposeBuilder(entry_builder);
+
    return res;
 }
 
@@ -35,24 +35,48 @@
 #include "pipe/p_context.h"
 #include "pipe/p_defines.h"
 
+#include "util/u_box.h"
 #include "util/u_inlines.h"
 #include "util/u_cpu_detect.h"
+#include "util/u_damage.h"
 #include "util/u_format.h"
 #include "util/u_math.h"
 #include "util/u_memory.h"
+#include "util/u_rect.h"
 #include "util/u_simple_list.h"
 #include "util/u_transfer.h"
+#include "util/u_atomic.h"
 
 #include "lp_context.h"
+#include "lp_debug.h"
 #include "lp_flush.h"
 #include "lp_screen.h"
 #include "lp_tile_image.h"
+#include "lp_tile_soa.h"
 #include "lp_texture.h"
 #include "lp_setup.h"
 #include "lp_state.h"
 
 #include "state_tracker/sw_winsys.h"
 
+#include "gallivm/lp_bld_sample.h"
+
+
+/**
+ * Textures smaller than this, in texels along each axis, fit in the cache
+ * anyway and are always sampled in linear layout.
+ */
+#define SAMPLER_TILING_MIN_SIZE 64
+
+/**
+ * Number of times the sampler images of a texture may be invalidated by
+ * writes before the texture falls back to linear sampling for good.
+ */
+#define SAMPLER_TILING_MAX_REBUILDS 8
+
+static void
+free_sampler_images(struct llvmpipe_resource *lpr);
+
 
 #ifdef DEBUG
 static struct llvmpipe_resource resource_list;
@@ -188,6 +212,52 @@ fail:
 
 
 
+/**
+ * Whether a texture can be sampled through tiled copies of its images (see
+ * llvmpipe_get_texture_sampler_image()).
+ */
+static boolean
+sampler_tiling_supported(const struct llvmpipe_resource *lpr)
+{
+   const struct pipe_resource *pt = &lpr->base;
+   const struct util_format_description *format_desc =
+      util_format_description(pt->format);
+
+   if (LP_PERF & (PERF_TEX_MEM | PERF_NO_TEX_TILING))
+      return FALSE;
+
+   if (!(pt->bind & PIPE_BIND_SAMPLER_VIEW))
+      return FALSE;
+
+   switch (pt->target) {
+   case PIPE_TEXTURE_2D:
+   case PIPE_TEXTURE_RECT:
+   case PIPE_TEXTURE_CUBE:
+   case PIPE_TEXTURE_3D:
+      break;
+   default:
+      return FALSE;
+   }
+
+   if (!format_desc ||
+       format_desc->layout != UTIL_FORMAT_LAYOUT_PLAIN ||
+       format_desc->block.width != 1 ||
+       format_desc->block.height != 1 ||
+       format_desc->block.bits % 8 != 0)
+      return FALSE;
+
+   if (pt->width0 < SAMPLER_TILING_MIN_SIZE ||
+       pt->height0 < SAMPLER_TILING_MIN_SIZE)
+      return FALSE;
+
+   /* The tiled images share the strides of the linear ones */
+   assert(TILE_SIZE % LP_SAMPLER_TILE_SIZE == 0);
+
+   return TRUE;
+}
+
+
+
 static boolean
 llvmpipe_displaytarget_layout(struct llvmpipe_screen *screen,
                               struct llvmpipe_resource *lpr)
@@ -218,8 +288,17 @@ llvmpipe_displaytarget_layout(struct llvmpipe_screen *screen,
                                           width, height,
                                           16,
                                           &lpr->row_stride[0] );
+   if (!lpr->dt)
+      return FALSE;
+
+   if (!util_damage_init(&lpr->damage, lpr->base.width0, lpr->base.height0,
+                         TILE_ORDER)) {
+      winsys->displaytarget_destroy(winsys, lpr->dt);
+      lpr->dt = NULL;
+      return FALSE;
+   }
 
-   return lpr->dt != NULL;
+   return TRUE;
 }
 
 
@@ -250,6 +329,7 @@ llvmpipe_resource_create(struct pipe_screen *_screen,
          if (!llvmpipe_texture_layout(screen, lpr))
             goto fail;
          assert(lpr->layout[0][0] == LP_TEX_LAYOUT_NONE);
+         lpr->sampler_tiled = sampler_tiling_supported(lpr);
       }
       assert(lpr->layout[0]);
    }
@@ -299,6 +379,7 @@ llvmpipe_resource_destroy(struct pipe_screen *pscreen,
       }
 
       FREE(lpr->layout[0]);
+      util_damage_cleanup(&lpr->damage);
    }
    else if (resource_is_texture(pt)) {
       /* regular texture */
@@ -320,6 +401,8 @@ llvmpipe_resource_destroy(struct pipe_screen *pscreen,
          }
       }
 
+      free_sampler_images(lpr);
+
       /* free layout flag arrays */
       for (level = 0; level < Elements(lpr->tiled); level++) {
          FREE(lpr->layout[level]);
@@ -331,6 +414,14 @@ llvmpipe_resource_destroy(struct pipe_screen *pscreen,
       align_free(lpr->data);
    }
 
+   {
+      uint level;
+      for (level = 0; level < Elements(lpr->clear_value); level++) {
+         FREE(lpr->clear_value[level]);
+         lpr->clear_value[level] = NULL;
+      }
+   }
+
 #ifdef DEBUG
    if (lpr->next)
       remove_from_list(lpr);
@@ -358,7 +449,8 @@ llvmpipe_resource_map(struct pipe_resource *resource,
 
    assert(tex_usage == LP_TEX_USAGE_READ ||
           tex_usage == LP_TEX_USAGE_READ_WRITE ||
-          tex_usage == LP_TEX_USAGE_WRITE_ALL);
+          tex_usage == LP_TEX_USAGE_WRITE_ALL ||
+          tex_usage == LP_TEX_USAGE_RENDER);
 
    assert(layout == LP_TEX_LAYOUT_NONE ||
           layout == LP_TEX_LAYOUT_TILED ||
@@ -424,9 +516,11 @@ llvmpipe_resource_unmap(struct pipe_resource *resource,
       assert(level == 0);
       assert(layer == 0);
 
-      /* make sure linear image is up to date */
+      /* make sure linear image is up to date.  Fast cleared tiles are
+       * resolved when presenting, see llvmpipe_flush_frontbuffer().
+       */
       (void) llvmpipe_get_texture_image(lpr, layer, level,
-                                        LP_TEX_USAGE_READ,
+                                        LP_TEX_USAGE_RENDER,
                                         LP_TEX_LAYOUT_LINEAR);
 
       winsys->displaytarget_unmap(winsys, lpr->dt);
@@ -499,6 +593,11 @@ llvmpipe_resource_from_handle(struct pipe_screen *screen,
 
    assert(lpr->layout[0][0] == LP_TEX_LAYOUT_NONE);
 
+   if (!util_damage_init(&lpr->damage, lpr->base.width0, lpr->base.height0,
+                         TILE_ORDER)) {
+      goto no_damage;
+   }
+
    lpr->id = id_counter++;
 
 #ifdef DEBUG
@@ -507,6 +606,8 @@ llvmpipe_resource_from_handle(struct pipe_screen *screen,
 
    return &lpr->base;
 
+no_damage:
+   FREE(lpr->layout[0]);
 no_layout_0:
    winsys->displaytarget_destroy(winsys, lpr->dt);
 no_dt:
@@ -695,6 +796,9 @@ llvmpipe_transfer_map( struct pipe_context *pipe,
       /* Do something to notify sharing contexts of a texture change.
        */
       screen->timestamp++;
+
+      if (lpr->dt)
+         util_damage_box(&lpr->damage, &transfer->box);
    }
 
    map +=
@@ -726,7 +830,8 @@ llvmpipe_is_resource_referenced( struct pipe_context *pipe,
    if (presource->target == PIPE_BUFFER)
       return LP_UNREFERENCED;
 
-   return lp_setup_is_resource_referenced(llvmpipe->setup, presource);
+   return lp_setup_is_resource_referenced(llvmpipe->setup, presource,
+                                          level, layer);
 }
 
 
@@ -943,6 +1048,174 @@ llvmpipe_set_texture_image_layout(struct llvmpipe_resource *lpr,
 }
 
 
+/**
+ * Fill a tile in the swizzled RGBA8 layout of the rasterizer's color
+ * tiles.
+ * Note: if the swizzled tile layout changes (see TILE_PIXEL) this code
+ * will need to change, like lp_rast_clear_color().
+ */
+static void
+fill_swizzled_color_tile(uint8_t *tile, const uint8_t color[4])
+{
+   const unsigned chunk = TILE_SIZE / 4;
+   unsigned j;
+
+   if (color[0] == color[1] &&
+       color[1] == color[2] &&
+       color[2] == color[3]) {
+      memset(tile, color[0], TILE_SIZE * TILE_SIZE * 4);
+      return;
+   }
+
+   for (j = 0; j < 4 * TILE_SIZE; j++) {
+      memset(tile, color[0], chunk);
+      tile += chunk;
+      memset(tile, color[1], chunk);
+      tile += chunk;
+      memset(tile, color[2], chunk);
+      tile += chunk;
+      memset(tile, color[3], chunk);
+      tile += chunk;
+   }
+}
+
+
+/**
+ * Write the pending fast clear value of a face/slice into one of its
+ * tiles, in the given layout.  The caller updates the tile layout.
+ * \param tx, ty  tile position, in tiles
+ */
+static void
+resolve_clear_tile(struct llvmpipe_resource *lpr,
+                   unsigned face_slice, unsigned level,
+                   unsigned tx, unsigned ty,
+                   enum lp_texture_layout layout)
+{
+   const uint32_t clear_value = lpr->clear_value[level][face_slice];
+   const enum pipe_format format = lpr->base.format;
+   const unsigned stride = lpr->row_stride[level];
+   const unsigned x = tx * TILE_SIZE, y = ty * TILE_SIZE;
+   ubyte *image;
+
+   image = llvmpipe_get_texture_image_address(lpr, face_slice, level, layout);
+   if (!image)
+      return;
+
+   if (util_format_is_depth_or_stencil(format)) {
+      union util_color uc;
+      uc.ui = clear_value;
+
+      if (layout == LP_TEX_LAYOUT_TILED) {
+         /* The tiled depth/stencil layout stores TILE_VECTOR_HEIGHT rows
+          * at a time, see lp_linear_to_tiled().
+          */
+         util_fill_rect(image, format,
+                        stride * TILE_VECTOR_HEIGHT,
+                        x * TILE_VECTOR_HEIGHT, y / TILE_VECTOR_HEIGHT,
+                        TILE_SIZE * TILE_VECTOR_HEIGHT,
+                        TILE_SIZE / TILE_VECTOR_HEIGHT,
+                        &uc);
+      }
+      else {
+         util_fill_rect(image, format, stride, x, y,
+                        TILE_SIZE, TILE_SIZE, &uc);
+      }
+   }
+   else if (layout == LP_TEX_LAYOUT_TILED) {
+      const unsigned tile_offset = (ty * lpr->tiles_per_row[level] + tx)
+         * TILE_SIZE * TILE_SIZE * 4;
+      fill_swizzled_color_tile(image + tile_offset,
+                               (const uint8_t *) &clear_value);
+   }
+   else {
+      /* Go through a swizzled tile, so that the result is the same as if
+       * the rasterizer had cleared the tile.
+       */
+      PIPE_ALIGN_VAR(16) uint8_t tile[TILE_SIZE * TILE_SIZE * 4];
+      const unsigned byte_offset = (ty + tx) * TILE_SIZE * TILE_SIZE * 4;
+
+      fill_swizzled_color_tile(tile, (const uint8_t *) &clear_value);
+
+      /* See llvmpipe_unswizzle_cbuf_tile() about the pointer arithmetic */
+      lp_tiled_to_linear(tile - byte_offset, image,
+                         x, y, TILE_SIZE, TILE_SIZE,
+                         format, stride,
+                         1);       /* tiles per row */
+   }
+}
+
+
+/**
+ * Free the sampler images of all levels.
+ */
+static void
+free_sampler_images(struct llvmpipe_resource *lpr)
+{
+   unsigned level;
+
+   for (level = 0; level < Elements(lpr->sampler); level++) {
+      if (lpr->sampler[level].data) {
+         align_free(lpr->sampler[level].data);
+         lpr->sampler[level].data = NULL;
+      }
+   }
+   lpr->sampler_valid = 0;
+}
+
+
+/**
+ * Note that a scene references the texture (and may read its sampler
+ * images).
+ */
+void
+llvmpipe_resource_scene_ref(struct llvmpipe_resource *lpr)
+{
+   p_atomic_inc(&lpr->scene_refs);
+}
+
+
+/**
+ * Note that a scene is done with the texture.  When the last one is,
+ * free the sampler images it stopped using meanwhile.
+ */
+void
+llvmpipe_resource_scene_unref(struct llvmpipe_resource *lpr)
+{
+   if (p_atomic_dec_zero(&lpr->scene_refs) && !lpr->sampler_tiled)
+      free_sampler_images(lpr);
+}
+
+
+/**
+ * Note that a level of the texture is about to be written, so its sampler
+ * image (if any) is stale.
+ *
+ * Textures which keep being written after being sampled (render targets,
+ * streamed uploads) stop using sampler images altogether.  These are
+ * freed once no scene can be reading them anymore.
+ */
+static void
+invalidate_sampler_image(struct llvmpipe_resource *lpr, unsigned level)
+{
+   if (lpr->sampler_valid & (1 << level)) {
+      struct llvmpipe_screen *screen = llvmpipe_screen(lpr->base.screen);
+
+      lpr->sampler_valid &= ~(1 << level);
+
+      if (++lpr->sampler_rebuilds >= SAMPLER_TILING_MAX_REBUILDS) {
+         lpr->sampler_tiled = FALSE;
+         if (p_atomic_read(&lpr->scene_refs) == 0)
+            free_sampler_images(lpr);
+      }
+
+      /* Make the contexts revalidate their sampler views, to rebuild the
+       * image or switch to the linear layout.
+       */
+      screen->timestamp++;
+   }
+}
+
+
 /**
  * Allocate storage for a linear or tile texture image (all cube
  * faces and all 3D slices.
@@ -1019,7 +1292,11 @@ llvmpipe_get_texture_image(struct llvmpipe_resource *lpr,
 
    assert(usage == LP_TEX_USAGE_READ ||
           usage == LP_TEX_USAGE_READ_WRITE ||
-          usage == LP_TEX_USAGE_WRITE_ALL);
+          usage == LP_TEX_USAGE_WRITE_ALL ||
+          usage == LP_TEX_USAGE_RENDER);
+
+   if (usage != LP_TEX_USAGE_READ)
+      invalidate_sampler_image(lpr, level);
 
    /* check for the special case of layout == LP_TEX_LAYOUT_NONE */
    if (layout == LP_TEX_LAYOUT_NONE) {
@@ -1075,8 +1352,10 @@ llvmpipe_get_texture_image(struct llvmpipe_resource *lpr,
       return target_data;
    }
 
-   if (other_data) {
-      /* may need to convert other data to the requested layout */
+   if (other_data || lpr->clear_value[level]) {
+      /* may need to convert other data to the requested layout, or to
+       * resolve fast cleared tiles
+       */
       enum lp_texture_layout new_layout;
       unsigned x, y;
 
@@ -1087,6 +1366,14 @@ llvmpipe_get_texture_image(struct llvmpipe_resource *lpr,
                llvmpipe_get_texture_tile_layout(lpr, face_slice, level, x, y);
             boolean convert;
 
+            if (cur_layout == LP_TEX_LAYOUT_CLEAR) {
+               if (usage == LP_TEX_USAGE_RENDER)
+                  continue;
+               if (usage != LP_TEX_USAGE_WRITE_ALL)
+                  resolve_clear_tile(lpr, face_slice, level, x, y, layout);
+               cur_layout = LP_TEX_LAYOUT_NONE;
+            }
+
             layout_logic(cur_layout, layout, usage, &new_layout, &convert);
 
             if (convert && other_data && target_data) {
@@ -1151,6 +1438,93 @@ llvmpipe_get_texture_image_all(struct llvmpipe_resource *lpr,
 }
 
 
+/**
+ * Copy an image from the linear layout to the tiled layout of the texture
+ * sampler (see LP_SAMPLER_TILE_SIZE).  Both have the same row stride.
+ * \param width  width of the image in texels, multiple of the tile size
+ * \param height  height of the image in texels, multiple of the tile size
+ */
+static void
+linear_to_sampler_tiled(const uint8_t *src, uint8_t *dst,
+                        unsigned width, unsigned height,
+                        unsigned texel_size, unsigned row_stride)
+{
+   const unsigned tile_size = LP_SAMPLER_TILE_SIZE;
+   const unsigned tile_row_size = tile_size * texel_size;
+   unsigned x, y, i;
+
+   for (y = 0; y < height; y += tile_size) {
+      const uint8_t *src_row = src + y * row_stride;
+      uint8_t *dst_tile = dst + y * row_stride;
+
+      for (x = 0; x < width; x += tile_size) {
+         for (i = 0; i < tile_size; i++) {
+            memcpy(dst_tile,
+                   src_row + i * row_stride + x * texel_size,
+                   tile_row_size);
+            dst_tile += tile_row_size;
+         }
+      }
+   }
+}
+
+
+/**
+ * Return pointer to start of the sampler image of a texture level, that is,
+ * a copy of the linear image in the tiled layout of the texture sampler
+ * (see LP_SAMPLER_TILE_SIZE), for all cube faces and 3D slices.
+ * The copy is made if the image was written since it was last made.
+ * This must only be used while lpr->sampler_tiled is set.
+ * \return NULL if out of memory
+ */
+void *
+llvmpipe_get_texture_sampler_image(struct llvmpipe_resource *lpr,
+                                   unsigned level)
+{
+   struct llvmpipe_texture_image *sampler_img = &lpr->sampler[level];
+
+   assert(lpr->sampler_tiled);
+
+   if (!(lpr->sampler_valid & (1 << level))) {
+      const unsigned width = u_minify(lpr->base.width0, level);
+      const unsigned height = u_minify(lpr->base.height0, level);
+      const unsigned texel_size = util_format_get_blocksize(lpr->base.format);
+      const unsigned face_size =
+         tex_image_face_size(lpr, level, LP_TEX_LAYOUT_LINEAR);
+      const uint8_t *linear;
+      unsigned slice;
+
+      linear = llvmpipe_get_texture_image_all(lpr, level, LP_TEX_USAGE_READ,
+                                              LP_TEX_LAYOUT_LINEAR);
+      if (!linear)
+         return NULL;
+
+      if (!sampler_img->data) {
+         uint alignment = MAX2(16, util_cpu_caps.cacheline);
+         sampler_img->data =
+            align_malloc(tex_image_size(lpr, level, LP_TEX_LAYOUT_LINEAR),
+                         alignment);
+         if (!sampler_img->data)
+            return NULL;
+      }
+
+      for (slice = 0; slice < lpr->num_slices_faces[level]; slice++) {
+         linear_to_sampler_tiled(linear + slice * face_size,
+                                 (uint8_t *) sampler_img->data +
+                                 slice * face_size,
+                                 align(width, LP_SAMPLER_TILE_SIZE),
+                                 align(height, LP_SAMPLER_TILE_SIZE),
+                                 texel_size,
+                                 lpr->row_stride[level]);
+      }
+
+      lpr->sampler_valid |= 1 << level;
+   }
+
+   return sampler_img->data;
+}
+
+
 /**
  * Get pointer to a linear image (not the tile!) where the tile at (x,y)
  * is known to be in linear layout.
@@ -1173,6 +1547,9 @@ llvmpipe_get_texture_tile_linear(struct llvmpipe_resource *lpr,
    assert(x % TILE_SIZE == 0);
    assert(y % TILE_SIZE == 0);
 
+   if (usage != LP_TEX_USAGE_READ)
+      invalidate_sampler_image(lpr, level);
+
    if (!linear_img->data) {
       /* allocate memory for the linear image now */
       alloc_image_data(lpr, level, LP_TEX_LAYOUT_LINEAR);
@@ -1187,6 +1564,13 @@ llvmpipe_get_texture_tile_linear(struct llvmpipe_resource *lpr,
    /* get current tile layout and determine if data conversion is needed */
    cur_layout = llvmpipe_get_texture_tile_layout(lpr, face_slice, level, tx, ty);
 
+   if (cur_layout == LP_TEX_LAYOUT_CLEAR) {
+      if (usage != LP_TEX_USAGE_WRITE_ALL)
+         resolve_clear_tile(lpr, face_slice, level, tx, ty,
+                            LP_TEX_LAYOUT_LINEAR);
+      cur_layout = LP_TEX_LAYOUT_NONE;
+   }
+
    layout_logic(cur_layout, LP_TEX_LAYOUT_LINEAR, usage,
                 &new_layout, &convert);
 
@@ -1238,6 +1622,13 @@ llvmpipe_get_texture_tile(struct llvmpipe_resource *lpr,
    /* get current tile layout and see if we need to convert the data */
    cur_layout = llvmpipe_get_texture_tile_layout(lpr, face_slice, level, tx, ty);
 
+   if (cur_layout == LP_TEX_LAYOUT_CLEAR) {
+      if (usage != LP_TEX_USAGE_WRITE_ALL)
+         resolve_clear_tile(lpr, face_slice, level, tx, ty,
+                            LP_TEX_LAYOUT_TILED);
+      cur_layout = LP_TEX_LAYOUT_NONE;
+   }
+
    layout_logic(cur_layout, LP_TEX_LAYOUT_TILED, usage, &new_layout, &convert);
    if (convert && linear_image && tiled_image) {
       lp_linear_to_tiled(linear_image, tiled_image,
@@ -1324,6 +1715,16 @@ llvmpipe_swizzle_cbuf_tile(struct llvmpipe_resource *lpr,
    assert(x % TILE_SIZE == 0);
    assert(y % TILE_SIZE == 0);
 
+   if (llvmpipe_get_texture_tile_layout(lpr, face_slice, level,
+                                        x / TILE_SIZE, y / TILE_SIZE) ==
+       LP_TEX_LAYOUT_CLEAR) {
+      /* the tile was fast cleared, the linear data is stale */
+      fill_swizzled_color_tile(tile,
+                               (const uint8_t *)
+                               &lpr->clear_value[level][face_slice]);
+      return;
+   }
+
    /* compute address of the slice/face of the image that contains the tile */
    linear_image = llvmpipe_get_texture_image_address(lpr, face_slice, level,
                                                      LP_TEX_LAYOUT_LINEAR);
@@ -1348,6 +1749,75 @@ llvmpipe_swizzle_cbuf_tile(struct llvmpipe_resource *lpr,
 }
 
 
+/**
+ * Record a clear of a whole 2D image (cube face or 3D slice) as a fast
+ * clear: all its tiles are marked LP_TEX_LAYOUT_CLEAR, and the clear value
+ * is only written to the tiles which are accessed later.
+ * The rasterizer must be idle.
+ * \param clear_value  RGBA8 color or packed z/stencil value
+ * \return FALSE if out of memory, in which case the image must be cleared
+ *         the slow way
+ */
+boolean
+llvmpipe_fast_clear_image(struct llvmpipe_resource *lpr,
+                          unsigned face_slice, unsigned level,
+                          uint32_t clear_value)
+{
+   const unsigned width = u_minify(lpr->base.width0, level);
+   const unsigned height = u_minify(lpr->base.height0, level);
+   const unsigned width_t = align(width, TILE_SIZE) / TILE_SIZE;
+   const unsigned height_t = align(height, TILE_SIZE) / TILE_SIZE;
+
+   assert(resource_is_texture(&lpr->base));
+   assert(face_slice < lpr->num_slices_faces[level]);
+
+   invalidate_sampler_image(lpr, level);
+
+   if (!lpr->clear_value[level]) {
+      lpr->clear_value[level] =
+         CALLOC(lpr->num_slices_faces[level], sizeof(uint32_t));
+      if (!lpr->clear_value[level])
+         return FALSE;
+   }
+
+   lpr->clear_value[level][face_slice] = clear_value;
+
+   llvmpipe_set_texture_image_layout(lpr, face_slice, level,
+                                     width_t, height_t,
+                                     LP_TEX_LAYOUT_CLEAR);
+
+   if (lpr->dt) {
+      struct pipe_box box;
+      u_box_2d(0, 0, width, height, &box);
+      util_damage_box(&lpr->damage, &box);
+   }
+
+   return TRUE;
+}
+
+
+/**
+ * Write the pending fast clears of all the images of a texture.
+ */
+void
+llvmpipe_resolve_fast_clears(struct llvmpipe_resource *lpr)
+{
+   unsigned level, slice;
+
+   for (level = 0; level < LP_MAX_TEXTURE_LEVELS; level++) {
+      if (!lpr->clear_value[level])
+         continue;
+
+      for (slice = 0; slice < lpr->num_slices_faces[level]; slice++) {
+         (void) llvmpipe_resource_map(&lpr->base, level, slice,
+                                      LP_TEX_USAGE_READ,
+                                      LP_TEX_LAYOUT_LINEAR);
+         llvmpipe_resource_unmap(&lpr->base, level, slice);
+      }
+   }
+}
+
+
 /**
  * Return size of resource in bytes
  */
@@ -1363,6 +1833,9 @@ llvmpipe_resource_size(const struct pipe_resource *resource)
 
       if (lpr->tiled[lvl].data)
          size += tex_image_size(lpr, lvl, LP_TEX_LAYOUT_TILED);
+
+      if (lpr->sampler[lvl].data)
+         size += tex_image_size(lpr, lvl, LP_TEX_LAYOUT_LINEAR);
    }
 
    return size;
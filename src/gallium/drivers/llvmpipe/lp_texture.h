@@ -30,6 +30,7 @@
 
 
 #include "pipe/p_state.h"
+#include "util/u_damage.h"
 #include "util/u_debug.h"
 #include "lp_limits.h"
 
@@ -38,7 +39,9 @@ enum lp_texture_usage
 {
    LP_TEX_USAGE_READ = 100,
    LP_TEX_USAGE_READ_WRITE,
-   LP_TEX_USAGE_WRITE_ALL
+   LP_TEX_USAGE_WRITE_ALL,
+   LP_TEX_USAGE_RENDER      /**< like READ_WRITE, but fast cleared tiles are
+                                 left for the rasterizer to resolve */
 };
 
 
@@ -48,7 +51,8 @@ enum lp_texture_layout
    LP_TEX_LAYOUT_NONE = 0,  /**< no layout for the tile data yet */
    LP_TEX_LAYOUT_TILED,     /**< the tile data is in tiled layout */
    LP_TEX_LAYOUT_LINEAR,    /**< the tile data is in linear layout */
-   LP_TEX_LAYOUT_BOTH       /**< the tile data is in both modes */
+   LP_TEX_LAYOUT_BOTH,      /**< the tile data is in both modes */
+   LP_TEX_LAYOUT_CLEAR      /**< the tile holds the pending fast clear value */
 };
 
 
@@ -101,6 +105,9 @@ struct llvmpipe_resource
     */
    struct sw_displaytarget *dt;
 
+   /** Regions of dt written since it was last displayed */
+   struct util_damage damage;
+
    /**
     * Malloc'ed data for regular textures, or a mapping to dt above.
     */
@@ -115,6 +122,25 @@ struct llvmpipe_resource
    /** array [level][face or slice][tile_y][tile_x] of layout values) */
    enum lp_texture_layout *layout[LP_MAX_TEXTURE_LEVELS];
 
+   /**
+    * array [level][face or slice] of fast clear values, for the tiles in
+    * LP_TEX_LAYOUT_CLEAR.  RGBA8 for color buffers (as in the swizzled
+    * tiles), the packed z/stencil value for depth/stencil buffers.
+    * Allocated on the first fast clear of the level.
+    */
+   uint32_t *clear_value[LP_MAX_TEXTURE_LEVELS];
+
+   /**
+    * Copies of the linear images in the tiled layout of the texture sampler
+    * (see LP_SAMPLER_TILE_SIZE), made when the texture is bound as a
+    * fragment sampler view.
+    */
+   struct llvmpipe_texture_image sampler[LP_MAX_TEXTURE_LEVELS];
+   unsigned sampler_valid;     /**< mask of the up to date sampler images */
+   unsigned sampler_rebuilds;  /**< times a sampler image was invalidated */
+   boolean sampler_tiled;      /**< sample the sampler images? */
+   int32_t scene_refs;         /**< number of scenes referencing the texture */
+
    boolean userBuffer;  /** Is this a user-space buffer? */
    unsigned timestamp;
 
@@ -208,6 +234,16 @@ llvmpipe_get_texture_image_all(struct llvmpipe_resource *lpr,
                                enum lp_texture_usage usage,
                                enum lp_texture_layout layout);
 
+void *
+llvmpipe_get_texture_sampler_image(struct llvmpipe_resource *lpr,
+                                   unsigned level);
+
+void
+llvmpipe_resource_scene_ref(struct llvmpipe_resource *lpr);
+
+void
+llvmpipe_resource_scene_unref(struct llvmpipe_resource *lpr);
+
 ubyte *
 llvmpipe_get_texture_tile_linear(struct llvmpipe_resource *lpr,
                                   unsigned face_slice, unsigned level,
@@ -233,6 +269,14 @@ llvmpipe_swizzle_cbuf_tile(struct llvmpipe_resource *lpr,
                            unsigned x, unsigned y,
                            uint8_t *tile);
 
+boolean
+llvmpipe_fast_clear_image(struct llvmpipe_resource *lpr,
+                          unsigned face_slice, unsigned level,
+                          uint32_t clear_value);
+
+void
+llvmpipe_resolve_fast_clears(struct llvmpipe_resource *lpr);
+
 extern void
 llvmpipe_print_resources(void);
 
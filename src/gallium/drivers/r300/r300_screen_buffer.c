@@ -57,6 +57,8 @@ static void r300_buffer_destroy(struct pipe_screen *screen,
     struct r300_screen *r300screen = r300_screen(screen);
     struct r300_resource *rbuf = r300_resource(buf);
 
+    u_vbuf_resource_destroyed(buf);
+
     if (rbuf->constant_buffer)
         FREE(rbuf->constant_buffer);
 
@@ -108,6 +110,9 @@ r300_buffer_transfer_map( struct pipe_context *pipe,
     struct r300_resource *rbuf = r300_resource(transfer->resource);
     uint8_t *map;
 
+    if (transfer->usage & PIPE_TRANSFER_WRITE)
+        u_vbuf_resource_written(transfer->resource);
+
     if (rbuf->b.user_ptr)
         return (uint8_t *) rbuf->b.user_ptr + transfer->box.x;
     if (rbuf->constant_buffer)
@@ -147,6 +152,8 @@ static void r300_buffer_transfer_inline_write(struct pipe_context *pipe,
     struct r300_resource *rbuf = r300_resource(resource);
     uint8_t *map = NULL;
 
+    u_vbuf_resource_written(resource);
+
     if (rbuf->constant_buffer) {
         memcpy(rbuf->constant_buffer + box->x, data, box->width);
         return;
@@ -187,6 +194,8 @@ struct pipe_resource *r300_buffer_create(struct pipe_screen *screen,
     pipe_reference_init(&rbuf->b.b.b.reference, 1);
     rbuf->b.b.b.screen = screen;
     rbuf->b.user_ptr = NULL;
+    rbuf->b.generation = 0;
+    LIST_INITHEAD(&rbuf->b.translations);
     rbuf->buf = NULL;
     rbuf->constant_buffer = NULL;
 
@@ -239,6 +248,7 @@ struct pipe_resource *r300_user_buffer_create(struct pipe_screen *screen,
     rbuf->b.b.b.flags = 0;
     rbuf->b.b.vtbl = &r300_buffer_vtbl;
     rbuf->b.user_ptr = ptr;
+    LIST_INITHEAD(&rbuf->b.translations);
     rbuf->buf = NULL;
     rbuf->constant_buffer = NULL;
     return &rbuf->b.b.b;
@@ -42,6 +42,8 @@ static void r600_buffer_destroy(struct pipe_screen *screen,
 	struct r600_screen *rscreen = (struct r600_screen*)screen;
 	struct r600_resource *rbuffer = r600_resource(buf);
 
+	u_vbuf_resource_destroyed(buf);
+
 	pb_reference(&rbuffer->buf, NULL);
 	util_slab_free(&rscreen->pool_buffers, rbuffer);
 }
@@ -76,6 +78,9 @@ static void *r600_buffer_transfer_map(struct pipe_context *pipe,
 	struct r600_pipe_context *rctx = (struct r600_pipe_context*)pipe;
 	uint8_t *data;
 
+	if (transfer->usage & PIPE_TRANSFER_WRITE)
+		u_vbuf_resource_written(transfer->resource);
+
 	if (rbuffer->b.user_ptr)
 		return (uint8_t*)rbuffer->b.user_ptr + transfer->box.x;
 
@@ -126,6 +131,8 @@ static void r600_buffer_transfer_inline_write(struct pipe_context *pipe,
 
 	assert(rbuffer->b.user_ptr == NULL);
 
+	u_vbuf_resource_written(resource);
+
 	map = rctx->ws->buffer_map(rbuffer->buf, rctx->ctx.cs,
 				   PIPE_TRANSFER_WRITE | PIPE_TRANSFER_DISCARD | usage);
 
@@ -175,6 +182,8 @@ struct pipe_resource *r600_buffer_create(struct pipe_screen *screen,
 	rbuffer->b.b.b.screen = screen;
 	rbuffer->b.b.vtbl = &r600_buffer_vtbl;
 	rbuffer->b.user_ptr = NULL;
+	rbuffer->b.generation = 0;
+	LIST_INITHEAD(&rbuffer->b.translations);
 
 	if (!r600_init_resource(rscreen, rbuffer, templ->width0, alignment, templ->bind, templ->usage)) {
 		FREE(rbuffer);
@@ -205,6 +214,7 @@ struct pipe_resource *r600_user_buffer_create(struct pipe_screen *screen,
 	rbuffer->b.b.b.array_size = 1;
 	rbuffer->b.b.b.flags = 0;
 	rbuffer->b.user_ptr = ptr;
+	LIST_INITHEAD(&rbuffer->b.translations);
 	rbuffer->buf = NULL;
 	return &rbuffer->b.b.b;
 }
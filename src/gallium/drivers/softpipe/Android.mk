@@ -38,6 +38,7 @@ C_SOURCES = \
 	sp_quad_depth_test.c \
 	sp_quad_fs.c \
 	sp_quad_blend.c \
+	sp_quad_threads.c \
 	sp_screen.c \
         sp_setup.c \
 	sp_state_blend.c \
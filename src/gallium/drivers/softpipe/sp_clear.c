@@ -37,6 +37,7 @@
 #include "sp_clear.h"
 #include "sp_context.h"
 #include "sp_query.h"
+#include "sp_quad_threads.h"
 #include "sp_tile_cache.h"
 
 
@@ -59,6 +60,10 @@ softpipe_clear(struct pipe_context *pipe, unsigned buffers,
    if (!softpipe_check_render_cond(softpipe))
       return;
 
+   /* The per-thread tile caches may hold tiles of the buffers */
+   if (softpipe->quad_threads)
+      sp_quad_threads_finish(softpipe->quad_threads, FALSE);
+
 #if 0
    softpipe_update_derived(softpipe, PIPE_PRIM_TRIANGLES); /* not needed?? */
 #endif
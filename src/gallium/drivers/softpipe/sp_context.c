@@ -50,6 +50,7 @@
 #include "sp_tex_tile_cache.h"
 #include "sp_texture.h"
 #include "sp_query.h"
+#include "sp_quad_threads.h"
 
 
 
@@ -99,6 +100,9 @@ softpipe_destroy( struct pipe_context *pipe )
    pipe_sampler_view_reference(&softpipe->pstipple.sampler_view, NULL);
 #endif
 
+   if (softpipe->quad_threads)
+      sp_quad_threads_destroy( softpipe->quad_threads );
+
    if (softpipe->draw)
       draw_destroy( softpipe->draw );
 
@@ -231,12 +235,21 @@ softpipe_create_context( struct pipe_screen *screen,
 			 void *priv )
 {
    struct softpipe_context *softpipe = CALLOC_STRUCT(softpipe_context);
-   uint i;
+   uint i, num_threads;
 
    util_init_math();
 
    softpipe->dump_fs = debug_get_bool_option( "SOFTPIPE_DUMP_FS", FALSE );
    softpipe->dump_gs = debug_get_bool_option( "SOFTPIPE_DUMP_GS", FALSE );
+   softpipe->dump_cache_stats =
+      debug_get_bool_option( "SOFTPIPE_DUMP_CACHE_STATS", FALSE );
+
+   softpipe->tile_cache_size =
+      debug_get_num_option( "SOFTPIPE_TILE_CACHE_SIZE",
+                            TILE_CACHE_DEFAULT_ENTRIES );
+   softpipe->tex_tile_cache_size =
+      debug_get_num_option( "SOFTPIPE_TEX_TILE_CACHE_SIZE",
+                            TEX_CACHE_DEFAULT_ENTRIES );
 
    softpipe->pipe.winsys = NULL;
    softpipe->pipe.screen = screen;
@@ -272,23 +285,31 @@ softpipe_create_context( struct pipe_screen *screen,
     * Must be before quad stage setup!
     */
    for (i = 0; i < PIPE_MAX_COLOR_BUFS; i++)
-      softpipe->cbuf_cache[i] = sp_create_tile_cache( &softpipe->pipe );
-   softpipe->zsbuf_cache = sp_create_tile_cache( &softpipe->pipe );
+      softpipe->cbuf_cache[i] = sp_create_tile_cache( &softpipe->pipe,
+                                                     softpipe->tile_cache_size );
+   softpipe->zsbuf_cache = sp_create_tile_cache( &softpipe->pipe,
+                                                  softpipe->tile_cache_size );
 
    for (i = 0; i < PIPE_MAX_SAMPLERS; i++) {
-      softpipe->fragment_tex_cache[i] = sp_create_tex_tile_cache( &softpipe->pipe );
+      softpipe->fragment_tex_cache[i] =
+         sp_create_tex_tile_cache( &softpipe->pipe,
+                                   softpipe->tex_tile_cache_size );
       if (!softpipe->fragment_tex_cache[i])
          goto fail;
    }
 
    for (i = 0; i < PIPE_MAX_VERTEX_SAMPLERS; i++) {
-      softpipe->vertex_tex_cache[i] = sp_create_tex_tile_cache( &softpipe->pipe );
+      softpipe->vertex_tex_cache[i] =
+         sp_create_tex_tile_cache( &softpipe->pipe,
+                                   softpipe->tex_tile_cache_size );
       if (!softpipe->vertex_tex_cache[i])
          goto fail;
    }
 
    for (i = 0; i < PIPE_MAX_GEOMETRY_SAMPLERS; i++) {
-      softpipe->geometry_tex_cache[i] = sp_create_tex_tile_cache( &softpipe->pipe );
+      softpipe->geometry_tex_cache[i] =
+         sp_create_tex_tile_cache( &softpipe->pipe,
+                                   softpipe->tex_tile_cache_size );
       if (!softpipe->geometry_tex_cache[i])
          goto fail;
    }
@@ -301,6 +322,12 @@ softpipe_create_context( struct pipe_screen *screen,
    softpipe->quad.blend = sp_quad_blend_stage(softpipe);
    softpipe->quad.pstipple = sp_quad_polygon_stipple_stage(softpipe);
 
+   num_threads = debug_get_num_option( "SOFTPIPE_NUM_THREADS", 0 );
+   if (num_threads) {
+      softpipe->quad_threads = sp_quad_threads_create(softpipe, num_threads);
+      if (!softpipe->quad_threads)
+         goto fail;
+   }
 
    /*
     * Create drawing context and plug our rendering stage into it.
@@ -54,6 +54,7 @@ struct sp_fragment_shader;
 struct sp_vertex_shader;
 struct sp_velems_state;
 struct sp_so_state;
+struct sp_quad_threads;
 
 
 struct softpipe_context {
@@ -164,6 +165,9 @@ struct softpipe_context {
       struct quad_stage *first; /**< points to one of the above stages */
    } quad;
 
+   /** Tile-parallel quad pipeline, NULL if running serially */
+   struct sp_quad_threads *quad_threads;
+
    /** TGSI exec things */
    struct {
       struct sp_sampler_variant *geom_samplers_list[PIPE_MAX_GEOMETRY_SAMPLERS];
@@ -190,8 +194,12 @@ struct softpipe_context {
    struct softpipe_tex_tile_cache *vertex_tex_cache[PIPE_MAX_VERTEX_SAMPLERS];
    struct softpipe_tex_tile_cache *geometry_tex_cache[PIPE_MAX_GEOMETRY_SAMPLERS];
 
+   unsigned tile_cache_size;      /**< entries per color/zs tile cache */
+   unsigned tex_tile_cache_size;  /**< entries per texture tile cache */
+
    unsigned dump_fs : 1;
    unsigned dump_gs : 1;
+   unsigned dump_cache_stats : 1;
    unsigned no_rast : 1;
 };
 
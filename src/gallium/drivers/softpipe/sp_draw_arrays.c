@@ -38,6 +38,7 @@
 
 #include "sp_context.h"
 #include "sp_query.h"
+#include "sp_quad_threads.h"
 #include "sp_state.h"
 #include "sp_texture.h"
 
@@ -90,6 +91,10 @@ softpipe_draw_stream_output(struct pipe_context *pipe, unsigned mode)
     */
    draw_flush(draw);
 
+   /* Quads binned for the worker threads refer to this draw's state */
+   if (sp->quad_threads)
+      sp_quad_threads_run(sp->quad_threads);
+
    /* Note: leave drawing surfaces mapped */
    sp->dirty_render_cache = TRUE;
 }
@@ -157,6 +162,10 @@ softpipe_draw_vbo(struct pipe_context *pipe,
     */
    draw_flush(draw);
 
+   /* Quads binned for the worker threads refer to this draw's state */
+   if (sp->quad_threads)
+      sp_quad_threads_run(sp->quad_threads);
+
    /* Note: leave drawing surfaces mapped */
    sp->dirty_render_cache = TRUE;
 }
@@ -33,13 +33,63 @@
 #include "pipe/p_defines.h"
 #include "pipe/p_screen.h"
 #include "draw/draw_context.h"
+#include "util/u_debug.h"
+#include "util/u_memory.h"
 #include "sp_flush.h"
 #include "sp_context.h"
 #include "sp_state.h"
+#include "sp_quad_threads.h"
 #include "sp_tile_cache.h"
 #include "sp_tex_tile_cache.h"
 
 
+/**
+ * Print and reset the tile cache counters (SOFTPIPE_DUMP_CACHE_STATS).
+ */
+static void
+dump_cache_stats(struct softpipe_context *softpipe)
+{
+   struct softpipe_tile_cache_stats tile_stats;
+   struct softpipe_tex_tile_cache_stats tex_stats;
+   uint64_t tile_total, tex_total;
+   uint i;
+
+   memset(&tile_stats, 0, sizeof tile_stats);
+   memset(&tex_stats, 0, sizeof tex_stats);
+
+   for (i = 0; i < PIPE_MAX_COLOR_BUFS; i++)
+      sp_tile_cache_add_stats(&tile_stats, softpipe->cbuf_cache[i]);
+   sp_tile_cache_add_stats(&tile_stats, softpipe->zsbuf_cache);
+
+   for (i = 0; i < PIPE_MAX_SAMPLERS; i++)
+      sp_tex_tile_cache_add_stats(&tex_stats, softpipe->fragment_tex_cache[i]);
+   for (i = 0; i < PIPE_MAX_VERTEX_SAMPLERS; i++)
+      sp_tex_tile_cache_add_stats(&tex_stats, softpipe->vertex_tex_cache[i]);
+   for (i = 0; i < PIPE_MAX_GEOMETRY_SAMPLERS; i++)
+      sp_tex_tile_cache_add_stats(&tex_stats, softpipe->geometry_tex_cache[i]);
+
+   if (softpipe->quad_threads)
+      sp_quad_threads_add_cache_stats(softpipe->quad_threads,
+                                      &tile_stats, &tex_stats);
+
+   tile_total = tile_stats.hits + tile_stats.misses;
+   tex_total = tex_stats.hits + tex_stats.misses;
+
+   debug_printf("softpipe: tile cache: %llu hits, %llu misses (%.1f%% hit), "
+                "%llu writebacks\n",
+                (unsigned long long) tile_stats.hits,
+                (unsigned long long) tile_stats.misses,
+                tile_total ? 100.0 * tile_stats.hits / tile_total : 0.0,
+                (unsigned long long) tile_stats.writebacks);
+   debug_printf("softpipe: tex cache: %llu hits, %llu misses (%.1f%% hit), "
+                "%llu prefetches\n",
+                (unsigned long long) tex_stats.hits,
+                (unsigned long long) tex_stats.misses,
+                tex_total ? 100.0 * tex_stats.hits / tex_total : 0.0,
+                (unsigned long long) tex_stats.prefetches);
+}
+
+
 void
 softpipe_flush( struct pipe_context *pipe,
                 unsigned flags,
@@ -50,6 +100,9 @@ softpipe_flush( struct pipe_context *pipe,
 
    draw_flush(softpipe->draw);
 
+   if (softpipe->quad_threads)
+      sp_quad_threads_finish(softpipe->quad_threads, TRUE);
+
    if (1 || (flags & SP_FLUSH_TEXTURE_CACHE)) {
       for (i = 0; i < softpipe->num_fragment_sampler_views; i++) {
          sp_flush_tex_tile_cache(softpipe->fragment_tex_cache[i]);
@@ -105,7 +158,12 @@ void
 softpipe_flush_wrapped( struct pipe_context *pipe,
                         struct pipe_fence_handle **fence )
 {
+   struct softpipe_context *softpipe = softpipe_context(pipe);
+
    softpipe_flush(pipe, SP_FLUSH_TEXTURE_CACHE, fence);
+
+   if (softpipe->dump_cache_stats)
+      dump_cache_stats(softpipe);
 }
 
 
@@ -38,5 +38,8 @@
 #define MAX_WIDTH (1 << (SP_MAX_TEXTURE_2D_LEVELS - 1))
 #define MAX_HEIGHT (1 << (SP_MAX_TEXTURE_2D_LEVELS - 1))
 
+/** Max number of threads for the tile-parallel quad pipeline */
+#define SP_MAX_THREADS 16
+
 
 #endif /* SP_LIMITS_H */
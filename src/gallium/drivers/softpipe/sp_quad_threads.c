@@ -0,0 +1,673 @@
+/**************************************************************************
+ *
+ * Copyright 2012 The Mesa authors.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * Tile-parallel quad pipeline.  See sp_quad_threads.h.
+ *
+ * Every worker thread owns a "shadow" softpipe_context.  At the start of
+ * each batch the shadow receives a copy of the real context's rendering
+ * state, while keeping its own quad stages, fragment shader machine,
+ * sampler variants and tile caches.  The regular quad stages are then
+ * run unchanged against the shadow context.
+ */
+
+#include "os/os_thread.h"
+#include "util/u_debug.h"
+#include "util/u_dynarray.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"
+#include "tgsi/tgsi_exec.h"
+
+#include "sp_context.h"
+#include "sp_quad.h"
+#include "sp_quad_pipe.h"
+#include "sp_quad_threads.h"
+#include "sp_state.h"
+#include "sp_tex_sample.h"
+#include "sp_tex_tile_cache.h"
+#include "sp_texture.h"
+#include "sp_tile_cache.h"
+
+
+/** Number of bins: one per row of tiles */
+#define NUM_BINS (MAX_HEIGHT / TILE_SIZE)
+
+/**
+ * Binned data is executed early, in the middle of a draw, once it
+ * exceeds this size.
+ */
+#define MAX_BINNED_BYTES (8 * 1024 * 1024)
+
+
+/**
+ * Header of a quad run in a bin.  Followed by 'nr' sp_binned_quads.
+ */
+struct sp_binned_run
+{
+   unsigned coef_offset;   /**< byte offset into sp_quad_threads::coefs */
+   unsigned nr;
+};
+
+
+struct sp_binned_quad
+{
+   struct quad_header_input input;
+   struct quad_header_inout inout;
+};
+
+
+enum sp_quad_thread_cmd
+{
+   SP_QUAD_THREAD_RUN,
+   SP_QUAD_THREAD_FLUSH,
+   SP_QUAD_THREAD_EXIT
+};
+
+
+/**
+ * Per-thread state.
+ */
+struct sp_quad_thread
+{
+   struct sp_quad_threads *qt;
+   unsigned thread_index;
+
+   /** Shadow context the thread's quad stages run against */
+   struct softpipe_context sp;
+
+   /** Private sampler variants, pointing at sp.fragment_tex_cache[] */
+   struct sp_sampler_variant samplers[PIPE_MAX_SAMPLERS];
+
+   struct quad_header quad[MAX_QUADS];
+   struct quad_header *quad_ptrs[MAX_QUADS];
+
+   pipe_semaphore work_ready;
+   pipe_semaphore work_done;
+};
+
+
+struct sp_quad_threads
+{
+   struct softpipe_context *softpipe;
+
+   unsigned num_threads;
+   struct sp_quad_thread tasks[SP_MAX_THREADS];
+   pipe_thread threads[SP_MAX_THREADS];
+
+   enum sp_quad_thread_cmd cmd;
+   boolean flush_tex_caches;
+
+   /** Binned quad runs, indexed by tile row */
+   struct util_dynarray bins[NUM_BINS];
+   unsigned max_bin;          /**< one past the highest non-empty bin */
+   unsigned binned_bytes;
+
+   /** Snapshots of the setup coefficients, referenced by the runs */
+   struct util_dynarray coefs;
+   int coef_offset;           /**< current snapshot, -1 if none */
+
+   /** Are the per-thread color/zs caches holding tiles? */
+   boolean caches_active;
+};
+
+
+/**
+ * Execute a command on all threads and wait for completion.
+ */
+static void
+run_threads(struct sp_quad_threads *qt, enum sp_quad_thread_cmd cmd)
+{
+   unsigned i;
+
+   qt->cmd = cmd;
+
+   for (i = 0; i < qt->num_threads; i++)
+      pipe_semaphore_signal(&qt->tasks[i].work_ready);
+
+   for (i = 0; i < qt->num_threads; i++)
+      pipe_semaphore_wait(&qt->tasks[i].work_done);
+}
+
+
+/**
+ * Run the thread's quad pipeline over the quads binned for one tile row.
+ */
+static void
+rasterize_bin(struct sp_quad_thread *task, const struct util_dynarray *bin)
+{
+   struct sp_quad_threads *qt = task->qt;
+   struct quad_stage *first = task->sp.quad.first;
+   const ubyte *p = (const ubyte *) bin->data;
+   const ubyte *end = p + bin->size;
+
+   while (p < end) {
+      const struct sp_binned_run *run = (const struct sp_binned_run *) p;
+      const struct sp_binned_quad *bq =
+         (const struct sp_binned_quad *) (run + 1);
+      const struct tgsi_interp_coef *posCoef =
+         (const struct tgsi_interp_coef *)
+         ((const ubyte *) qt->coefs.data + run->coef_offset);
+      unsigned i;
+
+      for (i = 0; i < run->nr; i++) {
+         task->quad[i].input = bq[i].input;
+         task->quad[i].inout = bq[i].inout;
+         task->quad[i].posCoef = posCoef;
+         task->quad[i].coef = posCoef + 1;
+         task->quad_ptrs[i] = &task->quad[i];
+      }
+
+      first->run(first, task->quad_ptrs, run->nr);
+
+      p = (const ubyte *) (bq + run->nr);
+   }
+}
+
+
+/**
+ * Write back the thread's color/zs tiles, and optionally forget its
+ * cached texture tiles.
+ */
+static void
+flush_thread_caches(struct sp_quad_thread *task)
+{
+   struct softpipe_context *sp = &task->sp;
+   unsigned i;
+
+   for (i = 0; i < PIPE_MAX_COLOR_BUFS; i++)
+      sp_flush_tile_cache(sp->cbuf_cache[i]);
+   sp_flush_tile_cache(sp->zsbuf_cache);
+
+   if (task->qt->flush_tex_caches) {
+      for (i = 0; i < PIPE_MAX_SAMPLERS; i++)
+         sp_flush_tex_tile_cache(sp->fragment_tex_cache[i]);
+   }
+}
+
+
+static PIPE_THREAD_ROUTINE( thread_func, init_data )
+{
+   struct sp_quad_thread *task = (struct sp_quad_thread *) init_data;
+   struct sp_quad_threads *qt = task->qt;
+
+   while (1) {
+      unsigned b;
+
+      pipe_semaphore_wait(&task->work_ready);
+
+      if (qt->cmd == SP_QUAD_THREAD_EXIT)
+         break;
+
+      if (qt->cmd == SP_QUAD_THREAD_RUN) {
+         for (b = task->thread_index; b < qt->max_bin; b += qt->num_threads)
+            rasterize_bin(task, &qt->bins[b]);
+      }
+      else {
+         flush_thread_caches(task);
+      }
+
+      pipe_semaphore_signal(&task->work_done);
+   }
+
+   return NULL;
+}
+
+
+/**
+ * Copy the real context's state into a thread's shadow context, keeping
+ * the thread's private objects.
+ */
+static void
+update_thread_state(struct sp_quad_thread *task)
+{
+   struct softpipe_context *softpipe = task->qt->softpipe;
+   struct softpipe_context *sp = &task->sp;
+   struct quad_stage *shade = sp->quad.shade;
+   struct quad_stage *depth_test = sp->quad.depth_test;
+   struct quad_stage *blend = sp->quad.blend;
+   struct quad_stage *pstipple = sp->quad.pstipple;
+   struct tgsi_exec_machine *fs_machine = sp->fs_machine;
+   struct softpipe_tile_cache *cbuf_cache[PIPE_MAX_COLOR_BUFS];
+   struct softpipe_tile_cache *zsbuf_cache = sp->zsbuf_cache;
+   struct softpipe_tex_tile_cache *tex_cache[PIPE_MAX_SAMPLERS];
+   unsigned i;
+
+   memcpy(cbuf_cache, sp->cbuf_cache, sizeof(cbuf_cache));
+   memcpy(tex_cache, sp->fragment_tex_cache, sizeof(tex_cache));
+
+   memcpy(sp, softpipe, sizeof(*sp));
+
+   sp->quad.shade = shade;
+   sp->quad.depth_test = depth_test;
+   sp->quad.blend = blend;
+   sp->quad.pstipple = pstipple;
+   sp->fs_machine = fs_machine;
+   memcpy(sp->cbuf_cache, cbuf_cache, sizeof(cbuf_cache));
+   sp->zsbuf_cache = zsbuf_cache;
+   memcpy(sp->fragment_tex_cache, tex_cache, sizeof(tex_cache));
+   sp->occlusion_count = 0;
+
+   /* Texture tile caches are not thread safe, so each thread samples
+    * through private copies of the sampler variants and caches.
+    */
+   for (i = 0; i < PIPE_MAX_SAMPLERS; i++) {
+      struct softpipe_tex_tile_cache *tc = sp->fragment_tex_cache[i];
+      const struct sp_sampler_variant *v = softpipe->tgsi.frag_samplers_list[i];
+
+      sp_tex_tile_cache_set_sampler_view(tc, softpipe->fragment_sampler_views[i]);
+
+      if (tc->texture) {
+         struct softpipe_resource *spt = softpipe_resource(tc->texture);
+         if (spt->timestamp != tc->timestamp) {
+            sp_tex_tile_cache_validate_texture(tc);
+            tc->timestamp = spt->timestamp;
+         }
+      }
+
+      if (v && softpipe->fragment_sampler_views[i]) {
+         task->samplers[i] = *v;
+         task->samplers[i].cache = tc;
+         tc->prefetch = v->cache->prefetch;
+         task->samplers[i].next = NULL;
+         sp->tgsi.frag_samplers_list[i] = &task->samplers[i];
+      }
+      else {
+         sp->tgsi.frag_samplers_list[i] = NULL;
+      }
+   }
+
+   sp_build_quad_pipeline(sp);
+   sp->quad.first->begin(sp->quad.first);
+}
+
+
+/**
+ * Point the per-thread color/zs caches at the current framebuffer and
+ * split any pending clear between them.
+ */
+static void
+activate_thread_caches(struct sp_quad_threads *qt)
+{
+   struct softpipe_context *softpipe = qt->softpipe;
+   unsigned i, j;
+
+   for (j = 0; j < qt->num_threads; j++) {
+      struct softpipe_context *sp = &qt->tasks[j].sp;
+
+      for (i = 0; i < PIPE_MAX_COLOR_BUFS; i++) {
+         struct pipe_surface *ps = softpipe->framebuffer.cbufs[i];
+
+         sp_tile_cache_set_surface(sp->cbuf_cache[i], ps);
+         if (ps) {
+            sp_tile_cache_move_clear(sp->cbuf_cache[i],
+                                     softpipe->cbuf_cache[i],
+                                     j, qt->num_threads);
+            sp_tile_cache_map_transfers(sp->cbuf_cache[i]);
+         }
+      }
+
+      sp_tile_cache_set_surface(sp->zsbuf_cache, softpipe->framebuffer.zsbuf);
+      if (softpipe->framebuffer.zsbuf) {
+         sp_tile_cache_move_clear(sp->zsbuf_cache, softpipe->zsbuf_cache,
+                                  j, qt->num_threads);
+         sp_tile_cache_map_transfers(sp->zsbuf_cache);
+      }
+   }
+
+   qt->caches_active = TRUE;
+}
+
+
+/**
+ * Called by the setup code before emitting quads with new state.
+ */
+void
+sp_quad_threads_begin(struct sp_quad_threads *qt)
+{
+   unsigned i;
+
+   /* Anything binned so far was set up with the previous state */
+   sp_quad_threads_run(qt);
+
+   if (!qt->caches_active)
+      activate_thread_caches(qt);
+
+   for (i = 0; i < qt->num_threads; i++)
+      update_thread_state(&qt->tasks[i]);
+}
+
+
+/**
+ * Bin a run of quads produced by the setup code.
+ * \param new_coefs  the quads' coefficients changed since the last call
+ */
+void
+sp_quad_threads_bin(struct sp_quad_threads *qt,
+                    struct quad_header *quads[],
+                    unsigned nr,
+                    boolean new_coefs)
+{
+   struct sp_binned_run *run;
+   struct sp_binned_quad *bq;
+   unsigned b, i, size;
+
+   assert(nr <= MAX_QUADS);
+
+   if (qt->binned_bytes > MAX_BINNED_BYTES)
+      sp_quad_threads_run(qt);
+
+   if (new_coefs || qt->coef_offset < 0) {
+      const unsigned num_inputs =
+         qt->softpipe->fs_variant->info.num_inputs;
+      struct tgsi_interp_coef *dst;
+
+      qt->coef_offset = qt->coefs.size;
+      size = (1 + num_inputs) * sizeof(struct tgsi_interp_coef);
+      dst = (struct tgsi_interp_coef *) util_dynarray_grow(&qt->coefs, size);
+      dst[0] = *quads[0]->posCoef;
+      memcpy(dst + 1, quads[0]->coef,
+             num_inputs * sizeof(struct tgsi_interp_coef));
+      qt->binned_bytes += size;
+   }
+
+   /* All the quads of a run lie in the same row of quads */
+   b = MAX2(quads[0]->input.y0, 0) >> TILE_SIZE_LOG2;
+   assert(b < NUM_BINS);
+
+   size = sizeof(*run) + nr * sizeof(*bq);
+   run = (struct sp_binned_run *) util_dynarray_grow(&qt->bins[b], size);
+   run->coef_offset = qt->coef_offset;
+   run->nr = nr;
+
+   bq = (struct sp_binned_quad *) (run + 1);
+   for (i = 0; i < nr; i++) {
+      bq[i].input = quads[i]->input;
+      bq[i].inout = quads[i]->inout;
+   }
+
+   qt->max_bin = MAX2(qt->max_bin, b + 1);
+   qt->binned_bytes += size;
+}
+
+
+/**
+ * Execute all binned quads and wait for completion.
+ */
+void
+sp_quad_threads_run(struct sp_quad_threads *qt)
+{
+   unsigned i;
+
+   if (!qt->max_bin)
+      return;
+
+   run_threads(qt, SP_QUAD_THREAD_RUN);
+
+   for (i = 0; i < qt->num_threads; i++) {
+      qt->softpipe->occlusion_count += qt->tasks[i].sp.occlusion_count;
+      qt->tasks[i].sp.occlusion_count = 0;
+   }
+
+   /* keep the allocations for the next batch */
+   for (i = 0; i < qt->max_bin; i++)
+      qt->bins[i].size = 0;
+   qt->coefs.size = 0;
+   qt->coef_offset = -1;
+   qt->max_bin = 0;
+   qt->binned_bytes = 0;
+}
+
+
+/**
+ * Execute all binned quads and write the per-thread color/zs tiles back
+ * to the surfaces, so that they can be accessed by other means.
+ */
+void
+sp_quad_threads_finish(struct sp_quad_threads *qt,
+                       boolean flush_tex_caches)
+{
+   unsigned i, j;
+
+   sp_quad_threads_run(qt);
+
+   if (!qt->caches_active && !flush_tex_caches)
+      return;
+
+   qt->flush_tex_caches = flush_tex_caches;
+   run_threads(qt, SP_QUAD_THREAD_FLUSH);
+
+   for (j = 0; j < qt->num_threads; j++) {
+      struct softpipe_context *sp = &qt->tasks[j].sp;
+
+      for (i = 0; i < PIPE_MAX_COLOR_BUFS; i++)
+         sp_tile_cache_unmap_transfers(sp->cbuf_cache[i]);
+      sp_tile_cache_unmap_transfers(sp->zsbuf_cache);
+   }
+
+   qt->caches_active = FALSE;
+}
+
+
+static void
+destroy_thread_objects(struct sp_quad_thread *task)
+{
+   struct softpipe_context *sp = &task->sp;
+   unsigned i;
+
+   if (sp->quad.shade)
+      sp->quad.shade->destroy(sp->quad.shade);
+   if (sp->quad.depth_test)
+      sp->quad.depth_test->destroy(sp->quad.depth_test);
+   if (sp->quad.blend)
+      sp->quad.blend->destroy(sp->quad.blend);
+   if (sp->quad.pstipple)
+      sp->quad.pstipple->destroy(sp->quad.pstipple);
+
+   for (i = 0; i < PIPE_MAX_COLOR_BUFS; i++) {
+      if (sp->cbuf_cache[i]) {
+         sp_tile_cache_set_surface(sp->cbuf_cache[i], NULL);
+         sp_destroy_tile_cache(sp->cbuf_cache[i]);
+      }
+   }
+   if (sp->zsbuf_cache) {
+      sp_tile_cache_set_surface(sp->zsbuf_cache, NULL);
+      sp_destroy_tile_cache(sp->zsbuf_cache);
+   }
+
+   for (i = 0; i < PIPE_MAX_SAMPLERS; i++) {
+      if (sp->fragment_tex_cache[i]) {
+         sp_tex_tile_cache_set_sampler_view(sp->fragment_tex_cache[i], NULL);
+         sp_destroy_tex_tile_cache(sp->fragment_tex_cache[i]);
+      }
+   }
+
+   if (sp->fs_machine)
+      tgsi_exec_machine_destroy(sp->fs_machine);
+}
+
+
+static boolean
+create_thread_objects(struct sp_quad_threads *qt, struct sp_quad_thread *task)
+{
+   struct softpipe_context *softpipe = qt->softpipe;
+   struct softpipe_context *sp = &task->sp;
+   unsigned i;
+
+   task->qt = qt;
+
+   /* Caches go through the real context for their transfers */
+   for (i = 0; i < PIPE_MAX_COLOR_BUFS; i++) {
+      sp->cbuf_cache[i] = sp_create_tile_cache(&softpipe->pipe,
+                                               softpipe->tile_cache_size);
+      if (!sp->cbuf_cache[i])
+         return FALSE;
+   }
+   sp->zsbuf_cache = sp_create_tile_cache(&softpipe->pipe,
+                                          softpipe->tile_cache_size);
+   if (!sp->zsbuf_cache)
+      return FALSE;
+
+   for (i = 0; i < PIPE_MAX_SAMPLERS; i++) {
+      sp->fragment_tex_cache[i] =
+         sp_create_tex_tile_cache(&softpipe->pipe,
+                                  softpipe->tex_tile_cache_size);
+      if (!sp->fragment_tex_cache[i])
+         return FALSE;
+   }
+
+   sp->fs_machine = tgsi_exec_machine_create();
+   if (!sp->fs_machine)
+      return FALSE;
+
+   sp->quad.shade = sp_quad_shade_stage(sp);
+   sp->quad.depth_test = sp_quad_depth_test_stage(sp);
+   sp->quad.blend = sp_quad_blend_stage(sp);
+   sp->quad.pstipple = sp_quad_polygon_stipple_stage(sp);
+   if (!sp->quad.shade || !sp->quad.depth_test ||
+       !sp->quad.blend || !sp->quad.pstipple)
+      return FALSE;
+
+   return TRUE;
+}
+
+
+/**
+ * Create the worker threads and their private quad pipelines.
+ */
+struct sp_quad_threads *
+sp_quad_threads_create(struct softpipe_context *softpipe,
+                       unsigned num_threads)
+{
+   struct sp_quad_threads *qt;
+   unsigned i;
+
+   assert(num_threads > 0);
+   num_threads = MIN2(num_threads, SP_MAX_THREADS);
+
+   qt = CALLOC_STRUCT(sp_quad_threads);
+   if (!qt)
+      return NULL;
+
+   qt->softpipe = softpipe;
+   qt->coef_offset = -1;
+
+   for (i = 0; i < num_threads; i++) {
+      struct sp_quad_thread *task = &qt->tasks[i];
+
+      task->thread_index = i;
+      if (!create_thread_objects(qt, task)) {
+         destroy_thread_objects(task);
+         goto fail;
+      }
+      qt->num_threads++;
+   }
+
+   for (i = 0; i < qt->num_threads; i++) {
+      pipe_semaphore_init(&qt->tasks[i].work_ready, 0);
+      pipe_semaphore_init(&qt->tasks[i].work_done, 0);
+      qt->threads[i] = pipe_thread_create(thread_func, &qt->tasks[i]);
+   }
+
+   return qt;
+
+fail:
+   for (i = 0; i < qt->num_threads; i++)
+      destroy_thread_objects(&qt->tasks[i]);
+   FREE(qt);
+   return NULL;
+}
+
+
+/**
+ * Unbind the fragment shader from the threads' shader machines, which
+ * only rebind when the token pointer changes.  Called when a shader is
+ * deleted, as a new shader's tokens may be allocated at the same address.
+ * Threads must be idle.
+ */
+void
+sp_quad_threads_unbind_fs(struct sp_quad_threads *qt)
+{
+   unsigned i;
+
+   for (i = 0; i < qt->num_threads; i++) {
+      struct tgsi_exec_machine *machine = qt->tasks[i].sp.fs_machine;
+
+      if (machine->Tokens)
+         tgsi_exec_machine_bind_shader(machine, NULL, 0, NULL);
+   }
+}
+
+
+/**
+ * Add the counters of the per-thread tile caches to the given sums.
+ * Threads must be idle (after sp_quad_threads_finish).
+ */
+void
+sp_quad_threads_add_cache_stats(struct sp_quad_threads *qt,
+                                struct softpipe_tile_cache_stats *tile_stats,
+                                struct softpipe_tex_tile_cache_stats *tex_stats)
+{
+   unsigned i, j;
+
+   for (i = 0; i < qt->num_threads; i++) {
+      struct softpipe_context *sp = &qt->tasks[i].sp;
+
+      for (j = 0; j < PIPE_MAX_COLOR_BUFS; j++)
+         sp_tile_cache_add_stats(tile_stats, sp->cbuf_cache[j]);
+      sp_tile_cache_add_stats(tile_stats, sp->zsbuf_cache);
+
+      for (j = 0; j < PIPE_MAX_SAMPLERS; j++)
+         sp_tex_tile_cache_add_stats(tex_stats, sp->fragment_tex_cache[j]);
+   }
+}
+
+
+void
+sp_quad_threads_destroy(struct sp_quad_threads *qt)
+{
+   unsigned i;
+
+   sp_quad_threads_finish(qt, TRUE);
+
+   /* Signal each thread to break out of its main loop and exit */
+   qt->cmd = SP_QUAD_THREAD_EXIT;
+   for (i = 0; i < qt->num_threads; i++)
+      pipe_semaphore_signal(&qt->tasks[i].work_ready);
+
+   for (i = 0; i < qt->num_threads; i++) {
+      pipe_thread_wait(qt->threads[i]);
+      pipe_semaphore_destroy(&qt->tasks[i].work_ready);
+      pipe_semaphore_destroy(&qt->tasks[i].work_done);
+      destroy_thread_objects(&qt->tasks[i]);
+   }
+
+   for (i = 0; i < NUM_BINS; i++)
+      util_dynarray_fini(&qt->bins[i]);
+   util_dynarray_fini(&qt->coefs);
+
+   FREE(qt);
+}
@@ -0,0 +1,88 @@
+/**************************************************************************
+ *
+ * Copyright 2012 The Mesa authors.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * Tile-parallel quad pipeline.
+ *
+ * When enabled (SOFTPIPE_NUM_THREADS > 0) the setup code doesn't run the
+ * quad pipeline directly.  Instead, quad runs are binned by screen tile
+ * row and, at the end of each draw, every worker thread runs a private
+ * quad pipeline (fragment shader machine, depth/blend stages, color/zs
+ * and texture tile caches) over the tile rows it owns.
+ *
+ * Each tile row belongs to exactly one thread and quad runs never cross
+ * tile rows, so every pixel sees the same quads, in the same order and
+ * with the same interpolation start points as in the serial path.
+ */
+
+#ifndef SP_QUAD_THREADS_H
+#define SP_QUAD_THREADS_H
+
+
+#include "pipe/p_compiler.h"
+
+
+struct softpipe_context;
+struct sp_quad_threads;
+struct quad_header;
+struct softpipe_tile_cache_stats;
+struct softpipe_tex_tile_cache_stats;
+
+
+struct sp_quad_threads *
+sp_quad_threads_create(struct softpipe_context *softpipe,
+                       unsigned num_threads);
+
+void
+sp_quad_threads_destroy(struct sp_quad_threads *qt);
+
+void
+sp_quad_threads_begin(struct sp_quad_threads *qt);
+
+void
+sp_quad_threads_bin(struct sp_quad_threads *qt,
+                    struct quad_header *quads[],
+                    unsigned nr,
+                    boolean new_coefs);
+
+void
+sp_quad_threads_run(struct sp_quad_threads *qt);
+
+void
+sp_quad_threads_finish(struct sp_quad_threads *qt,
+                       boolean flush_tex_caches);
+
+void
+sp_quad_threads_unbind_fs(struct sp_quad_threads *qt);
+
+void
+sp_quad_threads_add_cache_stats(struct sp_quad_threads *qt,
+                                struct softpipe_tile_cache_stats *tile_stats,
+                                struct softpipe_tex_tile_cache_stats *tex_stats);
+
+
+#endif /* SP_QUAD_THREADS_H */
@@ -306,8 +306,16 @@ softpipe_flush_frontbuffer(struct pipe_screen *_screen,
    struct softpipe_resource *texture = softpipe_resource(resource);
 
    assert(texture->dt);
-   if (texture->dt)
-      winsys->displaytarget_display(winsys, texture->dt, context_private);
+   if (texture->dt) {
+      struct pipe_box boxes[UTIL_DAMAGE_MAX_BOXES];
+      unsigned num_boxes;
+
+      num_boxes = util_damage_get_boxes(&texture->damage, boxes,
+                                        Elements(boxes));
+
+      winsys->displaytarget_display(winsys, texture->dt, context_private,
+                                    boxes, num_boxes);
+   }
 }
 
 /**
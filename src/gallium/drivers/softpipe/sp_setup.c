@@ -35,6 +35,7 @@
 #include "sp_context.h"
 #include "sp_quad.h"
 #include "sp_quad_pipe.h"
+#include "sp_quad_threads.h"
 #include "sp_setup.h"
 #include "sp_state.h"
 #include "draw/draw_context.h"
@@ -60,14 +61,6 @@ struct edge {
 };
 
 
-/**
- * Max number of quads (2x2 pixel blocks) to process per batch.
- * This can't be arbitrarily increased since we depend on some 32-bit
- * bitmasks (two bits per quad).
- */
-#define MAX_QUADS 16
-
-
 /**
  * Triangle setup info.
  * Also used for line drawing (taking some liberties).
@@ -99,6 +92,7 @@ struct setup_context {
 
    struct tgsi_interp_coef coef[PIPE_MAX_SHADER_INPUTS];
    struct tgsi_interp_coef posCoef;  /* For Z, W */
+   boolean new_coefs;  /**< coef[] changed since quads were last binned */
 
    struct {
       int left[2];   /**< [0] = row0, [1] = row1 */
@@ -152,6 +146,26 @@ quad_clip(struct setup_context *setup, struct quad_header *quad)
 }
 
 
+/**
+ * Pass a run of quads to the quad pipeline, or bin them for the worker
+ * threads.
+ */
+static INLINE void
+emit_quads(struct setup_context *setup, struct quad_header *quads[],
+           unsigned nr)
+{
+   struct softpipe_context *sp = setup->softpipe;
+
+   if (sp->quad_threads) {
+      sp_quad_threads_bin(sp->quad_threads, quads, nr, setup->new_coefs);
+      setup->new_coefs = FALSE;
+   }
+   else {
+      sp->quad.first->run( sp->quad.first, quads, nr );
+   }
+}
+
+
 /**
  * Emit a quad (pass to next stage) with clipping.
  */
@@ -161,9 +175,7 @@ clip_emit_quad(struct setup_context *setup, struct quad_header *quad)
    quad_clip( setup, quad );
 
    if (quad->inout.mask) {
-      struct softpipe_context *sp = setup->softpipe;
-
-      sp->quad.first->run( sp->quad.first, &quad, 1 );
+      emit_quads( setup, &quad, 1 );
    }
 }
 
@@ -198,7 +210,6 @@ flush_spans(struct setup_context *setup)
    const int xleft1 = setup->span.left[1];
    const int xright0 = setup->span.right[0];
    const int xright1 = setup->span.right[1];
-   struct quad_stage *pipe = setup->softpipe->quad.first;
 
    const int minleft = block_x(MIN2(xleft0, xleft1));
    const int maxright = MAX2(xright0, xright1);
@@ -240,7 +251,7 @@ flush_spans(struct setup_context *setup)
             lx += 2;
          } while (mask0 | mask1);
 
-         pipe->run( pipe, setup->quad_ptrs, q );
+         emit_quads( setup, setup->quad_ptrs, q );
       }
    }
 
@@ -605,6 +616,8 @@ setup_tri_coefficients(struct setup_context *setup)
    uint fragSlot;
    float v[3];
 
+   setup->new_coefs = TRUE;
+
    /* z and w are done by linear interpolation:
     */
    v[0] = setup->vmin[0][2];
@@ -962,6 +975,7 @@ setup_line_coefficients(struct setup_context *setup,
    if (area == 0.0f || util_is_inf_or_nan(area))
       return FALSE;
    setup->oneoverarea = 1.0f / area;
+   setup->new_coefs = TRUE;
 
    /* z and w are done by linear interpolation:
     */
@@ -1228,6 +1242,7 @@ sp_setup_point(struct setup_context *setup,
     * probably should be ruled out on that basis.
     */
    setup->vprovoke = v0;
+   setup->new_coefs = TRUE;
 
    /* setup Z, W */
    const_coeff(setup, &setup->posCoef, 0, 2);
@@ -1403,7 +1418,10 @@ sp_setup_prepare(struct setup_context *setup)
    /* Note: nr_attrs is only used for debugging (vertex printing) */
    setup->nr_vertex_attrs = draw_num_shader_outputs(sp->draw);
 
-   sp->quad.first->begin( sp->quad.first );
+   if (sp->quad_threads)
+      sp_quad_threads_begin( sp->quad_threads );
+   else
+      sp->quad.first->begin( sp->quad.first );
 
    if (sp->reduced_api_prim == PIPE_PRIM_TRIANGLES &&
        sp->rasterizer->fill_front == PIPE_POLYGON_MODE_FILL &&
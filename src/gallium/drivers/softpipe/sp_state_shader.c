@@ -29,6 +29,7 @@
 #include "sp_state.h"
 #include "sp_fs.h"
 #include "sp_texture.h"
+#include "sp_quad_threads.h"
 
 #include "pipe/p_defines.h"
 #include "util/u_memory.h"
@@ -187,6 +188,9 @@ softpipe_delete_fs_state(struct pipe_context *pipe, void *fs)
       tgsi_exec_machine_bind_shader(softpipe->fs_machine, NULL, 0, NULL);
    }
 
+   if (softpipe->quad_threads)
+      sp_quad_threads_unbind_fs(softpipe->quad_threads);
+
    /* delete variants */
    for (var = state->variants; var; var = next_var) {
       next_var = var->next;
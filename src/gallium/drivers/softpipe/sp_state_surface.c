@@ -30,6 +30,7 @@
 
 #include "sp_context.h"
 #include "sp_state.h"
+#include "sp_quad_threads.h"
 #include "sp_tile_cache.h"
 
 #include "draw/draw_context.h"
@@ -53,6 +54,9 @@ softpipe_set_framebuffer_state(struct pipe_context *pipe,
 
    draw_flush(sp->draw);
 
+   if (sp->quad_threads)
+      sp_quad_threads_finish(sp->quad_threads, FALSE);
+
    for (i = 0; i < PIPE_MAX_COLOR_BUFS; i++) {
       /* check if changing cbuf */
       if (sp->framebuffer.cbufs[i] != fb->cbufs[i]) {
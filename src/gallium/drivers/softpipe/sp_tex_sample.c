@@ -2352,6 +2352,29 @@ sample_swizzle(struct tgsi_sampler *tgsi_sampler,
 }
 
 
+/**
+ * Sample a quad, then prefetch around the tiles it missed.  The filters
+ * hold pointers into the cached tiles until they're done, so prefetching
+ * has to wait until here.
+ */
+static void
+sample_prefetch(struct tgsi_sampler *tgsi_sampler,
+                const float s[QUAD_SIZE],
+                const float t[QUAD_SIZE],
+                const float p[QUAD_SIZE],
+                const float c0[QUAD_SIZE],
+                enum tgsi_sampler_control control,
+                float rgba[NUM_CHANNELS][QUAD_SIZE])
+{
+   struct sp_sampler_variant *samp = sp_sampler_variant(tgsi_sampler);
+
+   samp->sample_quad(tgsi_sampler, s, t, p, c0, control, rgba);
+
+   if (samp->cache->num_pending)
+      sp_tex_tile_cache_run_prefetches(samp->cache);
+}
+
+
 static wrap_nearest_func
 get_nearest_unorm_wrap(unsigned mode)
 {
@@ -2551,12 +2574,26 @@ sp_sampler_variant_bind_view( struct sp_sampler_variant *samp,
                               const struct pipe_sampler_view *view )
 {
    const struct pipe_resource *texture = view->texture;
+   const struct pipe_sampler_state *sampler = samp->sampler;
 
    samp->view = view;
    samp->cache = tex_cache;
    samp->xpot = util_logbase2( texture->width0 );
    samp->ypot = util_logbase2( texture->height0 );
    samp->level = view->u.tex.first_level;
+
+   /* Linear filters touch the neighbor tiles and the next mipmap level,
+    * have the cache load those along with the missed tile.
+    */
+   tex_cache->prefetch = 0;
+   if (sampler->min_img_filter == PIPE_TEX_FILTER_LINEAR ||
+       sampler->mag_img_filter == PIPE_TEX_FILTER_LINEAR)
+      tex_cache->prefetch |= TEX_PREFETCH_NEIGHBORS;
+   if (sampler->min_mip_filter == PIPE_TEX_MIPFILTER_LINEAR)
+      tex_cache->prefetch |= TEX_PREFETCH_MIPMAP;
+
+   samp->base.get_samples = tex_cache->prefetch ? sample_prefetch
+                                                : samp->sample_quad;
 }
 
 
@@ -2800,12 +2837,14 @@ sp_create_sampler_variant( const struct pipe_sampler_state *sampler,
        key.bits.swizzle_g != PIPE_SWIZZLE_GREEN ||
        key.bits.swizzle_b != PIPE_SWIZZLE_BLUE ||
        key.bits.swizzle_a != PIPE_SWIZZLE_ALPHA) {
-      samp->base.get_samples = sample_swizzle;
+      samp->sample_quad = sample_swizzle;
    }
    else {
-      samp->base.get_samples = samp->sample_target;
+      samp->sample_quad = samp->sample_target;
    }
 
+   samp->base.get_samples = samp->sample_quad;
+
    samp->base.get_dims = sample_get_dims;
    samp->base.get_texel = sample_get_texels;
    return samp;
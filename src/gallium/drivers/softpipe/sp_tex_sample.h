@@ -118,6 +118,7 @@ struct sp_sampler_variant
    filter_func mip_filter;
    filter_func compare;
    filter_func sample_target;
+   filter_func sample_quad;   /**< get_samples without the prefetching */
    
    /* Linked list:
     */
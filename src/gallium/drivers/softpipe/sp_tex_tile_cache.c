@@ -44,7 +44,7 @@
    
 
 struct softpipe_tex_tile_cache *
-sp_create_tex_tile_cache( struct pipe_context *pipe )
+sp_create_tex_tile_cache( struct pipe_context *pipe, unsigned num_entries )
 {
    struct softpipe_tex_tile_cache *tc;
    uint pos;
@@ -55,31 +55,58 @@ sp_create_tex_tile_cache( struct pipe_context *pipe )
    tc = CALLOC_STRUCT( softpipe_tex_tile_cache );
    if (tc) {
       tc->pipe = pipe;
-      for (pos = 0; pos < NUM_ENTRIES; pos++) {
+      tc->num_sets = MAX2(num_entries / TEX_CACHE_WAYS, 1);
+      tc->num_entries = tc->num_sets * TEX_CACHE_WAYS;
+      tc->entries = CALLOC(tc->num_entries,
+                           sizeof(struct softpipe_tex_cached_tile));
+      if (!tc->entries) {
+         FREE(tc);
+         return NULL;
+      }
+      for (pos = 0; pos < tc->num_entries; pos++) {
          tc->entries[pos].addr.bits.invalid = 1;
       }
+      tc->lru_counter = 1;
       tc->last_tile = &tc->entries[0]; /* any tile */
    }
    return tc;
 }
 
 
+/**
+ * Unmap and destroy the transfers of all levels.
+ */
+static void
+tex_cache_release_transfers(struct softpipe_tex_tile_cache *tc)
+{
+   unsigned level;
+
+   for (level = 0; level < SP_MAX_TEXTURE_2D_LEVELS; level++) {
+      struct softpipe_tex_level_transfer *lt = &tc->tex_trans[level];
+
+      if (lt->trans) {
+         if (lt->map) {
+            tc->pipe->transfer_unmap(tc->pipe, lt->trans);
+            lt->map = NULL;
+         }
+
+         tc->pipe->transfer_destroy(tc->pipe, lt->trans);
+         lt->trans = NULL;
+      }
+   }
+}
+
+
 void
 sp_destroy_tex_tile_cache(struct softpipe_tex_tile_cache *tc)
 {
    if (tc) {
-      uint pos;
-
-      for (pos = 0; pos < NUM_ENTRIES; pos++) {
-         /*assert(tc->entries[pos].x < 0);*/
-      }
       if (tc->transfer) {
          tc->pipe->transfer_destroy(tc->pipe, tc->transfer);
       }
-      if (tc->tex_trans) {
-         tc->pipe->transfer_destroy(tc->pipe, tc->tex_trans);
-      }
+      tex_cache_release_transfers(tc);
 
+      FREE( tc->entries );
       FREE( tc );
    }
 }
@@ -90,17 +117,29 @@ sp_destroy_tex_tile_cache(struct softpipe_tex_tile_cache *tc)
 void
 sp_tex_tile_cache_map_transfers(struct softpipe_tex_tile_cache *tc)
 {
-   if (tc->tex_trans && !tc->tex_trans_map)
-      tc->tex_trans_map = tc->pipe->transfer_map(tc->pipe, tc->tex_trans);
+   unsigned level;
+
+   for (level = 0; level < SP_MAX_TEXTURE_2D_LEVELS; level++) {
+      struct softpipe_tex_level_transfer *lt = &tc->tex_trans[level];
+
+      if (lt->trans && !lt->map)
+         lt->map = tc->pipe->transfer_map(tc->pipe, lt->trans);
+   }
 }
 
 
 void
 sp_tex_tile_cache_unmap_transfers(struct softpipe_tex_tile_cache *tc)
 {
-   if (tc->tex_trans_map) {
-      tc->pipe->transfer_unmap(tc->pipe, tc->tex_trans);
-      tc->tex_trans_map = NULL;
+   unsigned level;
+
+   for (level = 0; level < SP_MAX_TEXTURE_2D_LEVELS; level++) {
+      struct softpipe_tex_level_transfer *lt = &tc->tex_trans[level];
+
+      if (lt->map) {
+         tc->pipe->transfer_unmap(tc->pipe, lt->trans);
+         lt->map = NULL;
+      }
    }
 }
 
@@ -116,9 +155,10 @@ sp_tex_tile_cache_validate_texture(struct softpipe_tex_tile_cache *tc)
    assert(tc);
    assert(tc->texture);
 
-   for (i = 0; i < NUM_ENTRIES; i++) {
+   for (i = 0; i < tc->num_entries; i++) {
       tc->entries[i].addr.bits.invalid = 1;
    }
+   tc->num_pending = 0;
 }
 
 static boolean
@@ -150,15 +190,7 @@ sp_tex_tile_cache_set_sampler_view(struct softpipe_tex_tile_cache *tc,
    if (!sp_tex_tile_is_compat_view(tc, view)) {
       pipe_resource_reference(&tc->texture, texture);
 
-      if (tc->tex_trans) {
-         if (tc->tex_trans_map) {
-            tc->pipe->transfer_unmap(tc->pipe, tc->tex_trans);
-            tc->tex_trans_map = NULL;
-         }
-
-         tc->pipe->transfer_destroy(tc->pipe, tc->tex_trans);
-         tc->tex_trans = NULL;
-      }
+      tex_cache_release_transfers(tc);
 
       if (view) {
          tc->swizzle_r = view->swizzle_r;
@@ -170,11 +202,11 @@ sp_tex_tile_cache_set_sampler_view(struct softpipe_tex_tile_cache *tc,
 
       /* mark as entries as invalid/empty */
       /* XXX we should try to avoid this when the teximage hasn't changed */
-      for (i = 0; i < NUM_ENTRIES; i++) {
+      for (i = 0; i < tc->num_entries; i++) {
          tc->entries[i].addr.bits.invalid = 1;
       }
 
-      tc->tex_face = -1; /* any invalid value here */
+      tc->num_pending = 0;
    }
 }
 
@@ -192,24 +224,42 @@ sp_flush_tex_tile_cache(struct softpipe_tex_tile_cache *tc)
 
    if (tc->texture) {
       /* caching a texture, mark all entries as empty */
-      for (pos = 0; pos < NUM_ENTRIES; pos++) {
+      for (pos = 0; pos < tc->num_entries; pos++) {
          tc->entries[pos].addr.bits.invalid = 1;
       }
-      tc->tex_face = -1;
+      tc->num_pending = 0;
+      for (pos = 0; pos < SP_MAX_TEXTURE_2D_LEVELS; pos++) {
+         tc->tex_trans[pos].face = -1; /* any invalid value here */
+      }
    }
 
 }
 
 
+/**
+ * Add the cache's hit/miss counters to sum and reset them.
+ */
+void
+sp_tex_tile_cache_add_stats(struct softpipe_tex_tile_cache_stats *sum,
+                            struct softpipe_tex_tile_cache *tc)
+{
+   if (!tc)
+      return;
+
+   sum->hits += tc->stats.hits;
+   sum->misses += tc->stats.misses;
+   sum->prefetches += tc->stats.prefetches;
+   memset(&tc->stats, 0, sizeof tc->stats);
+}
+
+
 /**
  * Given the texture face, level, zslice, x and y values, compute
- * the cache entry position/index where we'd hope to find the
- * cached texture tile.
- * This is basically a direct-map cache.
- * XXX There's probably lots of ways in which we can improve this.
+ * the cache set where we'd hope to find the cached texture tile.
  */
 static INLINE uint
-tex_cache_pos( union tex_tile_address addr )
+tex_cache_set( const struct softpipe_tex_tile_cache *tc,
+               union tex_tile_address addr )
 {
    uint entry = (addr.bits.x + 
                  addr.bits.y * 9 + 
@@ -217,112 +267,268 @@ tex_cache_pos( union tex_tile_address addr )
                  addr.bits.face + 
                  addr.bits.level * 7);
 
-   return entry % NUM_ENTRIES;
+   return entry % tc->num_sets;
 }
 
+
 /**
- * Similar to sp_get_cached_tile() but for textures.
- * Tiles are read-only and indexed with more params.
+ * Look for the tile at addr in its set.  If it isn't there, return the
+ * entry of the set to replace (an empty one, or the least recently used).
  */
-const struct softpipe_tex_cached_tile *
-sp_find_cached_tile_tex(struct softpipe_tex_tile_cache *tc, 
-                        union tex_tile_address addr )
+static INLINE struct softpipe_tex_cached_tile *
+tex_cache_lookup( struct softpipe_tex_tile_cache *tc,
+                  union tex_tile_address addr,
+                  boolean *hit )
 {
-   struct softpipe_tex_cached_tile *tile;
-   boolean zs = util_format_is_depth_or_stencil(tc->format);
+   struct softpipe_tex_cached_tile *set =
+      tc->entries + tex_cache_set(tc, addr) * TEX_CACHE_WAYS;
+   struct softpipe_tex_cached_tile *victim = set;
+   unsigned i;
 
-   tile = tc->entries + tex_cache_pos( addr );
+   for (i = 0; i < TEX_CACHE_WAYS; i++) {
+      if (set[i].addr.value == addr.value) {
+         *hit = TRUE;
+         return &set[i];
+      }
 
-   if (addr.value != tile->addr.value) {
+      if (!victim->addr.bits.invalid &&
+          (set[i].addr.bits.invalid || set[i].lru < victim->lru))
+         victim = &set[i];
+   }
 
-      /* cache miss.  Most misses are because we've invaldiated the
-       * texture cache previously -- most commonly on binding a new
-       * texture.  Currently we effectively flush the cache on texture
-       * bind.
-       */
-#if 0
-      _debug_printf("miss at %u:  x=%d y=%d z=%d face=%d level=%d\n"
-                    "   tile %u:  x=%d y=%d z=%d face=%d level=%d\n",
-                    pos, x/TILE_SIZE, y/TILE_SIZE, z, face, level,
-                    pos, tile->addr.bits.x, tile->addr.bits.y, tile->z, tile->face, tile->level);
-#endif
-
-      /* check if we need to get a new transfer */
-      if (!tc->tex_trans ||
-          tc->tex_face != addr.bits.face ||
-          tc->tex_level != addr.bits.level ||
-          tc->tex_z != addr.bits.z) {
-         /* get new transfer (view into texture) */
-         unsigned width, height, layer;
-
-         if (tc->tex_trans) {
-            if (tc->tex_trans_map) {
-               tc->pipe->transfer_unmap(tc->pipe, tc->tex_trans);
-               tc->tex_trans_map = NULL;
-            }
-
-            tc->pipe->transfer_destroy(tc->pipe, tc->tex_trans);
-            tc->tex_trans = NULL;
-         }
+   *hit = FALSE;
+   return victim;
+}
 
-         width = u_minify(tc->texture->width0, addr.bits.level);
-         if (tc->texture->target == PIPE_TEXTURE_1D_ARRAY) {
-            height = tc->texture->array_size;
-            layer = 0;
-         }
-         else {
-            height = u_minify(tc->texture->height0, addr.bits.level);
-            layer = addr.bits.face + addr.bits.z;
-         }
 
-         tc->tex_trans = 
-            pipe_get_transfer(tc->pipe, tc->texture,
-                              addr.bits.level,
-                              layer,
-                              PIPE_TRANSFER_READ | PIPE_TRANSFER_UNSYNCHRONIZED,
-                              0, 0, width, height);
+/**
+ * Return a new last use stamp.  When the counter wraps around, all stamps
+ * are reset so that older tiles don't look recently used.  The counter
+ * never drops below 1, so prefetched tiles can be stamped one less.
+ */
+static INLINE unsigned
+tex_cache_next_lru( struct softpipe_tex_tile_cache *tc )
+{
+   if (++tc->lru_counter == 0) {
+      unsigned pos;
+
+      for (pos = 0; pos < tc->num_entries; pos++) {
+         tc->entries[pos].lru = 0;
+      }
+      tc->lru_counter = 1;
+   }
+
+   return tc->lru_counter;
+}
 
-         tc->tex_trans_map = tc->pipe->transfer_map(tc->pipe, tc->tex_trans);
 
-         tc->tex_face = addr.bits.face;
-         tc->tex_level = addr.bits.level;
-         tc->tex_z = addr.bits.z;
+/**
+ * Read the texture tile at addr into the given cache entry.
+ */
+static void
+tex_cache_load_tile( struct softpipe_tex_tile_cache *tc,
+                     struct softpipe_tex_cached_tile *tile,
+                     union tex_tile_address addr )
+{
+   boolean zs = util_format_is_depth_or_stencil(tc->format);
+   struct softpipe_tex_level_transfer *lt = &tc->tex_trans[addr.bits.level];
+
+   /* check if we need to get a new transfer for this level */
+   if (!lt->trans ||
+       lt->face != addr.bits.face ||
+       lt->z != addr.bits.z) {
+      /* get new transfer (view into texture) */
+      unsigned width, height, layer;
+
+      if (lt->trans) {
+         if (lt->map) {
+            tc->pipe->transfer_unmap(tc->pipe, lt->trans);
+            lt->map = NULL;
+         }
+
+         tc->pipe->transfer_destroy(tc->pipe, lt->trans);
+         lt->trans = NULL;
       }
 
-      /* Get tile from the transfer (view into texture), explicitly passing
-       * the image format.
-       */
-      if (!zs && util_format_is_pure_uint(tc->format)) {
-         pipe_get_tile_ui_format(tc->pipe,
-                                 tc->tex_trans,
-                                 addr.bits.x * TILE_SIZE,
-                                 addr.bits.y * TILE_SIZE,
-                                 TILE_SIZE,
-                                 TILE_SIZE,
-                                 tc->format,
-                                 (unsigned *) tile->data.colorui);
-      } else if (!zs && util_format_is_pure_sint(tc->format)) {
-         pipe_get_tile_i_format(tc->pipe,
-                                tc->tex_trans,
+      width = u_minify(tc->texture->width0, addr.bits.level);
+      if (tc->texture->target == PIPE_TEXTURE_1D_ARRAY) {
+         height = tc->texture->array_size;
+         layer = 0;
+      }
+      else {
+         height = u_minify(tc->texture->height0, addr.bits.level);
+         layer = addr.bits.face + addr.bits.z;
+      }
+
+      lt->trans = 
+         pipe_get_transfer(tc->pipe, tc->texture,
+                           addr.bits.level,
+                           layer,
+                           PIPE_TRANSFER_READ | PIPE_TRANSFER_UNSYNCHRONIZED,
+                           0, 0, width, height);
+
+      lt->map = tc->pipe->transfer_map(tc->pipe, lt->trans);
+
+      lt->face = addr.bits.face;
+      lt->z = addr.bits.z;
+   }
+
+   /* Get tile from the transfer (view into texture), explicitly passing
+    * the image format.
+    */
+   if (!zs && util_format_is_pure_uint(tc->format)) {
+      pipe_get_tile_ui_format(tc->pipe,
+                              lt->trans,
+                              addr.bits.x * TILE_SIZE,
+                              addr.bits.y * TILE_SIZE,
+                              TILE_SIZE,
+                              TILE_SIZE,
+                              tc->format,
+                              (unsigned *) tile->data.colorui);
+   } else if (!zs && util_format_is_pure_sint(tc->format)) {
+      pipe_get_tile_i_format(tc->pipe,
+                             lt->trans,
+                             addr.bits.x * TILE_SIZE,
+                             addr.bits.y * TILE_SIZE,
+                             TILE_SIZE,
+                             TILE_SIZE,
+                             tc->format,
+                             (int *) tile->data.colori);
+   } else {
+      pipe_get_tile_rgba_format(tc->pipe,
+                                lt->trans,
                                 addr.bits.x * TILE_SIZE,
                                 addr.bits.y * TILE_SIZE,
                                 TILE_SIZE,
-                                 TILE_SIZE,
+                                TILE_SIZE,
                                 tc->format,
-                                (int *) tile->data.colori);
-      } else {
-         pipe_get_tile_rgba_format(tc->pipe,
-                                   tc->tex_trans,
-                                   addr.bits.x * TILE_SIZE,
-                                   addr.bits.y * TILE_SIZE,
-                                   TILE_SIZE,
-                                   TILE_SIZE,
-                                   tc->format,
-                                   (float *) tile->data.color);
+                                (float *) tile->data.color);
+   }
+   tile->addr = addr;
+}
+
+
+/**
+ * Load the tile at addr unless it's already cached.  Prefetched tiles
+ * get a stamp older than the most recently used tile so they never evict
+ * the tile which triggered the prefetch.
+ */
+static void
+tex_cache_prefetch_tile( struct softpipe_tex_tile_cache *tc,
+                         union tex_tile_address addr )
+{
+   struct softpipe_tex_cached_tile *tile;
+   boolean hit;
+
+   tile = tex_cache_lookup(tc, addr, &hit);
+   if (!hit) {
+      tex_cache_load_tile(tc, tile, addr);
+      tile->lru = tc->lru_counter - 1;
+      tc->stats.prefetches++;
+   }
+}
+
+
+/**
+ * Prefetch the tiles a linear filter is likely to touch next: the right,
+ * bottom and bottom-right neighbors of the tile at addr and the tile
+ * covering the same area in the next mipmap level.
+ */
+static void
+tex_cache_prefetch( struct softpipe_tex_tile_cache *tc,
+                    union tex_tile_address addr )
+{
+   const struct pipe_resource *texture = tc->texture;
+
+   if (tc->prefetch & TEX_PREFETCH_NEIGHBORS) {
+      unsigned width = u_minify(texture->width0, addr.bits.level);
+      unsigned height = u_minify(texture->height0, addr.bits.level);
+      boolean right = (addr.bits.x + 1) * TILE_SIZE < width;
+      boolean below = (texture->target != PIPE_TEXTURE_1D &&
+                       texture->target != PIPE_TEXTURE_1D_ARRAY &&
+                       (addr.bits.y + 1) * TILE_SIZE < height);
+      union tex_tile_address n = addr;
+
+      if (right) {
+         n.bits.x = addr.bits.x + 1;
+         tex_cache_prefetch_tile(tc, n);
+      }
+      if (below) {
+         n.bits.x = addr.bits.x;
+         n.bits.y = addr.bits.y + 1;
+         tex_cache_prefetch_tile(tc, n);
+         if (right) {
+            n.bits.x = addr.bits.x + 1;
+            tex_cache_prefetch_tile(tc, n);
+         }
       }
-      tile->addr = addr;
    }
 
+   if ((tc->prefetch & TEX_PREFETCH_MIPMAP) &&
+       addr.bits.level < texture->last_level &&
+       texture->target != PIPE_TEXTURE_3D) {
+      union tex_tile_address n = addr;
+
+      n.bits.x = addr.bits.x / 2;
+      if (texture->target != PIPE_TEXTURE_1D_ARRAY)
+         n.bits.y = addr.bits.y / 2;
+      n.bits.level = addr.bits.level + 1;
+      tex_cache_prefetch_tile(tc, n);
+   }
+}
+
+
+/**
+ * Prefetch around the tiles which missed during the last filter op.
+ * This must only be called once the op is done with the texel pointers
+ * it got from the cache, as prefetching may evict any tile.
+ */
+void
+sp_tex_tile_cache_run_prefetches(struct softpipe_tex_tile_cache *tc)
+{
+   unsigned i;
+
+   for (i = 0; i < tc->num_pending; i++)
+      tex_cache_prefetch(tc, tc->pending[i]);
+
+   tc->num_pending = 0;
+}
+
+
+/**
+ * Similar to sp_get_cached_tile() but for textures.
+ * Tiles are read-only and indexed with more params.
+ */
+const struct softpipe_tex_cached_tile *
+sp_find_cached_tile_tex(struct softpipe_tex_tile_cache *tc, 
+                        union tex_tile_address addr )
+{
+   struct softpipe_tex_cached_tile *tile;
+   boolean hit;
+
+   tile = tex_cache_lookup(tc, addr, &hit);
+
+   if (hit) {
+      tc->stats.hits++;
+   }
+   else {
+      /* cache miss.  Most misses are because we've invaldiated the
+       * texture cache previously -- most commonly on binding a new
+       * texture.  Currently we effectively flush the cache on texture
+       * bind.
+       */
+      tc->stats.misses++;
+      tex_cache_load_tile(tc, tile, addr);
+   }
+
+   tile->lru = tex_cache_next_lru(tc);
+
+   /* Don't prefetch right away: that could evict a tile the current
+    * filter op already got texels from.
+    */
+   if (!hit && tc->prefetch && tc->num_pending < TEX_PREFETCH_MAX_PENDING)
+      tc->pending[tc->num_pending++] = addr;
+
    tc->last_tile = tile;
    return tile;
 }
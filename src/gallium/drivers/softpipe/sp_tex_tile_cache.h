@@ -66,6 +66,7 @@ union tex_tile_address {
 struct softpipe_tex_cached_tile
 {
    union tex_tile_address addr;
+   unsigned lru;   /**< last use stamp, for replacement within a set */
    union {
       float color[TILE_SIZE][TILE_SIZE][4];
       unsigned int colorui[TILE_SIZE][TILE_SIZE][4];
@@ -73,7 +74,39 @@ struct softpipe_tex_cached_tile
    } data;
 };
 
-#define NUM_ENTRIES 50
+/**
+ * The cache is set-associative: a tile can live in any of the
+ * TEX_CACHE_WAYS entries of its set and the least recently used entry of
+ * the set is replaced on a miss.
+ */
+#define TEX_CACHE_WAYS 4
+#define TEX_CACHE_DEFAULT_ENTRIES 48
+
+/** Bits for softpipe_tex_tile_cache::prefetch */
+#define TEX_PREFETCH_NEIGHBORS 0x1  /**< right/bottom tiles, for linear filters */
+#define TEX_PREFETCH_MIPMAP    0x2  /**< next mipmap level, for linear mip filter */
+
+/** Max misses queued for prefetching until the filter op completes */
+#define TEX_PREFETCH_MAX_PENDING 8
+
+/**
+ * Transfer viewing one face/zslice of a mipmap level.  There is one per
+ * level so that linear mipmap filtering, and prefetching from the next
+ * level, don't remap the transfer on every tile load.
+ */
+struct softpipe_tex_level_transfer
+{
+   struct pipe_transfer *trans;
+   void *map;
+   int face, z;
+};
+
+struct softpipe_tex_tile_cache_stats
+{
+   uint64_t hits;
+   uint64_t misses;
+   uint64_t prefetches;
+};
 
 struct softpipe_tex_tile_cache
 {
@@ -84,11 +117,18 @@ struct softpipe_tex_tile_cache
    struct pipe_resource *texture;  /**< if caching a texture */
    unsigned timestamp;
 
-   struct softpipe_tex_cached_tile entries[NUM_ENTRIES];
+   unsigned num_entries;   /**< multiple of TEX_CACHE_WAYS */
+   unsigned num_sets;
+   unsigned lru_counter;
+   struct softpipe_tex_cached_tile *entries;
+
+   unsigned prefetch;      /**< TEX_PREFETCH_x bitmask */
 
-   struct pipe_transfer *tex_trans;
-   void *tex_trans_map;
-   int tex_face, tex_level, tex_z;
+   /** Missed tiles whose neighbors still have to be prefetched */
+   union tex_tile_address pending[TEX_PREFETCH_MAX_PENDING];
+   unsigned num_pending;
+
+   struct softpipe_tex_level_transfer tex_trans[SP_MAX_TEXTURE_2D_LEVELS];
 
    unsigned swizzle_r;
    unsigned swizzle_g;
@@ -97,11 +137,13 @@ struct softpipe_tex_tile_cache
    enum pipe_format format;
 
    struct softpipe_tex_cached_tile *last_tile;  /**< most recently retrieved tile */
+
+   struct softpipe_tex_tile_cache_stats stats;
 };
 
 
 extern struct softpipe_tex_tile_cache *
-sp_create_tex_tile_cache( struct pipe_context *pipe );
+sp_create_tex_tile_cache( struct pipe_context *pipe, unsigned num_entries );
 
 extern void
 sp_destroy_tex_tile_cache(struct softpipe_tex_tile_cache *tc);
@@ -123,12 +165,19 @@ sp_tex_tile_cache_validate_texture(struct softpipe_tex_tile_cache *tc);
 extern void
 sp_flush_tex_tile_cache(struct softpipe_tex_tile_cache *tc);
 
+extern void
+sp_tex_tile_cache_add_stats(struct softpipe_tex_tile_cache_stats *sum,
+                            struct softpipe_tex_tile_cache *tc);
+
 
 
 extern const struct softpipe_tex_cached_tile *
 sp_find_cached_tile_tex(struct softpipe_tex_tile_cache *tc, 
                          union tex_tile_address addr );
 
+extern void
+sp_tex_tile_cache_run_prefetches(struct softpipe_tex_tile_cache *tc);
+
 static INLINE union tex_tile_address
 tex_tile_address( unsigned x,
                   unsigned y,
@@ -154,8 +203,10 @@ static INLINE const struct softpipe_tex_cached_tile *
 sp_get_cached_tile_tex(struct softpipe_tex_tile_cache *tc, 
                          union tex_tile_address addr )
 {
-   if (tc->last_tile->addr.value == addr.value)
+   if (tc->last_tile->addr.value == addr.value) {
+      tc->stats.hits++;
       return tc->last_tile;
+   }
 
    return sp_find_cached_tile_tex( tc, addr );
 }
@@ -42,6 +42,7 @@
 #include "sp_flush.h"
 #include "sp_texture.h"
 #include "sp_screen.h"
+#include "sp_tile_cache.h"
 
 #include "state_tracker/sw_winsys.h"
 
@@ -107,8 +108,17 @@ softpipe_displaytarget_layout(struct pipe_screen *screen,
                                           spr->base.height0,
                                           16,
                                           &spr->stride[0] );
+   if (!spr->dt)
+      return FALSE;
+
+   if (!util_damage_init(&spr->damage, spr->base.width0, spr->base.height0,
+                         TILE_SIZE_LOG2)) {
+      winsys->displaytarget_destroy(winsys, spr->dt);
+      spr->dt = NULL;
+      return FALSE;
+   }
 
-   return spr->dt != NULL;
+   return TRUE;
 }
 
 
@@ -163,6 +173,7 @@ softpipe_resource_destroy(struct pipe_screen *pscreen,
       /* display target */
       struct sw_winsys *winsys = screen->winsys;
       winsys->displaytarget_destroy(winsys, spr->dt);
+      util_damage_cleanup(&spr->damage);
    }
    else if (!spr->userBuffer) {
       /* regular texture */
@@ -198,6 +209,12 @@ softpipe_resource_from_handle(struct pipe_screen *screen,
    if (!spr->dt)
       goto fail;
 
+   if (!util_damage_init(&spr->damage, spr->base.width0, spr->base.height0,
+                         TILE_SIZE_LOG2)) {
+      winsys->displaytarget_destroy(winsys, spr->dt);
+      goto fail;
+   }
+
    return &spr->base;
 
  fail:
@@ -448,6 +465,12 @@ softpipe_transfer_unmap(struct pipe_context *pipe,
    if (transfer->usage & PIPE_TRANSFER_WRITE) {
       /* Mark the texture as dirty to expire the tile caches. */
       spr->timestamp++;
+
+      /* The color tile caches map the whole surface unsynchronized, and
+       * report the tiles they actually write themselves.
+       */
+      if (spr->dt && !(transfer->usage & PIPE_TRANSFER_UNSYNCHRONIZED))
+         util_damage_box(&spr->damage, &transfer->box);
    }
 }
 
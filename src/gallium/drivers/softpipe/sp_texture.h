@@ -30,6 +30,7 @@
 
 
 #include "pipe/p_state.h"
+#include "util/u_damage.h"
 #include "sp_limits.h"
 
 
@@ -54,6 +55,9 @@ struct softpipe_resource
     */
    struct sw_displaytarget *dt;
 
+   /** Regions of dt written since it was last displayed */
+   struct util_damage damage;
+
    /**
     * Malloc'ed data for regular buffers and textures, or a mapping to dt above.
     */
@@ -36,6 +36,7 @@
 #include "util/u_format.h"
 #include "util/u_memory.h"
 #include "util/u_tile.h"
+#include "sp_texture.h"
 #include "sp_tile_cache.h"
 
 static struct softpipe_cached_tile *
@@ -43,13 +44,11 @@ sp_alloc_tile(struct softpipe_tile_cache *tc);
 
 
 /**
- * Return the position in the cache for the tile that contains win pos (x,y).
- * We currently use a direct mapped cache so this is like a hack key.
- * At some point we should investige something more sophisticated, like
- * a LRU replacement policy.
+ * Return the cache set for the tile that contains win pos (x,y).
+ * The tile may live in any of the set's TILE_CACHE_WAYS entries.
  */
-#define CACHE_POS(x, y) \
-   (((x) + (y) * 5) % NUM_ENTRIES)
+#define CACHE_SET(tc, x, y) \
+   (((x) + (y) * 5) % (tc)->num_sets)
 
 
 
@@ -81,7 +80,7 @@ clear_clear_flag(uint *bitvec, union tile_address addr)
    
 
 struct softpipe_tile_cache *
-sp_create_tile_cache( struct pipe_context *pipe )
+sp_create_tile_cache( struct pipe_context *pipe, unsigned num_entries )
 {
    struct softpipe_tile_cache *tc;
    uint pos;
@@ -99,7 +98,19 @@ sp_create_tile_cache( struct pipe_context *pipe )
    tc = CALLOC_STRUCT( softpipe_tile_cache );
    if (tc) {
       tc->pipe = pipe;
-      for (pos = 0; pos < NUM_ENTRIES; pos++) {
+      tc->num_sets = MAX2(num_entries / TILE_CACHE_WAYS, 1);
+      tc->num_entries = tc->num_sets * TILE_CACHE_WAYS;
+
+      tc->tile_addrs = CALLOC(tc->num_entries, sizeof(union tile_address));
+      tc->entries = CALLOC(tc->num_entries,
+                           sizeof(struct softpipe_cached_tile *));
+      tc->lru = CALLOC(tc->num_entries, sizeof(unsigned));
+      if (!tc->tile_addrs || !tc->entries || !tc->lru) {
+         sp_destroy_tile_cache(tc);
+         return NULL;
+      }
+
+      for (pos = 0; pos < tc->num_entries; pos++) {
          tc->tile_addrs[pos].bits.invalid = 1;
       }
       tc->last_tile_addr.bits.invalid = 1;
@@ -110,7 +121,7 @@ sp_create_tile_cache( struct pipe_context *pipe )
       tc->tile = MALLOC_STRUCT( softpipe_cached_tile );
       if (!tc->tile)
       {
-         FREE(tc);
+         sp_destroy_tile_cache(tc);
          return NULL;
       }
 
@@ -134,10 +145,15 @@ sp_destroy_tile_cache(struct softpipe_tile_cache *tc)
    if (tc) {
       uint pos;
 
-      for (pos = 0; pos < NUM_ENTRIES; pos++) {
-         /*assert(tc->entries[pos].x < 0);*/
-         FREE( tc->entries[pos] );
+      if (tc->entries) {
+         for (pos = 0; pos < tc->num_entries; pos++) {
+            /*assert(tc->entries[pos].x < 0);*/
+            FREE( tc->entries[pos] );
+         }
       }
+      FREE( tc->entries );
+      FREE( tc->tile_addrs );
+      FREE( tc->lru );
       FREE( tc->tile );
 
       if (tc->transfer) {
@@ -306,6 +322,20 @@ clear_tile(struct softpipe_cached_tile *tile,
 }
 
 
+/**
+ * Note that the tile at the given position, in pixels, was written back
+ * to the surface, so that display targets only present what changed.
+ */
+static INLINE void
+sp_tile_cache_damage(struct softpipe_tile_cache *tc, uint x, uint y)
+{
+   struct softpipe_resource *spr = softpipe_resource(tc->transfer->resource);
+
+   if (spr->dt)
+      util_damage_tile(&spr->damage, x / TILE_SIZE, y / TILE_SIZE);
+}
+
+
 /**
  * Actually clear the tiles which were flagged as being in a clear state.
  */
@@ -358,6 +388,7 @@ sp_tile_cache_flush_clear(struct softpipe_tile_cache *tc)
                                      x, y, TILE_SIZE, TILE_SIZE,
                                      (float *) tc->tile->data.color);
                }
+               sp_tile_cache_damage(tc, x, y);
             }
             numCleared++;
          }
@@ -406,8 +437,11 @@ sp_flush_tile(struct softpipe_tile_cache* tc, unsigned pos)
                                       tc->surface->format,
                                       (float *) tc->entries[pos]->data.color);
          }
+         sp_tile_cache_damage(tc, tc->tile_addrs[pos].bits.x * TILE_SIZE,
+                              tc->tile_addrs[pos].bits.y * TILE_SIZE);
       }
       tc->tile_addrs[pos].bits.invalid = 1;  /* mark as empty */
+      tc->stats.writebacks++;
    }
 }
 
@@ -423,7 +457,7 @@ sp_flush_tile_cache(struct softpipe_tile_cache *tc)
 
    if (pt) {
       /* caching a drawing transfer */
-      for (pos = 0; pos < NUM_ENTRIES; pos++) {
+      for (pos = 0; pos < tc->num_entries; pos++) {
          struct softpipe_cached_tile *tile = tc->entries[pos];
          if (!tile)
          {
@@ -456,7 +490,7 @@ sp_alloc_tile(struct softpipe_tile_cache *tc)
       if (!tc->tile)
       {
          unsigned pos;
-         for (pos = 0; pos < NUM_ENTRIES; ++pos) {
+         for (pos = 0; pos < tc->num_entries; ++pos) {
             if (!tc->entries[pos])
                continue;
 
@@ -479,6 +513,37 @@ sp_alloc_tile(struct softpipe_tile_cache *tc)
    return tile;
 }
 
+/**
+ * Return the position of the entry that holds the tile at addr, or of the
+ * entry of addr's set that should be replaced by it.
+ * \param hit  returns whether the tile is in the cache
+ */
+static INLINE unsigned
+sp_tile_cache_lookup(const struct softpipe_tile_cache *tc,
+                     union tile_address addr,
+                     boolean *hit)
+{
+   const unsigned first =
+      CACHE_SET(tc, addr.bits.x, addr.bits.y) * TILE_CACHE_WAYS;
+   unsigned pos, victim = first;
+
+   for (pos = first; pos < first + TILE_CACHE_WAYS; pos++) {
+      if (tc->tile_addrs[pos].value == addr.value) {
+         *hit = TRUE;
+         return pos;
+      }
+
+      /* prefer an empty entry, otherwise the least recently used one */
+      if (!tc->tile_addrs[victim].bits.invalid &&
+          (tc->tile_addrs[pos].bits.invalid || tc->lru[pos] < tc->lru[victim]))
+         victim = pos;
+   }
+
+   *hit = FALSE;
+   return victim;
+}
+
+
 /**
  * Get a tile from the cache.
  * \param x, y  position of tile, in pixels
@@ -488,53 +553,28 @@ sp_find_cached_tile(struct softpipe_tile_cache *tc,
                     union tile_address addr )
 {
    struct pipe_transfer *pt = tc->transfer;
+   struct softpipe_cached_tile *tile;
+   boolean hit;
    /* cache pos/entry: */
-   const int pos = CACHE_POS(addr.bits.x,
-                             addr.bits.y);
-   struct softpipe_cached_tile *tile = tc->entries[pos];
+   const unsigned pos = sp_tile_cache_lookup(tc, addr, &hit);
 
-   if (!tile) {
-      tile = sp_alloc_tile(tc);
-      tc->entries[pos] = tile;
+   if (hit) {
+      tc->stats.hits++;
+      tile = tc->entries[pos];
    }
+   else {
+      tc->stats.misses++;
 
-   if (addr.value != tc->tile_addrs[pos].value) {
+      tile = tc->entries[pos];
+      if (!tile) {
+         tile = sp_alloc_tile(tc);
+         tc->entries[pos] = tile;
+      }
 
       assert(pt->resource);
-      if (tc->tile_addrs[pos].bits.invalid == 0) {
-         /* put dirty tile back in framebuffer */
-         if (tc->depth_stencil) {
-            pipe_put_tile_raw(tc->pipe, pt,
-                              tc->tile_addrs[pos].bits.x * TILE_SIZE,
-                              tc->tile_addrs[pos].bits.y * TILE_SIZE,
-                              TILE_SIZE, TILE_SIZE,
-                              tile->data.depth32, 0/*STRIDE*/);
-         }
-         else {
-            if (util_format_is_pure_uint(tc->surface->format)) {
-               pipe_put_tile_ui_format(tc->pipe, pt,
-                                      tc->tile_addrs[pos].bits.x * TILE_SIZE,
-                                      tc->tile_addrs[pos].bits.y * TILE_SIZE,
-                                      TILE_SIZE, TILE_SIZE,
-                                      tc->surface->format,
-                                      (unsigned *) tile->data.colorui128);
-            } else if (util_format_is_pure_sint(tc->surface->format)) {
-               pipe_put_tile_i_format(tc->pipe, pt,
-                                      tc->tile_addrs[pos].bits.x * TILE_SIZE,
-                                      tc->tile_addrs[pos].bits.y * TILE_SIZE,
-                                      TILE_SIZE, TILE_SIZE,
-                                      tc->surface->format,
-                                      (int *) tile->data.colori128);
-            } else {
-               pipe_put_tile_rgba_format(tc->pipe, pt,
-                                         tc->tile_addrs[pos].bits.x * TILE_SIZE,
-                                         tc->tile_addrs[pos].bits.y * TILE_SIZE,
-                                         TILE_SIZE, TILE_SIZE,
-                                         tc->surface->format,
-                                         (float *) tile->data.color);
-            }
-         }
-      }
+
+      /* put dirty tile back in framebuffer */
+      sp_flush_tile(tc, pos);
 
       tc->tile_addrs[pos] = addr;
 
@@ -584,6 +624,12 @@ sp_find_cached_tile(struct softpipe_tile_cache *tc,
       }
    }
 
+   if (++tc->lru_counter == 0) {
+      /* wrapped around: reset the stamps so old tiles don't look recent */
+      memset(tc->lru, 0, tc->num_entries * sizeof(unsigned));
+      tc->lru_counter = 1;
+   }
+   tc->lru[pos] = tc->lru_counter;
    tc->last_tile = tile;
    tc->last_tile_addr = addr;
    return tile;
@@ -612,8 +658,56 @@ sp_tile_cache_clear(struct softpipe_tile_cache *tc,
    /* set flags to indicate all the tiles are cleared */
    memset(tc->clear_flags, 255, sizeof(tc->clear_flags));
 
-   for (pos = 0; pos < NUM_ENTRIES; pos++) {
+   for (pos = 0; pos < tc->num_entries; pos++) {
       tc->tile_addrs[pos].bits.invalid = 1;
    }
    tc->last_tile_addr.bits.invalid = 1;
 }
+
+
+/**
+ * Hand the pending clear of tile rows first_row, first_row + row_step, ...
+ * over from one cache to another cache of the same surface.
+ * Used to split a clear between the per-thread caches of the threaded
+ * quad pipeline, so that each thread only clears the rows it owns.
+ */
+void
+sp_tile_cache_move_clear(struct softpipe_tile_cache *dst,
+                         struct softpipe_tile_cache *src,
+                         unsigned first_row,
+                         unsigned row_step)
+{
+   const uint words_per_row = (MAX_WIDTH / TILE_SIZE) / 32;
+   uint y, i;
+
+   assert(dst->surface == src->surface);
+   assert(row_step > 0);
+
+   dst->clear_color = src->clear_color;
+   dst->clear_val = src->clear_val;
+
+   for (y = first_row; y < MAX_HEIGHT / TILE_SIZE; y += row_step) {
+      for (i = 0; i < words_per_row; i++) {
+         const uint w = y * words_per_row + i;
+         dst->clear_flags[w] |= src->clear_flags[w];
+         src->clear_flags[w] = 0;
+      }
+   }
+}
+
+
+/**
+ * Add the cache's hit/miss counters to sum and reset them.
+ */
+void
+sp_tile_cache_add_stats(struct softpipe_tile_cache_stats *sum,
+                        struct softpipe_tile_cache *tc)
+{
+   if (!tc)
+      return;
+
+   sum->hits += tc->stats.hits;
+   sum->misses += tc->stats.misses;
+   sum->writebacks += tc->stats.writebacks;
+   memset(&tc->stats, 0, sizeof tc->stats);
+}
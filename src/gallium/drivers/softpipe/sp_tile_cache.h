@@ -74,7 +74,20 @@ struct softpipe_cached_tile
    } data;
 };
 
-#define NUM_ENTRIES 50
+/**
+ * The cache is set-associative with LRU replacement within each set.
+ * The number of entries is chosen at creation time.
+ */
+#define TILE_CACHE_WAYS 4
+#define TILE_CACHE_DEFAULT_ENTRIES 64
+
+
+struct softpipe_tile_cache_stats
+{
+   uint64_t hits;
+   uint64_t misses;
+   uint64_t writebacks;   /**< dirty tiles written back to the surface */
+};
 
 
 struct softpipe_tile_cache
@@ -84,8 +97,13 @@ struct softpipe_tile_cache
    struct pipe_transfer *transfer;
    void *transfer_map;
 
-   union tile_address tile_addrs[NUM_ENTRIES];
-   struct softpipe_cached_tile *entries[NUM_ENTRIES];
+   unsigned num_entries;          /**< num_sets * TILE_CACHE_WAYS */
+   unsigned num_sets;
+   unsigned lru_counter;
+
+   union tile_address *tile_addrs;         /**< [num_entries] */
+   struct softpipe_cached_tile **entries;  /**< [num_entries] */
+   unsigned *lru;                          /**< [num_entries] last use */
    uint clear_flags[(MAX_WIDTH / TILE_SIZE) * (MAX_HEIGHT / TILE_SIZE) / 32];
    union pipe_color_union clear_color; /**< for color bufs */
    uint clear_val;        /**< for z+stencil */
@@ -95,11 +113,13 @@ struct softpipe_tile_cache
 
    union tile_address last_tile_addr;
    struct softpipe_cached_tile *last_tile;  /**< most recently retrieved tile */
+
+   struct softpipe_tile_cache_stats stats;
 };
 
 
 extern struct softpipe_tile_cache *
-sp_create_tile_cache( struct pipe_context *pipe );
+sp_create_tile_cache( struct pipe_context *pipe, unsigned num_entries );
 
 extern void
 sp_destroy_tile_cache(struct softpipe_tile_cache *tc);
@@ -125,6 +145,16 @@ sp_tile_cache_clear(struct softpipe_tile_cache *tc,
                     const union pipe_color_union *color,
                     uint clearValue);
 
+extern void
+sp_tile_cache_add_stats(struct softpipe_tile_cache_stats *sum,
+                        struct softpipe_tile_cache *tc);
+
+extern void
+sp_tile_cache_move_clear(struct softpipe_tile_cache *dst,
+                         struct softpipe_tile_cache *src,
+                         unsigned first_row,
+                         unsigned row_step);
+
 extern struct softpipe_cached_tile *
 sp_find_cached_tile(struct softpipe_tile_cache *tc, 
                     union tile_address addr );
@@ -151,8 +181,10 @@ sp_get_cached_tile(struct softpipe_tile_cache *tc,
 {
    union tile_address addr = tile_address( x, y );
 
-   if (tc->last_tile_addr.value == addr.value)
+   if (tc->last_tile_addr.value == addr.value) {
+      tc->stats.hits++;
       return tc->last_tile;
+   }
 
    return sp_find_cached_tile( tc, addr );
 }
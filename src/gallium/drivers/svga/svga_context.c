@@ -226,6 +226,13 @@ void svga_context_flush( struct svga_context *svga,
 
    svga_screen_cache_flush(svgascreen, fence);
 
+   /* The upload buffers released above can be recycled once this fence
+    * (or that of a later flush, if svga still references them) has
+    * signalled.
+    */
+   u_upload_fence(svga->upload_vb, fence);
+   u_upload_fence(svga->upload_ib, fence);
+
    /* To force the re-emission of rendertargets and texture sampler bindings on
     * the next command buffer.
     */
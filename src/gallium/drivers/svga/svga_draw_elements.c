@@ -53,6 +53,24 @@ translate_indices( struct svga_hwtnl *hwtnl,
    const void *src_map = NULL;
    struct pipe_resource *dst = NULL;
    void *dst_map = NULL;
+   struct svga_buffer *sbuf = NULL;
+   unsigned i;
+
+   /* Reuse an earlier translation of the same range.  User buffers can
+    * change behind our back, so their translations aren't kept.
+    */
+   if (!svga_buffer_is_user_buffer(src)) {
+      sbuf = svga_buffer(src);
+      for (i = 0; i < SVGA_BUFFER_MAX_TRANSLATED; i++) {
+         if (sbuf->translated[i].buffer &&
+             sbuf->translated[i].translate == translate &&
+             sbuf->translated[i].offset == offset &&
+             sbuf->translated[i].nr == nr) {
+            pipe_resource_reference(out_buf, sbuf->translated[i].buffer);
+            return PIPE_OK;
+         }
+      }
+   }
 
    dst = pipe_buffer_create( pipe->screen, 
 			     PIPE_BIND_INDEX_BUFFER, 
@@ -76,6 +94,14 @@ translate_indices( struct svga_hwtnl *hwtnl,
    pipe_buffer_unmap( pipe, src_transfer );
    pipe_buffer_unmap( pipe, dst_transfer );
 
+   if (sbuf) {
+      i = sbuf->next_translated++ % SVGA_BUFFER_MAX_TRANSLATED;
+      pipe_resource_reference(&sbuf->translated[i].buffer, dst);
+      sbuf->translated[i].translate = translate;
+      sbuf->translated[i].offset = offset;
+      sbuf->translated[i].nr = nr;
+   }
+
    *out_buf = dst;
    return PIPE_OK;
 
@@ -217,11 +243,8 @@ svga_hwtnl_draw_range_elements( struct svga_hwtnl *hwtnl,
       struct pipe_resource *gen_buf = NULL;
 
       /* Need to allocate a new index buffer and run the translate
-       * func to populate it.  Could potentially cache this translated
-       * index buffer with the original to avoid future
-       * re-translations.  Not much point if we're just accelerating
-       * GL though, as index buffers are typically used only once
-       * there.
+       * func to populate it, unless the same range of the original
+       * was translated before and hasn't been written to since.
        */
       ret = translate_indices( hwtnl,
                                index_buffer,
@@ -85,6 +85,8 @@ svga_buffer_get_transfer(struct pipe_context *pipe,
    transfer->box = *box;
 
    if (usage & PIPE_TRANSFER_WRITE) {
+      svga_buffer_release_translated(sbuf);
+
       if (usage & PIPE_TRANSFER_DISCARD_WHOLE_RESOURCE) {
          /*
           * Flush any pending primitives, finish writing any pending DMA
@@ -294,6 +296,20 @@ svga_buffer_transfer_destroy(struct pipe_context *pipe,
 }
 
 
+/**
+ * Drop the translated copies of the buffer's indices, once its contents
+ * change.
+ */
+void
+svga_buffer_release_translated(struct svga_buffer *sbuf)
+{
+   unsigned i;
+
+   for (i = 0; i < SVGA_BUFFER_MAX_TRANSLATED; i++)
+      pipe_resource_reference(&sbuf->translated[i].buffer, NULL);
+}
+
+
 static void
 svga_buffer_destroy( struct pipe_screen *screen,
 		     struct pipe_resource *buf )
@@ -311,6 +327,8 @@ svga_buffer_destroy( struct pipe_screen *screen,
    if(sbuf->uploaded.buffer)
       pipe_resource_reference(&sbuf->uploaded.buffer, NULL);
 
+   svga_buffer_release_translated(sbuf);
+
    if(sbuf->hwbuf)
       svga_buffer_destroy_hw_storage(ss, sbuf);
    
@@ -32,6 +32,7 @@
 #include "util/u_transfer.h"
 
 #include "util/u_double_list.h"
+#include "indices/u_indices.h"
 
 #include "svga_screen_cache.h"
 
@@ -41,6 +42,11 @@
  */
 #define SVGA_BUFFER_MAX_RANGES 32
 
+/**
+ * Maximum number of translated index buffers kept per buffer
+ */
+#define SVGA_BUFFER_MAX_TRANSLATED 4
+
 
 struct svga_screen;
 struct svga_context;
@@ -178,6 +184,22 @@ struct svga_buffer
     * a context. It is only valid if the dma.pending is set above.
     */
    struct list_head head;
+
+   /**
+    * Translated copies of index ranges of this buffer.
+    *
+    * Indices the hardware can't use directly (unsupported primitive,
+    * provoking vertex or fill mode) are translated into a new buffer.  The
+    * last few translations are kept here so that drawing the same range
+    * again reuses them, until the buffer is mapped for writing.
+    */
+   struct {
+      struct pipe_resource *buffer;
+      u_translate_func translate;
+      unsigned offset;
+      unsigned nr;
+   } translated[SVGA_BUFFER_MAX_TRANSLATED];
+   unsigned next_translated;
 };
 
 
@@ -230,6 +252,9 @@ svga_buffer_create(struct pipe_screen *screen,
  * before reserving command buffer space. And, in order to insert commands
  * it may need to call svga_context_flush().
  */
+void
+svga_buffer_release_translated(struct svga_buffer *sbuf);
+
 struct svga_winsys_surface *
 svga_buffer_handle(struct svga_context *svga,
                    struct pipe_resource *buf);
@@ -13,6 +13,13 @@ struct drisw_loader_funcs
 {
    void (*put_image) (struct dri_drawable *dri_drawable,
                       void *data, unsigned width, unsigned height);
+   /**
+    * Put a width x height image at (x, y) in the drawable.  Rows of data
+    * are width pixels long, padded to 32 bits.
+    */
+   void (*put_image2) (struct dri_drawable *dri_drawable,
+                       void *data, int x, int y,
+                       unsigned width, unsigned height);
 };
 
 /**
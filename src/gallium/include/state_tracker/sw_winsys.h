@@ -48,6 +48,7 @@ struct winsys_handle;
 struct pipe_screen;
 struct pipe_context;
 struct pipe_resource;
+struct pipe_box;
 
 
 /**
@@ -124,12 +125,20 @@ struct sw_winsys
    /**
     * @sa pipe_screen:flush_frontbuffer.
     *
+    * \param boxes  regions of the displaytarget modified since it was last
+    *               displayed, or NULL if unknown.  Winsys may present just
+    *               these regions when the displaytarget was also the last
+    *               one displayed to the same drawable.
+    * \param num_boxes  number of boxes, zero if nothing was modified
+    *
     * This call will likely become asynchronous eventually.
     */
    void
    (*displaytarget_display)( struct sw_winsys *ws, 
                              struct sw_displaytarget *dt,
-                             void *context_private );
+                             void *context_private,
+                             const struct pipe_box *boxes,
+                             unsigned num_boxes );
 
    void 
    (*displaytarget_destroy)( struct sw_winsys *ws, 
@@ -17,6 +17,11 @@ struct xlib_drawable {
    Visual *visual;
    int depth;
    Drawable drawable;
+
+   /** Private to the winsys: last display target shown in the drawable.
+    * Must be zero initialized.
+    */
+   struct sw_displaytarget *last_dt;
 };
 
 
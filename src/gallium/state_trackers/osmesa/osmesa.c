@@ -0,0 +1,893 @@
+/**************************************************************************
+ *
+ * Copyright 2012 The Mesa authors.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * \file osmesa.c
+ * Off-screen Mesa (OSMesa) API on top of a Gallium driver.
+ *
+ * Each context renders into a framebuffer of ordinary pipe resources,
+ * with the color buffer as the single buffered front left attachment.
+ * When the state tracker flushes the front buffer (glFlush, glFinish)
+ * the rendering is copied into the client's image buffer.  That copy
+ * flips the image for OSMESA_Y_UP and converts the pixels to the
+ * client's format/type in the same pass, so there is at most one format
+ * conversion per frame.
+ *
+ * Like with any single buffered window system, the client must call
+ * glFlush or glFinish before reading its image buffer.
+ */
+
+
+#include <stdio.h>
+#include "GL/osmesa.h"
+
+#include "pipe/p_context.h"
+#include "pipe/p_defines.h"
+#include "pipe/p_screen.h"
+#include "pipe/p_state.h"
+#include "state_tracker/st_api.h"
+
+#include "os/os_thread.h"
+#include "util/u_atomic.h"
+#include "util/u_format.h"
+#include "util/u_inlines.h"
+#include "util/u_memory.h"
+
+#include "osmesa_public.h"
+
+
+/**
+ * The framebuffer of a context, bound to the client's image buffer.
+ */
+struct osmesa_buffer
+{
+   struct st_framebuffer_iface *stfb;
+   struct st_visual visual;
+   enum pipe_texture_target target;
+
+   unsigned width, height;
+   struct pipe_resource *textures[ST_ATTACHMENT_COUNT];
+
+   void *map;                   /**< the client's image buffer */
+   enum pipe_format format;     /**< format of the image buffer */
+
+   /** Depth buffer mapping returned by OSMesaGetDepthBuffer() */
+   struct pipe_transfer *depth_transfer;
+};
+
+
+struct osmesa_context
+{
+   struct st_context_iface *stctx;
+
+   /** Private pipe context for reading back the framebuffer */
+   struct pipe_context *pipe;
+
+   struct osmesa_buffer *buffer;
+
+   GLenum format;         /**< OSMESA_RGBA, OSMESA_BGRA, etc */
+   GLenum type;           /**< GL_UNSIGNED_BYTE, etc */
+   GLint user_row_length; /**< OSMESA_ROW_LENGTH, 0 for the image width */
+   GLboolean y_up;        /**< OSMESA_Y_UP */
+};
+
+
+static struct osmesa_driver driver;
+
+static struct st_api *stapi;
+static struct st_manager *smapi;
+
+
+void
+osmesa_set_driver( const struct osmesa_driver *templ )
+{
+   driver = *templ;
+}
+
+
+static int
+osmesa_get_param(struct st_manager *smapi,
+                 enum st_manager_param param)
+{
+   return 0;
+}
+
+
+/**
+ * Create the st_api and the screen the first time they are needed.
+ */
+static boolean
+osmesa_init(void)
+{
+   pipe_static_mutex(init_mutex);
+
+   pipe_mutex_lock(init_mutex);
+
+   if (!stapi && driver.create_st_api)
+      stapi = driver.create_st_api();
+
+   if (stapi && !smapi && driver.create_pipe_screen) {
+      struct pipe_screen *screen = driver.create_pipe_screen();
+
+      if (screen) {
+         smapi = CALLOC_STRUCT(st_manager);
+         if (smapi) {
+            smapi->screen = screen;
+            smapi->get_param = osmesa_get_param;
+         }
+         else {
+            screen->destroy(screen);
+         }
+      }
+   }
+
+   pipe_mutex_unlock(init_mutex);
+
+   return stapi && smapi;
+}
+
+
+static INLINE struct osmesa_buffer *
+osmesa_buffer(struct st_framebuffer_iface *stfbi)
+{
+   return (struct osmesa_buffer *) stfbi->st_manager_private;
+}
+
+
+/**
+ * Map an OSMesa format and type to the pipe format of the client's image
+ * buffer.  OSMESA_BGR images are stored as R8G8B8 with red and blue
+ * swapped afterwards.
+ */
+static enum pipe_format
+osmesa_choose_image_format(GLenum format, GLenum type)
+{
+   switch (format) {
+   case OSMESA_RGBA:
+      if (type == GL_UNSIGNED_BYTE)
+         return PIPE_FORMAT_R8G8B8A8_UNORM;
+      if (type == GL_UNSIGNED_SHORT)
+         return PIPE_FORMAT_R16G16B16A16_UNORM;
+      if (type == GL_FLOAT)
+         return PIPE_FORMAT_R32G32B32A32_FLOAT;
+      break;
+   case OSMESA_BGRA:
+      if (type == GL_UNSIGNED_BYTE)
+         return PIPE_FORMAT_B8G8R8A8_UNORM;
+      break;
+   case OSMESA_ARGB:
+      if (type == GL_UNSIGNED_BYTE)
+         return PIPE_FORMAT_A8R8G8B8_UNORM;
+      break;
+   case OSMESA_RGB:
+      if (type == GL_UNSIGNED_BYTE)
+         return PIPE_FORMAT_R8G8B8_UNORM;
+      if (type == GL_UNSIGNED_SHORT)
+         return PIPE_FORMAT_R16G16B16_UNORM;
+      if (type == GL_FLOAT)
+         return PIPE_FORMAT_R32G32B32_FLOAT;
+      break;
+   case OSMESA_BGR:
+      if (type == GL_UNSIGNED_BYTE)
+         return PIPE_FORMAT_R8G8B8_UNORM;
+      break;
+   case OSMESA_RGB_565:
+      if (type == GL_UNSIGNED_SHORT_5_6_5)
+         return PIPE_FORMAT_B5G6R5_UNORM;
+      break;
+   }
+
+   return PIPE_FORMAT_NONE;
+}
+
+
+/**
+ * Choose the format of the color buffer rendered to, as close as possible
+ * to the client's image format so the copy is a plain memcpy.
+ */
+static enum pipe_format
+osmesa_choose_color_format(struct pipe_screen *screen, GLenum format)
+{
+   enum pipe_format formats[3];
+   unsigned count = 0, i;
+
+   switch (format) {
+   case OSMESA_RGBA:
+      formats[count++] = PIPE_FORMAT_R8G8B8A8_UNORM;
+      break;
+   case OSMESA_BGRA:
+      formats[count++] = PIPE_FORMAT_B8G8R8A8_UNORM;
+      break;
+   case OSMESA_ARGB:
+      formats[count++] = PIPE_FORMAT_A8R8G8B8_UNORM;
+      break;
+   case OSMESA_RGB_565:
+      formats[count++] = PIPE_FORMAT_B5G6R5_UNORM;
+      break;
+   case OSMESA_RGB:
+   case OSMESA_BGR:
+      break;
+   default:
+      /* color index rendering isn't supported */
+      return PIPE_FORMAT_NONE;
+   }
+
+   formats[count++] = PIPE_FORMAT_B8G8R8A8_UNORM;
+   formats[count++] = PIPE_FORMAT_R8G8B8A8_UNORM;
+
+   for (i = 0; i < count; i++) {
+      if (screen->is_format_supported(screen, formats[i], PIPE_TEXTURE_2D,
+                                      0, PIPE_BIND_RENDER_TARGET))
+         return formats[i];
+   }
+
+   return PIPE_FORMAT_NONE;
+}
+
+
+static enum pipe_format
+osmesa_choose_depth_stencil_format(struct pipe_screen *screen,
+                                   GLint depth, GLint stencil)
+{
+   enum pipe_format formats[8];
+   unsigned count = 0, i;
+
+   if (depth <= 0 && stencil <= 0)
+      return PIPE_FORMAT_NONE;
+
+   if (depth <= 16 && stencil <= 0) {
+      formats[count++] = PIPE_FORMAT_Z16_UNORM;
+   }
+   if (depth <= 24 && stencil <= 0) {
+      formats[count++] = PIPE_FORMAT_X8Z24_UNORM;
+      formats[count++] = PIPE_FORMAT_Z24X8_UNORM;
+   }
+   if (depth <= 24 && stencil <= 8) {
+      formats[count++] = PIPE_FORMAT_S8_UINT_Z24_UNORM;
+      formats[count++] = PIPE_FORMAT_Z24_UNORM_S8_UINT;
+   }
+   if (stencil <= 0) {
+      formats[count++] = PIPE_FORMAT_Z32_UNORM;
+   }
+
+   for (i = 0; i < count; i++) {
+      if (screen->is_format_supported(screen, formats[i], PIPE_TEXTURE_2D,
+                                      0, PIPE_BIND_DEPTH_STENCIL))
+         return formats[i];
+   }
+
+   return PIPE_FORMAT_NONE;
+}
+
+
+/**
+ * The accumulation buffer is only created when the screen supports its
+ * format, rendering goes on without one otherwise.
+ */
+static enum pipe_format
+osmesa_choose_accum_format(struct pipe_screen *screen, GLint accum)
+{
+   const enum pipe_format format = PIPE_FORMAT_R16G16B16A16_SNORM;
+
+   if (accum <= 0)
+      return PIPE_FORMAT_NONE;
+
+   if (!screen->is_format_supported(screen, format, PIPE_TEXTURE_2D,
+                                    0, PIPE_BIND_RENDER_TARGET))
+      return PIPE_FORMAT_NONE;
+
+   return format;
+}
+
+
+static struct pipe_context *
+osmesa_get_pipe(struct osmesa_context *osmesa)
+{
+   if (!osmesa->pipe)
+      osmesa->pipe = smapi->screen->context_create(smapi->screen, NULL);
+   return osmesa->pipe;
+}
+
+
+/**
+ * Wait for the rendering of the context to complete.
+ */
+static void
+osmesa_finish(struct osmesa_context *osmesa)
+{
+   struct pipe_screen *screen = smapi->screen;
+   struct pipe_fence_handle *fence = NULL;
+
+   osmesa->stctx->flush(osmesa->stctx, 0, &fence);
+   if (fence) {
+      screen->fence_finish(screen, fence, PIPE_TIMEOUT_INFINITE);
+      screen->fence_reference(screen, &fence, NULL);
+   }
+}
+
+
+static void
+osmesa_unmap_depth_buffer(struct osmesa_context *osmesa,
+                          struct osmesa_buffer *osbuffer)
+{
+   if (osbuffer->depth_transfer) {
+      pipe_transfer_unmap(osmesa->pipe, osbuffer->depth_transfer);
+      pipe_transfer_destroy(osmesa->pipe, osbuffer->depth_transfer);
+      osbuffer->depth_transfer = NULL;
+   }
+}
+
+
+/**
+ * Copy the color buffer to the client's image buffer.
+ */
+static void
+osmesa_read_buffer(struct osmesa_context *osmesa,
+                   struct osmesa_buffer *osbuffer)
+{
+   struct pipe_resource *res = osbuffer->textures[ST_ATTACHMENT_FRONT_LEFT];
+   const unsigned width = osbuffer->width, height = osbuffer->height;
+   const unsigned row_length =
+      osmesa->user_row_length ? osmesa->user_row_length : width;
+   const unsigned dst_stride =
+      util_format_get_stride(osbuffer->format, row_length);
+   struct pipe_context *pipe;
+   struct pipe_transfer *transfer;
+   const ubyte *src;
+   unsigned x, y;
+
+   if (!res || !osbuffer->map)
+      return;
+
+   pipe = osmesa_get_pipe(osmesa);
+   if (!pipe)
+      return;
+
+   osmesa_finish(osmesa);
+
+   transfer = pipe_get_transfer(pipe, res, 0, 0, PIPE_TRANSFER_READ,
+                                0, 0, width, height);
+   if (!transfer)
+      return;
+
+   src = pipe_transfer_map(pipe, transfer);
+   if (src) {
+      for (y = 0; y < height; y++) {
+         /* the pipe resource is stored top to bottom */
+         const unsigned dst_y = osmesa->y_up ? height - 1 - y : y;
+         const ubyte *src_row = src + y * transfer->stride;
+         ubyte *dst_row = (ubyte *) osbuffer->map + dst_y * dst_stride;
+
+         if (osbuffer->format == res->format) {
+            memcpy(dst_row, src_row,
+                   util_format_get_stride(res->format, width));
+         }
+         else {
+            util_format_translate(osbuffer->format, dst_row, dst_stride, 0, 0,
+                                  res->format, src_row, transfer->stride, 0, 0,
+                                  width, 1);
+
+            if (osmesa->format == OSMESA_BGR) {
+               for (x = 0; x < width; x++) {
+                  ubyte tmp = dst_row[x * 3];
+                  dst_row[x * 3] = dst_row[x * 3 + 2];
+                  dst_row[x * 3 + 2] = tmp;
+               }
+            }
+         }
+      }
+
+      pipe_transfer_unmap(pipe, transfer);
+   }
+
+   pipe_transfer_destroy(pipe, transfer);
+}
+
+
+/**
+ * Called via st_framebuffer_iface::flush_front(), after the state tracker
+ * has drawn to the front buffer.
+ */
+static boolean
+osmesa_st_framebuffer_flush_front(struct st_framebuffer_iface *stfbi,
+                                  enum st_attachment_type statt)
+{
+   struct osmesa_buffer *osbuffer = osmesa_buffer(stfbi);
+   OSMesaContext osmesa = OSMesaGetCurrentContext();
+
+   if (statt != ST_ATTACHMENT_FRONT_LEFT || !osmesa ||
+       osmesa->buffer != osbuffer)
+      return FALSE;
+
+   osmesa_read_buffer(osmesa, osbuffer);
+
+   return TRUE;
+}
+
+
+/**
+ * Create the requested attachments at the size of the image buffer.
+ *
+ * Called via st_framebuffer_iface::validate()
+ */
+static boolean
+osmesa_st_framebuffer_validate(struct st_framebuffer_iface *stfbi,
+                               const enum st_attachment_type *statts,
+                               unsigned count,
+                               struct pipe_resource **out)
+{
+   struct osmesa_buffer *osbuffer = osmesa_buffer(stfbi);
+   struct pipe_screen *screen = smapi->screen;
+   struct pipe_resource templ;
+   unsigned i;
+
+   memset(&templ, 0, sizeof(templ));
+   templ.target = osbuffer->target;
+   templ.width0 = osbuffer->width;
+   templ.height0 = osbuffer->height;
+   templ.depth0 = 1;
+   templ.array_size = 1;
+   templ.last_level = 0;
+
+   for (i = 0; i < count; i++) {
+      const enum st_attachment_type statt = statts[i];
+
+      out[i] = NULL;
+
+      if (!osbuffer->textures[statt]) {
+         switch (statt) {
+         case ST_ATTACHMENT_FRONT_LEFT:
+            templ.format = osbuffer->visual.color_format;
+            templ.bind = PIPE_BIND_RENDER_TARGET;
+            break;
+         case ST_ATTACHMENT_DEPTH_STENCIL:
+            templ.format = osbuffer->visual.depth_stencil_format;
+            templ.bind = PIPE_BIND_DEPTH_STENCIL;
+            break;
+         default:
+            templ.format = PIPE_FORMAT_NONE;
+            break;
+         }
+
+         if (templ.format == PIPE_FORMAT_NONE)
+            continue;
+
+         osbuffer->textures[statt] = screen->resource_create(screen, &templ);
+         if (!osbuffer->textures[statt])
+            return FALSE;
+      }
+
+      pipe_resource_reference(&out[i], osbuffer->textures[statt]);
+   }
+
+   return TRUE;
+}
+
+
+static struct osmesa_buffer *
+osmesa_create_buffer(const struct st_visual *visual)
+{
+   struct osmesa_buffer *osbuffer = CALLOC_STRUCT(osmesa_buffer);
+   struct st_framebuffer_iface *stfbi = CALLOC_STRUCT(st_framebuffer_iface);
+   struct pipe_screen *screen = smapi->screen;
+
+   if (!osbuffer || !stfbi) {
+      FREE(osbuffer);
+      FREE(stfbi);
+      return NULL;
+   }
+
+   osbuffer->stfb = stfbi;
+   osbuffer->visual = *visual;
+   if (screen->get_param(screen, PIPE_CAP_NPOT_TEXTURES))
+      osbuffer->target = PIPE_TEXTURE_2D;
+   else
+      osbuffer->target = PIPE_TEXTURE_RECT;
+
+   stfbi->visual = &osbuffer->visual;
+   stfbi->flush_front = osmesa_st_framebuffer_flush_front;
+   stfbi->validate = osmesa_st_framebuffer_validate;
+   p_atomic_set(&stfbi->stamp, 1);
+   stfbi->st_manager_private = (void *) osbuffer;
+
+   return osbuffer;
+}
+
+
+static void
+osmesa_destroy_buffer(struct osmesa_context *osmesa,
+                      struct osmesa_buffer *osbuffer)
+{
+   unsigned i;
+
+   osmesa_unmap_depth_buffer(osmesa, osbuffer);
+
+   for (i = 0; i < ST_ATTACHMENT_COUNT; i++)
+      pipe_resource_reference(&osbuffer->textures[i], NULL);
+
+   FREE(osbuffer->stfb);
+   FREE(osbuffer);
+}
+
+
+/**
+ * Resize the framebuffer, the state tracker will validate it again.
+ */
+static void
+osmesa_resize_buffer(struct osmesa_buffer *osbuffer,
+                     unsigned width, unsigned height)
+{
+   unsigned i;
+
+   if (osbuffer->width == width && osbuffer->height == height)
+      return;
+
+   for (i = 0; i < ST_ATTACHMENT_COUNT; i++)
+      pipe_resource_reference(&osbuffer->textures[i], NULL);
+
+   osbuffer->width = width;
+   osbuffer->height = height;
+   p_atomic_inc(&osbuffer->stfb->stamp);
+}
+
+
+
+/**********************************************************************/
+/*****                    Public Functions                        *****/
+/**********************************************************************/
+
+
+GLAPI OSMesaContext GLAPIENTRY
+OSMesaCreateContext( GLenum format, OSMesaContext sharelist )
+{
+   return OSMesaCreateContextExt(format, 24, 8, 0, sharelist);
+}
+
+
+GLAPI OSMesaContext GLAPIENTRY
+OSMesaCreateContextExt( GLenum format, GLint depthBits, GLint stencilBits,
+                        GLint accumBits, OSMesaContext sharelist )
+{
+   struct osmesa_context *osmesa;
+   struct st_context_attribs attribs;
+   struct pipe_screen *screen;
+
+   if (!osmesa_init())
+      return NULL;
+
+   screen = smapi->screen;
+
+   memset(&attribs, 0, sizeof(attribs));
+   attribs.profile = ST_PROFILE_DEFAULT;
+   attribs.major = 1;
+   attribs.minor = 0;
+   attribs.visual.buffer_mask = ST_ATTACHMENT_FRONT_LEFT_MASK;
+   attribs.visual.color_format = osmesa_choose_color_format(screen, format);
+   attribs.visual.depth_stencil_format =
+      osmesa_choose_depth_stencil_format(screen, depthBits, stencilBits);
+   attribs.visual.accum_format =
+      osmesa_choose_accum_format(screen, accumBits);
+   if (attribs.visual.depth_stencil_format != PIPE_FORMAT_NONE)
+      attribs.visual.buffer_mask |= ST_ATTACHMENT_DEPTH_STENCIL_MASK;
+   if (attribs.visual.accum_format != PIPE_FORMAT_NONE)
+      attribs.visual.buffer_mask |= ST_ATTACHMENT_ACCUM_MASK;
+   attribs.visual.samples = 0;
+   attribs.visual.render_buffer = ST_ATTACHMENT_FRONT_LEFT;
+
+   if (attribs.visual.color_format == PIPE_FORMAT_NONE)
+      return NULL;
+
+   osmesa = CALLOC_STRUCT(osmesa_context);
+   if (!osmesa)
+      return NULL;
+
+   osmesa->buffer = osmesa_create_buffer(&attribs.visual);
+   if (!osmesa->buffer) {
+      FREE(osmesa);
+      return NULL;
+   }
+
+   osmesa->stctx = stapi->create_context(stapi, smapi, &attribs,
+                                         sharelist ? sharelist->stctx : NULL);
+   if (!osmesa->stctx) {
+      osmesa_destroy_buffer(osmesa, osmesa->buffer);
+      FREE(osmesa);
+      return NULL;
+   }
+
+   osmesa->stctx->st_manager_private = (void *) osmesa;
+   osmesa->format = format;
+   osmesa->type = GL_UNSIGNED_BYTE;
+   osmesa->user_row_length = 0;
+   osmesa->y_up = GL_TRUE;
+
+   return osmesa;
+}
+
+
+GLAPI void GLAPIENTRY
+OSMesaDestroyContext( OSMesaContext osmesa )
+{
+   if (!osmesa)
+      return;
+
+   if (OSMesaGetCurrentContext() == osmesa)
+      stapi->make_current(stapi, NULL, NULL, NULL);
+
+   osmesa->stctx->destroy(osmesa->stctx);
+
+   osmesa_destroy_buffer(osmesa, osmesa->buffer);
+
+   if (osmesa->pipe)
+      osmesa->pipe->destroy(osmesa->pipe);
+
+   FREE(osmesa);
+}
+
+
+GLAPI GLboolean GLAPIENTRY
+OSMesaMakeCurrent( OSMesaContext osmesa, void *buffer, GLenum type,
+                   GLsizei width, GLsizei height )
+{
+   struct osmesa_buffer *osbuffer;
+   enum pipe_format format;
+   int max_size;
+
+   if (!osmesa && !buffer) {
+      if (stapi)
+         stapi->make_current(stapi, NULL, NULL, NULL);
+      return GL_TRUE;
+   }
+
+   if (!osmesa || !buffer || width < 1 || height < 1)
+      return GL_FALSE;
+
+   max_size = 1 << (smapi->screen->get_param(smapi->screen,
+                                      PIPE_CAP_MAX_TEXTURE_2D_LEVELS) - 1);
+   if (width > max_size || height > max_size)
+      return GL_FALSE;
+
+   format = osmesa_choose_image_format(osmesa->format, type);
+   if (format == PIPE_FORMAT_NONE)
+      return GL_FALSE;
+
+   osbuffer = osmesa->buffer;
+
+   if (osbuffer->depth_transfer)
+      osmesa_unmap_depth_buffer(osmesa, osbuffer);
+
+   osmesa_resize_buffer(osbuffer, width, height);
+   osbuffer->map = buffer;
+   osbuffer->format = format;
+   osmesa->type = type;
+
+   if (!stapi->make_current(stapi, osmesa->stctx,
+                            osbuffer->stfb, osbuffer->stfb))
+      return GL_FALSE;
+
+   return GL_TRUE;
+}
+
+
+GLAPI OSMesaContext GLAPIENTRY
+OSMesaGetCurrentContext( void )
+{
+   struct st_context_iface *stctx;
+
+   if (!stapi)
+      return NULL;
+
+   stctx = stapi->get_current(stapi);
+   return stctx ? (OSMesaContext) stctx->st_manager_private : NULL;
+}
+
+
+GLAPI void GLAPIENTRY
+OSMesaPixelStore( GLint pname, GLint value )
+{
+   OSMesaContext osmesa = OSMesaGetCurrentContext();
+
+   if (!osmesa)
+      return;
+
+   switch (pname) {
+   case OSMESA_ROW_LENGTH:
+      if (value < 0)
+         return;
+      osmesa->user_row_length = value;
+      break;
+   case OSMESA_Y_UP:
+      osmesa->y_up = value ? GL_TRUE : GL_FALSE;
+      break;
+   default:
+      debug_printf("Invalid pname in OSMesaPixelStore()\n");
+      return;
+   }
+}
+
+
+GLAPI void GLAPIENTRY
+OSMesaGetIntegerv( GLint pname, GLint *value )
+{
+   OSMesaContext osmesa = OSMesaGetCurrentContext();
+   struct osmesa_buffer *osbuffer = osmesa ? osmesa->buffer : NULL;
+
+   switch (pname) {
+   case OSMESA_WIDTH:
+      *value = osbuffer ? osbuffer->width : 0;
+      return;
+   case OSMESA_HEIGHT:
+      *value = osbuffer ? osbuffer->height : 0;
+      return;
+   case OSMESA_FORMAT:
+      *value = osmesa ? osmesa->format : 0;
+      return;
+   case OSMESA_TYPE:
+      *value = osmesa ? osmesa->type : 0;
+      return;
+   case OSMESA_ROW_LENGTH:
+      *value = osmesa ? osmesa->user_row_length : 0;
+      return;
+   case OSMESA_Y_UP:
+      *value = osmesa ? osmesa->y_up : 0;
+      return;
+   case OSMESA_MAX_WIDTH:
+   case OSMESA_MAX_HEIGHT:
+      if (osmesa_init())
+         *value = 1 << (smapi->screen->get_param(smapi->screen,
+                                      PIPE_CAP_MAX_TEXTURE_2D_LEVELS) - 1);
+      else
+         *value = 0;
+      return;
+   default:
+      debug_printf("Invalid pname in OSMesaGetIntegerv()\n");
+      return;
+   }
+}
+
+
+/**
+ * Return the depth buffer.  Like the color buffer it's only up to date
+ * after glFinish, and its rows are stored top to bottom.
+ */
+GLAPI GLboolean GLAPIENTRY
+OSMesaGetDepthBuffer( OSMesaContext osmesa, GLint *width, GLint *height,
+                      GLint *bytesPerValue, void **buffer )
+{
+   struct osmesa_buffer *osbuffer = osmesa ? osmesa->buffer : NULL;
+   struct pipe_resource *res =
+      osbuffer ? osbuffer->textures[ST_ATTACHMENT_DEPTH_STENCIL] : NULL;
+   struct pipe_context *pipe;
+   void *map = NULL;
+
+   if (res && (pipe = osmesa_get_pipe(osmesa)) != NULL) {
+      osmesa_unmap_depth_buffer(osmesa, osbuffer);
+      osmesa_finish(osmesa);
+
+      osbuffer->depth_transfer =
+         pipe_get_transfer(pipe, res, 0, 0, PIPE_TRANSFER_READ_WRITE,
+                           0, 0, res->width0, res->height0);
+      if (osbuffer->depth_transfer) {
+         map = pipe_transfer_map(pipe, osbuffer->depth_transfer);
+         if (!map) {
+            pipe_transfer_destroy(pipe, osbuffer->depth_transfer);
+            osbuffer->depth_transfer = NULL;
+         }
+      }
+   }
+
+   if (!map) {
+      *width = 0;
+      *height = 0;
+      *bytesPerValue = 0;
+      *buffer = NULL;
+      return GL_FALSE;
+   }
+
+   *width = res->width0;
+   *height = res->height0;
+   *bytesPerValue = util_format_get_blocksize(res->format);
+   *buffer = map;
+   return GL_TRUE;
+}
+
+
+GLAPI GLboolean GLAPIENTRY
+OSMesaGetColorBuffer( OSMesaContext osmesa, GLint *width, GLint *height,
+                      GLint *format, void **buffer )
+{
+   struct osmesa_buffer *osbuffer = osmesa ? osmesa->buffer : NULL;
+
+   if (!osbuffer || !osbuffer->map) {
+      *width = 0;
+      *height = 0;
+      *format = 0;
+      *buffer = NULL;
+      return GL_FALSE;
+   }
+
+   *width = osbuffer->width;
+   *height = osbuffer->height;
+   *format = osmesa->format;
+   *buffer = osbuffer->map;
+   return GL_TRUE;
+}
+
+
+struct name_function
+{
+   const char *name;
+   OSMESAproc function;
+};
+
+static struct name_function functions[] = {
+   { "OSMesaCreateContext", (OSMESAproc) OSMesaCreateContext },
+   { "OSMesaCreateContextExt", (OSMESAproc) OSMesaCreateContextExt },
+   { "OSMesaDestroyContext", (OSMESAproc) OSMesaDestroyContext },
+   { "OSMesaMakeCurrent", (OSMESAproc) OSMesaMakeCurrent },
+   { "OSMesaGetCurrentContext", (OSMESAproc) OSMesaGetCurrentContext },
+   { "OSMesaPixelStore", (OSMESAproc) OSMesaPixelStore },
+   { "OSMesaGetIntegerv", (OSMESAproc) OSMesaGetIntegerv },
+   { "OSMesaGetDepthBuffer", (OSMESAproc) OSMesaGetDepthBuffer },
+   { "OSMesaGetColorBuffer", (OSMESAproc) OSMesaGetColorBuffer },
+   { "OSMesaGetProcAddress", (OSMESAproc) OSMesaGetProcAddress },
+   { "OSMesaColorClamp", (OSMESAproc) OSMesaColorClamp },
+   { NULL, NULL }
+};
+
+
+GLAPI OSMESAproc GLAPIENTRY
+OSMesaGetProcAddress( const char *funcName )
+{
+   int i;
+
+   for (i = 0; functions[i].name; i++) {
+      if (strcmp(functions[i].name, funcName) == 0)
+         return functions[i].function;
+   }
+
+   if (!osmesa_init())
+      return NULL;
+
+   return (OSMESAproc) stapi->get_proc_address(stapi, funcName);
+}
+
+
+GLAPI void GLAPIENTRY
+OSMesaColorClamp(GLboolean enable)
+{
+   PFNGLCLAMPCOLORARBPROC clampColor;
+
+   if (!OSMesaGetCurrentContext())
+      return;
+
+   clampColor = (PFNGLCLAMPCOLORARBPROC)
+      stapi->get_proc_address(stapi, "glClampColorARB");
+   if (clampColor)
+      clampColor(GL_CLAMP_FRAGMENT_COLOR_ARB,
+                 enable ? GL_TRUE : GL_FIXED_ONLY_ARB);
+}
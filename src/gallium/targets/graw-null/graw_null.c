@@ -1,6 +1,24 @@
+#include "pipe/p_compiler.h"
+#include "pipe/p_context.h"
+#include "pipe/p_screen.h"
+#include "util/u_debug.h"
+#include "util/u_memory.h"
+#include "target-helpers/inline_sw_helper.h"
+#include "target-helpers/inline_debug_helper.h"
+#include "sw/null/null_sw_winsys.h"
 #include "state_tracker/graw.h"
 
 
+/* Offscreen graw on top of the null software winsys.
+ *
+ * There are no windows nor display targets: programs render to regular
+ * textures, which is what benchmarks want.  The driver is picked with the
+ * GALLIUM_DRIVER environment variable, as for the other software targets.
+ */
+
+static struct {
+   void (*draw)(void);
+} graw;
 
 
 struct pipe_screen *
@@ -11,7 +29,25 @@ graw_create_window_and_screen( int x,
                                enum pipe_format format,
                                void **handle)
 {
-   return NULL;
+   struct pipe_screen *screen;
+   struct sw_winsys *winsys;
+
+   winsys = null_sw_create();
+   if (winsys == NULL)
+      return NULL;
+
+   screen = sw_screen_create( winsys );
+   if (screen == NULL) {
+      winsys->destroy(winsys);
+      return NULL;
+   }
+
+   /* No window to present to */
+   *handle = NULL;
+
+   /* Inject any wrapping layers we want to here:
+    */
+   return debug_screen_wrap( screen );
 }
 
 
@@ -19,10 +55,13 @@ graw_create_window_and_screen( int x,
 void 
 graw_set_display_func( void (*draw)( void ) )
 {
+   graw.draw = draw;
 }
 
 
 void
 graw_main_loop( void )
 {
+   if (graw.draw)
+      graw.draw();
 }
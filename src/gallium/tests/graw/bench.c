@@ -0,0 +1,989 @@
+/* Rendering benchmarks for the software rasterizers.
+ *
+ * Renders a few canned scenes offscreen, with each driver and number of
+ * rasterizer threads, and prints one tab separated line of results per run
+ * for tracking performance over time.  It needs no window, so link it
+ * with the graw-null target.
+ *
+ * Usage: bench [-d driver,...] [-t max_threads] [-s scene,...]
+ *              [-w width] [-h height] [-m min_msecs]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "state_tracker/graw.h"
+#include "pipe/p_screen.h"
+#include "pipe/p_context.h"
+#include "pipe/p_shader_tokens.h"
+#include "pipe/p_state.h"
+#include "pipe/p_defines.h"
+
+#include "os/os_time.h"
+#include "util/u_box.h"
+#include "util/u_cpu_detect.h"
+#include "util/u_draw.h"
+#include "util/u_inlines.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"      /* Offset() */
+#include "util/u_string.h"
+
+
+struct vertex {
+   float position[4];
+   float attrib[4];      /* color or texcoord */
+};
+
+
+struct bench {
+   unsigned width, height;
+
+   struct pipe_screen *screen;
+   struct pipe_context *ctx;
+
+   struct pipe_resource *cbuf;
+   struct pipe_surface *cbuf_surf;
+   struct pipe_resource *zsbuf;
+   struct pipe_surface *zsbuf_surf;
+
+   void *blend;
+   void *dsa;
+   void *rasterizer;
+   void *velems;
+   void *vs;
+   void *fs;
+
+   struct pipe_resource *vbuf;
+   unsigned num_vertices;
+
+   struct pipe_resource *tex;
+   struct pipe_sampler_view *view;
+   void *sampler;
+
+   /** Scene specific work done per frame, in the scene's unit */
+   double items_per_frame;
+};
+
+
+struct scene {
+   const char *name;
+   const char *unit;
+   boolean (*init)(struct bench *b);
+   void (*draw)(struct bench *b);
+};
+
+
+/** Per scene options */
+#define NUM_TRIANGLES   65536
+#define NUM_FULLSCREEN  4
+#define NUM_PARTICLES   4096
+#define PARTICLE_SIZE   32
+#define TEX_SIZE        1024
+#define NUM_TEX_QUADS   2
+#define NUM_LAYERS      16
+#define NUM_DRAWS       4096
+#define DRAW_SIZE       16
+
+static unsigned min_time = 1000000;   /* usecs */
+
+
+/* Scenes must render the same everywhere, so don't rely on rand().
+ */
+static unsigned rand_state;
+
+static float
+frand(void)
+{
+   rand_state = rand_state * 1103515245 + 12345;
+   return (float)(rand_state >> 8) / 16777216.0f;
+}
+
+
+static void
+set_option(const char *name, const char *value)
+{
+#ifdef PIPE_OS_WINDOWS
+   _putenv_s(name, value);
+#else
+   setenv(name, value, 1);
+#endif
+}
+
+
+/*
+ * Helpers shared by the scenes.
+ */
+
+static void
+set_quad(struct vertex *v, float x0, float y0, float x1, float y1, float z,
+         const float attrib0[4], const float attrib1[4])
+{
+   static const unsigned corners[6][2] = {
+      {0, 0}, {1, 0}, {1, 1},
+      {0, 0}, {1, 1}, {0, 1}
+   };
+   unsigned i, c;
+
+   for (i = 0; i < 6; i++) {
+      const unsigned cx = corners[i][0], cy = corners[i][1];
+      v[i].position[0] = cx ? x1 : x0;
+      v[i].position[1] = cy ? y1 : y0;
+      v[i].position[2] = z;
+      v[i].position[3] = 1.0f;
+      for (c = 0; c < 4; c++) {
+         /* attrib0 at the first corner, attrib1 at the opposite one */
+         v[i].attrib[c] = attrib0[c];
+         if (c == 0 && cx)
+            v[i].attrib[c] = attrib1[c];
+         if (c == 1 && cy)
+            v[i].attrib[c] = attrib1[c];
+      }
+   }
+}
+
+
+static boolean
+set_vertices(struct bench *b, const struct vertex *vertices,
+             unsigned num_vertices)
+{
+   struct pipe_vertex_element ve[2];
+   struct pipe_vertex_buffer vbuf;
+   const unsigned size = num_vertices * sizeof *vertices;
+
+   memset(ve, 0, sizeof ve);
+   ve[0].src_offset = Offset(struct vertex, position);
+   ve[0].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+   ve[1].src_offset = Offset(struct vertex, attrib);
+   ve[1].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+
+   b->velems = b->ctx->create_vertex_elements_state(b->ctx, 2, ve);
+   b->ctx->bind_vertex_elements_state(b->ctx, b->velems);
+
+   b->vbuf = pipe_buffer_create(b->screen, PIPE_BIND_VERTEX_BUFFER,
+                                PIPE_USAGE_STATIC, size);
+   if (!b->vbuf)
+      return FALSE;
+   pipe_buffer_write(b->ctx, b->vbuf, 0, size, vertices);
+   b->num_vertices = num_vertices;
+
+   memset(&vbuf, 0, sizeof vbuf);
+   vbuf.stride = sizeof *vertices;
+   vbuf.buffer_offset = 0;
+   vbuf.buffer = b->vbuf;
+   b->ctx->set_vertex_buffers(b->ctx, 1, &vbuf);
+
+   return TRUE;
+}
+
+
+static boolean
+set_shaders(struct bench *b, const char *fs_text)
+{
+   const char *vs_text =
+      "VERT\n"
+      "DCL IN[0]\n"
+      "DCL IN[1]\n"
+      "DCL OUT[0], POSITION\n"
+      "DCL OUT[1], GENERIC[0]\n"
+      "  0: MOV OUT[1], IN[1]\n"
+      "  1: MOV OUT[0], IN[0]\n"
+      "  2: END\n";
+
+   b->vs = graw_parse_vertex_shader(b->ctx, vs_text);
+   b->fs = graw_parse_fragment_shader(b->ctx, fs_text);
+   if (!b->vs || !b->fs)
+      return FALSE;
+
+   b->ctx->bind_vs_state(b->ctx, b->vs);
+   b->ctx->bind_fs_state(b->ctx, b->fs);
+   return TRUE;
+}
+
+
+static const char *color_fs_text =
+   "FRAG\n"
+   "DCL IN[0], GENERIC[0], LINEAR\n"
+   "DCL OUT[0], COLOR\n"
+   "  0: MOV OUT[0], IN[0]\n"
+   "  1: END\n";
+
+
+static void
+set_blend(struct bench *b, boolean enable)
+{
+   struct pipe_blend_state blend;
+
+   memset(&blend, 0, sizeof blend);
+   blend.rt[0].colormask = PIPE_MASK_RGBA;
+   if (enable) {
+      blend.rt[0].blend_enable = 1;
+      blend.rt[0].rgb_func = PIPE_BLEND_ADD;
+      blend.rt[0].rgb_src_factor = PIPE_BLENDFACTOR_SRC_ALPHA;
+      blend.rt[0].rgb_dst_factor = PIPE_BLENDFACTOR_INV_SRC_ALPHA;
+      blend.rt[0].alpha_func = PIPE_BLEND_ADD;
+      blend.rt[0].alpha_src_factor = PIPE_BLENDFACTOR_ONE;
+      blend.rt[0].alpha_dst_factor = PIPE_BLENDFACTOR_INV_SRC_ALPHA;
+   }
+
+   b->blend = b->ctx->create_blend_state(b->ctx, &blend);
+   b->ctx->bind_blend_state(b->ctx, b->blend);
+}
+
+
+static void
+set_depth(struct bench *b, boolean enable)
+{
+   struct pipe_depth_stencil_alpha_state dsa;
+
+   memset(&dsa, 0, sizeof dsa);
+   if (enable) {
+      dsa.depth.enabled = 1;
+      dsa.depth.writemask = 1;
+      dsa.depth.func = PIPE_FUNC_LESS;
+   }
+
+   b->dsa = b->ctx->create_depth_stencil_alpha_state(b->ctx, &dsa);
+   b->ctx->bind_depth_stencil_alpha_state(b->ctx, b->dsa);
+}
+
+
+static void
+clear(struct bench *b)
+{
+   union pipe_color_union clear_color = { {0.2f, 0.2f, 0.2f, 1.0f} };
+   unsigned buffers = PIPE_CLEAR_COLOR;
+
+   if (b->zsbuf_surf)
+      buffers |= PIPE_CLEAR_DEPTHSTENCIL;
+
+   b->ctx->clear(b->ctx, buffers, &clear_color, 1.0, 0);
+}
+
+
+static void
+draw_all(struct bench *b)
+{
+   clear(b);
+   util_draw_arrays(b->ctx, PIPE_PRIM_TRIANGLES, 0, b->num_vertices);
+}
+
+
+/*
+ * Small triangle storm: lots of triangles covering a few pixels each,
+ * stressing the setup and binning.
+ */
+
+static boolean
+triangles_init(struct bench *b)
+{
+   const float dx = 2.0f * 3.0f / b->width;
+   const float dy = 2.0f * 3.0f / b->height;
+   struct vertex *v;
+   unsigned i, j, c;
+   boolean ret;
+
+   v = MALLOC(NUM_TRIANGLES * 3 * sizeof *v);
+   if (!v)
+      return FALSE;
+
+   for (i = 0; i < NUM_TRIANGLES; i++) {
+      const float x = frand() * 2.0f - 1.0f;
+      const float y = frand() * 2.0f - 1.0f;
+      float color[4];
+
+      for (c = 0; c < 3; c++)
+         color[c] = frand();
+      color[3] = 1.0f;
+
+      for (j = 0; j < 3; j++) {
+         struct vertex *vert = &v[i * 3 + j];
+         vert->position[0] = x + (j == 1 ? dx : 0.0f);
+         vert->position[1] = y + (j == 2 ? dy : 0.0f);
+         vert->position[2] = 0.0f;
+         vert->position[3] = 1.0f;
+         memcpy(vert->attrib, color, sizeof color);
+      }
+   }
+
+   set_blend(b, FALSE);
+   set_depth(b, FALSE);
+   ret = set_shaders(b, color_fs_text) &&
+         set_vertices(b, v, NUM_TRIANGLES * 3);
+
+   FREE(v);
+   b->items_per_frame = NUM_TRIANGLES;
+   return ret;
+}
+
+
+/*
+ * Full screen shading: a few full screen quads with an arithmetic heavy
+ * fragment shader.
+ */
+
+static boolean
+fullscreen_init(struct bench *b)
+{
+   static const float attrib0[4] = { 0.0f, 0.0f, 0.5f, 1.0f };
+   static const float attrib1[4] = { 1.0f, 1.0f, 0.5f, 1.0f };
+   const char *fs_text =
+      "FRAG\n"
+      "DCL IN[0], GENERIC[0], LINEAR\n"
+      "DCL OUT[0], COLOR\n"
+      "DCL TEMP[0..2]\n"
+      "IMM FLT32 { 0.5, 1.5, 3.0, 0.25 }\n"
+      "  0: MAD TEMP[0], IN[0], IMM[0].yyyy, IMM[0].xxxx\n"
+      "  1: MUL TEMP[1], TEMP[0], TEMP[0]\n"
+      "  2: EX2 TEMP[2].x, TEMP[1].xxxx\n"
+      "  3: LG2 TEMP[2].y, TEMP[0].yyyy\n"
+      "  4: RSQ TEMP[2].z, TEMP[1].zzzz\n"
+      "  5: SIN TEMP[2].w, TEMP[0].xxxx\n"
+      "  6: DP4 TEMP[1].x, TEMP[2], TEMP[0]\n"
+      "  7: MAD TEMP[0], TEMP[2], IMM[0].wwww, TEMP[1].xxxx\n"
+      "  8: COS TEMP[1], TEMP[0].yyyy\n"
+      "  9: MAD TEMP[0], TEMP[0], TEMP[1], IMM[0].zzzz\n"
+      " 10: FRC OUT[0], TEMP[0]\n"
+      " 11: END\n";
+   struct vertex v[NUM_FULLSCREEN * 6];
+   unsigned i;
+
+   for (i = 0; i < NUM_FULLSCREEN; i++)
+      set_quad(&v[i * 6], -1.0f, -1.0f, 1.0f, 1.0f, 0.0f, attrib0, attrib1);
+
+   set_blend(b, FALSE);
+   set_depth(b, FALSE);
+   b->items_per_frame = (double)NUM_FULLSCREEN * b->width * b->height;
+   return set_shaders(b, fs_text) &&
+          set_vertices(b, v, Elements(v));
+}
+
+
+/*
+ * Blended particles: many overlapping translucent quads.
+ */
+
+static boolean
+particles_init(struct bench *b)
+{
+   const float dx = 2.0f * PARTICLE_SIZE / b->width;
+   const float dy = 2.0f * PARTICLE_SIZE / b->height;
+   struct vertex *v;
+   unsigned i, c;
+   boolean ret;
+
+   v = MALLOC(NUM_PARTICLES * 6 * sizeof *v);
+   if (!v)
+      return FALSE;
+
+   for (i = 0; i < NUM_PARTICLES; i++) {
+      const float x = frand() * (2.0f - dx) - 1.0f;
+      const float y = frand() * (2.0f - dy) - 1.0f;
+      float color[4];
+
+      for (c = 0; c < 3; c++)
+         color[c] = frand();
+      color[3] = 0.25f;
+
+      set_quad(&v[i * 6], x, y, x + dx, y + dy, 0.0f, color, color);
+   }
+
+   set_blend(b, TRUE);
+   set_depth(b, FALSE);
+   ret = set_shaders(b, color_fs_text) &&
+         set_vertices(b, v, NUM_PARTICLES * 6);
+
+   FREE(v);
+   b->items_per_frame = NUM_PARTICLES;
+   return ret;
+}
+
+
+/*
+ * Texture heavy: full screen quads sampling a large mipmapped texture
+ * several times per fragment, with trilinear filtering.
+ */
+
+static boolean
+init_texture(struct bench *b)
+{
+   struct pipe_resource templat;
+   struct pipe_sampler_view sv_template;
+   struct pipe_sampler_state sampler_desc;
+   unsigned level, x, y;
+   uint8_t *texels;
+
+   memset(&templat, 0, sizeof templat);
+   templat.target = PIPE_TEXTURE_2D;
+   templat.format = PIPE_FORMAT_B8G8R8A8_UNORM;
+   templat.width0 = TEX_SIZE;
+   templat.height0 = TEX_SIZE;
+   templat.depth0 = 1;
+   templat.array_size = 1;
+   templat.last_level = util_logbase2(TEX_SIZE);
+   templat.nr_samples = 1;
+   templat.bind = PIPE_BIND_SAMPLER_VIEW;
+
+   b->tex = b->screen->resource_create(b->screen, &templat);
+   if (!b->tex)
+      return FALSE;
+
+   texels = MALLOC(TEX_SIZE * TEX_SIZE * 4);
+   if (!texels)
+      return FALSE;
+
+   for (level = 0; level <= templat.last_level; level++) {
+      const unsigned size = TEX_SIZE >> level;
+      struct pipe_box box;
+
+      /* A noisy checkerboard, with a different tint per level */
+      for (y = 0; y < size; y++) {
+         for (x = 0; x < size; x++) {
+            uint8_t *texel = texels + (y * size + x) * 4;
+            const uint8_t check = ((x ^ y) & 8) ? 0xc0 : 0x40;
+            texel[0] = check ^ (uint8_t)(frand() * 32.0f);
+            texel[1] = check ^ (uint8_t)(level * 24);
+            texel[2] = check;
+            texel[3] = 0xff;
+         }
+      }
+
+      u_box_2d(0, 0, size, size, &box);
+      b->ctx->transfer_inline_write(b->ctx, b->tex, level,
+                                    PIPE_TRANSFER_WRITE, &box,
+                                    texels, size * 4, size * size * 4);
+   }
+
+   FREE(texels);
+
+   memset(&sv_template, 0, sizeof sv_template);
+   sv_template.format = b->tex->format;
+   sv_template.texture = b->tex;
+   sv_template.u.tex.first_level = 0;
+   sv_template.u.tex.last_level = templat.last_level;
+   sv_template.swizzle_r = PIPE_SWIZZLE_RED;
+   sv_template.swizzle_g = PIPE_SWIZZLE_GREEN;
+   sv_template.swizzle_b = PIPE_SWIZZLE_BLUE;
+   sv_template.swizzle_a = PIPE_SWIZZLE_ALPHA;
+   b->view = b->ctx->create_sampler_view(b->ctx, b->tex, &sv_template);
+   if (!b->view)
+      return FALSE;
+
+   b->ctx->set_fragment_sampler_views(b->ctx, 1, &b->view);
+
+   memset(&sampler_desc, 0, sizeof sampler_desc);
+   sampler_desc.wrap_s = PIPE_TEX_WRAP_REPEAT;
+   sampler_desc.wrap_t = PIPE_TEX_WRAP_REPEAT;
+   sampler_desc.wrap_r = PIPE_TEX_WRAP_REPEAT;
+   sampler_desc.min_img_filter = PIPE_TEX_FILTER_LINEAR;
+   sampler_desc.min_mip_filter = PIPE_TEX_MIPFILTER_LINEAR;
+   sampler_desc.mag_img_filter = PIPE_TEX_FILTER_LINEAR;
+   sampler_desc.normalized_coords = 1;
+   sampler_desc.max_lod = (float)templat.last_level;
+
+   b->sampler = b->ctx->create_sampler_state(b->ctx, &sampler_desc);
+   if (!b->sampler)
+      return FALSE;
+
+   b->ctx->bind_fragment_sampler_states(b->ctx, 1, &b->sampler);
+   return TRUE;
+}
+
+
+static boolean
+texture_init(struct bench *b)
+{
+   static const float attrib0[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+   static const float attrib1[4] = { 2.0f, 2.0f, 0.0f, 1.0f };
+   const char *fs_text =
+      "FRAG\n"
+      "DCL IN[0], GENERIC[0], PERSPECTIVE\n"
+      "DCL OUT[0], COLOR\n"
+      "DCL SAMP[0]\n"
+      "DCL TEMP[0..3]\n"
+      "IMM FLT32 { 2.0, 0.5, 0.25, 0.3 }\n"
+      "  0: TEX TEMP[0], IN[0], SAMP[0], 2D\n"
+      "  1: MUL TEMP[1], IN[0], IMM[0].xxxx\n"
+      "  2: TEX TEMP[1], TEMP[1], SAMP[0], 2D\n"
+      "  3: MUL TEMP[2], IN[0], IMM[0].yyyy\n"
+      "  4: TEX TEMP[2], TEMP[2], SAMP[0], 2D\n"
+      "  5: ADD TEMP[3], IN[0], IMM[0].wwww\n"
+      "  6: TEX TEMP[3], TEMP[3], SAMP[0], 2D\n"
+      "  7: ADD TEMP[0], TEMP[0], TEMP[1]\n"
+      "  8: ADD TEMP[2], TEMP[2], TEMP[3]\n"
+      "  9: ADD TEMP[0], TEMP[0], TEMP[2]\n"
+      " 10: MUL OUT[0], TEMP[0], IMM[0].zzzz\n"
+      " 11: END\n";
+   struct vertex v[NUM_TEX_QUADS * 6];
+   unsigned i;
+
+   for (i = 0; i < NUM_TEX_QUADS; i++)
+      set_quad(&v[i * 6], -1.0f, -1.0f, 1.0f, 1.0f, 0.0f, attrib0, attrib1);
+
+   set_blend(b, FALSE);
+   set_depth(b, FALSE);
+   b->items_per_frame = (double)NUM_TEX_QUADS * b->width * b->height;
+   return init_texture(b) &&
+          set_shaders(b, fs_text) &&
+          set_vertices(b, v, Elements(v));
+}
+
+
+/*
+ * Depth complexity: full screen layers in random depth order, with depth
+ * testing and writes.
+ */
+
+static boolean
+depth_init(struct bench *b)
+{
+   struct vertex v[NUM_LAYERS * 6];
+   unsigned i, c;
+
+   for (i = 0; i < NUM_LAYERS; i++) {
+      const float z = frand() * 2.0f - 1.0f;
+      float color[4];
+
+      for (c = 0; c < 3; c++)
+         color[c] = frand();
+      color[3] = 1.0f;
+
+      set_quad(&v[i * 6], -1.0f, -1.0f, 1.0f, 1.0f, z, color, color);
+   }
+
+   set_blend(b, FALSE);
+   set_depth(b, TRUE);
+   b->items_per_frame = (double)NUM_LAYERS * b->width * b->height;
+   return set_shaders(b, color_fs_text) &&
+          set_vertices(b, v, Elements(v));
+}
+
+
+/*
+ * Many draw calls: small quads, each drawn with its own constant buffer.
+ */
+
+static boolean
+draws_init(struct bench *b)
+{
+   static const float zero[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+   const float dx = 2.0f * DRAW_SIZE / b->width;
+   const float dy = 2.0f * DRAW_SIZE / b->height;
+   const char *fs_text =
+      "FRAG\n"
+      "DCL IN[0], GENERIC[0], LINEAR\n"
+      "DCL OUT[0], COLOR\n"
+      "DCL CONST[0]\n"
+      "  0: ADD OUT[0], CONST[0], IN[0]\n"
+      "  1: END\n";
+   struct vertex *v;
+   unsigned i;
+   boolean ret;
+
+   v = MALLOC(NUM_DRAWS * 6 * sizeof *v);
+   if (!v)
+      return FALSE;
+
+   for (i = 0; i < NUM_DRAWS; i++) {
+      const float x = frand() * (2.0f - dx) - 1.0f;
+      const float y = frand() * (2.0f - dy) - 1.0f;
+      set_quad(&v[i * 6], x, y, x + dx, y + dy, 0.0f, zero, zero);
+   }
+
+   set_blend(b, FALSE);
+   set_depth(b, FALSE);
+   ret = set_shaders(b, fs_text) &&
+         set_vertices(b, v, NUM_DRAWS * 6);
+
+   FREE(v);
+   b->items_per_frame = NUM_DRAWS;
+   return ret;
+}
+
+
+static void
+draws_draw(struct bench *b)
+{
+   unsigned i;
+
+   clear(b);
+
+   for (i = 0; i < NUM_DRAWS; i++) {
+      float color[4];
+      struct pipe_resource *constants;
+
+      color[0] = (float)(i & 0xf) / 15.0f;
+      color[1] = (float)((i >> 4) & 0xf) / 15.0f;
+      color[2] = (float)((i >> 8) & 0xf) / 15.0f;
+      color[3] = 1.0f;
+
+      constants = b->screen->user_buffer_create(b->screen, color,
+                                                sizeof color,
+                                                PIPE_BIND_CONSTANT_BUFFER);
+      b->ctx->set_constant_buffer(b->ctx, PIPE_SHADER_FRAGMENT, 0,
+                                  constants);
+      pipe_resource_reference(&constants, NULL);
+
+      util_draw_arrays(b->ctx, PIPE_PRIM_TRIANGLES, i * 6, 6);
+   }
+}
+
+
+static const struct scene scenes[] = {
+   { "triangles",  "tris",      triangles_init,  draw_all },
+   { "fullscreen", "pixels",    fullscreen_init, draw_all },
+   { "particles",  "particles", particles_init,  draw_all },
+   { "texture",    "pixels",    texture_init,    draw_all },
+   { "depth",      "pixels",    depth_init,      draw_all },
+   { "draws",      "draws",     draws_init,      draws_draw },
+};
+
+
+/*
+ * Benchmark driver.
+ */
+
+static boolean
+init_framebuffer(struct bench *b)
+{
+   struct pipe_framebuffer_state fb;
+   struct pipe_resource templat;
+   struct pipe_surface surf_tmpl;
+   struct pipe_viewport_state vp;
+   struct pipe_rasterizer_state rasterizer;
+
+   memset(&templat, 0, sizeof templat);
+   templat.target = PIPE_TEXTURE_2D;
+   templat.format = PIPE_FORMAT_B8G8R8A8_UNORM;
+   templat.width0 = b->width;
+   templat.height0 = b->height;
+   templat.depth0 = 1;
+   templat.array_size = 1;
+   templat.last_level = 0;
+   templat.nr_samples = 1;
+   templat.bind = PIPE_BIND_RENDER_TARGET | PIPE_BIND_SAMPLER_VIEW;
+
+   b->cbuf = b->screen->resource_create(b->screen, &templat);
+   if (!b->cbuf)
+      return FALSE;
+
+   templat.format = PIPE_FORMAT_Z24_UNORM_S8_UINT;
+   templat.bind = PIPE_BIND_DEPTH_STENCIL;
+   b->zsbuf = b->screen->resource_create(b->screen, &templat);
+   if (!b->zsbuf)
+      return FALSE;
+
+   memset(&surf_tmpl, 0, sizeof surf_tmpl);
+   surf_tmpl.format = b->cbuf->format;
+   surf_tmpl.usage = PIPE_BIND_RENDER_TARGET;
+   b->cbuf_surf = b->ctx->create_surface(b->ctx, b->cbuf, &surf_tmpl);
+   surf_tmpl.format = b->zsbuf->format;
+   surf_tmpl.usage = PIPE_BIND_DEPTH_STENCIL;
+   b->zsbuf_surf = b->ctx->create_surface(b->ctx, b->zsbuf, &surf_tmpl);
+   if (!b->cbuf_surf || !b->zsbuf_surf)
+      return FALSE;
+
+   memset(&fb, 0, sizeof fb);
+   fb.nr_cbufs = 1;
+   fb.width = b->width;
+   fb.height = b->height;
+   fb.cbufs[0] = b->cbuf_surf;
+   fb.zsbuf = b->zsbuf_surf;
+   b->ctx->set_framebuffer_state(b->ctx, &fb);
+
+   vp.scale[0] = b->width / 2.0f;
+   vp.scale[1] = b->height / 2.0f;
+   vp.scale[2] = 0.5f;
+   vp.scale[3] = 1.0f;
+   vp.translate[0] = b->width / 2.0f;
+   vp.translate[1] = b->height / 2.0f;
+   vp.translate[2] = 0.5f;
+   vp.translate[3] = 0.0f;
+   b->ctx->set_viewport_state(b->ctx, &vp);
+
+   memset(&rasterizer, 0, sizeof rasterizer);
+   rasterizer.cull_face = PIPE_FACE_NONE;
+   rasterizer.gl_rasterization_rules = 1;
+   b->rasterizer = b->ctx->create_rasterizer_state(b->ctx, &rasterizer);
+   b->ctx->bind_rasterizer_state(b->ctx, b->rasterizer);
+
+   return TRUE;
+}
+
+
+static void
+fini_framebuffer(struct bench *b)
+{
+   struct pipe_framebuffer_state fb;
+
+   memset(&fb, 0, sizeof fb);
+   b->ctx->set_framebuffer_state(b->ctx, &fb);
+   pipe_surface_reference(&b->cbuf_surf, NULL);
+   pipe_surface_reference(&b->zsbuf_surf, NULL);
+   pipe_resource_reference(&b->cbuf, NULL);
+   pipe_resource_reference(&b->zsbuf, NULL);
+
+   if (b->rasterizer) {
+      b->ctx->bind_rasterizer_state(b->ctx, NULL);
+      b->ctx->delete_rasterizer_state(b->ctx, b->rasterizer);
+      b->rasterizer = NULL;
+   }
+}
+
+
+/**
+ * Unbind and destroy the state objects and resources of a scene.
+ */
+static void
+fini_scene(struct bench *b)
+{
+   struct pipe_context *ctx = b->ctx;
+
+   ctx->set_vertex_buffers(ctx, 0, NULL);
+   ctx->set_fragment_sampler_views(ctx, 0, NULL);
+   ctx->bind_fragment_sampler_states(ctx, 0, NULL);
+   ctx->set_constant_buffer(ctx, PIPE_SHADER_FRAGMENT, 0, NULL);
+
+   if (b->blend) {
+      ctx->bind_blend_state(ctx, NULL);
+      ctx->delete_blend_state(ctx, b->blend);
+   }
+   if (b->dsa) {
+      ctx->bind_depth_stencil_alpha_state(ctx, NULL);
+      ctx->delete_depth_stencil_alpha_state(ctx, b->dsa);
+   }
+   if (b->velems) {
+      ctx->bind_vertex_elements_state(ctx, NULL);
+      ctx->delete_vertex_elements_state(ctx, b->velems);
+   }
+   if (b->vs) {
+      ctx->bind_vs_state(ctx, NULL);
+      ctx->delete_vs_state(ctx, b->vs);
+   }
+   if (b->fs) {
+      ctx->bind_fs_state(ctx, NULL);
+      ctx->delete_fs_state(ctx, b->fs);
+   }
+   if (b->sampler)
+      ctx->delete_sampler_state(ctx, b->sampler);
+   if (b->view)
+      pipe_sampler_view_reference(&b->view, NULL);
+
+   pipe_resource_reference(&b->tex, NULL);
+   pipe_resource_reference(&b->vbuf, NULL);
+
+   b->blend = b->dsa = b->velems = b->vs = b->fs = b->sampler = NULL;
+   b->num_vertices = 0;
+   b->items_per_frame = 0.0;
+}
+
+
+static void
+run_frame(struct bench *b, const struct scene *scene)
+{
+   struct pipe_fence_handle *fence = NULL;
+
+   scene->draw(b);
+
+   b->ctx->flush(b->ctx, &fence);
+   if (fence) {
+      b->screen->fence_finish(b->screen, fence, PIPE_TIMEOUT_INFINITE);
+      b->screen->fence_reference(b->screen, &fence, NULL);
+   }
+}
+
+
+static boolean
+run_scene(struct bench *b, const char *driver, unsigned threads,
+          const struct scene *scene)
+{
+   int64_t start, elapsed;
+   unsigned frames = 0;
+   double msecs;
+
+   rand_state = 0;
+
+   if (!scene->init(b)) {
+      fprintf(stderr, "bench: failed to set up %s\n", scene->name);
+      fini_scene(b);
+      return FALSE;
+   }
+
+   /* Warm up: compile the shader variants, allocate the tiles */
+   run_frame(b, scene);
+
+   start = os_time_get();
+   do {
+      run_frame(b, scene);
+      ++frames;
+      elapsed = os_time_get() - start;
+   } while (elapsed < min_time || frames < 3);
+
+   msecs = elapsed / 1000.0 / frames;
+
+   printf("%s\t%u\t%s\t%u\t%u\t%u\t%.3f\t%.0f\t%s\n",
+          driver, threads, scene->name, b->width, b->height, frames,
+          msecs, b->items_per_frame * 1000.0 / msecs, scene->unit);
+   fflush(stdout);
+
+   fini_scene(b);
+   return TRUE;
+}
+
+
+static boolean
+in_list(const char *list, const char *name)
+{
+   const unsigned len = strlen(name);
+   const char *s = list;
+
+   if (!list)
+      return TRUE;
+
+   while ((s = strstr(s, name)) != NULL) {
+      if ((s == list || s[-1] == ',') && (s[len] == ',' || s[len] == '\0'))
+         return TRUE;
+      s += len;
+   }
+
+   return FALSE;
+}
+
+
+static boolean
+run_driver(struct bench *b, const char *driver, unsigned threads,
+           const char *scene_list)
+{
+   char threads_str[16];
+   void *window = NULL;
+   boolean success = TRUE;
+   unsigned i;
+
+   /* The drivers pick these up on screen/context creation */
+   util_snprintf(threads_str, sizeof threads_str, "%u", threads);
+   set_option("GALLIUM_DRIVER", driver);
+   set_option("LP_NUM_THREADS", threads_str);
+   set_option("SOFTPIPE_NUM_THREADS", threads_str);
+
+   b->screen = graw_create_window_and_screen(0, 0, b->width, b->height,
+                                             PIPE_FORMAT_B8G8R8A8_UNORM,
+                                             &window);
+   if (!b->screen) {
+      fprintf(stderr, "bench: unable to create a screen\n");
+      return FALSE;
+   }
+
+   /* Don't attribute a fallback driver's results to the requested one */
+   if (!strstr(b->screen->get_name(b->screen), driver)) {
+      fprintf(stderr, "bench: %s not available\n", driver);
+      b->screen->destroy(b->screen);
+      b->screen = NULL;
+      return FALSE;
+   }
+
+   b->ctx = b->screen->context_create(b->screen, NULL);
+   if (!b->ctx || !init_framebuffer(b)) {
+      fprintf(stderr, "bench: unable to create a context\n");
+      success = FALSE;
+   }
+   else {
+      for (i = 0; i < Elements(scenes); i++) {
+         if (in_list(scene_list, scenes[i].name)) {
+            if (!run_scene(b, driver, threads, &scenes[i]))
+               success = FALSE;
+         }
+      }
+   }
+
+   if (b->ctx) {
+      fini_framebuffer(b);
+      b->ctx->destroy(b->ctx);
+      b->ctx = NULL;
+   }
+   b->screen->destroy(b->screen);
+   b->screen = NULL;
+
+   return success;
+}
+
+
+static void
+usage(void)
+{
+   fprintf(stderr,
+           "usage: bench [-d driver,...] [-t max_threads] [-s scene,...]\n"
+           "             [-w width] [-h height] [-m min_msecs]\n"
+           "\n"
+           "Runs each scene with 1, 2, 4... up to max_threads rasterizer\n"
+           "threads (default: the number of CPUs) and prints tab separated\n"
+           "results.  Drivers default to llvmpipe,softpipe.  Scenes:\n");
+   {
+      unsigned i;
+      for (i = 0; i < Elements(scenes); i++)
+         fprintf(stderr, "  %s\n", scenes[i].name);
+   }
+   exit(1);
+}
+
+
+int main( int argc, char *argv[] )
+{
+   struct bench b;
+   char drivers[256] = "llvmpipe,softpipe";
+   const char *scene_list = NULL;
+   unsigned max_threads;
+   boolean success = TRUE;
+   char *driver;
+   int i;
+
+   util_cpu_detect();
+   max_threads = util_cpu_caps.nr_cpus;
+
+   memset(&b, 0, sizeof b);
+   b.width = 512;
+   b.height = 512;
+
+   for (i = 1; i < argc; i++) {
+      if (i + 1 >= argc)
+         usage();
+      if (strcmp(argv[i], "-d") == 0) {
+         strncpy(drivers, argv[++i], sizeof drivers - 1);
+         drivers[sizeof drivers - 1] = '\0';
+      }
+      else if (strcmp(argv[i], "-t") == 0)
+         max_threads = atoi(argv[++i]);
+      else if (strcmp(argv[i], "-s") == 0)
+         scene_list = argv[++i];
+      else if (strcmp(argv[i], "-w") == 0)
+         b.width = atoi(argv[++i]);
+      else if (strcmp(argv[i], "-h") == 0)
+         b.height = atoi(argv[++i]);
+      else if (strcmp(argv[i], "-m") == 0)
+         min_time = atoi(argv[++i]) * 1000;
+      else
+         usage();
+   }
+
+   if (!b.width || !b.height || !max_threads)
+      usage();
+
+   printf("driver\tthreads\tscene\twidth\theight\tframes\t"
+          "ms_per_frame\titems_per_sec\tunit\n");
+   fflush(stdout);
+
+   for (driver = strtok(drivers, ","); driver; driver = strtok(NULL, ",")) {
+      unsigned threads = 1;
+
+      for (;;) {
+         if (!run_driver(&b, driver, threads, scene_list)) {
+            success = FALSE;
+            break;
+         }
+         if (threads == max_threads)
+            break;
+         threads = MIN2(threads * 2, max_threads);
+      }
+   }
+
+   return success ? 0 : 1;
+}
@@ -0,0 +1,344 @@
+/**
+ * Delete and recreate fragment shaders between draws, and check that each
+ * draw ran the shader bound for it.
+ *
+ * The tokens of a new shader are often allocated at the address of the
+ * ones just freed, so drivers caching decoded shaders by token pointer
+ * (like the softpipe worker threads) may run the deleted shader instead.
+ * SOFTPIPE_NUM_THREADS defaults to 4 here to cover the threaded path.
+ *
+ * Usage: fs-recreate [iterations]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "state_tracker/graw.h"
+#include "pipe/p_screen.h"
+#include "pipe/p_context.h"
+#include "pipe/p_state.h"
+#include "pipe/p_defines.h"
+
+#include "util/u_debug.h"       /* debug_get_option() */
+#include "util/u_inlines.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"      /* Offset() */
+#include "util/u_draw_quad.h"
+#include "util/u_string.h"
+#include "util/u_tile.h"
+
+
+static int num_iters = 100;
+
+
+enum pipe_format formats[] = {
+   PIPE_FORMAT_R8G8B8A8_UNORM,
+   PIPE_FORMAT_B8G8R8A8_UNORM,
+   PIPE_FORMAT_NONE
+};
+
+static const int WIDTH = 300;
+static const int HEIGHT = 300;
+
+static struct pipe_screen *screen = NULL;
+static struct pipe_context *ctx = NULL;
+static struct pipe_surface *surf = NULL;
+static struct pipe_resource *tex = NULL;
+static void *window = NULL;
+
+struct vertex {
+   float position[4];
+};
+
+static struct vertex vertices[4] =
+{
+   { { -1.0f, -1.0f, 0.0f, 1.0f } },
+   { {  1.0f, -1.0f, 0.0f, 1.0f } },
+   { {  1.0f,  1.0f, 0.0f, 1.0f } },
+   { { -1.0f,  1.0f, 0.0f, 1.0f } }
+};
+
+/* Colors of the successive shaders */
+static const float colors[3][4] = {
+   { 1.0f, 0.0f, 0.0f, 1.0f },
+   { 0.0f, 1.0f, 0.0f, 1.0f },
+   { 0.0f, 0.0f, 1.0f, 1.0f }
+};
+
+
+
+
+static void set_viewport( float x, float y,
+                          float width, float height,
+                          float near, float far)
+{
+   float z = far;
+   float half_width = (float)width / 2.0f;
+   float half_height = (float)height / 2.0f;
+   float half_depth = ((float)far - (float)near) / 2.0f;
+   struct pipe_viewport_state vp;
+
+   vp.scale[0] = half_width;
+   vp.scale[1] = half_height;
+   vp.scale[2] = half_depth;
+   vp.scale[3] = 1.0f;
+
+   vp.translate[0] = half_width + x;
+   vp.translate[1] = half_height + y;
+   vp.translate[2] = half_depth + z;
+   vp.translate[3] = 0.0f;
+
+   ctx->set_viewport_state( ctx, &vp );
+}
+
+static void set_vertices( void )
+{
+   struct pipe_vertex_element ve[1];
+   struct pipe_vertex_buffer vbuf;
+   void *handle;
+
+   memset(ve, 0, sizeof ve);
+
+   ve[0].src_offset = Offset(struct vertex, position);
+   ve[0].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+
+   handle = ctx->create_vertex_elements_state(ctx, 1, ve);
+   ctx->bind_vertex_elements_state(ctx, handle);
+
+
+   vbuf.stride = sizeof(struct vertex);
+   vbuf.buffer_offset = 0;
+   vbuf.buffer = screen->user_buffer_create(screen,
+                                            vertices,
+                                            sizeof(vertices),
+                                            PIPE_BIND_VERTEX_BUFFER);
+
+   ctx->set_vertex_buffers(ctx, 1, &vbuf);
+}
+
+static void set_vertex_shader( void )
+{
+   void *handle;
+   const char *text =
+      "VERT\n"
+      "DCL IN[0]\n"
+      "DCL OUT[0], POSITION\n"
+      "  0: MOV OUT[0], IN[0]\n"
+      "  1: END\n";
+
+   handle = graw_parse_vertex_shader(ctx, text);
+   ctx->bind_vs_state(ctx, handle);
+}
+
+
+static void *
+create_fragment_shader( const float *color )
+{
+   char text[256];
+
+   util_snprintf(text, sizeof text,
+                 "FRAG\n"
+                 "DCL OUT[0], COLOR\n"
+                 "IMM FLT32 { %f, %f, %f, %f }\n"
+                 "  0: MOV OUT[0], IMM[0]\n"
+                 "  1: END\n",
+                 color[0], color[1], color[2], color[3]);
+
+   return graw_parse_fragment_shader(ctx, text);
+}
+
+
+/**
+ * Check a column of pixels crossing all the tile rows, which the
+ * softpipe threads share out.
+ */
+static boolean check_column( const float *color )
+{
+   struct pipe_transfer *t;
+   float *rgba;
+   boolean pass = TRUE;
+   int y, c;
+
+   rgba = MALLOC(HEIGHT * 4 * sizeof(float));
+   if (!rgba)
+      return FALSE;
+
+   t = pipe_get_transfer(ctx, tex,
+                         0, 0, /* level, layer */
+                         PIPE_TRANSFER_READ,
+                         WIDTH / 2, 0, 1, HEIGHT); /* x, y, width, height */
+   pipe_get_tile_rgba(ctx, t, 0, 0, 1, HEIGHT, rgba);
+   ctx->transfer_destroy(ctx, t);
+
+   for (y = 0; y < HEIGHT && pass; y++) {
+      for (c = 0; c < 4; c++) {
+         if (fabsf(rgba[y * 4 + c] - color[c]) > 0.01f) {
+            fprintf(stderr, "pixel (%d, %d) is %f %f %f %f, "
+                    "expected %f %f %f %f\n",
+                    WIDTH / 2, y,
+                    rgba[y * 4 + 0], rgba[y * 4 + 1],
+                    rgba[y * 4 + 2], rgba[y * 4 + 3],
+                    color[0], color[1], color[2], color[3]);
+            pass = FALSE;
+            break;
+         }
+      }
+   }
+
+   FREE(rgba);
+   return pass;
+}
+
+
+static void draw( void )
+{
+   union pipe_color_union clear_color = { {0,0,0,1} };
+   int i;
+
+   printf("Recreating %d shaders\n", num_iters);
+
+   for (i = 0; i < num_iters; i++) {
+      const float *color = colors[i % Elements(colors)];
+      void *fs = create_fragment_shader(color);
+
+      ctx->bind_fs_state(ctx, fs);
+
+      ctx->clear(ctx, PIPE_CLEAR_COLOR, &clear_color, 0, 0);
+      util_draw_arrays(ctx, PIPE_PRIM_QUADS, 0, 4);
+      ctx->flush(ctx, NULL);
+
+      ctx->bind_fs_state(ctx, NULL);
+      ctx->delete_fs_state(ctx, fs);
+
+      if (!check_column(color)) {
+         fprintf(stderr, "FAIL at iteration %d\n", i);
+         exit(1);
+      }
+   }
+
+   printf("PASS\n");
+
+   screen->flush_frontbuffer(screen, tex, 0, 0, window);
+   ctx->destroy(ctx);
+
+   exit(0);
+}
+
+
+static void init( void )
+{
+   struct pipe_framebuffer_state fb;
+   struct pipe_resource templat;
+   struct pipe_surface surf_tmpl;
+   int i;
+
+   /* Softpipe picks this up on context creation */
+   if (!debug_get_option("SOFTPIPE_NUM_THREADS", NULL)) {
+#ifdef PIPE_OS_WINDOWS
+      _putenv_s("SOFTPIPE_NUM_THREADS", "4");
+#else
+      setenv("SOFTPIPE_NUM_THREADS", "4", 1);
+#endif
+   }
+
+   /* It's hard to say whether window or screen should be created
+    * first.  Different environments would prefer one or the other.
+    *
+    * Also, no easy way of querying supported formats if the screen
+    * cannot be created first.
+    */
+   for (i = 0; formats[i] != PIPE_FORMAT_NONE; i++) {
+      screen = graw_create_window_and_screen(0, 0, 300, 300,
+                                             formats[i],
+                                             &window);
+      if (window && screen)
+         break;
+   }
+   if (!screen || !window) {
+      fprintf(stderr, "Unable to create window\n");
+      exit(1);
+   }
+
+   ctx = screen->context_create(screen, NULL);
+   if (ctx == NULL)
+      exit(3);
+
+   templat.target = PIPE_TEXTURE_2D;
+   templat.format = formats[i];
+   templat.width0 = WIDTH;
+   templat.height0 = HEIGHT;
+   templat.depth0 = 1;
+   templat.array_size = 1;
+   templat.last_level = 0;
+   templat.nr_samples = 1;
+   templat.bind = (PIPE_BIND_RENDER_TARGET |
+                   PIPE_BIND_DISPLAY_TARGET);
+
+   tex = screen->resource_create(screen, &templat);
+   if (tex == NULL) {
+      fprintf(stderr, "Unable to create screen texture!\n");
+      exit(4);
+   }
+
+   surf_tmpl.format = templat.format;
+   surf_tmpl.usage = PIPE_BIND_RENDER_TARGET;
+   surf_tmpl.u.tex.level = 0;
+   surf_tmpl.u.tex.first_layer = 0;
+   surf_tmpl.u.tex.last_layer = 0;
+   surf = ctx->create_surface(ctx, tex, &surf_tmpl);
+   if (surf == NULL) {
+      fprintf(stderr, "Unable to create tex surface!\n");
+      exit(5);
+   }
+
+   memset(&fb, 0, sizeof fb);
+   fb.nr_cbufs = 1;
+   fb.width = WIDTH;
+   fb.height = HEIGHT;
+   fb.cbufs[0] = surf;
+
+   ctx->set_framebuffer_state(ctx, &fb);
+
+   {
+      struct pipe_blend_state blend;
+      void *handle;
+      memset(&blend, 0, sizeof blend);
+      blend.rt[0].colormask = PIPE_MASK_RGBA;
+      handle = ctx->create_blend_state(ctx, &blend);
+      ctx->bind_blend_state(ctx, handle);
+   }
+
+   {
+      struct pipe_depth_stencil_alpha_state depthstencil;
+      void *handle;
+      memset(&depthstencil, 0, sizeof depthstencil);
+      handle = ctx->create_depth_stencil_alpha_state(ctx, &depthstencil);
+      ctx->bind_depth_stencil_alpha_state(ctx, handle);
+   }
+
+   {
+      struct pipe_rasterizer_state rasterizer;
+      void *handle;
+      memset(&rasterizer, 0, sizeof rasterizer);
+      rasterizer.cull_face = PIPE_FACE_NONE;
+      rasterizer.gl_rasterization_rules = 1;
+      handle = ctx->create_rasterizer_state(ctx, &rasterizer);
+      ctx->bind_rasterizer_state(ctx, handle);
+   }
+
+   set_viewport(0, 0, WIDTH, HEIGHT, 30, 1000);
+   set_vertices();
+   set_vertex_shader();
+}
+
+
+int main( int argc, char *argv[] )
+{
+   if (argc > 1)
+      num_iters = atoi(argv[1]);
+
+   init();
+
+   graw_set_display_func( draw );
+   graw_main_loop();
+   return 0;
+}
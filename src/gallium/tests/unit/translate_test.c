@@ -28,7 +28,9 @@
 #include "util/u_memory.h"
 #include "util/u_format.h"
 #include "util/u_cpu_detect.h"
+#include "util/u_half.h"
 #include "rtasm/rtasm_cpu.h"
+#include "os/os_time.h"
 
 /* don't use this for serious use */
 static double rand_double()
@@ -45,6 +47,121 @@ static double rand_double()
    return v;
 }
 
+#define BENCH_VERTICES 4096
+
+/** Minimum time spent on each measurement, in usecs */
+#define BENCH_MIN_TIME 20000
+
+/* common vertex fetch and emit conversions */
+static const struct {
+   enum pipe_format input_format;
+   enum pipe_format output_format;
+} bench_conversions[] = {
+   {PIPE_FORMAT_R32G32B32A32_FLOAT, PIPE_FORMAT_R32G32B32A32_FLOAT},
+   {PIPE_FORMAT_R32G32B32_FLOAT, PIPE_FORMAT_R32G32B32A32_FLOAT},
+   {PIPE_FORMAT_R32G32_FLOAT, PIPE_FORMAT_R32G32B32A32_FLOAT},
+   {PIPE_FORMAT_R16G16B16A16_FLOAT, PIPE_FORMAT_R32G32B32A32_FLOAT},
+   {PIPE_FORMAT_R16G16_FLOAT, PIPE_FORMAT_R32G32_FLOAT},
+   {PIPE_FORMAT_R8G8B8A8_UNORM, PIPE_FORMAT_R32G32B32A32_FLOAT},
+   {PIPE_FORMAT_R16G16_SNORM, PIPE_FORMAT_R32G32_FLOAT},
+   {PIPE_FORMAT_R10G10B10A2_UNORM, PIPE_FORMAT_R32G32B32A32_FLOAT},
+   {PIPE_FORMAT_R10G10B10A2_SNORM, PIPE_FORMAT_R32G32B32_FLOAT},
+   {PIPE_FORMAT_R32G32B32A32_FLOAT, PIPE_FORMAT_B8G8R8A8_UNORM},
+   {PIPE_FORMAT_R32G32B32A32_FLOAT, PIPE_FORMAT_R8G8B8A8_UNORM}
+};
+
+/**
+ * Return the throughput in millions of vertices per second, of run() if
+ * elts is NULL, of run_elts() otherwise.
+ */
+static double bench_translate(struct translate *translate,
+                              const unsigned *elts,
+                              void *output_buffer)
+{
+   int64_t start, elapsed;
+   unsigned iterations = 0;
+
+   start = os_time_get();
+   do {
+      if (elts)
+         translate->run_elts(translate, elts, BENCH_VERTICES, 0, output_buffer);
+      else
+         translate->run(translate, 0, BENCH_VERTICES, 0, output_buffer);
+      ++iterations;
+      elapsed = os_time_get() - start;
+   } while (elapsed < BENCH_MIN_TIME);
+
+   return (double)BENCH_VERTICES * iterations / elapsed;
+}
+
+/**
+ * Print the vertex throughput of create_fn for the common conversions,
+ * both for linear and indexed fetches.
+ */
+static void bench(struct translate *(*create_fn)(const struct translate_key *key),
+                  const char *name)
+{
+   unsigned char *input_buffer = align_malloc(BENCH_VERTICES * 32, 4096);
+   unsigned char *output_buffer = align_malloc(BENCH_VERTICES * 32, 4096);
+   unsigned *elts = align_malloc(BENCH_VERTICES * sizeof *elts, 4096);
+   struct translate_key key;
+   unsigned i;
+
+   /* keep the (half) floats in a sane range, away from the denormals */
+   for (i = 0; i < BENCH_VERTICES * 32; ++i)
+      input_buffer[i] = 0x20 | (rand() & 0x1f);
+
+   /* shuffle the vertices within runs of 64, like a vertex cache would */
+   for (i = 0; i < BENCH_VERTICES; ++i)
+      elts[i] = (i & ~63) | ((i * 37) & 63);
+
+   memset(&key, 0, sizeof key);
+   key.nr_elements = 1;
+   key.element[0].type = TRANSLATE_ELEMENT_NORMAL;
+
+   printf("%-28s %-28s %14s %14s\n", "input", "output",
+          "run Mverts/s", "elts Mverts/s");
+
+   for (i = 0; i < Elements(bench_conversions); ++i)
+   {
+      struct translate *translate;
+      unsigned input_size;
+      double linear_rate, elts_rate;
+
+      key.element[0].input_format = bench_conversions[i].input_format;
+      key.element[0].output_format = bench_conversions[i].output_format;
+      key.output_stride = util_format_get_stride(key.element[0].output_format, 1);
+      input_size = util_format_get_stride(key.element[0].input_format, 1);
+
+      translate = create_fn(&key);
+      if (!translate)
+      {
+         printf("%-28s %-28s %14s\n",
+                util_format_name(key.element[0].input_format),
+                util_format_name(key.element[0].output_format),
+                "unsupported");
+         continue;
+      }
+
+      translate->set_buffer(translate, 0, input_buffer, input_size, BENCH_VERTICES - 1);
+      linear_rate = bench_translate(translate, NULL, output_buffer);
+      elts_rate = bench_translate(translate, elts, output_buffer);
+
+      printf("%-28s %-28s %14.1f %14.1f\n",
+             util_format_name(key.element[0].input_format),
+             util_format_name(key.element[0].output_format),
+             linear_rate, elts_rate);
+
+      translate->release(translate);
+   }
+
+   printf("for translate_%s\n", name);
+
+   align_free(input_buffer);
+   align_free(output_buffer);
+   align_free(elts);
+}
+
 int main(int argc, char** argv)
 {
    struct translate *(*create_fn)(const struct translate_key *key) = 0;
@@ -57,6 +174,7 @@ int main(int argc, char** argv)
    unsigned char* byte_buffer;
    float* float_buffer;
    double* double_buffer;
+   uint16_t* half_buffer;
    unsigned * elts;
    unsigned count = 4;
    unsigned i, j, k;
@@ -127,16 +245,23 @@ int main(int argc, char** argv)
 
    if (!create_fn)
    {
-      printf("Usage: ./translate_test [generic|x86|nosse|sse|sse2|sse3|sse4.1]\n");
+      printf("Usage: ./translate_test [generic|x86|nosse|sse|sse2|sse3|sse4.1] [bench]\n");
       return 2;
    }
 
+   if (argc > 2 && !strcmp(argv[2], "bench"))
+   {
+      bench(create_fn, argv[1]);
+      return 0;
+   }
+
    for (i = 1; i < Elements(buffer); ++i)
       buffer[i] = align_malloc(buffer_size, 4096);
 
    byte_buffer = align_malloc(buffer_size, 4096);
    float_buffer = align_malloc(buffer_size, 4096);
    double_buffer = align_malloc(buffer_size, 4096);
+   half_buffer = align_malloc(buffer_size, 4096);
 
    elts = align_malloc(count * sizeof *elts, 4096);
 
@@ -159,6 +284,9 @@ int main(int argc, char** argv)
    for (i = 0; i < buffer_size / sizeof(double); ++i)
       double_buffer[i] = rand_double();
 
+   for (i = 0; i < buffer_size / sizeof(uint16_t); ++i)
+      half_buffer[i] = util_float_to_half((float)rand_double());
+
    for (i = 0; i < count; ++i)
       elts[i] = i;
 
@@ -246,6 +374,8 @@ int main(int argc, char** argv)
             buffer[0] = (unsigned char*)float_buffer;
          else if(input_is_float && input_format_desc->channel[0].size == 64)
             buffer[0] = (unsigned char*)double_buffer;
+         else if(input_is_float && input_format_desc->channel[0].size == 16)
+            buffer[0] = (unsigned char*)half_buffer;
          else if(input_is_float)
             abort();
          else
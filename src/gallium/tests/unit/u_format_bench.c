@@ -0,0 +1,333 @@
+/**************************************************************************
+ *
+ * Copyright 2012 The Mesa authors.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS AND/OR THEIR SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/**
+ * @file
+ * Throughput of the pixel format pack/unpack functions.
+ *
+ * For every format and direction this prints the rate in GB/s of packed
+ * pixel data, with the generic C code and with the SIMD kernels selected
+ * from the CPU caps, and checks that both give the same result.
+ *
+ * Usage: u_format_bench [format-name ...]
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "util/u_memory.h"
+#include "util/u_format.h"
+#include "util/u_format_s3tc.h"
+#include "util/u_cpu_detect.h"
+#include "os/os_time.h"
+
+
+#define WIDTH   256
+#define HEIGHT  256
+
+/** Minimum time spent on each measurement, in usecs */
+#define MIN_TIME 20000
+
+
+enum direction {
+   UNPACK_RGBA_FLOAT,
+   PACK_RGBA_FLOAT,
+   UNPACK_RGBA_8UNORM,
+   PACK_RGBA_8UNORM,
+   NUM_DIRECTIONS
+};
+
+static const char *direction_names[NUM_DIRECTIONS] = {
+   "unpack_rgba_float",
+   "pack_rgba_float",
+   "unpack_rgba_8unorm",
+   "pack_rgba_8unorm"
+};
+
+
+/**
+ * Formats whose 8unorm pack/unpack functions are unimplemented stubs that
+ * only print their name.  Timing them would measure stdio, and flood the
+ * output.
+ */
+static const enum pipe_format stub_8unorm_formats[] = {
+   PIPE_FORMAT_RGTC1_SNORM,
+   PIPE_FORMAT_RGTC2_SNORM,
+   PIPE_FORMAT_LATC1_SNORM,
+   PIPE_FORMAT_LATC2_SNORM
+};
+
+
+static boolean
+is_stub_8unorm(const struct util_format_description *format_desc)
+{
+   unsigned i;
+   for (i = 0; i < Elements(stub_8unorm_formats); ++i) {
+      if (format_desc->format == stub_8unorm_formats[i])
+         return TRUE;
+   }
+   return FALSE;
+}
+
+
+static boolean
+has_direction(const struct util_format_description *format_desc,
+              enum direction dir)
+{
+   switch (dir) {
+   case UNPACK_RGBA_FLOAT:
+      return format_desc->unpack_rgba_float != NULL;
+   case PACK_RGBA_FLOAT:
+      return format_desc->pack_rgba_float != NULL;
+   case UNPACK_RGBA_8UNORM:
+      return format_desc->unpack_rgba_8unorm != NULL &&
+             !is_stub_8unorm(format_desc);
+   case PACK_RGBA_8UNORM:
+      return format_desc->pack_rgba_8unorm != NULL &&
+             !is_stub_8unorm(format_desc);
+   default:
+      return FALSE;
+   }
+}
+
+
+static void
+run_direction(const struct util_format_description *format_desc,
+              enum direction dir,
+              uint8_t *packed, unsigned packed_stride,
+              float *rgba_float, uint8_t *rgba_8unorm)
+{
+   switch (dir) {
+   case UNPACK_RGBA_FLOAT:
+      format_desc->unpack_rgba_float(rgba_float, WIDTH * 4 * sizeof(float),
+                                     packed, packed_stride,
+                                     WIDTH, HEIGHT);
+      break;
+   case PACK_RGBA_FLOAT:
+      format_desc->pack_rgba_float(packed, packed_stride,
+                                   rgba_float, WIDTH * 4 * sizeof(float),
+                                   WIDTH, HEIGHT);
+      break;
+   case UNPACK_RGBA_8UNORM:
+      format_desc->unpack_rgba_8unorm(rgba_8unorm, WIDTH * 4,
+                                      packed, packed_stride,
+                                      WIDTH, HEIGHT);
+      break;
+   case PACK_RGBA_8UNORM:
+      format_desc->pack_rgba_8unorm(packed, packed_stride,
+                                    rgba_8unorm, WIDTH * 4,
+                                    WIDTH, HEIGHT);
+      break;
+   default:
+      break;
+   }
+}
+
+
+/**
+ * Return the throughput in GB/s of packed data.
+ */
+static double
+time_direction(const struct util_format_description *format_desc,
+               enum direction dir,
+               uint8_t *packed, unsigned packed_stride, unsigned packed_size,
+               float *rgba_float, uint8_t *rgba_8unorm)
+{
+   int64_t start, elapsed;
+   unsigned iterations = 0;
+
+   start = os_time_get();
+   do {
+      run_direction(format_desc, dir, packed, packed_stride,
+                    rgba_float, rgba_8unorm);
+      ++iterations;
+      elapsed = os_time_get() - start;
+   } while (elapsed < MIN_TIME);
+
+   return (double)packed_size * iterations / (elapsed * 1e3);
+}
+
+
+static void
+fill_random(uint8_t *data, unsigned size)
+{
+   unsigned i;
+   for (i = 0; i < size; ++i)
+      data[i] = rand() & 0xff;
+}
+
+
+static void
+fill_rgba_float(float *data, unsigned count)
+{
+   unsigned i;
+   for (i = 0; i < count; ++i)
+      data[i] = (float)(rand() % 1200 - 100) / 1000.0f;
+}
+
+
+static boolean
+bench_format(const struct util_format_description *format_desc,
+             const struct util_cpu_caps *simd_caps)
+{
+   const unsigned packed_stride = util_format_get_stride(format_desc->format,
+                                                         WIDTH);
+   const unsigned packed_size = util_format_get_2d_size(format_desc->format,
+                                                        packed_stride, HEIGHT);
+   const unsigned rgba_size = WIDTH * HEIGHT * 4;
+   uint8_t *packed[2];
+   float *rgba_float[2];
+   uint8_t *rgba_8unorm[2];
+   boolean success = TRUE;
+   unsigned dir, i;
+
+   for (i = 0; i < 2; ++i) {
+      packed[i] = MALLOC(packed_size);
+      rgba_float[i] = MALLOC(rgba_size * sizeof(float));
+      rgba_8unorm[i] = MALLOC(rgba_size);
+   }
+
+   for (dir = 0; dir < NUM_DIRECTIONS; ++dir) {
+      double rate[2];
+      boolean match = TRUE;
+
+      if (!has_direction(format_desc, dir))
+         continue;
+
+      /* The same input for both runs */
+      srand(dir);
+      fill_random(packed[0], packed_size);
+      fill_random(rgba_8unorm[0], rgba_size);
+      fill_rgba_float(rgba_float[0], rgba_size);
+      memcpy(packed[1], packed[0], packed_size);
+      memcpy(rgba_8unorm[1], rgba_8unorm[0], rgba_size);
+      memcpy(rgba_float[1], rgba_float[0], rgba_size * sizeof(float));
+
+      for (i = 0; i < 2; ++i) {
+         if (i == 0) {
+            util_cpu_caps.has_sse2 = 0;
+            util_cpu_caps.has_ssse3 = 0;
+         }
+         else {
+            util_cpu_caps = *simd_caps;
+         }
+
+         rate[i] = time_direction(format_desc, dir,
+                                  packed[i], packed_stride, packed_size,
+                                  rgba_float[i], rgba_8unorm[i]);
+      }
+
+      switch (dir) {
+      case UNPACK_RGBA_FLOAT:
+         match = memcmp(rgba_float[0], rgba_float[1],
+                        rgba_size * sizeof(float)) == 0;
+         break;
+      case UNPACK_RGBA_8UNORM:
+         match = memcmp(rgba_8unorm[0], rgba_8unorm[1], rgba_size) == 0;
+         break;
+      default:
+         match = memcmp(packed[0], packed[1], packed_size) == 0;
+         break;
+      }
+
+      printf("%-40s %-20s %8.3f %8.3f %6.2fx%s\n",
+             format_desc->name, direction_names[dir],
+             rate[0], rate[1], rate[1] / rate[0],
+             match ? "" : "  MISMATCH");
+      fflush(stdout);
+
+      if (!match)
+         success = FALSE;
+   }
+
+   for (i = 0; i < 2; ++i) {
+      FREE(packed[i]);
+      FREE(rgba_float[i]);
+      FREE(rgba_8unorm[i]);
+   }
+
+   return success;
+}
+
+
+static boolean
+format_requested(const struct util_format_description *format_desc,
+                 int argc, char **argv)
+{
+   int i;
+
+   if (argc < 2)
+      return TRUE;
+
+   for (i = 1; i < argc; ++i) {
+      if (strcmp(argv[i], format_desc->name) == 0 ||
+          strcmp(argv[i], format_desc->short_name) == 0)
+         return TRUE;
+   }
+
+   return FALSE;
+}
+
+
+int main(int argc, char **argv)
+{
+   struct util_cpu_caps simd_caps;
+   enum pipe_format format;
+   boolean success = TRUE;
+
+   util_format_s3tc_init();
+   util_cpu_detect();
+   simd_caps = util_cpu_caps;
+
+   printf("%-40s %-20s %8s %8s %7s\n",
+          "format", "direction", "C GB/s", "SIMD GB/s", "speedup");
+
+   for (format = 1; format < PIPE_FORMAT_COUNT; ++format) {
+      const struct util_format_description *format_desc;
+
+      format_desc = util_format_description(format);
+      if (!format_desc)
+         continue;
+
+      if (!format_requested(format_desc, argc, argv))
+         continue;
+
+      if (format_desc->layout == UTIL_FORMAT_LAYOUT_S3TC &&
+          !util_format_s3tc_enabled)
+         continue;
+
+      if (!bench_format(format_desc, &simd_caps))
+         success = FALSE;
+   }
+
+   util_cpu_caps = simd_caps;
+
+   return success ? 0 : 1;
+}
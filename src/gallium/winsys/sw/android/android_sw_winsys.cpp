@@ -75,7 +75,9 @@ namespace android {
 static void
 android_displaytarget_display(struct sw_winsys *ws,
                               struct sw_displaytarget *dt,
-                              void *context_private)
+                              void *context_private,
+                              const struct pipe_box *boxes,
+                              unsigned num_boxes)
 {
 }
 
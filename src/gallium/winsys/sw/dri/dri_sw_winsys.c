@@ -28,6 +28,7 @@
 
 #include "pipe/p_compiler.h"
 #include "pipe/p_format.h"
+#include "pipe/p_state.h"
 #include "util/u_inlines.h"
 #include "util/u_format.h"
 #include "util/u_math.h"
@@ -46,6 +47,9 @@ struct dri_sw_displaytarget
 
    void *data;
    void *mapped;
+
+   /** drawable this displaytarget was last displayed to */
+   void *last_drawable;
 };
 
 struct dri_sw_winsys
@@ -53,6 +57,10 @@ struct dri_sw_winsys
    struct sw_winsys base;
 
    struct drisw_loader_funcs *lf;
+
+   /** buffer for packing partial images, see dri_sw_put_box() */
+   void *scratch;
+   unsigned scratch_size;
 };
 
 static INLINE struct dri_sw_displaytarget *
@@ -165,15 +173,73 @@ dri_sw_displaytarget_get_handle(struct sw_winsys *winsys,
    return FALSE;
 }
 
+/**
+ * Put a region of the displaytarget.  The loader expects rows of the
+ * image width, so unless the region spans whole rows it gets packed in
+ * a scratch buffer first.
+ */
+static void
+dri_sw_put_box(struct dri_sw_winsys *dri_sw_ws,
+               struct dri_sw_displaytarget *dri_sw_dt,
+               struct dri_drawable *dri_drawable,
+               const struct pipe_box *box)
+{
+   const unsigned cpp = util_format_get_blocksize(dri_sw_dt->format);
+   const ubyte *src = (const ubyte *) dri_sw_dt->data +
+                      box->y * dri_sw_dt->stride + box->x * cpp;
+   unsigned stride, size, y;
+   ubyte *dst;
+
+   if (box->x == 0 && box->width == dri_sw_dt->width) {
+      dri_sw_ws->lf->put_image2(dri_drawable, (void *) src, 0, box->y,
+                                dri_sw_dt->stride / cpp, box->height);
+      return;
+   }
+
+   stride = align(box->width * cpp, 4);
+   size = stride * box->height;
+   if (size > dri_sw_ws->scratch_size) {
+      FREE(dri_sw_ws->scratch);
+      dri_sw_ws->scratch = MALLOC(size);
+      dri_sw_ws->scratch_size = dri_sw_ws->scratch ? size : 0;
+      if (!dri_sw_ws->scratch)
+         return;
+   }
+
+   dst = dri_sw_ws->scratch;
+   for (y = 0; y < box->height; y++) {
+      memcpy(dst, src, box->width * cpp);
+      src += dri_sw_dt->stride;
+      dst += stride;
+   }
+
+   dri_sw_ws->lf->put_image2(dri_drawable, dri_sw_ws->scratch,
+                             box->x, box->y, box->width, box->height);
+}
+
 static void
 dri_sw_displaytarget_display(struct sw_winsys *ws,
                              struct sw_displaytarget *dt,
-                             void *context_private)
+                             void *context_private,
+                             const struct pipe_box *boxes,
+                             unsigned num_boxes)
 {
    struct dri_sw_winsys *dri_sw_ws = dri_sw_winsys(ws);
    struct dri_sw_displaytarget *dri_sw_dt = dri_sw_displaytarget(dt);
    struct dri_drawable *dri_drawable = (struct dri_drawable *)context_private;
-   unsigned width, height;
+   unsigned width, height, i;
+
+   /* Only put the modified regions if the drawable shows the rest of the
+    * displaytarget already.
+    */
+   if (boxes && dri_sw_ws->lf->put_image2 &&
+       dri_sw_dt->last_drawable == context_private) {
+      for (i = 0; i < num_boxes; i++)
+         dri_sw_put_box(dri_sw_ws, dri_sw_dt, dri_drawable, &boxes[i]);
+      return;
+   }
+
+   dri_sw_dt->last_drawable = context_private;
 
    /* Set the width to 'stride / cpp'.
     *
@@ -190,6 +256,9 @@ dri_sw_displaytarget_display(struct sw_winsys *ws,
 static void
 dri_destroy_sw_winsys(struct sw_winsys *winsys)
 {
+   struct dri_sw_winsys *dri_sw_ws = dri_sw_winsys(winsys);
+
+   FREE(dri_sw_ws->scratch);
    FREE(winsys);
 }
 
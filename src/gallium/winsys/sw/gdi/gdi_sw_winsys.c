@@ -207,7 +207,9 @@ gdi_sw_display( struct sw_winsys *winsys,
 static void
 gdi_sw_displaytarget_display(struct sw_winsys *winsys, 
                              struct sw_displaytarget *dt,
-                             void *context_private)
+                             void *context_private,
+                             const struct pipe_box *boxes,
+                             unsigned num_boxes)
 {
     /* nasty:
      */
@@ -34,6 +34,7 @@
 
 #include "pipe/p_format.h"
 #include "pipe/p_context.h"
+#include "util/u_box.h"
 #include "util/u_inlines.h"
 #include "util/u_format.h"
 #include "util/u_math.h"
@@ -284,16 +285,22 @@ xlib_displaytarget_destroy(struct sw_winsys *ws,
 /**
  * Display/copy the image in the surface into the X window specified
  * by the display target.
+ *
+ * \param boxes  modified regions of the image, or NULL to copy it whole
  */
 static void
 xlib_sw_display(struct xlib_drawable *xlib_drawable,
-                struct sw_displaytarget *dt)
+                struct sw_displaytarget *dt,
+                const struct pipe_box *boxes,
+                unsigned num_boxes)
 {
    static boolean no_swap = 0;
    static boolean firsttime = 1;
    struct xlib_displaytarget *xlib_dt = xlib_displaytarget(dt);
    Display *display = xlib_dt->display;
    XImage *ximage;
+   struct pipe_box whole;
+   unsigned i;
 
    if (firsttime) {
       no_swap = getenv("SP_NO_RAST") != NULL;
@@ -315,8 +322,26 @@ xlib_sw_display(struct xlib_drawable *xlib_drawable,
       }
 
       xlib_dt->drawable = xlib_drawable->drawable;
+      boxes = NULL;
+   }
+
+   /* The rest of the window only matches the image if it was the last one
+    * displayed there, e.g. not after swapping front and back buffers.
+    */
+   if (xlib_drawable->last_dt != dt) {
+      xlib_drawable->last_dt = dt;
+      boxes = NULL;
+   }
+
+   if (!boxes) {
+      u_box_2d(0, 0, xlib_dt->width, xlib_dt->height, &whole);
+      boxes = &whole;
+      num_boxes = 1;
    }
 
+   if (!num_boxes)
+      return;
+
    if (xlib_dt->tempImage == NULL) {
       assert(util_format_get_blockwidth(xlib_dt->format) == 1);
       assert(util_format_get_blockheight(xlib_dt->format) == 1);
@@ -337,8 +362,11 @@ xlib_sw_display(struct xlib_drawable *xlib_drawable,
       ximage->data = xlib_dt->data;
 
       /* _debug_printf("XSHM\n"); */
-      XShmPutImage(xlib_dt->display, xlib_drawable->drawable, xlib_dt->gc,
-                   ximage, 0, 0, 0, 0, xlib_dt->width, xlib_dt->height, False);
+      for (i = 0; i < num_boxes; i++) {
+         XShmPutImage(xlib_dt->display, xlib_drawable->drawable, xlib_dt->gc,
+                      ximage, boxes[i].x, boxes[i].y, boxes[i].x, boxes[i].y,
+                      boxes[i].width, boxes[i].height, False);
+      }
    }
    else {
       /* display image in Window */
@@ -355,8 +383,11 @@ xlib_sw_display(struct xlib_drawable *xlib_drawable,
       ximage->bytes_per_line = xlib_dt->stride;
 
       /* _debug_printf("XPUT\n"); */
-      XPutImage(xlib_dt->display, xlib_drawable->drawable, xlib_dt->gc,
-                ximage, 0, 0, 0, 0, xlib_dt->width, xlib_dt->height);
+      for (i = 0; i < num_boxes; i++) {
+         XPutImage(xlib_dt->display, xlib_drawable->drawable, xlib_dt->gc,
+                   ximage, boxes[i].x, boxes[i].y, boxes[i].x, boxes[i].y,
+                   boxes[i].width, boxes[i].height);
+      }
    }
 
    XFlush(xlib_dt->display);
@@ -370,10 +401,12 @@ xlib_sw_display(struct xlib_drawable *xlib_drawable,
 static void
 xlib_displaytarget_display(struct sw_winsys *ws,
                            struct sw_displaytarget *dt,
-                           void *context_private)
+                           void *context_private,
+                           const struct pipe_box *boxes,
+                           unsigned num_boxes)
 {
    struct xlib_drawable *xlib_drawable = (struct xlib_drawable *)context_private;
-   xlib_sw_display(xlib_drawable, dt);
+   xlib_sw_display(xlib_drawable, dt, boxes, num_boxes);
 }
 
 
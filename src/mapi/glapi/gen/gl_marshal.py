@@ -0,0 +1,374 @@
+#!/usr/bin/python2
+
+# Copyright 2012 The Mesa authors.
+#
+# Permission is hereby granted, free of charge, to any person obtaining a
+# copy of this software and associated documentation files (the "Software"),
+# to deal in the Software without restriction, including without limitation
+# on the rights to use, copy, modify, merge, publish, distribute, sub
+# license, and/or sell copies of the Software, and to permit persons to whom
+# the Software is furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice (including the next
+# paragraph) shall be included in all copies or substantial portions of the
+# Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.  IN NO EVENT SHALL
+# THE AUTHORS AND/OR THEIR SUPPLIERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+# FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+# IN THE SOFTWARE.
+
+# Generates src/mesa/main/marshal_generated.c: the client side
+# (marshal) and server side (unmarshal) halves of every GL entry point
+# for the GL command thread, see src/mesa/main/marshal.h.
+#
+# An entry point is executed asynchronously when all of its parameters
+# can be copied into the command buffer: scalars, arrays with a fixed
+# count and arrays whose length is given by another parameter.  Entry
+# points returning a value, writing through a pointer, taking pixel
+# data or taking pointers of unknown size are executed synchronously:
+# the client waits for the server thread to go idle and calls the real
+# implementation itself.
+
+import gl_XML
+import license
+import sys, getopt, re
+
+
+# Entry points that must always wait for the server thread.
+sync_functions = set([
+	'Finish',
+])
+
+# Entry points reading vertex arrays (and index buffers when the value is
+# True).  They can only be executed asynchronously when no array, nor the
+# indices, live in client memory the application may change after the
+# call returns.
+draw_functions = {
+	'ArrayElement': False,
+	'DrawArrays': False,
+	'DrawArraysInstancedARB': False,
+	'MultiDrawArraysEXT': False,
+	'DrawTransformFeedback': False,
+	'DrawElements': True,
+	'DrawRangeElements': True,
+	'DrawElementsInstancedARB': True,
+	'DrawElementsBaseVertex': True,
+	'DrawRangeElementsBaseVertex': True,
+	'DrawElementsInstancedBaseVertex': True,
+	'MultiDrawElementsEXT': True,
+	'MultiDrawElementsBaseVertex': True,
+}
+
+# Client side state tracking, called before the command is queued.
+hooks = {
+	'BindBufferARB': '_mesa_glthread_BindBuffer(ctx, target, buffer);',
+	'DeleteBuffersARB': '_mesa_glthread_DeleteBuffers(ctx, n, buffer);',
+	'BindVertexArray': '_mesa_glthread_BindVertexArray(ctx);',
+	'BindVertexArrayAPPLE': '_mesa_glthread_BindVertexArray(ctx);',
+	'PopClientAttrib': '_mesa_glthread_PopClientAttrib(ctx);',
+	'InterleavedArrays': '_mesa_glthread_Pointer(ctx);',
+}
+
+# Called after the command is queued.
+post_hooks = {
+	'Flush': '_mesa_glthread_flush_batch(ctx);',
+}
+
+
+def is_array_pointer_function(func):
+	"""gl*Pointer entry points only record the pointer, they don't
+	read through it."""
+	return (re.match(r'.*Pointer(ARB|EXT|NV)?$', func.name) and
+		not func.name.startswith('Get'))
+
+
+def pointer_depth(p):
+	return len([t for t in p.type_expr.expr if t.pointer])
+
+
+def element_size(p):
+	"""C expression for the size of one element pointed to by p."""
+	if pointer_depth(p) == 1 and p.get_base_type_string() in ('GLvoid', 'void'):
+		return '1'
+	return 'sizeof(*%s)' % (p.name)
+
+
+def array_element_size(p):
+	"""C expression for the size of one element of the variable size
+	array p, taking count_scale into account."""
+	if p.count_scale > 1:
+		return '%d * %s' % (p.count_scale, element_size(p))
+	return element_size(p)
+
+
+class marshal_function:
+	def __init__(self, func, api_params):
+		self.func = func
+		self.name = func.name
+		self.params = [p for p in func.parameterIterator() if not p.is_padding]
+		self.called_params = ', '.join([p.name for p in self.params])
+
+		# Parameters copied by value (including pointers which are
+		# only recorded), fixed size arrays and variable size arrays.
+		self.value_params = []
+		self.fixed_params = []
+		self.variable_params = []
+
+		self.is_async = self.classify(api_params)
+
+
+	def classify(self, api_params):
+		func = self.func
+
+		if func.name in sync_functions or func.return_type != 'void':
+			return False
+
+		names = [p.name for p in self.params]
+		for p in self.params:
+			if p.is_output or p.is_image() or p.count_parameter_list:
+				return False
+
+			if not p.is_pointer():
+				self.value_params.append(p)
+			elif is_array_pointer_function(func) and not p.count and not p.counter:
+				self.value_params.append(p)
+			elif func.name in draw_functions and p.name == 'indices' and not p.counter:
+				self.value_params.append(p)
+			elif p.type_string().find('const') < 0:
+				# Non-const pointers are written to.
+				return False
+			elif pointer_depth(p) > 1 and func.name not in draw_functions:
+				# Arrays of pointers to client memory (strings...)
+				return False
+			elif p.count:
+				if pointer_depth(p) > 1 or element_size(p) == '1':
+					return False
+				self.fixed_params.append(p)
+			elif p.counter and p.counter in names:
+				counter = self.params[names.index(p.counter)]
+				if counter.is_pointer():
+					return False
+				self.variable_params.append(p)
+			else:
+				return False
+
+		return True
+
+
+	def print_struct(self):
+		print 'struct marshal_cmd_%s' % (self.name)
+		print '{'
+		print '   struct marshal_cmd_base cmd_base;'
+		for p in self.value_params:
+			print '   %s %s;' % (p.type_string(), p.name)
+		for p in self.fixed_params:
+			print '   %s %s[%d];' % (p.get_base_type_string(), p.name, p.count * p.count_scale)
+		for p in self.variable_params:
+			print '   GLboolean %s_null; /* If set, no data follows for "%s" */' % (p.name, p.name)
+		for p in self.variable_params:
+			print '   /* Next MARSHAL_ALIGN(%s * %s) bytes are %s %s */' % (p.counter, array_element_size(p), p.type_string(), p.name)
+		print '};'
+
+
+	def print_unmarshal(self):
+		print 'static inline void'
+		print '_mesa_unmarshal_%s(struct gl_context *ctx, const struct marshal_cmd_%s *cmd)' % (self.name, self.name)
+		print '{'
+		for p in self.params:
+			print '   %s %s;' % (p.type_string(), p.name)
+		if self.variable_params:
+			print '   const char *variable_data = (const char *) cmd + MARSHAL_ALIGN(sizeof(*cmd));'
+		for p in self.params:
+			if p in self.value_params:
+				print '   %s = cmd->%s;' % (p.name, p.name)
+			elif p in self.fixed_params:
+				print '   %s = cmd->%s;' % (p.name, p.name)
+		for p in self.variable_params:
+			print '   if (cmd->%s_null) {' % (p.name)
+			print '      %s = NULL;' % (p.name)
+			print '   }'
+			print '   else {'
+			print '      %s = (%s) variable_data;' % (p.name, p.type_string())
+			print '      variable_data += MARSHAL_ALIGN(_mesa_glthread_array_size(%s, %s));' % (p.counter, array_element_size(p))
+			print '   }'
+		print '   CALL_%s(ctx->CurrentDispatch, (%s));' % (self.name, self.called_params)
+		print '}'
+
+
+	def print_sync_call(self, indent):
+		print '%s_mesa_glthread_begin_sync(ctx);' % (indent)
+		if self.func.return_type != 'void':
+			print '%sret = CALL_%s(ctx->CurrentDispatch, (%s));' % (indent, self.name, self.called_params)
+		else:
+			print '%sCALL_%s(ctx->CurrentDispatch, (%s));' % (indent, self.name, self.called_params)
+		print '%s_mesa_glthread_end_sync(ctx);' % (indent)
+
+
+	def print_marshal(self):
+		print 'static %s GLAPIENTRY' % (self.func.return_type)
+		print '_mesa_marshal_%s(%s)' % (self.name, self.func.get_parameter_string())
+		print '{'
+		print '   GET_CURRENT_CONTEXT(ctx);'
+		if self.func.return_type != 'void':
+			print '   %s ret;' % (self.func.return_type)
+
+		if self.is_async:
+			for p in self.variable_params:
+				print '   size_t %s_size = %s ? _mesa_glthread_array_size(%s, %s) : 0;' % (p.name, p.name, p.counter, array_element_size(p))
+			size = 'MARSHAL_ALIGN(sizeof(struct marshal_cmd_%s))' % (self.name)
+			for p in self.variable_params:
+				size += '\n      + MARSHAL_ALIGN(%s_size)' % (p.name)
+			print '   size_t cmd_size = %s;' % (size)
+
+		if self.name in hooks:
+			print '   %s' % (hooks[self.name])
+		if is_array_pointer_function(self.func) and self.name not in hooks:
+			print '   _mesa_glthread_Pointer(ctx);'
+
+		if self.is_async:
+			cond = 'cmd_size <= MARSHAL_MAX_CMD_SIZE'
+			if self.name in draw_functions:
+				cond += ' &&\n       _mesa_glthread_draw_is_async(ctx, %s)' % (['GL_FALSE', 'GL_TRUE'][draw_functions[self.name]])
+			print '   if (%s) {' % (cond)
+			if self.params:
+				print '      struct marshal_cmd_%s *cmd =' % (self.name)
+				print '         _mesa_glthread_allocate_command(ctx, DISPATCH_CMD_%s, cmd_size);' % (self.name)
+			else:
+				print '      _mesa_glthread_allocate_command(ctx, DISPATCH_CMD_%s, cmd_size);' % (self.name)
+			if self.variable_params:
+				print '      char *variable_data = (char *) cmd + MARSHAL_ALIGN(sizeof(*cmd));'
+			for p in self.value_params:
+				print '      cmd->%s = %s;' % (p.name, p.name)
+			for p in self.fixed_params:
+				print '      memcpy(cmd->%s, %s, sizeof(cmd->%s));' % (p.name, p.name, p.name)
+			for p in self.variable_params:
+				print '      cmd->%s_null = !%s;' % (p.name, p.name)
+				print '      if (%s_size) {' % (p.name)
+				print '         memcpy(variable_data, %s, %s_size);' % (p.name, p.name)
+				print '         variable_data += MARSHAL_ALIGN(%s_size);' % (p.name)
+				print '      }'
+			if self.name in post_hooks:
+				print '      %s' % (post_hooks[self.name])
+			print '   }'
+			print '   else {'
+			self.print_sync_call('      ')
+			print '   }'
+		else:
+			self.print_sync_call('   ')
+
+		if self.func.return_type != 'void':
+			print '   return ret;'
+		print '}'
+
+
+class PrintCode(gl_XML.gl_print_base):
+	def __init__(self):
+		gl_XML.gl_print_base.__init__(self)
+
+		self.name = 'gl_marshal.py (from Mesa)'
+		self.license = license.bsd_license_template % (
+			'Copyright 2012 The Mesa authors.', 'THE AUTHORS')
+		return
+
+
+	def printRealHeader(self):
+		print ''
+		print '#include "main/api_exec.h"'
+		print '#include "main/context.h"'
+		print '#include "main/dispatch.h"'
+		print '#include "main/marshal.h"'
+		print ''
+		print '#ifdef PTHREADS'
+		print ''
+		return
+
+
+	def printRealFooter(self):
+		print ''
+		print '#endif /* PTHREADS */'
+		return
+
+
+	def printBody(self, api):
+		funcs = [marshal_function(f, api) for f in api.functionIterateByOffset()]
+		async_funcs = [f for f in funcs if f.is_async]
+
+		print 'enum marshal_dispatch_cmd_id'
+		print '{'
+		for f in async_funcs:
+			print '   DISPATCH_CMD_%s,' % (f.name)
+		print '   NUM_DISPATCH_CMD'
+		print '};'
+		print ''
+
+		for f in funcs:
+			print ''
+			if f.is_async:
+				print '/* %s: marshalled asynchronously */' % (f.name)
+				f.print_struct()
+				f.print_unmarshal()
+			else:
+				print '/* %s: marshalled synchronously */' % (f.name)
+			f.print_marshal()
+			print ''
+
+		print ''
+		print 'size_t'
+		print '_mesa_unmarshal_dispatch_cmd(struct gl_context *ctx, const void *cmd)'
+		print '{'
+		print '   const struct marshal_cmd_base *cmd_base = cmd;'
+		print '   switch (cmd_base->cmd_id) {'
+		for f in async_funcs:
+			print '   case DISPATCH_CMD_%s:' % (f.name)
+			print '      _mesa_unmarshal_%s(ctx, (const struct marshal_cmd_%s *) cmd);' % (f.name, f.name)
+			print '      break;'
+		print '   default:'
+		print '      assert(!"Unrecognized command ID");'
+		print '      break;'
+		print '   }'
+		print ''
+		print '   return cmd_base->cmd_size;'
+		print '}'
+		print ''
+		print ''
+		print 'struct _glapi_table *'
+		print '_mesa_create_marshal_table(void)'
+		print '{'
+		print '   struct _glapi_table *table;'
+		print ''
+		print '   table = _mesa_alloc_dispatch_table(_gloffset_COUNT);'
+		print '   if (table == NULL)'
+		print '      return NULL;'
+		print ''
+		for f in funcs:
+			print '   SET_%s(table, _mesa_marshal_%s);' % (f.name, f.name)
+		print ''
+		print '   return table;'
+		print '}'
+		return
+
+
+def show_usage():
+	print "Usage: %s [-f input_file_name]" % sys.argv[0]
+	sys.exit(1)
+
+if __name__ == '__main__':
+	file_name = "gl_API.xml"
+
+	try:
+		(args, trail) = getopt.getopt(sys.argv[1:], "f:")
+	except Exception,e:
+		show_usage()
+
+	for (arg,val) in args:
+		if arg == "-f":
+			file_name = val
+
+	printer = PrintCode()
+
+	api = gl_XML.parse_GL_API( file_name )
+	printer.Print( api )
@@ -13,6 +13,12 @@ extern "C" {
 #define _glthread_LOCK_MUTEX(name)           u_mutex_lock(name)
 #define _glthread_UNLOCK_MUTEX(name)         u_mutex_unlock(name)
 
+#define _glthread_INIT_RWLOCK(name)          u_rwlock_init(name)
+#define _glthread_DESTROY_RWLOCK(name)       u_rwlock_destroy(name)
+#define _glthread_READ_LOCK(name)            u_rwlock_rdlock(name)
+#define _glthread_WRITE_LOCK(name)           u_rwlock_wrlock(name)
+#define _glthread_UNLOCK_RWLOCK(name)        u_rwlock_unlock(name)
+
 #define _glthread_InitTSD(tsd)               u_tsd_init(tsd);
 #define _glthread_DestroyTSD(tsd)            u_tsd_destroy(tsd);
 #define _glthread_GetTSD(tsd)                u_tsd_get(tsd);
@@ -20,6 +26,7 @@ extern "C" {
 
 typedef struct u_tsd _glthread_TSD;
 typedef u_mutex _glthread_Mutex;
+typedef u_rwlock _glthread_RWLock;
 
 #ifdef __cplusplus
 }
@@ -89,6 +89,14 @@ typedef pthread_mutex_t u_mutex;
 #define u_mutex_lock(name)    (void) pthread_mutex_lock(&(name))
 #define u_mutex_unlock(name)  (void) pthread_mutex_unlock(&(name))
 
+typedef pthread_rwlock_t u_rwlock;
+
+#define u_rwlock_init(name)    pthread_rwlock_init(&(name), NULL)
+#define u_rwlock_destroy(name) pthread_rwlock_destroy(&(name))
+#define u_rwlock_rdlock(name)  (void) pthread_rwlock_rdlock(&(name))
+#define u_rwlock_wrlock(name)  (void) pthread_rwlock_wrlock(&(name))
+#define u_rwlock_unlock(name)  (void) pthread_rwlock_unlock(&(name))
+
 #endif /* PTHREADS */
 
 
@@ -115,6 +123,15 @@ typedef CRITICAL_SECTION u_mutex;
 #define u_mutex_lock(name)    EnterCriticalSection(&name)
 #define u_mutex_unlock(name)  LeaveCriticalSection(&name)
 
+/* Slim reader/writer locks need Vista, readers are serialized instead */
+typedef CRITICAL_SECTION u_rwlock;
+
+#define u_rwlock_init(name)    InitializeCriticalSection(&name)
+#define u_rwlock_destroy(name) DeleteCriticalSection(&name)
+#define u_rwlock_rdlock(name)  EnterCriticalSection(&name)
+#define u_rwlock_wrlock(name)  EnterCriticalSection(&name)
+#define u_rwlock_unlock(name)  LeaveCriticalSection(&name)
+
 #endif /* WIN32 */
 
 
@@ -135,6 +152,14 @@ typedef unsigned u_mutex;
 #define u_mutex_lock(name)             (void) name
 #define u_mutex_unlock(name)           (void) name
 
+typedef unsigned u_rwlock;
+
+#define u_rwlock_init(name)            (void) name
+#define u_rwlock_destroy(name)         (void) name
+#define u_rwlock_rdlock(name)          (void) name
+#define u_rwlock_wrlock(name)          (void) name
+#define u_rwlock_unlock(name)          (void) name
+
 #endif /* THREADS */
 
 
@@ -102,6 +102,7 @@
 #include "hash.h"
 #include "light.h"
 #include "lines.h"
+#include "marshal.h"
 #include "macros.h"
 #include "matrix.h"
 #include "multisample.h"
@@ -169,6 +170,7 @@ _mesa_notifySwapBuffers(struct gl_context *ctx)
 {
    if (MESA_VERBOSE & VERBOSE_SWAPBUFFERS)
       _mesa_debug(ctx, "SwapBuffers\n");
+   _mesa_glthread_finish(ctx);
    FLUSH_CURRENT( ctx, 0 );
    if (ctx->Driver.Flush) {
       ctx->Driver.Flush(ctx);
@@ -1097,6 +1099,8 @@ _mesa_free_context_data( struct gl_context *ctx )
       _mesa_make_current(ctx, NULL, NULL);
    }
 
+   _mesa_glthread_destroy(ctx);
+
    /* unreference WinSysDraw/Read buffers */
    _mesa_reference_framebuffer(&ctx->WinSysDrawBuffer, NULL);
    _mesa_reference_framebuffer(&ctx->WinSysReadBuffer, NULL);
@@ -1429,6 +1433,12 @@ _mesa_make_current( struct gl_context *newCtx,
       }
    }
 
+   /* Pending commands must be executed before we touch the contexts */
+   if (curCtx)
+      _mesa_glthread_finish(curCtx);
+   if (newCtx && newCtx != curCtx)
+      _mesa_glthread_finish(newCtx);
+
    if (curCtx && 
       (curCtx->WinSysDrawBuffer || curCtx->WinSysReadBuffer) &&
        /* make sure this context is valid for flushing */
@@ -1526,6 +1536,8 @@ _mesa_make_current( struct gl_context *newCtx,
 
 	 newCtx->FirstTimeCurrent = GL_FALSE;
       }
+
+      _mesa_glthread_make_current(newCtx);
    }
    
    return GL_TRUE;
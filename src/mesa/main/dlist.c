@@ -989,6 +989,7 @@ dlist_alloc(struct gl_context *ctx, OpCode opcode, GLuint bytes)
 
    n = ctx->ListState.CurrentBlock + ctx->ListState.CurrentPos;
    ctx->ListState.CurrentPos += numNodes;
+   ctx->ListState.LastInstruction = n;
 
    n[0].opcode = opcode;
 
@@ -1017,6 +1018,23 @@ _mesa_dlist_alloc(struct gl_context *ctx, GLuint opcode, GLuint bytes)
 }
 
 
+/**
+ * Return the payload of the last instruction of the display list being
+ * compiled if it has the given opcode, NULL otherwise.  Modules use this
+ * to extend their previous instruction instead of adding a new one.
+ */
+void *
+_mesa_dlist_last_alloc(struct gl_context *ctx, GLuint opcode)
+{
+   Node *n = ctx->ListState.LastInstruction;
+
+   if (n && n[0].opcode == (OpCode) opcode)
+      return n + 1;
+   else
+      return NULL;
+}
+
+
 /**
  * This function allows modules and drivers to get their own opcodes
  * for extending display list functionality.
@@ -2191,15 +2209,63 @@ save_DepthRange(GLclampd nearval, GLclampd farval)
 }
 
 
+/**
+ * Return true if the display list being compiled is known to have set the
+ * enable to this state already, otherwise remember the new state.
+ */
+static GLboolean
+enable_is_redundant(struct gl_context *ctx, GLenum cap, GLboolean state)
+{
+   const GLuint n = Elements(ctx->ListState.Current.Enable);
+   GLuint i;
+
+   for (i = 0; i < n; i++) {
+      if (ctx->ListState.Current.Enable[i].Cap == cap) {
+         if (ctx->ListState.Current.Enable[i].State == state)
+            return GL_TRUE;
+         break;
+      }
+   }
+
+   /* Only save the value if we know the statechange will take effect:
+    */
+   if (ctx->Driver.CurrentSavePrimitive == PRIM_OUTSIDE_BEGIN_END) {
+      if (i == n)
+         i = ctx->ListState.Current.EnableNext++ % n;
+      ctx->ListState.Current.Enable[i].Cap = cap;
+      ctx->ListState.Current.Enable[i].State = state;
+   }
+   else if (i < n) {
+      ctx->ListState.Current.Enable[i].Cap = 0;
+   }
+
+   return GL_FALSE;
+}
+
+
+/**
+ * Forget the enables remembered by enable_is_redundant(), for commands
+ * which change them indirectly or change their meaning.
+ */
+static void
+invalidate_saved_enables(struct gl_context *ctx)
+{
+   memset(ctx->ListState.Current.Enable, 0,
+          sizeof(ctx->ListState.Current.Enable));
+}
+
+
 static void GLAPIENTRY
 save_Disable(GLenum cap)
 {
    GET_CURRENT_CONTEXT(ctx);
    Node *n;
    ASSERT_OUTSIDE_SAVE_BEGIN_END_AND_FLUSH(ctx);
-   n = alloc_instruction(ctx, OPCODE_DISABLE, 1);
-   if (n) {
-      n[1].e = cap;
+   if (!enable_is_redundant(ctx, cap, GL_FALSE)) {
+      n = alloc_instruction(ctx, OPCODE_DISABLE, 1);
+      if (n) {
+         n[1].e = cap;
+      }
    }
    if (ctx->ExecuteFlag) {
       CALL_Disable(ctx->Exec, (cap));
@@ -2213,6 +2279,7 @@ save_DisableIndexed(GLuint index, GLenum cap)
    GET_CURRENT_CONTEXT(ctx);
    Node *n;
    ASSERT_OUTSIDE_SAVE_BEGIN_END_AND_FLUSH(ctx);
+   invalidate_saved_enables(ctx);
    n = alloc_instruction(ctx, OPCODE_DISABLE_INDEXED, 2);
    if (n) {
       n[1].ui = index;
@@ -2271,9 +2338,11 @@ save_Enable(GLenum cap)
    GET_CURRENT_CONTEXT(ctx);
    Node *n;
    ASSERT_OUTSIDE_SAVE_BEGIN_END_AND_FLUSH(ctx);
-   n = alloc_instruction(ctx, OPCODE_ENABLE, 1);
-   if (n) {
-      n[1].e = cap;
+   if (!enable_is_redundant(ctx, cap, GL_TRUE)) {
+      n = alloc_instruction(ctx, OPCODE_ENABLE, 1);
+      if (n) {
+         n[1].e = cap;
+      }
    }
    if (ctx->ExecuteFlag) {
       CALL_Enable(ctx->Exec, (cap));
@@ -2288,6 +2357,7 @@ save_EnableIndexed(GLuint index, GLenum cap)
    GET_CURRENT_CONTEXT(ctx);
    Node *n;
    ASSERT_OUTSIDE_SAVE_BEGIN_END_AND_FLUSH(ctx);
+   invalidate_saved_enables(ctx);
    n = alloc_instruction(ctx, OPCODE_ENABLE_INDEXED, 2);
    if (n) {
       n[1].ui = index;
@@ -3314,6 +3384,13 @@ save_PopAttrib(void)
    GET_CURRENT_CONTEXT(ctx);
    ASSERT_OUTSIDE_SAVE_BEGIN_END_AND_FLUSH(ctx);
    (void) alloc_instruction(ctx, OPCODE_POP_ATTRIB, 0);
+
+   /* The current values and enables may have been restored to anything */
+   memset(ctx->ListState.ActiveAttribSize, 0,
+          sizeof ctx->ListState.ActiveAttribSize);
+   memset(ctx->ListState.ActiveMaterialSize, 0,
+          sizeof ctx->ListState.ActiveMaterialSize);
+   memset(&ctx->ListState.Current, 0, sizeof ctx->ListState.Current);
    if (ctx->ExecuteFlag) {
       CALL_PopAttrib(ctx->Exec, ());
    }
@@ -4476,6 +4553,8 @@ save_ActiveTextureARB(GLenum target)
    GET_CURRENT_CONTEXT(ctx);
    Node *n;
    ASSERT_OUTSIDE_SAVE_BEGIN_END_AND_FLUSH(ctx);
+   /* texture enables are per unit */
+   invalidate_saved_enables(ctx);
    n = alloc_instruction(ctx, OPCODE_ACTIVE_TEXTURE, 1);
    if (n) {
       n[1].e = target;
@@ -5363,21 +5442,43 @@ save_SetFragmentShaderConstantATI(GLuint dst, const GLfloat *value)
 }
 #endif
 
+/**
+ * Return true if a non-position attribute is known to be already set to
+ * this value by the display list being compiled, so the instruction can
+ * be dropped.  This lets consecutive vertex lists be merged.
+ */
+static GLboolean
+attr_is_redundant(struct gl_context *ctx, GLuint attr, GLuint size,
+                  GLfloat x, GLfloat y, GLfloat z, GLfloat w)
+{
+   GLfloat v[4];
+
+   if (attr == VERT_ATTRIB_POS ||
+       ctx->ListState.ActiveAttribSize[attr] != size)
+      return GL_FALSE;
+
+   ASSIGN_4V(v, x, y, z, w);
+   return memcmp(ctx->ListState.CurrentAttrib[attr], v, sizeof(v)) == 0;
+}
+
+
 static void GLAPIENTRY
 save_Attr1fNV(GLenum attr, GLfloat x)
 {
    GET_CURRENT_CONTEXT(ctx);
    Node *n;
    SAVE_FLUSH_VERTICES(ctx);
-   n = alloc_instruction(ctx, OPCODE_ATTR_1F_NV, 2);
-   if (n) {
-      n[1].e = attr;
-      n[2].f = x;
-   }
+   if (!attr_is_redundant(ctx, attr, 1, x, 0, 0, 1)) {
+      n = alloc_instruction(ctx, OPCODE_ATTR_1F_NV, 2);
+      if (n) {
+         n[1].e = attr;
+         n[2].f = x;
+      }
 
-   ASSERT(attr < MAX_VERTEX_GENERIC_ATTRIBS);
-   ctx->ListState.ActiveAttribSize[attr] = 1;
-   ASSIGN_4V(ctx->ListState.CurrentAttrib[attr], x, 0, 0, 1);
+      ASSERT(attr < MAX_VERTEX_GENERIC_ATTRIBS);
+      ctx->ListState.ActiveAttribSize[attr] = 1;
+      ASSIGN_4V(ctx->ListState.CurrentAttrib[attr], x, 0, 0, 1);
+   }
 
    if (ctx->ExecuteFlag) {
       CALL_VertexAttrib1fNV(ctx->Exec, (attr, x));
@@ -5390,16 +5491,18 @@ save_Attr2fNV(GLenum attr, GLfloat x, GLfloat y)
    GET_CURRENT_CONTEXT(ctx);
    Node *n;
    SAVE_FLUSH_VERTICES(ctx);
-   n = alloc_instruction(ctx, OPCODE_ATTR_2F_NV, 3);
-   if (n) {
-      n[1].e = attr;
-      n[2].f = x;
-      n[3].f = y;
-   }
+   if (!attr_is_redundant(ctx, attr, 2, x, y, 0, 1)) {
+      n = alloc_instruction(ctx, OPCODE_ATTR_2F_NV, 3);
+      if (n) {
+         n[1].e = attr;
+         n[2].f = x;
+         n[3].f = y;
+      }
 
-   ASSERT(attr < MAX_VERTEX_GENERIC_ATTRIBS);
-   ctx->ListState.ActiveAttribSize[attr] = 2;
-   ASSIGN_4V(ctx->ListState.CurrentAttrib[attr], x, y, 0, 1);
+      ASSERT(attr < MAX_VERTEX_GENERIC_ATTRIBS);
+      ctx->ListState.ActiveAttribSize[attr] = 2;
+      ASSIGN_4V(ctx->ListState.CurrentAttrib[attr], x, y, 0, 1);
+   }
 
    if (ctx->ExecuteFlag) {
       CALL_VertexAttrib2fNV(ctx->Exec, (attr, x, y));
@@ -5412,17 +5515,19 @@ save_Attr3fNV(GLenum attr, GLfloat x, GLfloat y, GLfloat z)
    GET_CURRENT_CONTEXT(ctx);
    Node *n;
    SAVE_FLUSH_VERTICES(ctx);
-   n = alloc_instruction(ctx, OPCODE_ATTR_3F_NV, 4);
-   if (n) {
-      n[1].e = attr;
-      n[2].f = x;
-      n[3].f = y;
-      n[4].f = z;
-   }
+   if (!attr_is_redundant(ctx, attr, 3, x, y, z, 1)) {
+      n = alloc_instruction(ctx, OPCODE_ATTR_3F_NV, 4);
+      if (n) {
+         n[1].e = attr;
+         n[2].f = x;
+         n[3].f = y;
+         n[4].f = z;
+      }
 
-   ASSERT(attr < MAX_VERTEX_GENERIC_ATTRIBS);
-   ctx->ListState.ActiveAttribSize[attr] = 3;
-   ASSIGN_4V(ctx->ListState.CurrentAttrib[attr], x, y, z, 1);
+      ASSERT(attr < MAX_VERTEX_GENERIC_ATTRIBS);
+      ctx->ListState.ActiveAttribSize[attr] = 3;
+      ASSIGN_4V(ctx->ListState.CurrentAttrib[attr], x, y, z, 1);
+   }
 
    if (ctx->ExecuteFlag) {
       CALL_VertexAttrib3fNV(ctx->Exec, (attr, x, y, z));
@@ -5435,18 +5540,20 @@ save_Attr4fNV(GLenum attr, GLfloat x, GLfloat y, GLfloat z, GLfloat w)
    GET_CURRENT_CONTEXT(ctx);
    Node *n;
    SAVE_FLUSH_VERTICES(ctx);
-   n = alloc_instruction(ctx, OPCODE_ATTR_4F_NV, 5);
-   if (n) {
-      n[1].e = attr;
-      n[2].f = x;
-      n[3].f = y;
-      n[4].f = z;
-      n[5].f = w;
-   }
+   if (!attr_is_redundant(ctx, attr, 4, x, y, z, w)) {
+      n = alloc_instruction(ctx, OPCODE_ATTR_4F_NV, 5);
+      if (n) {
+         n[1].e = attr;
+         n[2].f = x;
+         n[3].f = y;
+         n[4].f = z;
+         n[5].f = w;
+      }
 
-   ASSERT(attr < MAX_VERTEX_GENERIC_ATTRIBS);
-   ctx->ListState.ActiveAttribSize[attr] = 4;
-   ASSIGN_4V(ctx->ListState.CurrentAttrib[attr], x, y, z, w);
+      ASSERT(attr < MAX_VERTEX_GENERIC_ATTRIBS);
+      ctx->ListState.ActiveAttribSize[attr] = 4;
+      ASSIGN_4V(ctx->ListState.CurrentAttrib[attr], x, y, z, w);
+   }
 
    if (ctx->ExecuteFlag) {
       CALL_VertexAttrib4fNV(ctx->Exec, (attr, x, y, z, w));
@@ -8800,6 +8907,7 @@ _mesa_NewList(GLuint name, GLenum mode)
    ctx->ListState.CurrentList = make_list(name, BLOCK_SIZE);
    ctx->ListState.CurrentBlock = ctx->ListState.CurrentList->Head;
    ctx->ListState.CurrentPos = 0;
+   ctx->ListState.LastInstruction = NULL;
 
    ctx->Driver.NewList(ctx, name, mode);
 
@@ -4,6 +4,9 @@
  *
  * Used for display lists, texture objects, vertex/fragment programs,
  * buffer objects, etc.  The hash functions are thread-safe.
+ *
+ * Keys below DENSE_MAX_SIZE index an array directly, larger ones go in
+ * an open addressing table which is resized as needed.
  * 
  * \note key=0 is illegal.
  *
@@ -41,28 +44,54 @@
 #include "hash.h"
 
 
-#define TABLE_SIZE 1023  /**< Size of lookup table/array */
+/**
+ * Keys below this are stored in a directly indexed array.  Names returned
+ * by glGen* are allocated upwards from 1 so most objects end up there.
+ */
+#define DENSE_MAX_SIZE (1 << 16)
+
+/** Initial size of the direct indexed array */
+#define DENSE_MIN_SIZE 64
+
+/** Initial size of the open addressing table used for larger keys */
+#define SPARSE_MIN_SIZE 64
+
+/**
+ * Keys of free and deleted slots in the open addressing table.  Keys below
+ * DENSE_MAX_SIZE never go there so these can't be valid keys.
+ */
+#define EMPTY_KEY   0
+#define DELETED_KEY 1
 
-#define HASH_FUNC(K)  ((K) % TABLE_SIZE)
+/** Fibonacci hashing: the top bits of the product select the slot */
+#define HASH_FUNC(T, K)  (((K) * 2654435761u) >> (T)->SparseShift)
 
 
 /**
- * An entry in the hash table.  
+ * An entry in the open addressing table.
  */
 struct HashEntry {
-   GLuint Key;             /**< the entry's key */
+   GLuint Key;             /**< the entry's key, or EMPTY/DELETED_KEY */
    void *Data;             /**< the entry's data */
-   struct HashEntry *Next; /**< pointer to next entry */
 };
 
 
 /**
- * The hash table data structure.  
+ * The hash table data structure.
+ *
+ * Lookups, by far the most common operation, only take the lock for
+ * reading so contexts sharing objects don't serialize on them.
  */
 struct _mesa_HashTable {
-   struct HashEntry *Table[TABLE_SIZE];  /**< the lookup table */
+   void **Dense;                /**< data of keys below DenseSize */
+   GLuint DenseSize;            /**< power of two, at most DENSE_MAX_SIZE */
+   struct HashEntry *Sparse;    /**< linear probing table for larger keys */
+   GLuint SparseSize;           /**< power of two, or zero */
+   GLuint SparseShift;          /**< 32 - log2(SparseSize) */
+   GLuint SparseUsed;           /**< number of live entries in Sparse */
+   GLuint SparseDeleted;        /**< number of DELETED_KEY slots in Sparse */
    GLuint MaxKey;                        /**< highest key inserted so far */
-   _glthread_Mutex Mutex;                /**< mutual exclusion lock */
+   _glthread_RWLock Lock;                /**< readers/writer lock */
    _glthread_Mutex WalkMutex;            /**< for _mesa_HashWalk() */
    GLboolean InDeleteAll;                /**< Debug check */
 };
@@ -79,7 +108,7 @@ _mesa_NewHashTable(void)
 {
    struct _mesa_HashTable *table = CALLOC_STRUCT(_mesa_HashTable);
    if (table) {
-      _glthread_INIT_MUTEX(table->Mutex);
+      _glthread_INIT_RWLOCK(table->Lock);
       _glthread_INIT_MUTEX(table->WalkMutex);
    }
    return table;
@@ -100,25 +129,135 @@ _mesa_DeleteHashTable(struct _mesa_HashTable *table)
 {
    GLuint pos;
    assert(table);
-   for (pos = 0; pos < TABLE_SIZE; pos++) {
-      struct HashEntry *entry = table->Table[pos];
-      while (entry) {
-	 struct HashEntry *next = entry->Next;
-         if (entry->Data) {
-            _mesa_problem(NULL,
-                          "In _mesa_DeleteHashTable, found non-freed data");
-         }
-	 free(entry);
-	 entry = next;
+   for (pos = 0; pos < table->DenseSize; pos++) {
+      if (table->Dense[pos]) {
+         _mesa_problem(NULL,
+                       "In _mesa_DeleteHashTable, found non-freed data");
+         break;
+      }
+   }
+   for (pos = 0; pos < table->SparseSize; pos++) {
+      if (table->Sparse[pos].Key > DELETED_KEY && table->Sparse[pos].Data) {
+         _mesa_problem(NULL,
+                       "In _mesa_DeleteHashTable, found non-freed data");
+         break;
       }
    }
-   _glthread_DESTROY_MUTEX(table->Mutex);
+   free(table->Dense);
+   free(table->Sparse);
+   _glthread_DESTROY_RWLOCK(table->Lock);
    _glthread_DESTROY_MUTEX(table->WalkMutex);
    free(table);
 }
 
 
 
+/**
+ * Find the open addressing table slot holding the given key.
+ * \return the entry or NULL if key not in the table
+ */
+static inline struct HashEntry *
+sparse_find(const struct _mesa_HashTable *table, GLuint key)
+{
+   GLuint mask, pos;
+
+   if (!table->SparseSize)
+      return NULL;
+
+   mask = table->SparseSize - 1;
+   pos = HASH_FUNC(table, key);
+   while (table->Sparse[pos].Key != EMPTY_KEY) {
+      if (table->Sparse[pos].Key == key)
+         return &table->Sparse[pos];
+      pos = (pos + 1) & mask;
+   }
+   return NULL;
+}
+
+
+/**
+ * Store a key known not to be in the open addressing table, which must
+ * have room for it.
+ */
+static void
+sparse_insert_new(struct _mesa_HashTable *table, GLuint key, void *data)
+{
+   const GLuint mask = table->SparseSize - 1;
+   GLuint pos = HASH_FUNC(table, key);
+
+   while (table->Sparse[pos].Key > DELETED_KEY)
+      pos = (pos + 1) & mask;
+
+   if (table->Sparse[pos].Key == DELETED_KEY)
+      table->SparseDeleted--;
+
+   table->Sparse[pos].Key = key;
+   table->Sparse[pos].Data = data;
+   table->SparseUsed++;
+}
+
+
+/**
+ * Rehash the open addressing table into a table of the given size,
+ * dropping the deleted slots.
+ */
+static GLboolean
+sparse_resize(struct _mesa_HashTable *table, GLuint size)
+{
+   struct HashEntry *old = table->Sparse;
+   const GLuint oldSize = table->SparseSize;
+   GLuint pos, shift;
+
+   table->Sparse = calloc(size, sizeof(struct HashEntry));
+   if (!table->Sparse) {
+      table->Sparse = old;
+      return GL_FALSE;
+   }
+
+   for (shift = 32; size > 1; size >>= 1)
+      shift--;
+
+   table->SparseSize = 1 << (32 - shift);
+   table->SparseShift = shift;
+   table->SparseUsed = 0;
+   table->SparseDeleted = 0;
+
+   for (pos = 0; pos < oldSize; pos++) {
+      if (old[pos].Key > DELETED_KEY)
+         sparse_insert_new(table, old[pos].Key, old[pos].Data);
+   }
+
+   free(old);
+   return GL_TRUE;
+}
+
+
+/**
+ * Grow the direct indexed array to hold the given key.
+ */
+static GLboolean
+dense_grow(struct _mesa_HashTable *table, GLuint key)
+{
+   GLuint size = table->DenseSize ? table->DenseSize : DENSE_MIN_SIZE;
+   void **dense;
+
+   assert(key < DENSE_MAX_SIZE);
+
+   while (size <= key)
+      size *= 2;
+
+   dense = realloc(table->Dense, size * sizeof(void *));
+   if (!dense)
+      return GL_FALSE;
+
+   memset(dense + table->DenseSize, 0,
+          (size - table->DenseSize) * sizeof(void *));
+   table->Dense = dense;
+   table->DenseSize = size;
+   return GL_TRUE;
+}
+
+
 /**
  * Lookup an entry in the hash table, without locking.
  * \sa _mesa_HashLookup
@@ -126,21 +265,16 @@ _mesa_DeleteHashTable(struct _mesa_HashTable *table)
 static inline void *
 _mesa_HashLookup_unlocked(struct _mesa_HashTable *table, GLuint key)
 {
-   GLuint pos;
    const struct HashEntry *entry;
 
    assert(table);
    assert(key);
 
-   pos = HASH_FUNC(key);
-   entry = table->Table[pos];
-   while (entry) {
-      if (entry->Key == key) {
-         return entry->Data;
-      }
-      entry = entry->Next;
-   }
-   return NULL;
+   if (key < DENSE_MAX_SIZE)
+      return key < table->DenseSize ? table->Dense[key] : NULL;
+
+   entry = sparse_find(table, key);
+   return entry ? entry->Data : NULL;
 }
 
 
@@ -157,9 +291,9 @@ _mesa_HashLookup(struct _mesa_HashTable *table, GLuint key)
 {
    void *res;
    assert(table);
-   _glthread_LOCK_MUTEX(table->Mutex);
+   _glthread_READ_LOCK(table->Lock);
    res = _mesa_HashLookup_unlocked(table, key);
-   _glthread_UNLOCK_MUTEX(table->Mutex);
+   _glthread_UNLOCK_RWLOCK(table->Lock);
    return res;
 }
 
@@ -175,45 +309,45 @@ _mesa_HashLookup(struct _mesa_HashTable *table, GLuint key)
 void
 _mesa_HashInsert(struct _mesa_HashTable *table, GLuint key, void *data)
 {
-   /* search for existing entry with this key */
-   GLuint pos;
    struct HashEntry *entry;
 
    assert(table);
    assert(key);
 
-   _glthread_LOCK_MUTEX(table->Mutex);
+   _glthread_WRITE_LOCK(table->Lock);
 
    if (key > table->MaxKey)
       table->MaxKey = key;
 
-   pos = HASH_FUNC(key);
-
-   /* check if replacing an existing entry with same key */
-   for (entry = table->Table[pos]; entry; entry = entry->Next) {
-      if (entry->Key == key) {
-         /* replace entry's data */
-#if 0 /* not sure this check is always valid */
-         if (entry->Data) {
-            _mesa_problem(NULL, "Memory leak detected in _mesa_HashInsert");
-         }
-#endif
-	 entry->Data = data;
-         _glthread_UNLOCK_MUTEX(table->Mutex);
-	 return;
-      }
+   if (key < DENSE_MAX_SIZE) {
+      if (key < table->DenseSize || dense_grow(table, key))
+         table->Dense[key] = data;
+      _glthread_UNLOCK_RWLOCK(table->Lock);
+      return;
    }
 
-   /* alloc and insert new table entry */
-   entry = MALLOC_STRUCT(HashEntry);
+   /* check if replacing an existing entry with same key */
+   entry = sparse_find(table, key);
    if (entry) {
-      entry->Key = key;
       entry->Data = data;
-      entry->Next = table->Table[pos];
-      table->Table[pos] = entry;
+      _glthread_UNLOCK_RWLOCK(table->Lock);
+      return;
+   }
+
+   /* keep at least half of the slots free so probe sequences stay short */
+   if ((table->SparseUsed + table->SparseDeleted + 1) * 2 > table->SparseSize) {
+      GLuint size = SPARSE_MIN_SIZE;
+      while (size < (table->SparseUsed + 1) * 4)
+         size *= 2;
+      if (!sparse_resize(table, size)) {
+         _glthread_UNLOCK_RWLOCK(table->Lock);
+         return;
+      }
    }
 
-   _glthread_UNLOCK_MUTEX(table->Mutex);
+   sparse_insert_new(table, key, data);
+
+   _glthread_UNLOCK_RWLOCK(table->Lock);
 }
 
 
@@ -230,8 +364,7 @@ _mesa_HashInsert(struct _mesa_HashTable *table, GLuint key, void *data)
 void
 _mesa_HashRemove(struct _mesa_HashTable *table, GLuint key)
 {
-   GLuint pos;
-   struct HashEntry *entry, *prev;
+   struct HashEntry *entry;
 
    assert(table);
    assert(key);
@@ -243,29 +376,27 @@ _mesa_HashRemove(struct _mesa_HashTable *table, GLuint key)
       return;
    }
 
-   _glthread_LOCK_MUTEX(table->Mutex);
-
-   pos = HASH_FUNC(key);
-   prev = NULL;
-   entry = table->Table[pos];
-   while (entry) {
-      if (entry->Key == key) {
-         /* found it! */
-         if (prev) {
-            prev->Next = entry->Next;
-         }
-         else {
-            table->Table[pos] = entry->Next;
-         }
-         free(entry);
-         _glthread_UNLOCK_MUTEX(table->Mutex);
-	 return;
+   _glthread_WRITE_LOCK(table->Lock);
+
+   if (key < DENSE_MAX_SIZE) {
+      if (key < table->DenseSize)
+         table->Dense[key] = NULL;
+   }
+   else {
+      /* Leave a marker rather than moving entries, so that a
+       * _mesa_HashWalk() callback removing its entry doesn't make the
+       * walk skip others.
+       */
+      entry = sparse_find(table, key);
+      if (entry) {
+         entry->Key = DELETED_KEY;
+         entry->Data = NULL;
+         table->SparseUsed--;
+         table->SparseDeleted++;
       }
-      prev = entry;
-      entry = entry->Next;
    }
 
-   _glthread_UNLOCK_MUTEX(table->Mutex);
+   _glthread_UNLOCK_RWLOCK(table->Lock);
 }
 
 
@@ -287,19 +418,56 @@ _mesa_HashDeleteAll(struct _mesa_HashTable *table,
    GLuint pos;
    ASSERT(table);
    ASSERT(callback);
-   _glthread_LOCK_MUTEX(table->Mutex);
+   _glthread_WRITE_LOCK(table->Lock);
    table->InDeleteAll = GL_TRUE;
-   for (pos = 0; pos < TABLE_SIZE; pos++) {
-      struct HashEntry *entry, *next;
-      for (entry = table->Table[pos]; entry; entry = next) {
-         callback(entry->Key, entry->Data, userData);
-         next = entry->Next;
-         free(entry);
+   for (pos = 1; pos < table->DenseSize; pos++) {
+      if (table->Dense[pos]) {
+         callback(pos, table->Dense[pos], userData);
+         table->Dense[pos] = NULL;
       }
-      table->Table[pos] = NULL;
    }
+   for (pos = 0; pos < table->SparseSize; pos++) {
+      struct HashEntry *entry = &table->Sparse[pos];
+      if (entry->Key > DELETED_KEY)
+         callback(entry->Key, entry->Data, userData);
+   }
+   free(table->Sparse);
+   table->Sparse = NULL;
+   table->SparseSize = 0;
+   table->SparseUsed = 0;
+   table->SparseDeleted = 0;
    table->InDeleteAll = GL_FALSE;
-   _glthread_UNLOCK_MUTEX(table->Mutex);
+   _glthread_UNLOCK_RWLOCK(table->Lock);
+}
+
+
+/**
+ * Return the first key at or above the given one in the direct indexed
+ * array, or 0 if there is none.
+ */
+static GLuint
+dense_next(const struct _mesa_HashTable *table, GLuint key)
+{
+   for (; key < table->DenseSize; key++) {
+      if (table->Dense[key])
+         return key;
+   }
+   return 0;
+}
+
+
+/**
+ * Return the first live slot at or after the given one in the open
+ * addressing table, or SparseSize if there is none.
+ */
+static GLuint
+sparse_next(const struct _mesa_HashTable *table, GLuint pos)
+{
+   for (; pos < table->SparseSize; pos++) {
+      if (table->Sparse[pos].Key > DELETED_KEY)
+         return pos;
+   }
+   return table->SparseSize;
 }
 
 
@@ -308,8 +476,8 @@ _mesa_HashDeleteAll(struct _mesa_HashTable *table,
  * Note: we use a separate mutex in this function to avoid a recursive
  * locking deadlock (in case the callback calls _mesa_HashRemove()) and to
  * prevent multiple threads/contexts from getting tangled up.
- * A lock-less version of this function could be used when the table will
- * not be modified.
+ * The table lock is only held while fetching each entry, the callback
+ * must not insert new keys into the table.
  * \param table  the hash table to walk
  * \param callback  the callback function
  * \param userData  arbitrary pointer to pass along to the callback
@@ -322,26 +490,47 @@ _mesa_HashWalk(const struct _mesa_HashTable *table,
 {
    /* cast-away const */
    struct _mesa_HashTable *table2 = (struct _mesa_HashTable *) table;
-   GLuint pos;
+   GLuint pos, key;
+   void *data;
    ASSERT(table);
    ASSERT(callback);
    _glthread_LOCK_MUTEX(table2->WalkMutex);
-   for (pos = 0; pos < TABLE_SIZE; pos++) {
-      struct HashEntry *entry, *next;
-      for (entry = table->Table[pos]; entry; entry = next) {
-         /* save 'next' pointer now in case the callback deletes the entry */
-         next = entry->Next;
-         callback(entry->Key, entry->Data, userData);
+
+   for (pos = 1; ; pos++) {
+      _glthread_READ_LOCK(table2->Lock);
+      pos = dense_next(table2, pos);
+      data = pos ? table2->Dense[pos] : NULL;
+      _glthread_UNLOCK_RWLOCK(table2->Lock);
+      if (!pos)
+         break;
+      callback(pos, data, userData);
+   }
+
+   for (pos = 0; ; pos++) {
+      _glthread_READ_LOCK(table2->Lock);
+      pos = sparse_next(table2, pos);
+      if (pos < table2->SparseSize) {
+         key = table2->Sparse[pos].Key;
+         data = table2->Sparse[pos].Data;
       }
+      else {
+         key = 0;
+         data = NULL;
+      }
+      _glthread_UNLOCK_RWLOCK(table2->Lock);
+      if (!key)
+         break;
+      callback(key, data, userData);
    }
+
    _glthread_UNLOCK_MUTEX(table2->WalkMutex);
 }
 
 
 /**
  * Return the key of the "first" entry in the hash table.
- * While holding the lock, walks through all table positions until finding
- * the first entry of the first non-empty one.
+ * Small keys are returned first, in increasing order, followed by the
+ * others in table order.
  * 
  * \param table  the hash table
  * \return key for the "first" entry in the hash table.
@@ -349,17 +538,17 @@ _mesa_HashWalk(const struct _mesa_HashTable *table,
 GLuint
 _mesa_HashFirstEntry(struct _mesa_HashTable *table)
 {
-   GLuint pos;
+   GLuint key, pos;
    assert(table);
-   _glthread_LOCK_MUTEX(table->Mutex);
-   for (pos = 0; pos < TABLE_SIZE; pos++) {
-      if (table->Table[pos]) {
-         _glthread_UNLOCK_MUTEX(table->Mutex);
-         return table->Table[pos]->Key;
-      }
+   _glthread_READ_LOCK(table->Lock);
+   key = dense_next(table, 1);
+   if (!key) {
+      pos = sparse_next(table, 0);
+      if (pos < table->SparseSize)
+         key = table->Sparse[pos].Key;
    }
-   _glthread_UNLOCK_MUTEX(table->Mutex);
-   return 0;
+   _glthread_UNLOCK_RWLOCK(table->Lock);
+   return key;
 }
 
 
@@ -372,40 +561,35 @@ _mesa_HashFirstEntry(struct _mesa_HashTable *table)
 GLuint
 _mesa_HashNextEntry(const struct _mesa_HashTable *table, GLuint key)
 {
+   /* cast-away const */
+   struct _mesa_HashTable *table2 = (struct _mesa_HashTable *) table;
    const struct HashEntry *entry;
-   GLuint pos;
+   GLuint pos, next = 0;
 
    assert(table);
    assert(key);
 
-   /* Find the entry with given key */
-   pos = HASH_FUNC(key);
-   for (entry = table->Table[pos]; entry ; entry = entry->Next) {
-      if (entry->Key == key) {
-         break;
-      }
-   }
+   _glthread_READ_LOCK(table2->Lock);
 
-   if (!entry) {
+   if (key < DENSE_MAX_SIZE) {
+      next = dense_next(table, key + 1);
+      pos = 0;
+   }
+   else {
+      /* Find the entry with given key */
+      entry = sparse_find(table, key);
       /* the given key was not found, so we can't find the next entry */
-      return 0;
+      pos = entry ? entry - table->Sparse + 1 : table->SparseSize;
    }
 
-   if (entry->Next) {
-      /* return next in linked list */
-      return entry->Next->Key;
-   }
-   else {
-      /* look for next non-empty table slot */
-      pos++;
-      while (pos < TABLE_SIZE) {
-         if (table->Table[pos]) {
-            return table->Table[pos]->Key;
-         }
-         pos++;
-      }
-      return 0;
+   if (!next) {
+      pos = sparse_next(table, pos);
+      if (pos < table->SparseSize)
+         next = table->Sparse[pos].Key;
    }
+
+   _glthread_UNLOCK_RWLOCK(table2->Lock);
+   return next;
 }
 
 
@@ -419,12 +603,14 @@ _mesa_HashPrint(const struct _mesa_HashTable *table)
 {
    GLuint pos;
    assert(table);
-   for (pos = 0; pos < TABLE_SIZE; pos++) {
-      const struct HashEntry *entry = table->Table[pos];
-      while (entry) {
-	 _mesa_debug(NULL, "%u %p\n", entry->Key, entry->Data);
-	 entry = entry->Next;
-      }
+   for (pos = 1; pos < table->DenseSize; pos++) {
+      if (table->Dense[pos])
+         _mesa_debug(NULL, "%u %p\n", pos, table->Dense[pos]);
+   }
+   for (pos = 0; pos < table->SparseSize; pos++) {
+      const struct HashEntry *entry = &table->Sparse[pos];
+      if (entry->Key > DELETED_KEY)
+         _mesa_debug(NULL, "%u %p\n", entry->Key, entry->Data);
    }
 }
 
@@ -447,11 +633,12 @@ GLuint
 _mesa_HashFindFreeKeyBlock(struct _mesa_HashTable *table, GLuint numKeys)
 {
    const GLuint maxKey = ~((GLuint) 0);
-   _glthread_LOCK_MUTEX(table->Mutex);
+   _glthread_READ_LOCK(table->Lock);
    if (maxKey - numKeys > table->MaxKey) {
       /* the quick solution */
-      _glthread_UNLOCK_MUTEX(table->Mutex);
-      return table->MaxKey + 1;
+      GLuint key = table->MaxKey + 1;
+      _glthread_UNLOCK_RWLOCK(table->Lock);
+      return key;
    }
    else {
       /* the slow solution */
@@ -468,13 +655,13 @@ _mesa_HashFindFreeKeyBlock(struct _mesa_HashTable *table, GLuint numKeys)
 	    /* this key not in use, check if we've found enough */
 	    freeCount++;
 	    if (freeCount == numKeys) {
-               _glthread_UNLOCK_MUTEX(table->Mutex);
+               _glthread_UNLOCK_RWLOCK(table->Lock);
 	       return freeStart;
 	    }
 	 }
       }
       /* cannot allocate a block of numKeys consecutive keys */
-      _glthread_UNLOCK_MUTEX(table->Mutex);
+      _glthread_UNLOCK_RWLOCK(table->Lock);
       return 0;
    }
 }
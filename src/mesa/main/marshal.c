@@ -0,0 +1,317 @@
+/*
+ * Mesa 3-D graphics library
+ *
+ * Copyright 2012 The Mesa authors.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+/**
+ * \file marshal.c
+ * GL command thread: batch queue, server thread and client side state
+ * tracking.  See marshal.h.
+ */
+
+
+#include "main/glheader.h"
+#include "main/context.h"
+#include "main/imports.h"
+#include "main/marshal.h"
+
+
+#ifdef PTHREADS
+
+
+/**
+ * Execute the commands of a batch.
+ */
+static void
+glthread_unmarshal_batch(struct gl_context *ctx, struct glthread_batch *batch)
+{
+   const uint8_t *buffer = (const uint8_t *) batch->buffer;
+   size_t pos = 0;
+
+   /* Display list compilation and vertex loopback go through the current
+    * dispatch of this thread.
+    */
+   _glapi_set_dispatch(ctx->CurrentDispatch);
+
+   while (pos < batch->used)
+      pos += _mesa_unmarshal_dispatch_cmd(ctx, buffer + pos);
+
+   assert(pos == batch->used);
+}
+
+
+static void *
+glthread_worker(void *data)
+{
+   struct gl_context *ctx = (struct gl_context *) data;
+   struct glthread_state *glthread = ctx->GLThread;
+
+   _glapi_set_context(ctx);
+
+   pthread_mutex_lock(&glthread->mutex);
+
+   while (1) {
+      struct glthread_batch *batch;
+
+      while (!glthread->num_queued && !glthread->shutdown)
+         pthread_cond_wait(&glthread->new_work, &glthread->mutex);
+
+      if (!glthread->num_queued)
+         break;   /* shutdown with nothing left to do */
+
+      batch = &glthread->batches[glthread->head];
+      pthread_mutex_unlock(&glthread->mutex);
+
+      glthread_unmarshal_batch(ctx, batch);
+
+      pthread_mutex_lock(&glthread->mutex);
+      batch->used = 0;
+      glthread->head = (glthread->head + 1) % MARSHAL_MAX_BATCHES;
+      glthread->num_queued--;
+      pthread_cond_broadcast(&glthread->work_done);
+   }
+
+   pthread_mutex_unlock(&glthread->mutex);
+
+   return NULL;
+}
+
+
+/**
+ * Start the command thread of a context, if requested with MESA_GLTHREAD.
+ */
+static void
+glthread_init(struct gl_context *ctx)
+{
+   struct glthread_state *glthread;
+   const char *env;
+
+   if (ctx->GLThread || ctx->API != API_OPENGL)
+      return;
+
+   env = _mesa_getenv("MESA_GLTHREAD");
+   if (!env || (strcmp(env, "true") != 0 && strcmp(env, "1") != 0))
+      return;
+
+   glthread = CALLOC_STRUCT(glthread_state);
+   if (!glthread)
+      return;
+
+   glthread->dispatch = _mesa_create_marshal_table();
+   if (!glthread->dispatch) {
+      free(glthread);
+      return;
+   }
+
+   pthread_mutex_init(&glthread->mutex, NULL);
+   pthread_cond_init(&glthread->new_work, NULL);
+   pthread_cond_init(&glthread->work_done, NULL);
+
+   ctx->GLThread = glthread;
+
+   if (pthread_create(&glthread->thread, NULL, glthread_worker, ctx) != 0) {
+      _mesa_warning(ctx, "failed to create the GL command thread");
+      ctx->GLThread = NULL;
+      pthread_cond_destroy(&glthread->work_done);
+      pthread_cond_destroy(&glthread->new_work);
+      pthread_mutex_destroy(&glthread->mutex);
+      free(glthread->dispatch);
+      free(glthread);
+   }
+}
+
+
+/**
+ * Called by _mesa_make_current() on the client thread once the context is
+ * current: start the command thread if needed and dispatch to the
+ * marshalling functions.
+ */
+void
+_mesa_glthread_make_current(struct gl_context *ctx)
+{
+   glthread_init(ctx);
+
+   if (ctx->GLThread)
+      _glapi_set_dispatch(ctx->GLThread->dispatch);
+}
+
+
+/**
+ * Execute all pending commands and stop the command thread.
+ */
+void
+_mesa_glthread_destroy(struct gl_context *ctx)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   if (!glthread)
+      return;
+
+   _mesa_glthread_flush_batch(ctx);
+
+   pthread_mutex_lock(&glthread->mutex);
+   glthread->shutdown = GL_TRUE;
+   pthread_cond_signal(&glthread->new_work);
+   pthread_mutex_unlock(&glthread->mutex);
+
+   pthread_join(glthread->thread, NULL);
+
+   pthread_cond_destroy(&glthread->work_done);
+   pthread_cond_destroy(&glthread->new_work);
+   pthread_mutex_destroy(&glthread->mutex);
+
+   ctx->GLThread = NULL;
+
+   /* The client may still have the marshalling table current */
+   if (_glapi_get_dispatch() == glthread->dispatch)
+      _glapi_set_dispatch(ctx->CurrentDispatch);
+
+   free(glthread->dispatch);
+   free(glthread);
+}
+
+
+/**
+ * Queue the batch being filled for the server thread and start a new one,
+ * waiting for a free batch if the queue is full.
+ */
+void
+_mesa_glthread_flush_batch(struct gl_context *ctx)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   if (!glthread || !glthread->batches[glthread->current].used)
+      return;
+
+   pthread_mutex_lock(&glthread->mutex);
+
+   glthread->num_queued++;
+   pthread_cond_signal(&glthread->new_work);
+
+   while (glthread->num_queued == MARSHAL_MAX_BATCHES)
+      pthread_cond_wait(&glthread->work_done, &glthread->mutex);
+
+   pthread_mutex_unlock(&glthread->mutex);
+
+   glthread->current = (glthread->current + 1) % MARSHAL_MAX_BATCHES;
+   assert(!glthread->batches[glthread->current].used);
+}
+
+
+/**
+ * Wait until all commands issued so far have been executed.
+ *
+ * Must be called from the client thread before touching the context
+ * directly: synchronous GL calls, MakeCurrent, SwapBuffers...
+ */
+void
+_mesa_glthread_finish(struct gl_context *ctx)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   if (!glthread)
+      return;
+
+   /* Called from the server thread itself, e.g. by a driver flushing
+    * the context while executing a command.
+    */
+   if (pthread_equal(pthread_self(), glthread->thread))
+      return;
+
+   _mesa_glthread_flush_batch(ctx);
+
+   pthread_mutex_lock(&glthread->mutex);
+   while (glthread->num_queued)
+      pthread_cond_wait(&glthread->work_done, &glthread->mutex);
+   pthread_mutex_unlock(&glthread->mutex);
+}
+
+
+void
+_mesa_glthread_BindBuffer(struct gl_context *ctx, GLenum target,
+                          GLuint buffer)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+
+   switch (target) {
+   case GL_ARRAY_BUFFER_ARB:
+      glthread->array_buffer = buffer;
+      break;
+   case GL_ELEMENT_ARRAY_BUFFER_ARB:
+      glthread->element_array_buffer = buffer;
+      break;
+   }
+}
+
+
+void
+_mesa_glthread_DeleteBuffers(struct gl_context *ctx, GLsizei n,
+                             const GLuint *buffers)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   GLsizei i;
+
+   if (!buffers)
+      return;
+
+   /* Deleting a bound buffer unbinds it */
+   for (i = 0; i < n; i++) {
+      if (buffers[i] == glthread->array_buffer)
+         glthread->array_buffer = 0;
+      if (buffers[i] == glthread->element_array_buffer)
+         glthread->element_array_buffer = 0;
+   }
+}
+
+
+void
+_mesa_glthread_BindVertexArray(struct gl_context *ctx)
+{
+   /* The element array binding is vertex array object state we don't
+    * track, assume client memory indices.
+    */
+   ctx->GLThread->element_array_buffer = 0;
+}
+
+
+void
+_mesa_glthread_PopClientAttrib(struct gl_context *ctx)
+{
+   /* Buffer bindings may have been restored to anything, including 0 */
+   ctx->GLThread->array_buffer = 0;
+   ctx->GLThread->element_array_buffer = 0;
+}
+
+
+void
+_mesa_glthread_Pointer(struct gl_context *ctx)
+{
+   /* Once an array sourced from client memory, draws can't be queued
+    * anymore as we don't track which arrays are enabled.
+    */
+   if (!ctx->GLThread->array_buffer)
+      ctx->GLThread->client_arrays = GL_TRUE;
+}
+
+
+#endif /* PTHREADS */
@@ -0,0 +1,248 @@
+/*
+ * Mesa 3-D graphics library
+ *
+ * Copyright 2012 The Mesa authors.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+/**
+ * \file marshal.h
+ * GL command thread.
+ *
+ * When enabled with MESA_GLTHREAD=true, the dispatch table of the
+ * application thread (the client) is replaced by a table of marshalling
+ * functions generated by src/mapi/glapi/gen/gl_marshal.py.  They copy
+ * each call and its parameters into a command batch which a dedicated
+ * thread (the server) later executes through ctx->CurrentDispatch, so
+ * Mesa's validation, vbo and driver work overlaps with the application.
+ *
+ * Calls which return a value or write to or keep reading from client
+ * memory (glGet*, glReadPixels, glMapBuffer...) are executed
+ * synchronously: the client waits until the server is idle and makes
+ * the call itself.
+ */
+
+
+#ifndef MARSHAL_H
+#define MARSHAL_H
+
+
+#include "main/glheader.h"
+#include "main/mtypes.h"
+#include "glapi/glapi.h"
+
+#ifdef PTHREADS
+#include <pthread.h>
+#endif
+
+
+/** Size of a command batch, in bytes */
+#define MARSHAL_BATCH_SIZE (64 * 1024)
+
+/** Number of batches: one being filled, the others queued/executing */
+#define MARSHAL_MAX_BATCHES 4
+
+/** Commands larger than this are executed synchronously */
+#define MARSHAL_MAX_CMD_SIZE (8 * 1024)
+
+/** Commands and their variable size data are 8 byte aligned */
+#define MARSHAL_ALIGN(size) (((size) + 7) & ~(size_t) 7)
+
+
+/**
+ * Header of every command in a batch.
+ */
+struct marshal_cmd_base
+{
+   uint16_t cmd_id;     /**< DISPATCH_CMD_x, see marshal_generated.c */
+   uint16_t cmd_size;   /**< Total size of the command, in bytes */
+};
+
+
+#ifdef PTHREADS
+
+struct glthread_batch
+{
+   uint64_t buffer[MARSHAL_BATCH_SIZE / 8];
+   size_t used;   /**< bytes of buffer holding commands */
+};
+
+
+struct glthread_state
+{
+   pthread_t thread;
+   pthread_mutex_t mutex;
+   pthread_cond_t new_work;    /**< signalled when a batch is queued */
+   pthread_cond_t work_done;   /**< signalled when a batch was executed */
+   GLboolean shutdown;
+
+   struct glthread_batch batches[MARSHAL_MAX_BATCHES];
+   unsigned head;          /**< oldest queued batch, executing on the server */
+   unsigned num_queued;    /**< batches queued for the server */
+   unsigned current;       /**< batch being filled by the client */
+
+   /** Table of marshalling functions, the client's dispatch */
+   struct _glapi_table *dispatch;
+
+   /**
+    * Client side tracking of the state deciding whether draws may run
+    * asynchronously: they can't while they source data from client
+    * memory the application is free to change once the call returns.
+    */
+   GLuint array_buffer;          /**< GL_ARRAY_BUFFER binding */
+   GLuint element_array_buffer;  /**< GL_ELEMENT_ARRAY_BUFFER binding */
+   GLboolean client_arrays;      /**< a gl*Pointer call used client memory */
+};
+
+
+extern void
+_mesa_glthread_make_current(struct gl_context *ctx);
+
+extern void
+_mesa_glthread_destroy(struct gl_context *ctx);
+
+extern void
+_mesa_glthread_flush_batch(struct gl_context *ctx);
+
+extern void
+_mesa_glthread_finish(struct gl_context *ctx);
+
+extern void
+_mesa_glthread_BindBuffer(struct gl_context *ctx, GLenum target,
+                          GLuint buffer);
+
+extern void
+_mesa_glthread_DeleteBuffers(struct gl_context *ctx, GLsizei n,
+                             const GLuint *buffers);
+
+extern void
+_mesa_glthread_BindVertexArray(struct gl_context *ctx);
+
+extern void
+_mesa_glthread_PopClientAttrib(struct gl_context *ctx);
+
+extern void
+_mesa_glthread_Pointer(struct gl_context *ctx);
+
+
+/* In marshal_generated.c */
+extern struct _glapi_table *
+_mesa_create_marshal_table(void);
+
+extern size_t
+_mesa_unmarshal_dispatch_cmd(struct gl_context *ctx, const void *cmd);
+
+
+/**
+ * Reserve space for a command of the given size (including variable size
+ * data, a multiple of 8) in the current batch.
+ */
+static INLINE void *
+_mesa_glthread_allocate_command(struct gl_context *ctx,
+                                uint16_t cmd_id,
+                                size_t size)
+{
+   struct glthread_state *glthread = ctx->GLThread;
+   struct glthread_batch *batch = &glthread->batches[glthread->current];
+   struct marshal_cmd_base *cmd_base;
+
+   assert(size <= MARSHAL_MAX_CMD_SIZE);
+
+   if (batch->used + size > MARSHAL_BATCH_SIZE) {
+      _mesa_glthread_flush_batch(ctx);
+      batch = &glthread->batches[glthread->current];
+   }
+
+   cmd_base = (struct marshal_cmd_base *)
+      ((uint8_t *) batch->buffer + batch->used);
+   batch->used += size;
+   cmd_base->cmd_id = cmd_id;
+   cmd_base->cmd_size = size;
+   return cmd_base;
+}
+
+
+/**
+ * Size in bytes of an array of count elements, or something larger than
+ * MARSHAL_MAX_CMD_SIZE if count is negative or the size is too large to
+ * be copied into a command.
+ */
+static INLINE size_t
+_mesa_glthread_array_size(GLint64 count, size_t elem_size)
+{
+   if (count < 0 || (uint64_t) count > MARSHAL_MAX_CMD_SIZE / elem_size)
+      return MARSHAL_MAX_CMD_SIZE + 1;
+   return (size_t) count * elem_size;
+}
+
+
+/**
+ * Whether a draw may be queued, rather than executed synchronously.
+ */
+static INLINE GLboolean
+_mesa_glthread_draw_is_async(const struct gl_context *ctx, GLboolean indexed)
+{
+   const struct glthread_state *glthread = ctx->GLThread;
+
+   return !glthread->client_arrays &&
+          (!indexed || glthread->element_array_buffer != 0);
+}
+
+
+/**
+ * Wait for the server thread to go idle before executing a call on the
+ * client thread.  Mesa code re-entering the dispatch (array elements,
+ * loopback...) must see the real dispatch table meanwhile.
+ */
+static INLINE void
+_mesa_glthread_begin_sync(struct gl_context *ctx)
+{
+   _mesa_glthread_finish(ctx);
+   _glapi_set_dispatch(ctx->CurrentDispatch);
+}
+
+static INLINE void
+_mesa_glthread_end_sync(struct gl_context *ctx)
+{
+   _glapi_set_dispatch(ctx->GLThread->dispatch);
+}
+
+#else /* PTHREADS */
+
+static INLINE void
+_mesa_glthread_make_current(struct gl_context *ctx)
+{
+}
+
+static INLINE void
+_mesa_glthread_destroy(struct gl_context *ctx)
+{
+}
+
+static INLINE void
+_mesa_glthread_finish(struct gl_context *ctx)
+{
+}
+
+#endif /* PTHREADS */
+
+
+#endif /* MARSHAL_H */
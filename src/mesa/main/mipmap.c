@@ -37,6 +37,30 @@
 #include "macros.h"
 #include "../../gallium/auxiliary/util/u_format_rgb9e5.h"
 #include "../../gallium/auxiliary/util/u_format_r11g11b10f.h"
+#include "../../gallium/auxiliary/util/u_mipmap_row.h"
+
+#ifdef PTHREADS
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+
+/**
+ * Pseudo datatypes for the sRGB-correct filtering of the 8-bit sRGB formats
+ * (MESA_MIPMAP_SRGB=1), with no alpha or the alpha as the first or last
+ * component in memory.  Only handled by do_row(), not by do_row_3D().
+ */
+#define MIPMAP_TYPE_SRGB8                0x10001
+#define MIPMAP_TYPE_SRGB8_ALPHA_FIRST    0x10002
+#define MIPMAP_TYPE_SRGB8_ALPHA_LAST     0x10003
+
+static GLboolean
+is_srgb_type(GLenum datatype)
+{
+   return (datatype == MIPMAP_TYPE_SRGB8 ||
+           datatype == MIPMAP_TYPE_SRGB8_ALPHA_FIRST ||
+           datatype == MIPMAP_TYPE_SRGB8_ALPHA_LAST);
+}
 
 
 
@@ -45,6 +69,9 @@ bytes_per_pixel(GLenum datatype, GLuint comps)
 {
    GLint b;
 
+   if (is_srgb_type(datatype))
+      return comps;
+
    if (datatype == GL_UNSIGNED_INT_8_24_REV_MESA ||
        datatype == GL_UNSIGNED_INT_24_8_MESA)
       return 4;
@@ -135,6 +162,31 @@ bytes_per_pixel(GLenum datatype, GLuint comps)
 /*@}*/
 
 
+/**
+ * Table for the sRGB-correct filtering, sRGB 8-bit values to linear.
+ */
+static const GLfloat *
+get_srgb_to_linear_table(void)
+{
+   static GLfloat table[256];
+   static GLboolean initialized = GL_FALSE;
+
+   if (!initialized) {
+      GLuint i;
+      for (i = 0; i < 256; i++) {
+         const GLdouble cs = i / 255.0;
+         if (cs <= 0.04045)
+            table[i] = (GLfloat) (cs / 12.92);
+         else
+            table[i] = (GLfloat) pow((cs + 0.055) / 1.055, 2.4);
+      }
+      initialized = GL_TRUE;
+   }
+
+   return table;
+}
+
+
 /**
  * Average together two rows of a source image to produce a single new
  * row in the dest image.  It's legal for the two source rows to point
@@ -158,6 +210,42 @@ do_row(GLenum datatype, GLuint comps, GLint srcWidth,
    assert(srcWidth == dstWidth || srcWidth == 2 * dstWidth);
    */
 
+   if (is_srgb_type(datatype)) {
+      const GLuint alpha = (datatype == MIPMAP_TYPE_SRGB8_ALPHA_FIRST) ? 0 :
+         (datatype == MIPMAP_TYPE_SRGB8_ALPHA_LAST) ? comps - 1 : comps;
+      util_mipmap_row_srgb8(comps, alpha, get_srgb_to_linear_table(),
+                            srcRowA, srcRowB, srcWidth, dstWidth, dstRow);
+      return;
+   }
+
+   if (srcWidth != dstWidth) {
+      /* Do the start of the row with the vector code, if there's some */
+      GLuint n = 0;
+
+      if (datatype == GL_UNSIGNED_BYTE)
+         n = util_mipmap_row_unorm8(comps, srcRowA, srcRowB,
+                                    dstWidth, dstRow);
+      else if (datatype == GL_UNSIGNED_SHORT)
+         n = util_mipmap_row_unorm16(comps, srcRowA, srcRowB,
+                                     dstWidth, dstRow);
+      else if (datatype == GL_FLOAT)
+         n = util_mipmap_row_float(comps, srcRowA, srcRowB,
+                                   dstWidth, dstRow);
+
+      if (n == (GLuint) dstWidth)
+         return;
+
+      if (n) {
+         /* k0 and colStride are unchanged for the rest of the row */
+         const GLint bpt = bytes_per_pixel(datatype, comps);
+         srcRowA = (const GLubyte *) srcRowA + 2 * n * bpt;
+         srcRowB = (const GLubyte *) srcRowB + 2 * n * bpt;
+         dstRow = (GLubyte *) dstRow + n * bpt;
+         srcWidth -= 2 * n;
+         dstWidth -= n;
+      }
+   }
+
    if (datatype == GL_UNSIGNED_BYTE && comps == 4) {
       GLuint i, j, k;
       const GLubyte(*rowA)[4] = (const GLubyte(*)[4]) srcRowA;
@@ -1439,6 +1527,127 @@ make_1d_mipmap(GLenum datatype, GLuint comps, GLint border,
 }
 
 
+/**
+ * A band of destination rows of a 2D image, each computed from two source
+ * rows.
+ */
+struct mipmap_rows
+{
+   GLenum datatype;
+   GLuint comps;
+   GLint srcWidth;
+   const GLubyte *srcA, *srcB;
+   GLint srcStride;            /**< between two dest rows, in bytes */
+   GLint dstWidth;
+   GLubyte *dst;
+   GLint dstStride;
+   GLint numRows;
+};
+
+
+static void
+do_rows(const struct mipmap_rows *rows)
+{
+   const GLubyte *srcA = rows->srcA, *srcB = rows->srcB;
+   GLubyte *dst = rows->dst;
+   GLint row;
+
+   for (row = 0; row < rows->numRows; row++) {
+      do_row(rows->datatype, rows->comps, rows->srcWidth, srcA, srcB,
+             rows->dstWidth, dst);
+      srcA += rows->srcStride;
+      srcB += rows->srcStride;
+      dst += rows->dstStride;
+   }
+}
+
+
+#ifdef PTHREADS
+
+static void *
+do_rows_thread(void *data)
+{
+   do_rows((const struct mipmap_rows *) data);
+   return NULL;
+}
+
+
+/**
+ * Number of threads for large images, MESA_MIPMAP_THREADS or the number
+ * of CPUs.
+ */
+static GLuint
+get_num_threads(void)
+{
+   static GLint numThreads = 0;
+
+   if (!numThreads) {
+      const char *env = _mesa_getenv("MESA_MIPMAP_THREADS");
+      GLint n = env ? atoi(env) : (GLint) sysconf(_SC_NPROCESSORS_ONLN);
+      numThreads = CLAMP(n, 1, UTIL_MIPMAP_MAX_THREADS);
+   }
+
+   return numThreads;
+}
+
+#endif /* PTHREADS */
+
+
+/**
+ * Compute rows, splitting large images in bands done by several threads.
+ */
+static void
+do_rows_threaded(const struct mipmap_rows *rows)
+{
+#ifdef PTHREADS
+   const GLint bpt = bytes_per_pixel(rows->datatype, rows->comps);
+   GLint numThreads = 1;
+
+   if (rows->dstWidth * rows->numRows * bpt >= UTIL_MIPMAP_THREAD_MIN_BYTES)
+      numThreads = MIN2(get_num_threads(), (GLuint) rows->numRows);
+
+   if (numThreads > 1) {
+      struct mipmap_rows bands[UTIL_MIPMAP_MAX_THREADS];
+      pthread_t threads[UTIL_MIPMAP_MAX_THREADS];
+      GLboolean started[UTIL_MIPMAP_MAX_THREADS];
+      GLint t, first = 0;
+
+      for (t = 0; t < numThreads; t++) {
+         const GLint last = rows->numRows * (t + 1) / numThreads;
+         bands[t] = *rows;
+         bands[t].srcA += first * rows->srcStride;
+         bands[t].srcB += first * rows->srcStride;
+         bands[t].dst += first * rows->dstStride;
+         bands[t].numRows = last - first;
+         first = last;
+      }
+
+      /* the sRGB table is built on first use, don't let the workers race */
+      if (is_srgb_type(rows->datatype))
+         (void) get_srgb_to_linear_table();
+
+      /* the first band is done by this thread */
+      for (t = 1; t < numThreads; t++) {
+         started[t] = pthread_create(&threads[t], NULL,
+                                     do_rows_thread, &bands[t]) == 0;
+         if (!started[t])
+            do_rows(&bands[t]);
+      }
+
+      do_rows(&bands[0]);
+
+      for (t = 1; t < numThreads; t++) {
+         if (started[t])
+            pthread_join(threads[t], NULL);
+      }
+      return;
+   }
+#endif
+
+   do_rows(rows);
+}
+
+
 static void
 make_2d_mipmap(GLenum datatype, GLuint comps, GLint border,
                GLint srcWidth, GLint srcHeight,
@@ -1453,6 +1662,7 @@ make_2d_mipmap(GLenum datatype, GLuint comps, GLint border,
    const GLubyte *srcA, *srcB;
    GLubyte *dst;
    GLint row, srcRowStep;
+   struct mipmap_rows rows;
 
    /* Compute src and dst pointers, skipping any border */
    srcA = srcPtr + border * ((srcWidth + 1) * bpt);
@@ -1469,13 +1679,17 @@ make_2d_mipmap(GLenum datatype, GLuint comps, GLint border,
 
    dst = dstPtr + border * ((dstWidth + 1) * bpt);
 
-   for (row = 0; row < dstHeightNB; row++) {
-      do_row(datatype, comps, srcWidthNB, srcA, srcB,
-             dstWidthNB, dst);
-      srcA += srcRowStep * srcRowStride;
-      srcB += srcRowStep * srcRowStride;
-      dst += dstRowStride;
-   }
+   rows.datatype = datatype;
+   rows.comps = comps;
+   rows.srcWidth = srcWidthNB;
+   rows.srcA = srcA;
+   rows.srcB = srcB;
+   rows.srcStride = srcRowStep * srcRowStride;
+   rows.dstWidth = dstWidthNB;
+   rows.dst = dst;
+   rows.dstStride = dstRowStride;
+   rows.numRows = dstHeightNB;
+   do_rows_threaded(&rows);
 
    /* This is ugly but probably won't be used much */
    if (border > 0) {
@@ -1803,6 +2017,47 @@ next_mipmap_level_size(GLenum target, GLint border,
    }
 }
 
+/**
+ * Whether sRGB textures are filtered in linear space (MESA_MIPMAP_SRGB).
+ */
+static GLboolean
+srgb_linear_filtering(void)
+{
+   static GLint enabled = -1;
+
+   if (enabled < 0) {
+      const char *env = _mesa_getenv("MESA_MIPMAP_SRGB");
+      enabled = env && (strcmp(env, "1") == 0 || strcmp(env, "true") == 0);
+   }
+
+   return enabled;
+}
+
+
+/**
+ * Return the pseudo datatype for the sRGB-correct filtering of an 8-bit
+ * sRGB format, or the datatype unchanged.
+ */
+static GLenum
+get_srgb_type(gl_format format, GLenum datatype)
+{
+   const GLboolean le = _mesa_little_endian();
+
+   switch (format) {
+   case MESA_FORMAT_SRGB8:
+   case MESA_FORMAT_SL8:
+      return MIPMAP_TYPE_SRGB8;
+   case MESA_FORMAT_SRGBA8:
+      return le ? MIPMAP_TYPE_SRGB8_ALPHA_FIRST : MIPMAP_TYPE_SRGB8_ALPHA_LAST;
+   case MESA_FORMAT_SARGB8:
+   case MESA_FORMAT_SLA8:
+      return le ? MIPMAP_TYPE_SRGB8_ALPHA_LAST : MIPMAP_TYPE_SRGB8_ALPHA_FIRST;
+   default:
+      return datatype;
+   }
+}
+
+
 static void
 generate_mipmap_uncompressed(struct gl_context *ctx, GLenum target,
 			     struct gl_texture_object *texObj,
@@ -1815,6 +2070,9 @@ generate_mipmap_uncompressed(struct gl_context *ctx, GLenum target,
 
    _mesa_format_to_type_and_comps(srcImage->TexFormat, &datatype, &comps);
 
+   if (target != GL_TEXTURE_3D && srgb_linear_filtering())
+      datatype = get_srgb_type(srcImage->TexFormat, datatype);
+
    for (level = texObj->BaseLevel; level < maxLevel; level++) {
       /* generate image[level+1] from image[level] */
       struct gl_texture_image *srcImage, *dstImage;
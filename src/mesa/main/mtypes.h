@@ -3153,6 +3153,7 @@ struct gl_dlist_state
    struct gl_display_list *CurrentList; /**< List currently being compiled */
    union gl_dlist_node *CurrentBlock; /**< Pointer to current block of nodes */
    GLuint CurrentPos;		/**< Index into current block of nodes */
+   union gl_dlist_node *LastInstruction; /**< Last one of the current list */
 
    GLvertexformat ListVtxfmt;
 
@@ -3173,6 +3174,13 @@ struct gl_dlist_state
        * list.  Used to eliminate some redundant state changes.
        */
       GLenum ShadeModel;
+
+      /** Recently changed glEnable/glDisable states */
+      struct {
+         GLenum Cap;
+         GLboolean State;
+      } Enable[8];
+      GLuint EnableNext;   /**< Next Enable[] entry to replace */
    } Current;
 };
 
@@ -3211,6 +3219,9 @@ struct gl_context
    struct _glapi_table *CurrentDispatch;  /**< == Save or Exec !! */
    /*@}*/
 
+   /** GL command thread state, NULL unless MESA_GLTHREAD is set */
+   struct glthread_state *GLThread;
+
    struct gl_config Visual;
    struct gl_framebuffer *DrawBuffer;	/**< buffer for writing */
    struct gl_framebuffer *ReadBuffer;	/**< buffer for reading */
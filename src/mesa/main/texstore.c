@@ -74,6 +74,10 @@
 #include "../../gallium/auxiliary/util/u_format_rgb9e5.h"
 #include "../../gallium/auxiliary/util/u_format_r11g11b10f.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 
 enum {
    ZERO = 4, 
@@ -4515,6 +4519,399 @@ _mesa_get_texstore_func(gl_format format)
 }
 
 
+/**
+ * Direct row conversion.
+ *
+ * Common uploads which have no memcpy path (RGBA <-> BGRA, RGB -> RGBX,
+ * luminance expansion, float <-> half float) are converted straight from
+ * the user's image to the texture, one row at a time, instead of going
+ * through a temporary float/ubyte image of the whole texture.
+ *
+ * The converters assume a little endian host: the 8888 formats are
+ * handled as bytes in memory order, e.g. MESA_FORMAT_ARGB8888 as B,G,R,A.
+ */
+
+typedef void (*TexstoreRowFunc)(GLubyte *dst, const GLubyte *src, GLuint n);
+
+
+/** Swap the first and third bytes of each 4-byte texel */
+static void
+row_swap_rb_8888(GLubyte *dst, const GLubyte *src, GLuint n)
+{
+   GLuint *d = (GLuint *) dst;
+   GLuint i = 0;
+
+#if defined(__SSE2__)
+   const __m128i ag_mask = _mm_set1_epi32(0xff00ff00);
+   for (; i + 4 <= n; i += 4) {
+      __m128i p = _mm_loadu_si128((const __m128i *) (src + i * 4));
+      __m128i ag = _mm_and_si128(p, ag_mask);
+      __m128i rb = _mm_andnot_si128(ag_mask, p);
+      rb = _mm_shufflelo_epi16(rb, _MM_SHUFFLE(2, 3, 0, 1));
+      rb = _mm_shufflehi_epi16(rb, _MM_SHUFFLE(2, 3, 0, 1));
+      _mm_storeu_si128((__m128i *) (d + i), _mm_or_si128(ag, rb));
+   }
+#endif
+
+   for (; i < n; i++) {
+      GLuint p;
+      memcpy(&p, src + i * 4, 4);
+      d[i] = (p & 0xff00ff00) | ((p >> 16) & 0xff) | ((p & 0xff) << 16);
+   }
+}
+
+
+/** As above, but set the fourth byte (alpha) to 0xff */
+static void
+row_swap_rb_8888_opaque(GLubyte *dst, const GLubyte *src, GLuint n)
+{
+   GLuint *d = (GLuint *) dst;
+   GLuint i = 0;
+
+#if defined(__SSE2__)
+   const __m128i g_mask = _mm_set1_epi32(0x0000ff00);
+   const __m128i rb_mask = _mm_set1_epi32(0x00ff00ff);
+   const __m128i a_mask = _mm_set1_epi32(0xff000000);
+   for (; i + 4 <= n; i += 4) {
+      __m128i p = _mm_loadu_si128((const __m128i *) (src + i * 4));
+      __m128i g = _mm_and_si128(p, g_mask);
+      __m128i rb = _mm_and_si128(p, rb_mask);
+      rb = _mm_shufflelo_epi16(rb, _MM_SHUFFLE(2, 3, 0, 1));
+      rb = _mm_shufflehi_epi16(rb, _MM_SHUFFLE(2, 3, 0, 1));
+      p = _mm_or_si128(_mm_or_si128(g, rb), a_mask);
+      _mm_storeu_si128((__m128i *) (d + i), p);
+   }
+#endif
+
+   for (; i < n; i++) {
+      GLuint p;
+      memcpy(&p, src + i * 4, 4);
+      d[i] = 0xff000000 | (p & 0x0000ff00) |
+             ((p >> 16) & 0xff) | ((p & 0xff) << 16);
+   }
+}
+
+
+/** Copy 4-byte texels, setting the fourth byte (alpha) to 0xff */
+static void
+row_copy_8888_opaque(GLubyte *dst, const GLubyte *src, GLuint n)
+{
+   GLuint *d = (GLuint *) dst;
+   GLuint i = 0;
+
+#if defined(__SSE2__)
+   const __m128i a_mask = _mm_set1_epi32(0xff000000);
+   for (; i + 4 <= n; i += 4) {
+      __m128i p = _mm_loadu_si128((const __m128i *) (src + i * 4));
+      _mm_storeu_si128((__m128i *) (d + i), _mm_or_si128(p, a_mask));
+   }
+#endif
+
+   for (; i < n; i++) {
+      GLuint p;
+      memcpy(&p, src + i * 4, 4);
+      d[i] = p | 0xff000000;
+   }
+}
+
+
+/** Expand 3-byte texels to 4 bytes, with 0xff in the fourth byte */
+static void
+row_expand_888_to_8888(GLubyte *dst, const GLubyte *src, GLuint n)
+{
+   GLuint *d = (GLuint *) dst;
+   GLuint i;
+
+   for (i = 0; i < n; i++) {
+      d[i] = 0xff000000 | (src[2] << 16) | (src[1] << 8) | src[0];
+      src += 3;
+   }
+}
+
+
+/** As above, swapping the first and third bytes */
+static void
+row_expand_888_to_8888_swap_rb(GLubyte *dst, const GLubyte *src, GLuint n)
+{
+   GLuint *d = (GLuint *) dst;
+   GLuint i;
+
+   for (i = 0; i < n; i++) {
+      d[i] = 0xff000000 | (src[0] << 16) | (src[1] << 8) | src[2];
+      src += 3;
+   }
+}
+
+
+/** Luminance to L,L,L,0xff */
+static void
+row_l8_to_8888(GLubyte *dst, const GLubyte *src, GLuint n)
+{
+   GLuint *d = (GLuint *) dst;
+   GLuint i = 0;
+
+#if defined(__SSE2__)
+   const __m128i a_mask = _mm_set1_epi32(0xff000000);
+   for (; i + 16 <= n; i += 16) {
+      __m128i l = _mm_loadu_si128((const __m128i *) (src + i));
+      __m128i ll_lo = _mm_unpacklo_epi8(l, l);
+      __m128i ll_hi = _mm_unpackhi_epi8(l, l);
+      __m128i p0 = _mm_unpacklo_epi16(ll_lo, ll_lo);
+      __m128i p1 = _mm_unpackhi_epi16(ll_lo, ll_lo);
+      __m128i p2 = _mm_unpacklo_epi16(ll_hi, ll_hi);
+      __m128i p3 = _mm_unpackhi_epi16(ll_hi, ll_hi);
+      _mm_storeu_si128((__m128i *) (d + i + 0), _mm_or_si128(p0, a_mask));
+      _mm_storeu_si128((__m128i *) (d + i + 4), _mm_or_si128(p1, a_mask));
+      _mm_storeu_si128((__m128i *) (d + i + 8), _mm_or_si128(p2, a_mask));
+      _mm_storeu_si128((__m128i *) (d + i + 12), _mm_or_si128(p3, a_mask));
+   }
+#endif
+
+   for (; i < n; i++) {
+      d[i] = 0xff000000 | (src[i] * 0x010101);
+   }
+}
+
+
+/** Luminance/alpha to L,L,L,A */
+static void
+row_l8a8_to_8888(GLubyte *dst, const GLubyte *src, GLuint n)
+{
+   GLuint *d = (GLuint *) dst;
+   GLuint i = 0;
+
+#if defined(__SSE2__)
+   const __m128i l_mask = _mm_set1_epi16(0x00ff);
+   for (; i + 8 <= n; i += 8) {
+      __m128i la = _mm_loadu_si128((const __m128i *) (src + i * 2));
+      __m128i l = _mm_and_si128(la, l_mask);
+      __m128i ll = _mm_or_si128(l, _mm_slli_epi16(l, 8));
+      _mm_storeu_si128((__m128i *) (d + i + 0), _mm_unpacklo_epi16(ll, la));
+      _mm_storeu_si128((__m128i *) (d + i + 4), _mm_unpackhi_epi16(ll, la));
+   }
+#endif
+
+   for (; i < n; i++) {
+      const GLuint l = src[i * 2], a = src[i * 2 + 1];
+      d[i] = (a << 24) | (l * 0x010101);
+   }
+}
+
+
+/** Luminance to L,0xff */
+static void
+row_l8_to_88(GLubyte *dst, const GLubyte *src, GLuint n)
+{
+   GLuint i = 0;
+
+#if defined(__SSE2__)
+   const __m128i ones = _mm_set1_epi8((char) 0xff);
+   for (; i + 16 <= n; i += 16) {
+      __m128i l = _mm_loadu_si128((const __m128i *) (src + i));
+      _mm_storeu_si128((__m128i *) (dst + i * 2), _mm_unpacklo_epi8(l, ones));
+      _mm_storeu_si128((__m128i *) (dst + i * 2 + 16),
+                       _mm_unpackhi_epi8(l, ones));
+   }
+#endif
+
+   for (; i < n; i++) {
+      dst[i * 2] = src[i];
+      dst[i * 2 + 1] = 0xff;
+   }
+}
+
+
+#define ROW_FLOAT_TO_HALF(NAME, SRC_COMPS, DST_COMPS)                   \
+static void                                                             \
+NAME(GLubyte *dst, const GLubyte *src, GLuint n)                        \
+{                                                                       \
+   const GLfloat *s = (const GLfloat *) src;                            \
+   GLhalfARB *d = (GLhalfARB *) dst;                                    \
+   GLuint i, c;                                                         \
+   for (i = 0; i < n; i++) {                                            \
+      for (c = 0; c < SRC_COMPS; c++)                                   \
+         d[c] = _mesa_float_to_half(s[c]);                              \
+      if (DST_COMPS > SRC_COMPS)                                        \
+         d[DST_COMPS - 1] = 0x3c00;  /* 1.0 */                          \
+      s += SRC_COMPS;                                                   \
+      d += DST_COMPS;                                                   \
+   }                                                                    \
+}
+
+ROW_FLOAT_TO_HALF(row_float_to_half_4, 4, 4)
+ROW_FLOAT_TO_HALF(row_float_to_half_3, 3, 3)
+ROW_FLOAT_TO_HALF(row_float_to_half_3_to_4, 3, 4)
+
+
+#define ROW_HALF_TO_FLOAT(NAME, SRC_COMPS, DST_COMPS)                   \
+static void                                                             \
+NAME(GLubyte *dst, const GLubyte *src, GLuint n)                        \
+{                                                                       \
+   const GLhalfARB *s = (const GLhalfARB *) src;                        \
+   GLfloat *d = (GLfloat *) dst;                                        \
+   GLuint i, c;                                                         \
+   for (i = 0; i < n; i++) {                                            \
+      for (c = 0; c < SRC_COMPS; c++)                                   \
+         d[c] = _mesa_half_to_float(s[c]);                              \
+      if (DST_COMPS > SRC_COMPS)                                        \
+         d[DST_COMPS - 1] = 1.0F;                                       \
+      s += SRC_COMPS;                                                   \
+      d += DST_COMPS;                                                   \
+   }                                                                    \
+}
+
+ROW_HALF_TO_FLOAT(row_half_to_float_4, 4, 4)
+ROW_HALF_TO_FLOAT(row_half_to_float_3, 3, 3)
+ROW_HALF_TO_FLOAT(row_half_to_float_3_to_4, 3, 4)
+
+
+/**
+ * Row converters, by user format/type, base internal format and texture
+ * format.  RGB base formats need the alpha set to one.
+ */
+static const struct {
+   GLenum srcFormat;
+   GLenum srcType;
+   GLenum baseInternalFormat;
+   gl_format dstFormat;
+   TexstoreRowFunc convert;
+} texstore_row_funcs[] = {
+   /* RGBA <-> BGRA */
+   { GL_RGBA, GL_UNSIGNED_BYTE, GL_RGBA, MESA_FORMAT_ARGB8888,
+     row_swap_rb_8888 },
+   { GL_RGBA, GL_UNSIGNED_BYTE, GL_RGB, MESA_FORMAT_ARGB8888,
+     row_swap_rb_8888_opaque },
+   { GL_RGBA, GL_UNSIGNED_BYTE, GL_RGB, MESA_FORMAT_XRGB8888,
+     row_swap_rb_8888_opaque },
+   { GL_BGRA, GL_UNSIGNED_BYTE, GL_RGBA, MESA_FORMAT_RGBA8888_REV,
+     row_swap_rb_8888 },
+   { GL_BGRA, GL_UNSIGNED_BYTE, GL_RGB, MESA_FORMAT_RGBA8888_REV,
+     row_swap_rb_8888_opaque },
+   { GL_BGRA, GL_UNSIGNED_BYTE, GL_RGB, MESA_FORMAT_RGBX8888_REV,
+     row_swap_rb_8888_opaque },
+
+   /* RGBA -> RGB1 */
+   { GL_RGBA, GL_UNSIGNED_BYTE, GL_RGB, MESA_FORMAT_RGBA8888_REV,
+     row_copy_8888_opaque },
+   { GL_RGBA, GL_UNSIGNED_BYTE, GL_RGB, MESA_FORMAT_RGBX8888_REV,
+     row_copy_8888_opaque },
+   { GL_BGRA, GL_UNSIGNED_BYTE, GL_RGB, MESA_FORMAT_ARGB8888,
+     row_copy_8888_opaque },
+   { GL_BGRA, GL_UNSIGNED_BYTE, GL_RGB, MESA_FORMAT_XRGB8888,
+     row_copy_8888_opaque },
+
+   /* RGB -> RGBX */
+   { GL_RGB, GL_UNSIGNED_BYTE, GL_RGB, MESA_FORMAT_ARGB8888,
+     row_expand_888_to_8888_swap_rb },
+   { GL_RGB, GL_UNSIGNED_BYTE, GL_RGB, MESA_FORMAT_XRGB8888,
+     row_expand_888_to_8888_swap_rb },
+   { GL_RGB, GL_UNSIGNED_BYTE, GL_RGB, MESA_FORMAT_RGBA8888_REV,
+     row_expand_888_to_8888 },
+   { GL_RGB, GL_UNSIGNED_BYTE, GL_RGB, MESA_FORMAT_RGBX8888_REV,
+     row_expand_888_to_8888 },
+   { GL_BGR, GL_UNSIGNED_BYTE, GL_RGB, MESA_FORMAT_ARGB8888,
+     row_expand_888_to_8888 },
+   { GL_BGR, GL_UNSIGNED_BYTE, GL_RGB, MESA_FORMAT_XRGB8888,
+     row_expand_888_to_8888 },
+   { GL_BGR, GL_UNSIGNED_BYTE, GL_RGB, MESA_FORMAT_RGBA8888_REV,
+     row_expand_888_to_8888_swap_rb },
+   { GL_BGR, GL_UNSIGNED_BYTE, GL_RGB, MESA_FORMAT_RGBX8888_REV,
+     row_expand_888_to_8888_swap_rb },
+
+   /* luminance expansion */
+   { GL_LUMINANCE, GL_UNSIGNED_BYTE, GL_LUMINANCE, MESA_FORMAT_ARGB8888,
+     row_l8_to_8888 },
+   { GL_LUMINANCE, GL_UNSIGNED_BYTE, GL_LUMINANCE, MESA_FORMAT_XRGB8888,
+     row_l8_to_8888 },
+   { GL_LUMINANCE, GL_UNSIGNED_BYTE, GL_LUMINANCE, MESA_FORMAT_RGBA8888_REV,
+     row_l8_to_8888 },
+   { GL_LUMINANCE, GL_UNSIGNED_BYTE, GL_LUMINANCE, MESA_FORMAT_RGBX8888_REV,
+     row_l8_to_8888 },
+   { GL_LUMINANCE, GL_UNSIGNED_BYTE, GL_LUMINANCE, MESA_FORMAT_AL88,
+     row_l8_to_88 },
+   { GL_LUMINANCE_ALPHA, GL_UNSIGNED_BYTE, GL_LUMINANCE_ALPHA,
+     MESA_FORMAT_ARGB8888, row_l8a8_to_8888 },
+   { GL_LUMINANCE_ALPHA, GL_UNSIGNED_BYTE, GL_LUMINANCE_ALPHA,
+     MESA_FORMAT_RGBA8888_REV, row_l8a8_to_8888 },
+
+   /* half float */
+   { GL_RGBA, GL_FLOAT, GL_RGBA, MESA_FORMAT_RGBA_FLOAT16,
+     row_float_to_half_4 },
+   { GL_RGB, GL_FLOAT, GL_RGB, MESA_FORMAT_RGB_FLOAT16,
+     row_float_to_half_3 },
+   { GL_RGB, GL_FLOAT, GL_RGB, MESA_FORMAT_RGBA_FLOAT16,
+     row_float_to_half_3_to_4 },
+   { GL_RGBA, GL_HALF_FLOAT_ARB, GL_RGBA, MESA_FORMAT_RGBA_FLOAT32,
+     row_half_to_float_4 },
+   { GL_RGB, GL_HALF_FLOAT_ARB, GL_RGB, MESA_FORMAT_RGB_FLOAT32,
+     row_half_to_float_3 },
+   { GL_RGB, GL_HALF_FLOAT_ARB, GL_RGB, MESA_FORMAT_RGBA_FLOAT32,
+     row_half_to_float_3_to_4 },
+};
+
+
+/**
+ * Find a direct row converter for the upload, if any.
+ */
+static TexstoreRowFunc
+texstore_find_row_func(struct gl_context *ctx,
+                       GLenum baseInternalFormat, gl_format dstFormat,
+                       GLenum srcFormat, GLenum srcType,
+                       const struct gl_pixelstore_attrib *srcPacking)
+{
+   GLuint i;
+
+   if (ctx->_ImageTransferState ||
+       srcPacking->SwapBytes ||
+       !_mesa_little_endian())
+      return NULL;
+
+   /* same memory layout as bytes on little endian hosts */
+   if (srcType == GL_UNSIGNED_INT_8_8_8_8_REV &&
+       (srcFormat == GL_RGBA || srcFormat == GL_BGRA))
+      srcType = GL_UNSIGNED_BYTE;
+
+   for (i = 0; i < Elements(texstore_row_funcs); i++) {
+      if (texstore_row_funcs[i].dstFormat == dstFormat &&
+          texstore_row_funcs[i].srcFormat == srcFormat &&
+          texstore_row_funcs[i].srcType == srcType &&
+          texstore_row_funcs[i].baseInternalFormat == baseInternalFormat)
+         return texstore_row_funcs[i].convert;
+   }
+
+   return NULL;
+}
+
+
+/**
+ * Store the image with a direct row converter.
+ */
+static void
+texstore_rows(TexstoreRowFunc convert, TEXSTORE_PARAMS)
+{
+   const GLint srcRowStride = _mesa_image_row_stride(srcPacking, srcWidth,
+                                                     srcFormat, srcType);
+   const GLuint texelBytes = _mesa_get_format_bytes(dstFormat);
+   GLint img, row;
+
+   for (img = 0; img < srcDepth; img++) {
+      const GLubyte *srcRow = (const GLubyte *)
+         _mesa_image_address(dims, srcPacking, srcAddr,
+                             srcWidth, srcHeight, srcFormat, srcType,
+                             img, 0, 0);
+      GLubyte *dstRow = dstSlices[dstZoffset + img]
+         + dstYoffset * dstRowStride
+         + dstXoffset * texelBytes;
+
+      for (row = 0; row < srcHeight; row++) {
+         convert(dstRow, srcRow, srcWidth);
+         dstRow += dstRowStride;
+         srcRow += srcRowStride;
+      }
+   }
+}
+
+
 /**
  * Store user data into texture memory.
  * Called via glTex[Sub]Image1/2/3D()
@@ -4523,8 +4920,20 @@ GLboolean
 _mesa_texstore(TEXSTORE_PARAMS)
 {
    StoreTexImageFunc storeImage;
+   TexstoreRowFunc convertRow;
    GLboolean success;
 
+   convertRow = texstore_find_row_func(ctx, baseInternalFormat, dstFormat,
+                                       srcFormat, srcType, srcPacking);
+   if (convertRow) {
+      texstore_rows(convertRow, ctx, dims, baseInternalFormat,
+                    dstFormat, dstXoffset, dstYoffset, dstZoffset,
+                    dstRowStride, dstSlices,
+                    srcWidth, srcHeight, srcDepth,
+                    srcFormat, srcType, srcAddr, srcPacking);
+      return GL_TRUE;
+   }
+
    storeImage = _mesa_get_texstore_func(dstFormat);
 
    success = storeImage(ctx, dims, baseInternalFormat,
@@ -53,6 +53,8 @@ MAIN_SOURCES = \
 	main/imports.c \
 	main/light.c \
 	main/lines.c \
+	main/marshal.c \
+	main/marshal_generated.c \
 	main/matrix.c \
 	main/mipmap.c \
 	main/mm.c \
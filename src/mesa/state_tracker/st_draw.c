@@ -60,6 +60,7 @@
 #include "util/u_format.h"
 #include "util/u_prim.h"
 #include "util/u_draw_quad.h"
+#include "util/u_sse.h"
 #include "draw/draw_context.h"
 #include "cso_cache/cso_context.h"
 
@@ -674,6 +675,75 @@ struct sub_primitive
 };
 
 
+/**
+ * Return the position of the first restart index in elements[i..end),
+ * or end if there's none.  The SSE2 path compares 16 bytes of indices at
+ * a time, which makes scanning long restart-free runs cheap.
+ */
+static unsigned
+find_restart_index(const void *elements, unsigned element_size,
+                   unsigned i, unsigned end, unsigned restart_index)
+{
+#define SCAN_ELEMENTS(TYPE) \
+   do { \
+      const TYPE *e = (const TYPE *) elements; \
+      for (; i < end; i++) { \
+         if (e[i] == restart_index) \
+            return i; \
+      } \
+   } while (0)
+
+#if defined(PIPE_ARCH_SSE)
+#define SCAN_ELEMENTS_SSE2(TYPE, CMPEQ, SET1) \
+   do { \
+      const TYPE *e = (const TYPE *) elements; \
+      const __m128i restart = SET1((TYPE) restart_index); \
+      const unsigned n = 16 / sizeof(TYPE); \
+      if (restart_index != (TYPE) restart_index) \
+         return end; \
+      for (; i + n <= end; i += n) { \
+         __m128i v = _mm_loadu_si128((const __m128i *) (e + i)); \
+         int mask = _mm_movemask_epi8(CMPEQ(v, restart)); \
+         if (mask) \
+            return i + (ffs(mask) - 1) / sizeof(TYPE); \
+      } \
+   } while (0)
+
+   switch (element_size) {
+   case 1:
+      SCAN_ELEMENTS_SSE2(ubyte, _mm_cmpeq_epi8, _mm_set1_epi8);
+      break;
+   case 2:
+      SCAN_ELEMENTS_SSE2(ushort, _mm_cmpeq_epi16, _mm_set1_epi16);
+      break;
+   case 4:
+      SCAN_ELEMENTS_SSE2(uint, _mm_cmpeq_epi32, _mm_set1_epi32);
+      break;
+   }
+
+#undef SCAN_ELEMENTS_SSE2
+#endif
+
+   switch (element_size) {
+   case 1:
+      SCAN_ELEMENTS(ubyte);
+      break;
+   case 2:
+      SCAN_ELEMENTS(ushort);
+      break;
+   case 4:
+      SCAN_ELEMENTS(uint);
+      break;
+   default:
+      assert(0 && "bad index_size in find_restart_index()");
+   }
+
+#undef SCAN_ELEMENTS
+
+   return end;
+}
+
+
 /**
  * Scan the elements array to find restart indexes.  Return a list
  * of primitive (start,count) pairs to indicate how to draw the sub-
@@ -686,7 +756,7 @@ find_sub_primitives(const void *elements, unsigned element_size,
 {
    const unsigned max_prims = end - start;
    struct sub_primitive *sub_prims;
-   unsigned i, cur_start, cur_count, num;
+   unsigned i, num;
 
    sub_prims = (struct sub_primitive *)
       malloc(max_prims * sizeof(struct sub_primitive));
@@ -696,49 +766,20 @@ find_sub_primitives(const void *elements, unsigned element_size,
       return NULL;
    }
 
-   cur_start = start;
-   cur_count = 0;
    num = 0;
 
-#define SCAN_ELEMENTS(TYPE) \
-   for (i = start; i < end; i++) { \
-      if (((const TYPE *) elements)[i] == restart_index) { \
-         if (cur_count > 0) { \
-            assert(num < max_prims); \
-            sub_prims[num].start = cur_start; \
-            sub_prims[num].count = cur_count; \
-            num++; \
-         } \
-         cur_start = i + 1; \
-         cur_count = 0; \
-      } \
-      else { \
-         cur_count++; \
-      } \
-   } \
-   if (cur_count > 0) { \
-      assert(num < max_prims); \
-      sub_prims[num].start = cur_start; \
-      sub_prims[num].count = cur_count; \
-      num++; \
-   }
-
-   switch (element_size) {
-   case 1:
-      SCAN_ELEMENTS(ubyte);
-      break;
-   case 2:
-      SCAN_ELEMENTS(ushort);
-      break;
-   case 4:
-      SCAN_ELEMENTS(uint);
-      break;
-   default:
-      assert(0 && "bad index_size in find_sub_primitives()");
+   for (i = start; i < end; ) {
+      unsigned next = find_restart_index(elements, element_size,
+                                         i, end, restart_index);
+      if (next > i) {
+         assert(num < max_prims);
+         sub_prims[num].start = i;
+         sub_prims[num].count = next - i;
+         num++;
+      }
+      i = next + 1;
    }
 
-#undef SCAN_ELEMENTS
-
    *num_sub_prims = num;
 
    return sub_prims;
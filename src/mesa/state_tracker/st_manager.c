@@ -39,6 +39,7 @@
 #include "main/mtypes.h"
 #include "main/context.h"
 #include "main/mfeatures.h"
+#include "main/marshal.h"
 #include "main/texobj.h"
 #include "main/teximage.h"
 #include "main/texstate.h"
@@ -514,6 +515,10 @@ st_context_flush(struct st_context_iface *stctxi, unsigned flags,
                  struct pipe_fence_handle **fence)
 {
    struct st_context *st = (struct st_context *) stctxi;
+
+   /* Called by the window system: run the commands queued so far */
+   _mesa_glthread_finish(st->ctx);
+
    st_flush(st, fence);
    if (flags & ST_FLUSH_FRONT)
       st_manager_flush_frontbuffer(st);
@@ -535,6 +540,8 @@ st_context_teximage(struct st_context_iface *stctxi,
    GLenum internalFormat;
    GLuint width, height, depth;
 
+   _mesa_glthread_finish(ctx);
+
    switch (target) {
    case ST_TEXTURE_1D:
       target = GL_TEXTURE_1D;
@@ -631,6 +638,8 @@ st_context_copy(struct st_context_iface *stctxi,
    struct st_context *st = (struct st_context *) stctxi;
    struct st_context *src = (struct st_context *) stsrci;
 
+   _mesa_glthread_finish(src->ctx);
+   _mesa_glthread_finish(st->ctx);
    _mesa_copy_context(src->ctx, st->ctx, mask);
 }
 
@@ -28,6 +28,7 @@
 
 #include "main/api_arrayelt.h"
 #include "main/glheader.h"
+#include "main/imports.h"
 #include "main/mtypes.h"
 #include "main/vtxfmt.h"
 #include "vbo_context.h"
@@ -40,6 +41,8 @@ void vbo_exec_init( struct gl_context *ctx )
 
    exec->ctx = ctx;
 
+   exec->dump_stats = _mesa_getenv("MESA_VBO_STATS") != NULL;
+
    /* Initialize the arrayelt helper
     */
    if (!ctx->aelt_context &&
@@ -62,10 +65,41 @@ void vbo_exec_init( struct gl_context *ctx )
 }
 
 
+/**
+ * Print the immediate mode statistics, to tell why vertex batches are
+ * broken up.
+ */
+static void vbo_exec_dump_stats( const struct vbo_exec_context *exec )
+{
+   static const char *reasons[VBO_FLUSH_NUM_REASONS] = {
+      "state change",
+      "buffer full",
+      "primitives full",
+      "vertex format",
+      "glBegin"
+   };
+   GLuint i, draws = 0;
+
+   for (i = 0; i < VBO_FLUSH_NUM_REASONS; i++)
+      draws += exec->stats.flushes[i];
+
+   fprintf(stderr, "vbo: %u glBegin/glEnd, %u merged, %u vertices, "
+           "%u draws\n", exec->stats.prims, exec->stats.merged,
+           exec->stats.verts, draws);
+
+   for (i = 0; i < VBO_FLUSH_NUM_REASONS; i++)
+      fprintf(stderr, "vbo:   %-16s %u\n", reasons[i],
+              exec->stats.flushes[i]);
+}
+
+
 void vbo_exec_destroy( struct gl_context *ctx )
 {
    struct vbo_exec_context *exec = &vbo_context(ctx)->exec;
 
+   if (exec->dump_stats)
+      vbo_exec_dump_stats( exec );
+
    if (ctx->aelt_context) {
       _ae_destroy_context( ctx );
       ctx->aelt_context = NULL;
@@ -49,7 +49,18 @@ USE OR OTHER DEALINGS IN THE SOFTWARE.
 /**
  * Size of the VBO to use for glBegin/glVertex/glEnd-style rendering.
  */
-#define VBO_VERT_BUFFER_SIZE (1024*64)	/* bytes */
+#define VBO_VERT_BUFFER_SIZE (1024*256)	/* bytes */
+
+
+/** Why a batch of immediate mode vertices was drawn */
+enum vbo_flush_reason {
+   VBO_FLUSH_STATE,           /**< state change, query, SwapBuffers... */
+   VBO_FLUSH_BUFFER_FULL,     /**< vertex buffer full */
+   VBO_FLUSH_PRIM_FULL,       /**< VBO_MAX_PRIM primitives queued */
+   VBO_FLUSH_VERTEX_FORMAT,   /**< attribute added or enlarged */
+   VBO_FLUSH_BEGIN,           /**< glBegin isolating attribs set outside */
+   VBO_FLUSH_NUM_REASONS
+};
 
 
 /** Current vertex program mode */
@@ -138,6 +149,15 @@ struct vbo_exec_context
    /* Which flags to set in vbo_exec_BeginVertices() */
    GLbitfield begin_vertices_flags;
 
+   /** Immediate mode statistics, printed at exit if MESA_VBO_STATS is set */
+   struct {
+      GLuint flushes[VBO_FLUSH_NUM_REASONS];  /**< draws, by reason */
+      GLuint prims;     /**< glBegin/glEnd pairs */
+      GLuint merged;    /**< of which merged into the previous primitive */
+      GLuint verts;     /**< vertices drawn */
+   } stats;
+   GLboolean dump_stats;
+
 #ifdef DEBUG
    GLint flush_call_depth;
 #endif
@@ -166,13 +186,15 @@ void vbo_exec_vtx_destroy( struct vbo_exec_context *exec );
 
 #if FEATURE_beginend
 
-void vbo_exec_vtx_flush( struct vbo_exec_context *exec, GLboolean unmap );
+void vbo_exec_vtx_flush( struct vbo_exec_context *exec, GLboolean unmap,
+                         enum vbo_flush_reason reason );
 void vbo_exec_vtx_map( struct vbo_exec_context *exec );
 
 #else /* FEATURE_beginend */
 
 static inline void
-vbo_exec_vtx_flush( struct vbo_exec_context *exec, GLboolean unmap )
+vbo_exec_vtx_flush( struct vbo_exec_context *exec, GLboolean unmap,
+                    enum vbo_flush_reason reason )
 {
 }
 
@@ -64,7 +64,8 @@ static void reset_attrfv( struct vbo_exec_context *exec );
  * Close off the last primitive, execute the buffer, restart the
  * primitive.  
  */
-static void vbo_exec_wrap_buffers( struct vbo_exec_context *exec )
+static void vbo_exec_wrap_buffers( struct vbo_exec_context *exec,
+                                   enum vbo_flush_reason reason )
 {
    if (exec->vtx.prim_count == 0) {
       exec->vtx.copied.nr = 0;
@@ -87,7 +88,7 @@ static void vbo_exec_wrap_buffers( struct vbo_exec_context *exec )
       /* Execute the buffer and save copied vertices.
        */
       if (exec->vtx.vert_count)
-	 vbo_exec_vtx_flush( exec, GL_FALSE );
+	 vbo_exec_vtx_flush( exec, GL_FALSE, reason );
       else {
 	 exec->vtx.prim_count = 0;
 	 exec->vtx.copied.nr = 0;
@@ -122,7 +123,7 @@ void vbo_exec_vtx_wrap( struct vbo_exec_context *exec )
    /* Run pipeline on current vertices, copy wrapped vertices
     * to exec->vtx.copied.
     */
-   vbo_exec_wrap_buffers( exec );
+   vbo_exec_wrap_buffers( exec, VBO_FLUSH_BUFFER_FULL );
    
    /* Copy stored stored vertices to start of new list. 
     */
@@ -240,7 +241,7 @@ vbo_exec_wrap_upgrade_vertex(struct vbo_exec_context *exec,
    /* Run pipeline on current vertices, copy wrapped vertices
     * to exec->vtx.copied.
     */
-   vbo_exec_wrap_buffers( exec );
+   vbo_exec_wrap_buffers( exec, VBO_FLUSH_VERTEX_FORMAT );
 
    if (unlikely(exec->vtx.copied.nr)) {
       /* We're in the middle of a primitive, keep the old vertex
@@ -438,10 +439,11 @@ do {									\
  * \param  unmap - leave VBO unmapped after flushing?
  */
 static void
-vbo_exec_FlushVertices_internal(struct vbo_exec_context *exec, GLboolean unmap)
+vbo_exec_FlushVertices_internal(struct vbo_exec_context *exec, GLboolean unmap,
+                                enum vbo_flush_reason reason)
 {
    if (exec->vtx.vert_count || unmap) {
-      vbo_exec_vtx_flush( exec, unmap );
+      vbo_exec_vtx_flush( exec, unmap, reason );
    }
 
    if (exec->vtx.vertex_size) {
@@ -719,7 +721,7 @@ static void GLAPIENTRY vbo_exec_Begin( GLenum mode )
        * begin/end pairs.
        */
       if (exec->vtx.vertex_size && !exec->vtx.attrsz[0]) 
-	 vbo_exec_FlushVertices_internal(exec, GL_FALSE);
+	 vbo_exec_FlushVertices_internal(exec, GL_FALSE, VBO_FLUSH_BEGIN);
 
       i = exec->vtx.prim_count++;
       exec->vtx.prim[i].mode = mode;
@@ -740,6 +742,45 @@ static void GLAPIENTRY vbo_exec_Begin( GLenum mode )
 }
 
 
+/**
+ * Check if two consecutive, complete primitives can be drawn as one: they
+ * must be independent points, lines, triangles or quads with the same
+ * flags, the second one's vertices following the first one's.
+ */
+static GLboolean
+vbo_exec_can_merge_prims(const struct _mesa_prim *p0,
+                         const struct _mesa_prim *p1)
+{
+   if (!p0->begin || !p0->end || !p1->begin || !p1->end)
+      return GL_FALSE;
+
+   if (p0->mode != p1->mode ||
+       p0->weak != p1->weak ||
+       p0->no_current_update != p1->no_current_update ||
+       p0->num_instances != p1->num_instances)
+      return GL_FALSE;
+
+   if (p0->start + p0->count != p1->start)
+      return GL_FALSE;
+
+   /* Leftover vertices of an incomplete primitive would combine with the
+    * next primitive's vertices.
+    */
+   switch (p0->mode) {
+   case GL_POINTS:
+      return GL_TRUE;
+   case GL_LINES:
+      return p0->count % 2 == 0 && p1->count % 2 == 0;
+   case GL_TRIANGLES:
+      return p0->count % 3 == 0 && p1->count % 3 == 0;
+   case GL_QUADS:
+      return p0->count % 4 == 0 && p1->count % 4 == 0;
+   default:
+      return GL_FALSE;
+   }
+}
+
+
 /**
  * Called via glEnd.
  */
@@ -757,12 +798,25 @@ static void GLAPIENTRY vbo_exec_End( void )
 
          exec->vtx.prim[i].end = 1; 
          exec->vtx.prim[i].count = idx - exec->vtx.prim[i].start;
+
+         exec->stats.prims++;
+
+         /* Fold it into the previous primitive if drawing both at once
+          * gives the same result.
+          */
+         if (i > 0 &&
+             vbo_exec_can_merge_prims(&exec->vtx.prim[i - 1],
+                                      &exec->vtx.prim[i])) {
+            exec->vtx.prim[i - 1].count += exec->vtx.prim[i].count;
+            exec->vtx.prim_count--;
+            exec->stats.merged++;
+         }
       }
 
       ctx->Driver.CurrentExecPrimitive = PRIM_OUTSIDE_BEGIN_END;
 
       if (exec->vtx.prim_count == VBO_MAX_PRIM)
-	 vbo_exec_vtx_flush( exec, GL_FALSE );
+	 vbo_exec_vtx_flush( exec, GL_FALSE, VBO_FLUSH_PRIM_FULL );
    }
    else 
       _mesa_error( ctx, GL_INVALID_OPERATION, "glEnd" );
@@ -1190,7 +1244,7 @@ void vbo_exec_FlushVertices( struct gl_context *ctx, GLuint flags )
    }
 
    /* Flush (draw), and make sure VBO is left unmapped when done */
-   vbo_exec_FlushVertices_internal(exec, GL_TRUE);
+   vbo_exec_FlushVertices_internal(exec, GL_TRUE, VBO_FLUSH_STATE);
 
    /* Need to do this to ensure BeginVertices gets called again:
     */
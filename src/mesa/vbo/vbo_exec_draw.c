@@ -373,9 +373,11 @@ vbo_exec_vtx_map( struct vbo_exec_context *exec )
 /**
  * Execute the buffer and save copied verts.
  * \param keep_unmapped  if true, leave the VBO unmapped when we're done.
+ * \param reason  why the vertices are drawn now, for statistics
  */
 void
-vbo_exec_vtx_flush(struct vbo_exec_context *exec, GLboolean keepUnmapped)
+vbo_exec_vtx_flush(struct vbo_exec_context *exec, GLboolean keepUnmapped,
+                   enum vbo_flush_reason reason)
 {
    if (0)
       vbo_exec_debug_verts( exec );
@@ -413,6 +415,9 @@ vbo_exec_vtx_flush(struct vbo_exec_context *exec, GLboolean keepUnmapped)
 				       0,
 				       exec->vtx.vert_count - 1);
 
+         exec->stats.flushes[reason]++;
+         exec->stats.verts += exec->vtx.vert_count;
+
 	 /* If using a real VBO, get new storage -- unless asked not to.
           */
          if (_mesa_is_bufferobj(exec->vtx.bufferobj) && !keepUnmapped) {
@@ -81,6 +81,12 @@ struct vbo_save_vertex_list {
    struct _mesa_prim *prim;
    GLuint prim_count;
 
+   /* Object space bounding box of the vertex positions, used to skip
+    * drawing lists which are entirely outside of the view volume.
+    */
+   GLfloat bbox[2][3];
+   GLboolean bbox_valid;
+
    struct vbo_save_vertex_store *vertex_store;
    struct vbo_save_primitive_store *prim_store;
 };
@@ -149,6 +155,7 @@ struct vbo_save_context {
    GLuint vert_count;
    GLuint max_vert;
    GLboolean dangling_attr_ref;
+   GLboolean no_current_update;   /**< Last list didn't update current */
 
    GLuint opcode_vertex_list;
 
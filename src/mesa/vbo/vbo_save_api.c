@@ -306,48 +306,56 @@ _save_reset_counters(struct gl_context *ctx)
 
 
 /**
- * Insert the active immediate struct onto the display list currently
- * being built.
+ * Compute the bounding box of the positions of the current run of
+ * vertices.  Only plain (x,y[,z][,1]) positions are handled.
  */
-static void
-_save_compile_vertex_list(struct gl_context *ctx)
+static GLboolean
+_save_compute_bbox(const struct vbo_save_context *save, GLfloat bbox[2][3])
 {
-   struct vbo_save_context *save = &vbo_context(ctx)->save;
-   struct vbo_save_vertex_list *node;
+   const GLuint sz = save->attrsz[VBO_ATTRIB_POS];
+   const GLfloat *v = save->buffer;
+   GLuint i, j;
 
-   /* Allocate space for this structure in the display list currently
-    * being compiled.
-    */
-   node = (struct vbo_save_vertex_list *)
-      _mesa_dlist_alloc(ctx, save->opcode_vertex_list, sizeof(*node));
+   if (sz < 2 || save->vert_count == 0)
+      return GL_FALSE;
 
-   if (!node)
-      return;
+   ASSIGN_3V(bbox[0], v[0], v[1], sz > 2 ? v[2] : 0.0F);
+   COPY_3V(bbox[1], bbox[0]);
 
-   /* Duplicate our template, increment refcounts to the storage structs:
-    */
-   memcpy(node->attrsz, save->attrsz, sizeof(node->attrsz));
-   node->vertex_size = save->vertex_size;
-   node->buffer_offset =
-      (save->buffer - save->vertex_store->buffer) * sizeof(GLfloat);
-   node->count = save->vert_count;
-   node->wrap_count = save->copied.nr;
-   node->dangling_attr_ref = save->dangling_attr_ref;
-   node->prim = save->prim;
-   node->prim_count = save->prim_count;
-   node->vertex_store = save->vertex_store;
-   node->prim_store = save->prim_store;
-
-   node->vertex_store->refcount++;
-   node->prim_store->refcount++;
+   for (i = 0; i < save->vert_count; i++, v += save->vertex_size) {
+      if (sz == 4 && v[3] != 1.0F)
+         return GL_FALSE;
+
+      for (j = 0; j < MIN2(sz, 3); j++) {
+         bbox[0][j] = MIN2(bbox[0][j], v[j]);
+         bbox[1][j] = MAX2(bbox[1][j], v[j]);
+      }
+   }
+
+   return GL_TRUE;
+}
+
+
+/**
+ * Keep a copy of the final vertex of the list in regular memory for
+ * updating the current values at playback.
+ */
+static void
+_save_update_current_data(struct gl_context *ctx,
+                          struct vbo_save_vertex_list *node)
+{
+   struct vbo_save_context *save = &vbo_context(ctx)->save;
+
+   if (node->current_data) {
+      FREE(node->current_data);
+      node->current_data = NULL;
+   }
 
    if (node->prim[0].no_current_update) {
       node->current_size = 0;
-      node->current_data = NULL;
    }
    else {
       node->current_size = node->vertex_size - node->attrsz[0];
-      node->current_data = NULL;
 
       if (node->current_size) {
          /* If the malloc fails, we just pull the data out of the VBO
@@ -369,32 +377,149 @@ _save_compile_vertex_list(struct gl_context *ctx)
          }
       }
    }
+}
+
+
+/**
+ * If the last instruction of the display list is a vertex list which
+ * the current run of vertices directly follows in the same storage,
+ * append the new primitives to it instead of starting a new list.  This
+ * turns sequences of glBegin/glEnd pairs separated only by redundant
+ * state changes into a single draw at playback.
+ */
+static struct vbo_save_vertex_list *
+_save_merge_vertex_list(struct gl_context *ctx)
+{
+   struct vbo_save_context *save = &vbo_context(ctx)->save;
+   struct vbo_save_vertex_list *node;
+   GLfloat bbox[2][3];
+   GLuint i;
+
+   if (save->copied.nr || save->prim_count == 0 || !save->prim[0].begin)
+      return NULL;
+
+   node = (struct vbo_save_vertex_list *)
+      _mesa_dlist_last_alloc(ctx, save->opcode_vertex_list);
+
+   if (!node ||
+       node->vertex_store != save->vertex_store ||
+       node->prim_store != save->prim_store ||
+       node->prim + node->prim_count != save->prim ||
+       node->buffer_offset +
+          node->count * node->vertex_size * sizeof(GLfloat) !=
+          (save->buffer - save->vertex_store->buffer) * sizeof(GLfloat) ||
+       node->vertex_size != save->vertex_size ||
+       memcmp(node->attrsz, save->attrsz, sizeof(node->attrsz)) != 0 ||
+       node->prim_count == 0 ||
+       !node->prim[node->prim_count - 1].end ||
+       node->prim[0].no_current_update != save->prim[0].no_current_update)
+      return NULL;
+
+   for (i = 0; i < save->prim_count; i++)
+      save->prim[i].start += node->count;
+
+   if (node->bbox_valid && _save_compute_bbox(save, bbox)) {
+      for (i = 0; i < 3; i++) {
+         node->bbox[0][i] = MIN2(node->bbox[0][i], bbox[0][i]);
+         node->bbox[1][i] = MAX2(node->bbox[1][i], bbox[1][i]);
+      }
+   }
+   else {
+      node->bbox_valid = GL_FALSE;
+   }
+
+   node->count += save->vert_count;
+   node->prim_count += save->prim_count;
+   node->dangling_attr_ref |= save->dangling_attr_ref;
+
+   return node;
+}
+
+
+/**
+ * Insert the active immediate struct onto the display list currently
+ * being built.
+ */
+static void
+_save_compile_vertex_list(struct gl_context *ctx)
+{
+   struct vbo_save_context *save = &vbo_context(ctx)->save;
+   struct vbo_save_vertex_list *node;
+   const GLuint wrap_count = save->copied.nr;
+   const GLfloat *buffer;
+   GLuint i;
+
+   node = _save_merge_vertex_list(ctx);
+
+   if (!node) {
+      /* Allocate space for this structure in the display list currently
+       * being compiled.
+       */
+      node = (struct vbo_save_vertex_list *)
+         _mesa_dlist_alloc(ctx, save->opcode_vertex_list, sizeof(*node));
+
+      if (!node)
+         return;
+
+      /* Duplicate our template, increment refcounts to the storage structs:
+       */
+      memcpy(node->attrsz, save->attrsz, sizeof(node->attrsz));
+      node->vertex_size = save->vertex_size;
+      node->buffer_offset =
+         (save->buffer - save->vertex_store->buffer) * sizeof(GLfloat);
+      node->count = save->vert_count;
+      node->wrap_count = wrap_count;
+      node->dangling_attr_ref = save->dangling_attr_ref;
+      node->prim = save->prim;
+      node->prim_count = save->prim_count;
+      node->bbox_valid = _save_compute_bbox(save, node->bbox);
+      node->vertex_store = save->vertex_store;
+      node->prim_store = save->prim_store;
+      node->current_data = NULL;
+
+      node->vertex_store->refcount++;
+      node->prim_store->refcount++;
+   }
+
+   _save_update_current_data(ctx, node);
 
    assert(node->attrsz[VBO_ATTRIB_POS] != 0 || node->count == 0);
 
    if (save->dangling_attr_ref)
       ctx->ListState.CurrentList->Flags |= DLIST_DANGLING_REFS;
 
-   save->vertex_store->used += save->vertex_size * node->count;
-   save->prim_store->used += node->prim_count;
+   /* Remember whether the list leaves the current values untouched, so
+    * that the values tracked in ctx->ListState can be marked unknown.
+    */
+   save->no_current_update = GL_FALSE;
+   for (i = 0; i < save->prim_count; i++) {
+      if (save->prim[i].no_current_update)
+         save->no_current_update = GL_TRUE;
+   }
+
+   save->vertex_store->used += save->vertex_size * save->vert_count;
+   save->prim_store->used += save->prim_count;
+
+   /* Primitive starts are relative to the start of the (possibly merged)
+    * node:
+    */
+   buffer = (const GLfloat *) ((const char *) save->vertex_store->buffer +
+                               node->buffer_offset);
 
    /* Copy duplicated vertices 
     */
-   save->copied.nr = _save_copy_vertices(ctx, node, save->buffer);
+   save->copied.nr = _save_copy_vertices(ctx, node, buffer);
 
-   /* Deal with GL_COMPILE_AND_EXECUTE:
+   /* Deal with GL_COMPILE_AND_EXECUTE, only the primitives added now:
     */
    if (ctx->ExecuteFlag) {
       struct _glapi_table *dispatch = GET_DISPATCH();
 
       _glapi_set_dispatch(ctx->Exec);
 
-      vbo_loopback_vertex_list(ctx,
-                               (const GLfloat *) ((const char *) save->
-                                                  vertex_store->buffer +
-                                                  node->buffer_offset),
-                               node->attrsz, node->prim, node->prim_count,
-                               node->wrap_count, node->vertex_size);
+      vbo_loopback_vertex_list(ctx, buffer, node->attrsz,
+                               save->prim, save->prim_count,
+                               wrap_count, node->vertex_size);
 
       _glapi_set_dispatch(dispatch);
    }
@@ -511,7 +636,10 @@ _save_copy_to_current(struct gl_context *ctx)
 
    for (i = VBO_ATTRIB_POS + 1; i < VBO_ATTRIB_MAX; i++) {
       if (save->attrsz[i]) {
-         save->currentsz[i][0] = save->attrsz[i];
+         /* Lists from glDrawArrays/Elements don't update the current
+          * values at playback, so they are unknown afterwards.
+          */
+         save->currentsz[i][0] = save->no_current_update ? 0 : save->attrsz[i];
          COPY_CLEAN_4V(save->current[i], save->attrsz[i], save->attrptr[i]);
       }
    }
@@ -237,6 +237,62 @@ vbo_save_loopback_vertex_list(struct gl_context *ctx,
 }
 
 
+/**
+ * Return true if the list can't produce any fragments because its
+ * bounding box is entirely outside one of the view volume planes.
+ * Only plain fixed function rendering of filled polygons is considered,
+ * where nothing but the fragments is observable.
+ */
+static GLboolean
+vbo_save_list_is_culled(struct gl_context *ctx,
+                        const struct vbo_save_vertex_list *node)
+{
+   const GLfloat *m = ctx->_ModelProjectMatrix.m;
+   const GLuint planes = ctx->Transform.DepthClamp ? 4 : 6;
+   GLuint outside[6] = { 0, 0, 0, 0, 0, 0 };
+   GLuint i, p;
+
+   if (!node->bbox_valid ||
+       get_program_mode(ctx) != VP_NONE ||
+       ctx->RenderMode != GL_RENDER ||
+       ctx->Query.PrimitivesGenerated ||
+       ctx->Query.PrimitivesWritten ||
+       ctx->TransformFeedback.CurrentObject->Active ||
+       ctx->Polygon.FrontMode != GL_FILL ||
+       ctx->Polygon.BackMode != GL_FILL)
+      return GL_FALSE;
+
+   for (i = 0; i < node->prim_count; i++) {
+      if (node->prim[i].mode < GL_TRIANGLES)
+         return GL_FALSE;
+   }
+
+   for (i = 0; i < 8; i++) {
+      const GLfloat x = node->bbox[i & 1][0];
+      const GLfloat y = node->bbox[(i >> 1) & 1][1];
+      const GLfloat z = node->bbox[(i >> 2) & 1][2];
+      GLfloat c[4];
+
+      for (p = 0; p < 4; p++)
+         c[p] = m[p] * x + m[4 + p] * y + m[8 + p] * z + m[12 + p];
+
+      /* -w <= x,y,z <= w */
+      for (p = 0; p < planes; p++) {
+         const GLfloat d = (p & 1) ? c[3] - c[p >> 1] : c[3] + c[p >> 1];
+         if (d < 0.0F)
+            outside[p]++;
+      }
+   }
+
+   for (p = 0; p < planes; p++) {
+      if (outside[p] == 8)
+         return GL_TRUE;
+   }
+
+   return GL_FALSE;
+}
+
+
 /**
  * Execute the buffer and save copied verts.
  * This is called from the display list code when executing
@@ -291,7 +347,7 @@ vbo_save_playback_vertex_list(struct gl_context *ctx, void *data)
       if (ctx->NewState)
 	 _mesa_update_state( ctx );
 
-      if (node->count > 0) {
+      if (node->count > 0 && !vbo_save_list_is_culled(ctx, node)) {
          vbo_context(ctx)->draw_prims(ctx, 
                                       save->inputs, 
                                       node->prim, 